@@ -0,0 +1,151 @@
+/*
+  -------------------------------------------------------------------------
+
+  Copyright 2015 roxlu <info#AT#roxlu.com>
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  -------------------------------------------------------------------------
+
+
+
+  Analytics
+  =========
+
+  Statistics of the luma (Y) of a frame, for services that watch the
+  health of a screen, e.g. to raise an alert when a display turns
+  black, freezes on a single color or shows a "blue screen", without
+  copying or decoding the frames themselves. `FrameAnalyzer` computes
+  a `FrameStats`:
+
+      histogram          The number of pixels per luma value.
+      mean, variance     Of the luma of the whole frame.
+      tile_mean,         Of every tile of a SC_STATS_TILE_COLS x
+      tile_variance      SC_STATS_TILE_ROWS grid over the frame; a
+                         frozen or broken part of the screen stands out.
+      peak_luma,         The most common luma value and the part of the
+      peak_fraction      pixels within SC_STATS_PEAK_RANGE of it.
+      is_uniform         Nearly every pixel has the peak luma: a single
+                         color screen, maybe with a pointer or a line
+                         of text on it.
+      is_blank           Uniform and black.
+
+  Set `Settings::frame_stats` and every frame that you receive has the
+  SC_FRAME_HAS_STATS flag and the `FrameInfo::stats` of the frame. The
+  statistics describe the frame before we apply masks and overlays,
+  so a masked region doesn't look like a black screen. The levels of
+  a pyramid carry the stats of the full frame.
+
+  ````c++
+
+      void on_frame(sc::PixelBuffer& buffer) {
+        if (NULL != buffer.info && (buffer.info->flags & SC_FRAME_HAS_STATS)) {
+          if (buffer.info->stats.is_blank) {
+            alert("display is black");
+          }
+        }
+      }
+
+  ````
+
+  Cost: when we convert a frame (see Convert.h) we compute the stats
+  of every slice right after we converted it, so the luma rows are
+  still in the cache. Converting into YCbCr computes Y anyway; for
+  RGB frames we compute Y per row with `kernel_bgra_to_luma_row()`,
+  the same Y that a conversion with the same SC_CONVERT_* flags
+  would give. `kernel_luma_stats_row()` sums the samples and their
+  squares with SIMD; the histogram is counted per sample. When we
+  don't convert, `analyze()` makes a separate pass in the same slices,
+  on the threads of the `Executor` when you pass one.
+
+  Luma values are the Y samples of the YCbCr frames and the Y that
+  the SC_CONVERT_* flags give for RGB frames: video range (16 - 235)
+  unless the format or flags are full range; `black_level` tells which.
+
+  Supported pixel formats: SC_BGRA, SC_RGBA, SC_420V, SC_420F and
+  SC_I420.
+
+ */
+#ifndef SCREEN_CAPTURE_ANALYTICS_H
+#define SCREEN_CAPTURE_ANALYTICS_H
+
+#include <vector>
+#include <screencapture/Types.h>
+#include <screencapture/Kernels.h>
+
+#define SC_STATS_TILE_COLS 8                                     /* The number of columns of the grid of tiles. */
+#define SC_STATS_TILE_ROWS 8                                     /* The number of rows of the grid of tiles. */
+#define SC_STATS_PEAK_RANGE 4                                    /* Luma values within this distance of the peak count as the peak, see `FrameStats::peak_fraction`. */
+#define SC_STATS_UNIFORM_FRACTION 0.99f                          /* A frame is uniform when at least this part of its pixels is within SC_STATS_PEAK_RANGE of the peak. */
+#define SC_STATS_BLANK_LUMA 16                                   /* A uniform frame is blank when its peak is at most this much brighter than black. */
+
+namespace sc {
+
+  class Executor;
+
+  /* ----------------------------------------------------------- */
+
+  class FrameStats {
+  public:
+    FrameStats();
+
+  public:
+    uint32_t histogram[256];                                     /* The number of pixels per luma value. */
+    float mean;                                                  /* The mean luma. */
+    float variance;                                              /* The variance of the luma. */
+    float tile_mean[SC_STATS_TILE_ROWS][SC_STATS_TILE_COLS];     /* The mean luma per tile; tile column c covers the pixels x with x * SC_STATS_TILE_COLS / width == c, rows likewise. Tiles without pixels (tiny frames) are 0. */
+    float tile_variance[SC_STATS_TILE_ROWS][SC_STATS_TILE_COLS]; /* The variance of the luma per tile. */
+    int black_level;                                             /* The luma of black: 16 for video range, 0 for full range. */
+    int peak_luma;                                               /* The most common luma value. */
+    float peak_fraction;                                         /* The part of the pixels (0 - 1) with a luma within SC_STATS_PEAK_RANGE of `peak_luma`. */
+    int is_uniform;                                              /* 1 when `peak_fraction` >= SC_STATS_UNIFORM_FRACTION, otherwise 0. */
+    int is_blank;                                                /* 1 when the frame is uniform and `peak_luma` <= `black_level` + SC_STATS_BLANK_LUMA, otherwise 0. */
+  };
+
+  /* ----------------------------------------------------------- */
+
+  /* The sums of one thread. */
+  struct AnalyzerScratch {
+    uint32_t histogram[256 * 4];                                 /* See `kernel_luma_stats_row()`. */
+    uint64_t tile_sums[SC_STATS_TILE_ROWS * SC_STATS_TILE_COLS][2];  /* The sum and sum of squares per tile. */
+    std::vector<uint8_t> luma;                                   /* One row of Y of a RGB frame. */
+  };
+
+  /* ----------------------------------------------------------- */
+
+  class FrameAnalyzer {
+  public:
+    FrameAnalyzer();
+    ~FrameAnalyzer();
+    int analyze(PixelBuffer& frame, int flags = 0, Executor* executor = NULL);  /* Computes the `stats` of `frame` in one pass; `flags` are the SC_CONVERT_* flags for the luma of RGB frames. Returns 0 on success, < 0 on error. */
+    int begin(int w, int h, int fmt, int flags, int nthreads);   /* Clears the sums for a `w` x `h` frame in `fmt` whose rows will be added by `nthreads` threads. Returns 0 on success, < 0 when we can't analyze `fmt`. */
+    void addRows(PixelBuffer& rows, int row, int thread);        /* Adds the rows of `rows`, a slice of the frame (see `begin()`) that starts at frame row `row`; `thread` is the thread index of the executor. */
+    void addLumaRows(const uint8_t* luma, size_t stride, int row, int nrows, int thread);  /* Adds `nrows` rows of Y samples, starting at frame row `row`. */
+    void finish();                                               /* Adds up the sums of the threads into `stats` and sets `has_stats`. */
+    void reset();                                                /* Clears `has_stats`, e.g. before a new frame. */
+    int canAnalyze(int fmt);                                     /* Returns 0 when we can analyze frames in `fmt`, otherwise -1. */
+
+  public:
+    FrameStats stats;                                            /* The result of `finish()`. */
+    bool has_stats;                                              /* True when `stats` belongs to the last frame, i.e. `finish()` was called after `begin()`. */
+    int width;                                                   /* The size of the frame, see `begin()`. */
+    int height;
+    int pixel_format;
+    YuvCoefficients coefficients;                                /* The Y coefficients for RGB frames; R and B are swapped for SC_RGBA. */
+    int tile_x[SC_STATS_TILE_COLS + 1];                          /* The first column of every tile, and the width. */
+    std::vector<AnalyzerScratch*> scratch;                       /* The sums of every thread. */
+  };
+
+} /* namespace sc */
+
+#endif
@@ -52,6 +52,7 @@ namespace sc {
     virtual int getDisplays(std::vector<Display*>& result) = 0;  /* Get the available / active displays. The implementation is responsible for freeing the allocated displays in `shutdown()`. The info member of the `Display` struct can be set to anything implementation related. */
     virtual int getPixelFormats(std::vector<int>& formats) = 0;  /* Get the supported output pixel formats that the capturer can use. */                             
     virtual int canChangeCursorVisibility();                     /* Should returns 0 when we can hide/show the cursor. */
+    virtual int canUseColorMatrix(int matrix);                   /* Should return 0 when the native YCbCr formats can use the given SC_COLOR_MATRIX_*, see Settings::color_matrix. Otherwise we capture in RGB and convert. */
 
     /* State  */
     int isConfigured();                                          /* Returns 0 when the capturer is configured, otherwise -1. */
@@ -108,6 +109,10 @@ namespace sc {
     return -1;
   }
 
+  inline int Base::canUseColorMatrix(int matrix) {
+    return (SC_COLOR_MATRIX_BT601 == matrix) ? 0 : -1;
+  }
+
   /* ----------------------------------------------------------- */
   
 } /* namespace sc */
@@ -0,0 +1,201 @@
+/*
+  -------------------------------------------------------------------------
+
+  Copyright 2015 roxlu <info#AT#roxlu.com>
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  -------------------------------------------------------------------------
+
+
+  Compositor
+  ==========
+
+  Tiles the frames of several `ScreenCapture` sessions into one
+  canvas, e.g. a 4 x 4 mosaic of 16 displays for monitoring. The
+  canvas is a grid of `cols` x `rows` cells; pass the frames of a
+  session into `setFrame()` from its callback and we scale them,
+  keeping the aspect ratio, straight into the cell of the canvas. Call
+  `update()` at the rate you want the canvas; it passes the canvas to
+  the callback when one or more cells received a frame since the
+  previous call.
+
+  ````c++
+
+      static void on_frame(sc::PixelBuffer& buf) {
+        Session* s = (Session*)buf.user;
+        s->compositor->setFrame(s->cell, buf);
+      }
+
+      static void on_canvas(sc::PixelBuffer& canvas) {
+        // encode canvas; canvas.info->dirty_rects tells what changed.
+      }
+
+      sc::CompositorSettings cfg;
+      cfg.width = 1920;
+      cfg.height = 1080;
+      cfg.pixel_format = SC_420V;
+      cfg.cols = 4;
+      cfg.rows = 4;
+      cfg.num_threads = 0;
+
+      sc::Compositor compositor(on_canvas);
+      compositor.init(cfg);
+
+      // Every 33 ms:
+      compositor.update();
+
+  ````
+
+  Scaling into the canvas is the only pass over the pixels of a
+  frame: a cell is a view (`PixelBuffer::getView()`) of the canvas and
+  every cell has its own `Scaler`, so a session that changes its size
+  only initializes its own scaler. Cells whose session didn't produce
+  a frame are not touched. When `num_threads` is not 1 we scale the
+  rows of a frame in slices on an `Executor`. When a frame already has
+  the size of its cell we copy its rows.
+
+  `setFrame()` and `update()` can be called from different threads.
+  They share a lock: sessions that deliver frames at the same time
+  scale them one after the other (each on all threads of the
+  executor), and `update()` holds the lock while the callback runs, so
+  copy or encode the canvas in the callback and don't call
+  `setFrame()` from it.
+
+  The sessions must deliver frames in the pixel format of the canvas;
+  configure them with it (see `Settings::pixel_format`) and, to save
+  the most work, with the size of their cell (`getCellSize()`) so
+  they don't scale twice. The parts of the cells that the frames
+  don't cover are black. The canvas has a `FrameInfo` with the dirty
+  rects of the frames that we scaled since the previous `update()`,
+  mapped into the canvas, or the whole frame when a session has no
+  info.
+
+ */
+#ifndef SCREEN_CAPTURE_COMPOSITOR_H
+#define SCREEN_CAPTURE_COMPOSITOR_H
+
+#include <vector>
+#include <screencapture/Types.h>
+#include <screencapture/Scaler.h>
+#include <screencapture/Executor.h>
+#include <screencapture/FrameInfo.h>
+
+#if defined(_WIN32)
+#  if !defined(WIN32_LEAN_AND_MEAN)
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#endif
+
+#define SC_COMPOSITOR_MAX_CELLS 64                               /* The maximum number of cells, `cols` * `rows`. */
+#define SC_COMPOSITOR_MAX_DIRTY_RECTS 16                         /* When a cell collects more dirty rects between two updates we report its whole frame. */
+
+namespace sc {
+
+  /* ----------------------------------------------------------- */
+
+  class CompositorSettings {
+  public:
+    CompositorSettings();
+
+  public:
+    int width;                                                   /* Width of the canvas. */
+    int height;                                                  /* Height of the canvas. */
+    int pixel_format;                                            /* The pixel format of the canvas and of the frames that you pass into `setFrame()`. */
+    int cols;                                                    /* The number of cells per row of the grid. */
+    int rows;                                                    /* The number of rows of the grid. */
+    int scale_quality;                                           /* SC_SCALE_BILINEAR (default), SC_SCALE_BICUBIC or SC_SCALE_LANCZOS3. */
+    int num_threads;                                             /* The number of threads that scale a frame; 1 (default) scales on the thread that calls `setFrame()`, 0 uses one thread per CPU core. */
+    int convert_flags;                                           /* The SC_CONVERT_* flags of the frames; we use them for the black of the YCbCr formats. */
+    int keep_aspect;                                             /* 1 (default) fits the frames into their cell with their aspect ratio, 0 stretches them over the cell. */
+  };
+
+  /* ----------------------------------------------------------- */
+
+  class CompositorCell {
+  public:
+    CompositorCell();
+
+  public:
+    int x;                                                       /* Left of the cell in the canvas. */
+    int y;                                                       /* Top of the cell in the canvas. */
+    int width;                                                   /* Width of the cell. */
+    int height;                                                  /* Height of the cell. */
+    int frame_x;                                                 /* Left of the scaled frame in the canvas; the cell around it is black. */
+    int frame_y;                                                 /* Top of the scaled frame in the canvas. */
+    int frame_width;                                             /* Width of the scaled frame; 0 until we received a frame. */
+    int frame_height;                                            /* Height of the scaled frame. */
+    int source_width;                                            /* Width of the last frame that we received. */
+    int source_height;                                           /* Height of the last frame that we received. */
+    Scaler scaler;                                               /* Scales the frames of the source into `frame_width` x `frame_height`. */
+    bool has_new_frame;                                          /* Set by `setFrame()`, cleared by `update()`. */
+    bool is_dirty_whole;                                         /* Set when we report the whole frame as dirty at the next `update()`. */
+    std::vector<DirtyRect> dirty_rects;                          /* The dirty rects in the canvas since the previous `update()`. */
+    FrameInfo info;                                              /* Scratch: the info of the source mapped into the cell. */
+    uint64_t num_frames;                                         /* The number of frames that we scaled into this cell. */
+  };
+
+  /* ----------------------------------------------------------- */
+
+  class Compositor {
+  public:
+    Compositor(screencapture_callback callback, void* user = NULL);  /* The `callback` receives the canvas from `update()`, with its `user` member set to `user`. */
+    ~Compositor();
+    int init(CompositorSettings cfg);                            /* Allocates the canvas, fills it with black and computes the cells. Can be called again to change the settings. Returns 0 on success, < 0 on error. */
+    int shutdown();                                              /* Frees the canvas and stops the threads. */
+    int setFrame(int cell, PixelBuffer& frame);                  /* Scales `frame` into the cell with the given index (row * cols + col). Can be called from any thread, e.g. the callback of a capture session. Returns 0 on success, < 0 on error. */
+    int update();                                                /* Passes the canvas into the callback when a cell received a frame since the previous call. Returns 0 when we called the callback, 1 when nothing changed and < 0 on error. */
+    int getCellSize(int cell, int& w, int& h);                   /* Sets `w` and `h` to the size of the cell with the given index. Returns 0 on success, < 0 on error. */
+    int isInit();                                                /* Returns 0 when initialized, otherwise -1. */
+
+  private:
+    void lock();
+    void unlock();
+    int fillCell(CompositorCell& c);                             /* Fills the cell with black. */
+    int layoutFrame(CompositorCell& c, int srcw, int srch);      /* Computes the rect of the scaled frame in the cell and (re)initializes the scaler of the cell. */
+    void addDirtyRects(CompositorCell& c, PixelBuffer& frame);   /* Maps the dirty rects of `frame` into the canvas. */
+    Executor* getExecutor();
+
+  public:
+    screencapture_callback callback;                             /* Receives the canvas. */
+    void* user;                                                  /* Set as `user` of the canvas. */
+    CompositorSettings settings;                                 /* The settings of `init()`. */
+    PixelBuffer canvas;                                          /* The mosaic that we pass into the callback. */
+    std::vector<uint8_t> canvas_pixels;                          /* The memory of `canvas`. */
+    FrameInfo canvas_info;                                       /* The dirty rects and time of `canvas`. */
+    std::vector<CompositorCell*> cells;                          /* The cells, row by row. */
+    Executor executor;                                           /* Scales the frames in slices; only initialized when `settings.num_threads` is not 1. */
+    uint8_t black[3][4];                                         /* The black sample per plane of the pixel format. */
+#if defined(_WIN32)
+    CRITICAL_SECTION mutex;
+#else
+    pthread_mutex_t mutex;
+#endif
+  };
+
+  /* ----------------------------------------------------------- */
+
+  inline Executor* Compositor::getExecutor() {
+    return (0 == executor.isInit()) ? &executor : NULL;
+  }
+
+  inline int Compositor::isInit() {
+    return (0 == cells.size()) ? -1 : 0;
+  }
+
+} /* namespace sc */
+
+#endif
@@ -0,0 +1,117 @@
+/*
+  -------------------------------------------------------------------------
+
+  Copyright 2015 roxlu <info#AT#roxlu.com>
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  -------------------------------------------------------------------------
+
+  Convert
+  =======
+
+  Pixel format conversions between `PixelBuffer`s. The destination
+  buffer must be initialized with `init()` using the same width and
+  height as the source, and its planes must point to memory that you
+  allocated, e.g.:
+
+  ````c++
+
+      sc::PixelBuffer i420;
+      std::vector<uint8_t> mem;
+
+      i420.init(buffer.width, buffer.height, SC_I420);
+      mem.resize(i420.getNumBytes());
+      i420.setPlanes(&mem.front());
+
+      sc::screencapture_convert(buffer, i420);
+
+  ````
+
+  Supported conversions:
+
+      SC_BGRA             > SC_I420, SC_420V, SC_420F, SC_RGBA, SC_RGB24, SC_BGR24
+      SC_I420             > SC_BGRA, SC_420V, SC_420F
+      SC_420V, SC_420F    > SC_I420, SC_BGRA, SC_RGBA
+      SC_L10R             > SC_P010, SC_RGB48, SC_BGRA
+
+  Conversions between RGB and YCbCr use the BT.601 matrix unless you
+  pass `SC_CONVERT_BT709` or `SC_CONVERT_BT2020`. The range of SC_420V
+  (video) and SC_420F (full) is part of the format; SC_I420 and SC_P010
+  are video range unless you pass `SC_CONVERT_FULL_RANGE`. Use the same
+  flags as the encoder or renderer that receives the frames, otherwise
+  the colors shift; `screencapture_get_convert_flags()` gives the flags
+  for the `color_matrix` and `color_range` of `Settings`. Every matrix
+  and range has its own precomputed fixed point coefficients (see
+  Kernels.cpp and `screencapture_get_yuv_coefficients()`) which the
+  kernels load once per row, so the choice costs no throughput.
+  SC_L10R > SC_BGRA drops the lowest two bits of every channel; pass
+  `SC_CONVERT_DITHER` to apply a 2x2 ordered dither first, which
+  avoids banding in smooth (HDR) gradients.
+
+  When a frame has to be scaled and converted, e.g. a 4K SC_BGRA capture
+  into 1080p SC_420V, use `screencapture_scale_convert()`. It scales two
+  rows at a time (see `Scaler::scaleRows()`) and converts them while
+  they're still in the cache, so the scaled BGRA frame is never written
+  to and read back from memory. The result is identical to scaling
+  and converting in two steps. Supported: SC_BGRA > SC_I420, SC_420V
+  and SC_420F.
+
+  Both functions accept an `Executor` (see Executor.h) to process the
+  frame in horizontal slices on multiple threads. Slices start at an
+  even row, so every slice converts whole 4:2:0 chroma rows and the
+  result is identical to the single threaded one.
+
+  Pass a `FrameAnalyzer` (see Analytics.h) to compute the luma
+  statistics of the destination frame in the same pass: we analyze
+  every slice, or every two rows of `screencapture_scale_convert()`,
+  right after we converted it, while its rows are still in the cache.
+  The result is in `FrameAnalyzer::stats`.
+
+  `ScreenCapture` uses these conversions to deliver pixel formats that
+  the driver can't capture natively; it captures in a format the driver
+  supports and converts the frame before calling your callback.
+
+ */
+#ifndef SCREEN_CAPTURE_CONVERT_H
+#define SCREEN_CAPTURE_CONVERT_H
+
+#include <vector>
+#include <screencapture/Types.h>
+
+/* Conversion flags. */
+#define SC_CONVERT_DITHER (1 << 0)                               /* Use an ordered dither when we reduce the bit depth. */
+#define SC_CONVERT_BT709 (1 << 1)                                /* Use the BT.709 instead of the BT.601 matrix for YCbCr. */
+#define SC_CONVERT_BT2020 (1 << 2)                               /* Use the BT.2020 (non-constant luminance) instead of the BT.601 matrix for YCbCr. */
+#define SC_CONVERT_FULL_RANGE (1 << 3)                           /* SC_I420 and SC_P010 use full instead of video range; SC_420V and SC_420F ignore this. */
+
+namespace sc {
+
+  class Scaler;
+  struct YuvCoefficients;
+  class Executor;
+  class FrameAnalyzer;
+
+  int screencapture_convert(PixelBuffer& src, PixelBuffer& dst, int flags = 0, Executor* executor = NULL, FrameAnalyzer* analyzer = NULL);  /* Converts the pixels of `src` into the pixel format of `dst`. `flags` is a combination of the SC_CONVERT_* flags. When `executor` is given the frame is converted in parallel slices. When `analyzer` is given we also compute the stats of `dst`. Returns 0 on success, < 0 when the conversion isn't supported or when the buffers are invalid. */
+  int screencapture_can_convert(int from, int to);                /* Returns 0 when we can convert from the pixel format `from` into `to`, otherwise -1. */
+  int screencapture_get_conversions(int from, std::vector<int>& formats);  /* Fills `formats` with the pixel formats that we can convert `from` into. */
+  int screencapture_scale_convert(Scaler& scaler, PixelBuffer& src, PixelBuffer& dst, int flags = 0, Executor* executor = NULL, FrameAnalyzer* analyzer = NULL);  /* Scales `src` with `scaler`, which must be initialized for the size and format of `src` and the size of `dst`, and converts it into `dst` in one pass; with `analyzer` we also compute the stats of `dst`. Returns 0 on success, < 0 on error. */
+  int screencapture_can_scale_convert(int from, int to);          /* Returns 0 when `screencapture_scale_convert()` supports converting `from` into `to`, otherwise -1. */
+  int screencapture_get_color_range(int fmt, int range);          /* Returns the range that frames in `fmt` use when `range` (SC_COLOR_RANGE_*) is requested: SC_COLOR_RANGE_VIDEO or SC_COLOR_RANGE_FULL. */
+  int screencapture_get_convert_flags(int fmt, int matrix, int range);  /* Returns the SC_CONVERT_* flags for frames in `fmt` with the SC_COLOR_MATRIX_* `matrix` and SC_COLOR_RANGE_* `range`, e.g. of `Settings`; use them for every conversion from or into `fmt`. */
+  const YuvCoefficients& screencapture_get_yuv_coefficients(int fmt, int flags);  /* Returns the fixed point coefficients (see Kernels.h) of the SC_CONVERT_* matrix in `flags` with the range of the YCbCr format `fmt`; use the same flags as for `screencapture_convert()`. */
+  int screencapture_get_black(int fmt, int flags, uint8_t black[3][4]);  /* Sets `black[i]` to the black sample of plane i of `fmt` (the bytes per sample of `screencapture_get_plane_layout()`), with the matrix and range of `flags` for YCbCr. Use it with `kernel_fill_row()`. Returns 0 on success, < 0 when we can't convert black into `fmt`. */
+
+} /* namespace sc */
+
+#endif
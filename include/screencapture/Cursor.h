@@ -0,0 +1,181 @@
+/*
+  -------------------------------------------------------------------------
+
+  Copyright 2015 roxlu <info#AT#roxlu.com>
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  -------------------------------------------------------------------------
+
+  Cursor
+  ======
+
+  Draws the mouse pointer into captured frames on the CPU. Drivers that
+  capture the screen without the pointer (e.g. X11 with XFixes,
+  PipeWire or DRM, where the pointer is a hardware overlay) receive
+  the pointer shape separately; set it with `setShape()` whenever it
+  changes and call `draw()` for every frame.
+
+  ````c++
+
+      sc::Cursor cursor;
+      cursor.setShape(SC_CURSOR_COLOR, 32, 32, 32 * 4, pixels, hotspot_x, hotspot_y);
+
+      // For every frame.
+      cursor.draw(frame, pointer_x, pointer_y);
+
+  ````
+
+  Pointer types, they are the same as the Windows (DXGI) shape types:
+
+      SC_CURSOR_COLOR            BGRA with straight alpha, blended over the frame.
+      SC_CURSOR_MASKED_COLOR     BGRA where the alpha is a mask: 0x00 replaces
+                                 the screen pixel with the color, 0xFF XORs
+                                 the screen pixel with the color.
+      SC_CURSOR_MONOCHROME       A 1 bit AND mask followed by a 1 bit XOR mask
+                                 (most significant bit first). AND 0, XOR 0 is
+                                 black, 0 1 is white, 1 0 is the screen and 1 1
+                                 inverts the screen (e.g. the text cursor).
+
+  `setShape()` decodes the masked types into a BGRA AND and XOR mask
+  per pixel, so drawing them is (dst AND mask) XOR mask and drawing a
+  color pointer is a blend; both only touch the rows of the pointer's
+  bounding box with the SIMD kernels `kernel_mask_bgra_row()` and
+  `kernel_blend_bgra_row()`. Inverting has to read the screen pixels,
+  that's why we can't draw these pointers as a texture with alpha.
+
+  `setShape()` and `screencapture_decode_monochrome_cursor()` decode
+  monochrome pointers 8 pixels at a time: a 256 entry table expands
+  every byte of the bitplanes into 8 mask bytes which the SIMD kernels
+  interleave into BGRA (see `kernel_mono_to_masks_row()`). Text
+  editors change the pointer shape all the time, so this runs more
+  often than you'd expect.
+
+  Supported frame formats: SC_BGRA, SC_420V, SC_420F and SC_I420. For
+  the YCbCr formats we convert the (even aligned) bounding box into
+  BGRA, draw, convert it back and copy only the samples of the pixels
+  that the pointer changes, so the pixels around the pointer keep
+  their exact values. Pass the same SC_CONVERT_* flags as the
+  conversions of the frame (see `ScreenCapture::convert_flags`).
+
+  CursorCache
+  -----------
+
+  Most applications flip between a handful of shapes (arrow, I-beam,
+  hand), but the drivers receive the raw shape again after every
+  change. `CursorCache` keeps the last `SC_CURSOR_CACHE_SIZE` decoded
+  shapes keyed by a 64 bit hash of the raw bytes, type, size and
+  hotspot, so a shape that reappears costs a hash and a compare
+  instead of a decode. Every entry has the decoded `Cursor` for the
+  CPU compositor and a BGRA bitmap for renderers that draw the
+  pointer as a texture. Renderers that upload the bitmap key their
+  textures on `CursorCacheEntry::id`; we give an entry a new id when
+  we reuse it for another shape.
+
+  ````c++
+
+      sc::CursorCacheEntry* shape = NULL;
+      if (0 > cache.get(SC_CURSOR_MONOCHROME, w, h, pitch, pixels, hotx, hoty, &shape)) {
+        return -1;
+      }
+
+      shape->cursor.draw(frame, pointer_x, pointer_y);
+
+  ````
+
+ */
+#ifndef SCREEN_CAPTURE_CURSOR_H
+#define SCREEN_CAPTURE_CURSOR_H
+
+#include <vector>
+#include <screencapture/Types.h>
+
+/* Pointer shape types. */
+#define SC_CURSOR_NONE 0
+#define SC_CURSOR_COLOR 1                                        /* 32 bit BGRA, straight alpha. */
+#define SC_CURSOR_MASKED_COLOR 2                                 /* 32 bit BGRA, the alpha selects replace (0x00) or XOR (0xFF). */
+#define SC_CURSOR_MONOCHROME 3                                   /* 1 bit AND mask followed by a 1 bit XOR mask. */
+#define SC_CURSOR_CACHE_SIZE 16                                  /* The default number of shapes that a CursorCache keeps. */
+
+namespace sc {
+
+  class Cursor {
+  public:
+    Cursor();
+    ~Cursor();
+    int setShape(int type, int w, int h, int pitch, const uint8_t* pixels, int hotx = 0, int hoty = 0);  /* Decodes a pointer shape of the given SC_CURSOR_* type and size. `pitch` is the number of bytes per row of `pixels`. For SC_CURSOR_MONOCHROME `h` is the height of the pointer; `pixels` holds `h` rows of the AND mask followed by `h` rows of the XOR mask. `hotx` and `hoty` is the hotspot. Returns 0 on success, < 0 on error. */
+    int draw(PixelBuffer& frame, int x, int y, int flags = 0);   /* Draws the pointer with its hotspot at `x`, `y` into `frame`; the pointer may be partially or completely outside the frame. `flags` are the SC_CONVERT_* flags for YCbCr frames. Returns 0 on success, < 0 on error. */
+    int canDraw(int fmt);                                        /* Returns 0 when we can draw into frames with the pixel format `fmt`, otherwise -1. */
+
+  private:
+    void drawRows(uint8_t* dst, size_t stride, int x, int y, int w, int h);  /* Draws `w` x `h` pixels of the pointer, starting at pixel `x`, `y` of the pointer, into the BGRA pixels at `dst`. */
+    int drawYuv(PixelBuffer& frame, int x0, int y0, int x1, int y1, int left, int top, int flags);  /* Draws the pointer pixels that cover [x0, x1) x [y0, y1) of a YCbCr frame; the pointer starts at `left`, `top`. */
+
+  public:
+    int type;                                                    /* The SC_CURSOR_* type of the shape. */
+    int width;                                                   /* Width of the pointer. */
+    int height;                                                  /* Height of the pointer. */
+    int hotspot_x;                                               /* The pixel of the pointer that points at the position we draw at. */
+    int hotspot_y;                                               /* See `hotspot_x`. */
+    std::vector<uint8_t> color;                                  /* SC_CURSOR_COLOR: the BGRA pixels, `width` * 4 bytes per row. */
+    std::vector<uint8_t> and_mask;                               /* The masked types: the BGRA AND mask per pixel, `width` * 4 bytes per row. */
+    std::vector<uint8_t> xor_mask;                               /* The masked types: the BGRA XOR mask per pixel. */
+    std::vector<uint8_t> coverage;                               /* Per pixel 1 when drawing the pointer changes the pixel, otherwise 0. */
+    PixelBuffer bgra;                                            /* The bounding box of the pointer in a YCbCr frame, converted to BGRA. */
+    PixelBuffer yuv;                                             /* `bgra` converted back into the pixel format of the frame. */
+    std::vector<uint8_t> bgra_mem;                               /* The memory of `bgra`. */
+    std::vector<uint8_t> yuv_mem;                                /* The memory of `yuv`. */
+  };
+
+  /* ----------------------------------------------------------- */
+
+  class CursorCacheEntry {
+  public:
+    CursorCacheEntry();
+    int setShape(int type, int w, int h, int pitch, const uint8_t* pixels, int hotx, int hoty);  /* Copies the raw shape and decodes it into `cursor` and `bgra`. Returns 0 on success, < 0 on error. */
+    int isShape(int type, int w, int h, int pitch, const uint8_t* pixels, int hotx, int hoty);   /* Returns 0 when the raw shape is the same as the one of this entry, otherwise -1. */
+
+  public:
+    uint64_t hash;                                               /* The hash of the raw shape, see `CursorCache::hashShape()`. */
+    int id;                                                      /* Unique per shape; renderers use it as the key of their textures. */
+    uint64_t last_used;                                          /* The value of `CursorCache::clock` when we looked up this shape the last time. */
+    std::vector<uint8_t> shape;                                  /* The raw shape without the padding of the rows, to rule out hash collisions. */
+    std::vector<uint8_t> bgra;                                   /* The pointer as BGRA (`cursor.width` * 4 bytes per row) for renderers that draw it with alpha, see `screencapture_decode_monochrome_cursor()`. */
+    Cursor cursor;                                               /* The decoded pointer for the CPU compositor; also holds the type, size and hotspot. */
+  };
+
+  class CursorCache {
+  public:
+    CursorCache();
+    ~CursorCache();
+    int setCapacity(int n);                                      /* Sets the maximum number of shapes that we keep; removes the least recently used shapes when we have more. Returns 0 on success, < 0 on error. */
+    int get(int type, int w, int h, int pitch, const uint8_t* pixels, int hotx, int hoty, CursorCacheEntry** result);  /* Looks up the shape (same arguments as `Cursor::setShape()`) and decodes it when we didn't see it before, replacing the least recently used shape when the cache is full. Returns 0 when the shape was cached, 1 when we decoded it and < 0 on error. The entry stays valid until the next call to `get()`, `setCapacity()` or `clear()`. */
+    void clear();                                                /* Removes all shapes and resets `num_hits` and `num_misses`. */
+    static uint64_t hashShape(int type, int w, int h, int pitch, const uint8_t* pixels, int hotx, int hoty);  /* Hashes the rows of the raw shape (without the padding), the type, size and hotspot. */
+
+  public:
+    std::vector<CursorCacheEntry*> entries;                      /* The cached shapes, not ordered. */
+    size_t capacity;                                             /* The maximum number of entries, SC_CURSOR_CACHE_SIZE by default. */
+    uint64_t clock;                                              /* Incremented for every lookup; used to find the least recently used entry. */
+    int next_id;                                                 /* The id that we give the next decoded shape. */
+    uint64_t num_hits;                                           /* The number of lookups that found the shape. */
+    uint64_t num_misses;                                         /* The number of lookups that had to decode the shape. */
+  };
+
+  /* ----------------------------------------------------------- */
+
+  int screencapture_decode_monochrome_cursor(const uint8_t* pixels, int w, int h, int pitch, uint8_t* dst, int dst_stride);  /* Expands a monochrome pointer of `w` x `h` pixels (`h` rows of the AND mask followed by `h` rows of the XOR mask, `pitch` bytes per row) into BGRA for renderers that draw the pointer with alpha: black, white or transparent. Pixels that should invert the screen become black. Returns 0 on success, < 0 on error. */
+
+} /* namespace sc */
+
+#endif
@@ -0,0 +1,173 @@
+/*
+  -------------------------------------------------------------------------
+
+  Copyright 2015 roxlu <info#AT#roxlu.com>
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  -------------------------------------------------------------------------
+
+
+  Dirty
+  =====
+
+  Finds the parts of a frame that changed since the previous frame for
+  drivers that don't tell us (e.g. fbdev, DRM dumb buffers or XShm).
+  `DirtyDetector` splits every frame into tiles of `tile_size` x
+  `tile_size` pixels (64 by default), hashes each tile with
+  `kernel_hash_block()` and compares the hashes with the ones of the
+  previous frame. The changed tiles are merged into as few rectangles
+  as we can find cheaply: neighbouring tiles of a row become one run
+  and runs with the same columns in consecutive rows become one
+  rectangle. Encoders and uploaders can use the rectangles to only
+  process the changed parts.
+
+  ````c++
+
+      sc::DirtyDetector detector;
+      std::vector<sc::DirtyRect> rects;
+
+      detector.init(buffer.width, buffer.height, buffer.pixel_format);
+
+      // For every frame.
+      detector.update(buffer, rects);
+
+      for (size_t i = 0; i < rects.size(); ++i) {
+        upload(rects[i].x, rects[i].y, rects[i].width, rects[i].height);
+      }
+
+  ````
+
+  The first frame after `init()` or `reset()` is dirty as a whole.
+  Tiles are hashed with a fast 64 bit hash, not compared, so a changed
+  tile is reported as unchanged when its hash collides with the
+  previous one; with 64 bits that's extremely unlikely but not
+  impossible. Call `reset()` when you need a full frame, e.g. for a
+  key frame. For the 4:2:0 formats a tile also covers its chroma
+  samples; `tile_size` must be even so tiles don't share them.
+
+  Hashing reads every byte of the frame once; with the SIMD kernels
+  it takes roughly as long as copying the frame (see test_dirty).
+
+  StaticFrameFilter
+  -----------------
+
+  A static desktop doesn't need to be encoded or sent again and
+  again. `StaticFrameFilter` tells you to drop a frame when it's the
+  same as the last frame that it let through. When the driver knows
+  whether a frame changed it sets `PixelBuffer::damage` and we trust
+  it; otherwise we hash the whole frame with `kernel_hash_block()` and
+  compare it with the hash of the last frame that we let through. To
+  keep receivers alive (and to refresh them after packet loss) we
+  still let one static frame through every `keepalive_ms`
+  milliseconds. `ScreenCapture` uses this filter when you set
+  `Settings::drop_static_frames`.
+
+  ````c++
+
+      sc::StaticFrameFilter filter;
+      filter.init(1000);
+
+      // For every frame, with a monotonic time in milliseconds.
+      if (0 == filter.shouldDrop(buffer, now_ms)) {
+        return;
+      }
+
+      encode(buffer);
+
+  ````
+
+  The keepalive only works for frames that the driver delivers; e.g.
+  DXGI and CGDisplayStream don't deliver frames at all while nothing
+  changes, so the keepalive can't deliver frames either.
+
+ */
+#ifndef SCREEN_CAPTURE_DIRTY_H
+#define SCREEN_CAPTURE_DIRTY_H
+
+#include <vector>
+#include <screencapture/Types.h>
+#include <screencapture/FrameInfo.h>
+
+#define SC_DIRTY_TILE_SIZE 64                                    /* The default width and height of the tiles. */
+
+namespace sc {
+
+  /* ----------------------------------------------------------- */
+
+  class DirtyDetector {
+  public:
+    DirtyDetector();
+    ~DirtyDetector();
+    int init(int w, int h, int fmt, int tile = SC_DIRTY_TILE_SIZE);  /* Prepares to detect the changes of `w` x `h` frames of pixel format `fmt` in tiles of `tile` x `tile` pixels; `tile` must be even. Returns 0 on success, < 0 on error. */
+    int shutdown();                                              /* Releases the hashes; `init()` can be called again. */
+    int update(PixelBuffer& frame, std::vector<DirtyRect>& rects);  /* Hashes the tiles of `frame`, which must match the size and format given to `init()`, and sets `rects` to the rectangles that changed since the previous call. `rects` is empty when nothing changed. Returns 0 on success, < 0 on error. */
+    void reset();                                                /* Forgets the previous frame so the next call to `update()` reports the whole frame. */
+    int isInit();                                                /* Returns 0 when initialized, otherwise -1. */
+    int isInitFor(int w, int h, int fmt, int tile = SC_DIRTY_TILE_SIZE);  /* Returns 0 when we're initialized for the given size, pixel format and tile size, otherwise -1. */
+
+  private:
+    uint64_t hashTile(PixelBuffer& frame, int col, int row);     /* Returns the hash of the samples of all planes of the tile at `col`, `row`. */
+    void mergeTiles(std::vector<DirtyRect>& rects);              /* Merges the tiles that are set in `dirty` into rectangles. */
+
+  public:
+    int width;                                                   /* The width of the frames. */
+    int height;                                                  /* The height of the frames. */
+    int pixel_format;                                            /* The pixel format of the frames. */
+    int tile_size;                                               /* The width and height of a tile in pixels; the tiles at the right and bottom may be smaller. */
+    int num_cols;                                                /* The number of tiles per row. */
+    int num_rows;                                                /* The number of rows of tiles. */
+    int num_planes;                                              /* The number of planes of `pixel_format`. */
+    int bpp[3];                                                  /* The bytes per sample of every plane. */
+    int num_dirty;                                               /* The number of tiles that changed in the last call to `update()`. */
+    bool has_hashes;                                             /* False until we hashed the first frame, or after `reset()`. */
+    std::vector<uint64_t> hashes;                                /* The hash of every tile of the previous frame, row by row. */
+    std::vector<uint8_t> dirty;                                  /* Per tile 1 when it changed in the last call to `update()`, otherwise 0. */
+    std::vector<int> runs;                                       /* The rectangles (indices into `rects`) that end at the row of tiles above the one that we merge. */
+    std::vector<int> next_runs;                                  /* See `runs`; the rectangles that end at the current row. */
+  };
+
+  /* ----------------------------------------------------------- */
+
+  class StaticFrameFilter {
+  public:
+    StaticFrameFilter();
+    int init(int keepalive);                                     /* Sets the keepalive in milliseconds; 0 drops every static frame. Forgets the last frame. Returns 0 on success, < 0 on error. */
+    int shouldDrop(PixelBuffer& frame, uint64_t now);            /* Returns 0 when `frame` is the same as the last frame that we let through and the keepalive didn't expire, so you should drop it; otherwise -1 and `frame` becomes the last frame. `now` is a monotonic time in milliseconds. */
+    void reset();                                                /* Forgets the last frame so we let the next frame through. */
+
+  private:
+    int hashFrame(PixelBuffer& frame, uint64_t& result);         /* Hashes the samples (not the padding) of all planes of `frame`. Returns 0 on success, < 0 when we can't hash the frame. */
+
+  public:
+    int keepalive_ms;                                            /* We let a static frame through when the last frame that we let through is this many milliseconds old; 0 disables the keepalive. */
+    bool has_last;                                               /* False until we let the first frame through, or after `reset()`. */
+    bool has_hash;                                               /* True when `last_hash` is the hash of the last frame that we let through; drivers that set `PixelBuffer::damage` don't need it. */
+    uint64_t last_hash;                                          /* The hash of the last frame that we let through. */
+    uint64_t last_time;                                          /* The time when we let the last frame through. */
+    int last_width;                                              /* The size and format of the last frame that we let through; a frame of another size or format is never static. */
+    int last_height;                                             /* See `last_width`. */
+    int last_format;                                             /* See `last_width`. */
+    uint64_t num_dropped;                                        /* The number of frames that we told you to drop. */
+    uint64_t num_passed;                                         /* The number of frames that we let through. */
+  };
+
+  /* ----------------------------------------------------------- */
+
+  inline int DirtyDetector::isInit() {
+    return (SC_NONE == pixel_format) ? -1 : 0;
+  }
+
+} /* namespace sc */
+
+#endif
@@ -0,0 +1,144 @@
+/*
+  -------------------------------------------------------------------------
+
+  Copyright 2015 roxlu <info#AT#roxlu.com>
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  -------------------------------------------------------------------------
+
+  Executor
+  ========
+
+  A pool of worker threads that processes a frame in horizontal slices.
+  `run()` splits `nrows` rows into slices of `slice_rows` rows
+  and calls the task for every slice; the workers and the calling thread
+  take the next unprocessed slice until all are done, then `run()`
+  returns. The threads are created once in `init()` and sleep while
+  there is no work.
+
+  ````c++
+
+      static void on_slice(void* user, int thread, int first, int count) {
+        // process the rows [first, first + count)
+      }
+
+      sc::Executor executor;
+      executor.init(0);  // one thread per CPU core
+      executor.run(on_slice, data, height, screencapture_get_rows_per_slice(width * 4, 2));
+
+  ````
+
+  `thread` is a value in [0, getNumThreads()) that is unique for the
+  threads running at the same time; use it to select per thread scratch
+  memory. Slices are sized so the rows they touch fit in the L2 cache
+  (see `screencapture_get_rows_per_slice()`), which keeps the workers
+  from fighting over memory bandwidth on large (e.g. 8K) frames.
+
+  The conversions (Convert.h), the scaler (Scaler.h) and `ScreenCapture`
+  (see `Settings::num_threads`) accept an executor.
+
+ */
+#ifndef SCREEN_CAPTURE_EXECUTOR_H
+#define SCREEN_CAPTURE_EXECUTOR_H
+
+#include <stddef.h>
+#include <vector>
+
+#if defined(_WIN32)
+#  if !defined(WIN32_LEAN_AND_MEAN)
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#endif
+
+/* The number of bytes that the rows of a slice should touch. */
+#define SC_EXECUTOR_SLICE_BYTES (256 * 1024)
+
+namespace sc {
+
+  class Executor;
+
+  typedef void(*executor_task)(void* user, int thread, int first, int count);
+
+  /* ----------------------------------------------------------- */
+
+  struct ExecutorWorker {
+    Executor* executor;                                          /* The executor that owns the worker. */
+    int index;                                                   /* The `thread` value that we pass into the tasks; 0 is the thread that calls `run()`. */
+#if defined(_WIN32)
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+  };
+
+  /* ----------------------------------------------------------- */
+
+  class Executor {
+  public:
+    Executor();
+    ~Executor();
+    int init(int nthreads);                                      /* Creates `nthreads - 1` workers; the thread that calls `run()` is the other one. Pass 0 to use one thread per CPU core. Returns 0 on success, < 0 on error. */
+    int shutdown();                                              /* Stops and joins the workers. */
+    int run(executor_task task, void* user, int nrows, int slice_rows); /* Calls `task` for every slice of `slice_rows` rows in [0, nrows) and returns when all slices are done. Returns 0 on success, < 0 on error. */
+    int getNumThreads();                                         /* Returns the number of threads that run tasks, including the one that calls `run()`. */
+    int isInit();                                                /* Returns 0 when initialized, otherwise -1. */
+
+  public:
+    void processSlices(int thread);                              /* Runs slices of the current job until none are left; called by the workers and by `run()`. */
+    void lock();
+    void unlock();
+
+  public:
+    std::vector<ExecutorWorker*> workers;
+    int num_threads;                                             /* The number of threads including the caller; 0 when not initialized. */
+    bool must_stop;                                              /* Set by `shutdown()` to make the workers exit. */
+    int generation;                                              /* Incremented for every job; the workers wait until it changes. */
+    int num_busy;                                                /* The number of workers that didn't finish the current job yet. */
+    executor_task task;                                          /* The current job. */
+    void* user;
+    int num_rows;
+    int rows_per_slice;
+    int next_row;                                                /* The first row of the next slice that we hand out. */
+#if defined(_WIN32)
+    CRITICAL_SECTION mutex;
+    CONDITION_VARIABLE cond_work;                                /* Signalled when there is a new job or when we stop. */
+    CONDITION_VARIABLE cond_done;                                /* Signalled when the last worker finishes the current job. */
+#else
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_work;
+    pthread_cond_t cond_done;
+#endif
+  };
+
+  /* ----------------------------------------------------------- */
+
+  int screencapture_get_num_cpus();                              /* Returns the number of CPU cores, at least 1. */
+  int screencapture_get_rows_per_slice(size_t row_bytes, int alignment);     /* Returns the number of rows, a multiple of `alignment`, that touch about SC_EXECUTOR_SLICE_BYTES bytes. Use 2 as alignment for 4:2:0 formats. */
+
+  /* ----------------------------------------------------------- */
+
+  inline int Executor::getNumThreads() {
+    return (0 == num_threads) ? 1 : num_threads;
+  }
+
+  inline int Executor::isInit() {
+    return (0 == num_threads) ? -1 : 0;
+  }
+
+} /* namespace sc */
+
+#endif
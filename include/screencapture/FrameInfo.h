@@ -0,0 +1,137 @@
+/*
+  -------------------------------------------------------------------------
+
+  Copyright 2015 roxlu <info#AT#roxlu.com>
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  -------------------------------------------------------------------------
+
+
+  FrameInfo
+  =========
+
+  What we know about a frame besides its pixels. Every `PixelBuffer`
+  that you receive in the capture callback has an `info` pointer to
+  the `FrameInfo` of the frame (NULL when the driver doesn't provide
+  one); like the pixels it's only valid during the callback. Drivers
+  fill in what the platform tells them:
+
+      SC_FRAME_HAS_DIRTY_RECTS   `dirty_rects` plus the destinations of
+                                 `move_rects` cover everything that
+                                 changed since the previous frame.
+      SC_FRAME_HAS_MOVE_RECTS    `move_rects` holds the rectangles that
+                                 were copied from elsewhere in the
+                                 previous frame (e.g. scrolling).
+      SC_FRAME_HAS_CURSOR        `cursor_x`, `cursor_y` and
+                                 `cursor_visible` are the pointer.
+
+  `ScreenCapture` adds SC_FRAME_HAS_STATS and the luma `stats` of the
+  frame when you set `Settings::frame_stats`; see Analytics.h.
+
+  `capture_time` is when we received the frame and `present_time` when
+  the system presented its content (0 when unknown), both in
+  nanoseconds of the clock of `screencapture_get_time_ns()`.
+
+  The rectangles and the cursor are in the pixels of the frame that the
+  info belongs to. `ScreenCapture` rotates and scales them along with
+  the frame: moves survive rotation, but when we scale a frame a move
+  is not an exact copy anymore, so we turn it into a dirty rectangle.
+  The scaled dirty rectangles grow by the radius of the filter. When a
+  frame is letterboxed, use `fit()` so the rectangles are offset by the
+  bars.
+
+  ````c++
+
+      void on_frame(sc::PixelBuffer& buffer) {
+
+        if (NULL == buffer.info || 0 == (buffer.info->flags & SC_FRAME_HAS_DIRTY_RECTS)) {
+          encode_everything(buffer);
+          return;
+        }
+
+        for (size_t i = 0; i < buffer.info->move_rects.size(); ++i) {
+          copy(buffer.info->move_rects[i]);
+        }
+
+        for (size_t i = 0; i < buffer.info->dirty_rects.size(); ++i) {
+          encode(buffer, buffer.info->dirty_rects[i]);
+        }
+      }
+
+  ````
+
+ */
+#ifndef SCREEN_CAPTURE_FRAME_INFO_H
+#define SCREEN_CAPTURE_FRAME_INFO_H
+
+#include <vector>
+#include <screencapture/Types.h>
+#include <screencapture/Analytics.h>
+
+#define SC_FRAME_HAS_DIRTY_RECTS (1 << 0)                        /* `dirty_rects` and the destinations of `move_rects` cover every change since the previous frame. */
+#define SC_FRAME_HAS_MOVE_RECTS (1 << 1)                         /* `move_rects` holds the moves since the previous frame. */
+#define SC_FRAME_HAS_CURSOR (1 << 2)                             /* The cursor members are set. */
+#define SC_FRAME_HAS_STATS (1 << 3)                              /* `stats` holds the luma statistics of the frame. */
+
+namespace sc {
+
+  /* ----------------------------------------------------------- */
+
+  struct DirtyRect {
+    int x;                                                       /* Left of the changed rectangle, in pixels. */
+    int y;                                                       /* Top of the changed rectangle. */
+    int width;                                                   /* Width of the changed rectangle; clipped to the frame. */
+    int height;                                                  /* Height of the changed rectangle; clipped to the frame. */
+  };
+
+  struct MoveRect {
+    int src_x;                                                   /* Left of the pixels in the previous frame. */
+    int src_y;                                                   /* Top of the pixels in the previous frame. */
+    int x;                                                       /* Left of the rectangle in the current frame where the pixels moved to. */
+    int y;                                                       /* Top of the rectangle in the current frame. */
+    int width;                                                   /* Width of the moved rectangle. */
+    int height;                                                  /* Height of the moved rectangle. */
+  };
+
+  /* ----------------------------------------------------------- */
+
+  class FrameInfo {
+  public:
+    FrameInfo();
+    void reset();                                                /* Clears the flags, rectangles, cursor and times; drivers call this before they fill in a new frame. */
+    void rotate(int rotation, int w, int h);                     /* Maps the rectangles and cursor of a `w` x `h` frame into the frame rotated by `rotation` (SC_ROTATE_* and SC_FLIP_*, see Rotate.h). */
+    void scale(int w, int h, int dst_w, int dst_h, int margin);  /* Maps the rectangles and cursor of a `w` x `h` frame into a `dst_w` x `dst_h` frame; dirty rectangles grow by `margin` source pixels first and moves become dirty rectangles when the size changes. */
+    void fit(int w, int h, int dst_w, int dst_h, int even, int margin); /* Like `scale()` but for a `w` x `h` frame that was scaled into the letterboxed rect of `screencapture_get_fit_rect()` (with `even`) in a `dst_w` x `dst_h` frame. */
+    int breakMoves(const DirtyRect& r);                          /* Turns the moves whose source or destination intersects `r` into dirty rectangles of their destination (dropped without SC_FRAME_HAS_DIRTY_RECTS); for pixels that are drawn over the frame after the moves, like the pointer. Returns the number of moves that we turned. */
+    void alignEven(int w, int h);                                /* Grows the dirty rectangles to even coordinates (clipped to `w` x `h`) and turns moves with odd coordinates into dirty rectangles, for frames that we convert into 4:2:0. */
+
+  public:
+    int flags;                                                   /* The SC_FRAME_HAS_* flags of the members that are set. */
+    std::vector<DirtyRect> dirty_rects;                          /* The rectangles that changed since the previous frame, see SC_FRAME_HAS_DIRTY_RECTS. */
+    std::vector<MoveRect> move_rects;                            /* The rectangles that moved since the previous frame. */
+    int cursor_x;                                                /* The position of the pointer's hotspot; may be outside the frame. */
+    int cursor_y;                                                /* See `cursor_x`. */
+    int cursor_visible;                                          /* 1 when the pointer is visible, otherwise 0. */
+    uint64_t capture_time;                                       /* When we received the frame, in nanoseconds; see `screencapture_get_time_ns()`. */
+    uint64_t present_time;                                       /* When the system presented the content of the frame, in nanoseconds of the same clock; 0 when unknown. */
+    FrameStats stats;                                            /* The luma histogram, tile statistics and blank detection of the frame, see SC_FRAME_HAS_STATS and Analytics.h. */
+  };
+
+  /* ----------------------------------------------------------- */
+
+  uint64_t screencapture_get_time_ns();                          /* Returns the time of a monotonic clock in nanoseconds: mach_absolute_time() on Mac, QueryPerformanceCounter() on Windows and CLOCK_MONOTONIC elsewhere. */
+
+} /* namespace sc */
+
+#endif
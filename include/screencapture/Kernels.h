@@ -0,0 +1,198 @@
+/*
+  -------------------------------------------------------------------------
+
+  Copyright 2015 roxlu <info#AT#roxlu.com>
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  -------------------------------------------------------------------------
+
+  Kernels
+  =======
+
+  The low level (SIMD) pixel kernels that are used by the conversion
+  functions (see Convert.h). A kernel works on one row, or a pair of rows
+  for 4:2:0 formats, and doesn't do any validation; that's the job of
+  the caller. Every kernel has a SSE2 (or SSSE3) and a NEON version and
+  a plain C fallback which also handles the pixels at the end of a row
+  that don't fill a complete vector. The SIMD versions produce exactly the same
+  output as the C versions.
+
+  YCbCr conversions use fixed point coefficients: RGB to YCbCr
+  uses 8 fractional bits and YCbCr to RGB 6 fractional bits. The 10
+  bit kernels use the same coefficients; only the offsets are scaled.
+
+  Runtime dispatch:
+  -----------------
+  The kernels are compiled once per instruction set (see src/kernels/):
+  plain C, SSE2, SSSE3 and AVX2 on x86 and NEON on ARM. Only those
+  files are compiled with ISA specific flags, so the library runs on
+  any CPU of the architecture. `screencapture_init_kernels()` detects
+  the CPU features (cpuid, getauxval) once and selects the best variant
+  that the CPU supports. The `kernel_*()` functions below call the
+  selected variant and select it on their first call, so you only
+  have to call it to select the kernels up front, as
+  `ScreenCapture::init()` does.
+
+  Set the environment variable SC_KERNELS to c, sse2, ssse3, avx2 or
+  neon to override the selection, e.g. to compare the variants or to
+  work around a problem with one of them. Use
+  `screencapture_get_kernels()` to see which variant is used.
+
+  ````c++
+
+      sc::screencapture_init_kernels();
+      printf("Using the %s kernels.\n",
+             sc::screencapture_kernels_to_string(sc::screencapture_get_kernels()).c_str());
+
+  ````
+
+ */
+#ifndef SCREEN_CAPTURE_KERNELS_H
+#define SCREEN_CAPTURE_KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#  define SC_ARCH_X86 1
+#elif defined(__arm__) || defined(__aarch64__) || defined(_M_ARM) || defined(_M_ARM64)
+#  define SC_ARCH_ARM 1
+#endif
+
+/* Kernel variants. */
+#define SC_KERNELS_NONE -1
+#define SC_KERNELS_C 0                                           /* Plain C, available on every CPU. */
+#define SC_KERNELS_SSE2 1
+#define SC_KERNELS_SSSE3 2
+#define SC_KERNELS_AVX2 3
+#define SC_KERNELS_NEON 4
+
+/* CPU features, see `screencapture_get_cpu_features()`. */
+#define SC_CPU_SSE2 (1 << 0)
+#define SC_CPU_SSSE3 (1 << 1)
+#define SC_CPU_AVX2 (1 << 2)                                     /* Only set when the OS saves the AVX registers. */
+#define SC_CPU_NEON (1 << 3)
+
+namespace sc {
+
+  /* ----------------------------------------------------------- */
+
+  struct YuvCoefficients {
+    int16_t yr, yg, yb;                                          /* RGB > Y, 8 fractional bits. */
+    int16_t ur, ug, ub;                                          /* RGB > U (Cb), 8 fractional bits. */
+    int16_t vr, vg, vb;                                          /* RGB > V (Cr), 8 fractional bits. */
+    int16_t y_offset;                                            /* 16 for video range, 0 for full range. */
+    int16_t y_scale;                                             /* Y > RGB, 6 fractional bits. */
+    int16_t v_to_r;                                              /* V > R, 6 fractional bits. */
+    int16_t u_to_g;                                              /* U > G, 6 fractional bits; subtracted. */
+    int16_t v_to_g;                                              /* V > G, 6 fractional bits; subtracted. */
+    int16_t u_to_b;                                              /* U > B, 6 fractional bits. */
+  };
+
+  extern const YuvCoefficients yuv_bt601_video;                  /* BT.601, video range; the default for SC_I420, SC_420V and SC_P010. */
+  extern const YuvCoefficients yuv_bt601_full;                   /* BT.601, full range; the default for SC_420F. */
+  extern const YuvCoefficients yuv_bt709_video;                  /* BT.709, video range. */
+  extern const YuvCoefficients yuv_bt709_full;                   /* BT.709, full range. */
+  extern const YuvCoefficients yuv_bt2020_video;                 /* BT.2020 (non-constant luminance), video range. */
+  extern const YuvCoefficients yuv_bt2020_full;                  /* BT.2020 (non-constant luminance), full range. */
+
+  extern const uint8_t mono_expand[256][8];                      /* Expands the 8 bits of a byte into 8 bytes, 0xFF for a set bit; used to decode monochrome pointers. */
+  extern const uint64_t hash_keys[16][2];                        /* Odd random constants that `kernel_hash_block()` mixes into the 16 byte blocks of a row, one pair per position. */
+
+  /* ----------------------------------------------------------- */
+
+  void kernel_bgra_to_i420_rows(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, int width, const YuvCoefficients& c);    /* Converts two BGRA rows into two Y rows and one U and V row. `y1` may be NULL for the last row of an odd height, then pass `src0` for `src1`. */
+  void kernel_i420_to_bgra_row(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* dst, int width, const YuvCoefficients& c);                            /* Converts one row of Y with the matching U and V row into BGRA. */
+  void kernel_nv12_to_bgra_row(const uint8_t* y, const uint8_t* uv, uint8_t* dst, int width, const YuvCoefficients& c);                                             /* Converts one row of Y with the matching interleaved UV row into BGRA. */
+  void kernel_nv12_to_rgba_row(const uint8_t* y, const uint8_t* uv, uint8_t* dst, int width, const YuvCoefficients& c);                                             /* Converts one row of Y with the matching interleaved UV row into RGBA. */
+  void kernel_split_uv_row(const uint8_t* uv, uint8_t* u, uint8_t* v, int width);                                                                                    /* Deinterleaves `width` UV pairs. */
+  void kernel_merge_uv_row(const uint8_t* u, const uint8_t* v, uint8_t* uv, int width);                                                                              /* Interleaves `width` U and V samples. */
+  void kernel_bgra_to_rgba_row(const uint8_t* src, uint8_t* dst, int width);                                                                                         /* Swaps the R and B channels; `src` and `dst` may be the same. */
+  void kernel_bgra_to_rgb24_row(const uint8_t* src, uint8_t* dst, int width);                                                                                        /* Packs BGRA into R, G, B bytes, drops alpha. */
+  void kernel_bgra_to_bgr24_row(const uint8_t* src, uint8_t* dst, int width);                                                                                        /* Packs BGRA into B, G, R bytes, drops alpha. */
+  void kernel_l10r_to_p010_rows(const uint8_t* src0, const uint8_t* src1, uint16_t* y0, uint16_t* y1, uint16_t* uv, int width, const YuvCoefficients& c);          /* Converts two L10R rows into two P010 Y rows and one interleaved UV row. `y1` may be NULL, see kernel_bgra_to_i420_rows(). */
+  void kernel_l10r_to_rgb48_row(const uint8_t* src, uint16_t* dst, int width);                                                                                      /* Unpacks L10R into 16 bit R, G, B; the 10 bit values are scaled to the full 16 bit range. */
+  void kernel_l10r_to_bgra_row(const uint8_t* src, uint8_t* dst, int width, int d0, int d1);                                                                         /* Reduces L10R to BGRA; `d0` and `d1` (0-3) are added to the even and odd pixels before we drop the lowest two bits, pass 0 to truncate. */
+  void kernel_scale_rows_v(const uint8_t* src0, const uint8_t* src1, uint8_t* dst, int nbytes, int frac);                                                            /* Blends two rows: src0 + (src1 - src0) * frac, with `frac` in 7 fractional bits (0-127). */
+  void kernel_scale_row_h(const uint8_t* src, uint8_t* dst, int width, int bpp, const int* offsets, const int16_t* fracs);                                          /* Creates `width` samples of `bpp` bytes by blending the samples at `offsets` with their right neighbour using `fracs`. */
+  void kernel_box_2x2_row(const uint8_t* src0, const uint8_t* src1, uint8_t* dst, int width, int bpp);                                                              /* Creates `width` samples of `bpp` bytes from the rounded mean of the 2x2 blocks in the rows `src0` and `src1`. */
+  void kernel_box_sum_rows(const uint8_t* src, size_t stride, int nrows, uint16_t* sums, int nbytes);                                                               /* Sums `nbytes` bytes of `nrows` rows into `sums`. */
+  void kernel_box_reduce_row(const uint16_t* sums, uint8_t* dst, int width, int bpp, int factor);                                                                   /* Creates `width` samples of `bpp` bytes from the rounded mean of `factor` neighbouring samples in `sums` (from kernel_box_sum_rows()); `factor` is 2, 3 or 4. */
+  void kernel_filter_rows_v(const uint8_t* const* rows, const int16_t* weights, int taps, uint8_t* dst, int nbytes);                                                /* Filters `nbytes` bytes of the `taps` rows with the given weights (14 fractional bits); `taps` is a multiple of 4. */
+  void kernel_filter_row_h(const uint8_t* src, uint8_t* dst, int width, int bpp, const int* offsets, const int16_t* weights, int taps);                             /* Creates `width` samples of `bpp` bytes; sample x is the sum of `taps` samples from `offsets[x]` multiplied by `weights[x * taps]`. Reads up to `taps` samples from every offset. */
+  void kernel_transpose_block(const uint8_t* src, ptrdiff_t src_stride, uint8_t* dst, ptrdiff_t dst_stride, int width, int height, int bpp);                       /* Reads `height` rows of `width` samples of `bpp` bytes and writes them as `width` rows of `height` samples: dst row i is column i of `src`. The strides may be negative to flip. */
+  void kernel_reverse_row(const uint8_t* src, uint8_t* dst, int width, int bpp);                                                                                     /* Writes the `width` samples of `bpp` bytes in reverse order; `src` and `dst` must not overlap. */
+  void kernel_blend_bgra_row(const uint8_t* src, uint8_t* dst, int width);                                                                                          /* Blends `width` BGRA pixels of `src`, with straight (not premultiplied) alpha, over `dst`; the alpha of `dst` is kept. */
+  void kernel_mask_bgra_row(const uint8_t* and_mask, const uint8_t* xor_mask, uint8_t* dst, int width);                                                             /* Sets `width` BGRA pixels of `dst` to (dst AND and_mask) XOR xor_mask. */
+  void kernel_mono_to_bgra_row(const uint8_t* and_bits, const uint8_t* xor_bits, uint8_t* dst, int width);                                                          /* Expands `width` bits of a monochrome pointer into BGRA: black, white or transparent; pixels that should invert the screen become black. */
+  void kernel_mono_to_masks_row(const uint8_t* and_bits, const uint8_t* xor_bits, uint8_t* and_mask, uint8_t* xor_mask, int width);                                /* Expands `width` bits of a monochrome pointer into the BGRA AND and XOR masks of kernel_mask_bgra_row(). */
+  uint64_t kernel_hash_block(const uint8_t* src, size_t stride, int nbytes, int rows);                                                                             /* Returns a 64 bit hash of `nbytes` bytes of `rows` rows, e.g. a tile of a frame; not a cryptographic hash. Every variant returns the same hash. */
+  void kernel_fill_row(uint8_t* dst, int width, int bpp, const uint8_t* value);                                                                                    /* Sets `width` samples of `bpp` bytes to the sample at `value`. */
+  void kernel_box_slide_row(const uint8_t* add, const uint8_t* sub, uint16_t* sums, uint8_t* dst, int nbytes, int scale);                                          /* Writes (sums * scale) >> 16 of `nbytes` bytes into `dst`, then adds the row `add` to `sums` and subtracts the row `sub`: one step of a sliding box filter of n rows with `scale` = ceil(65536 / n), n <= 257. */
+  void kernel_blend_premul_bgra_row(const uint8_t* src, uint8_t* dst, int width);                                                                                  /* Blends `width` BGRA pixels of `src`, with premultiplied alpha, over `dst`: dst = src + dst * (255 - alpha) / 255 for all four channels. */
+  void kernel_blend_premul_row(const uint8_t* src, const uint8_t* alpha, uint8_t* dst, int nbytes);                                                                /* Blends `nbytes` premultiplied samples of `src` over `dst` with the alpha per byte in `alpha`, e.g. a Y or UV plane: dst = src + dst * (255 - alpha) / 255. */
+  void kernel_bgra_to_luma_row(const uint8_t* src, uint8_t* dst, int width, const YuvCoefficients& c);                                                             /* Writes the Y of `width` BGRA pixels, the same Y as kernel_bgra_to_i420_rows(); swap `yr` and `yb` of `c` for RGBA. */
+  void kernel_luma_stats_row(const uint8_t* src, int width, uint32_t* histogram, uint64_t* sums);                                                                  /* Counts `width` samples in `histogram` (4 x 256 bins, sample v of the i-th of every 4 samples counts in bin v * 4 + i % 4) and adds their sum and sum of squares to sums[0] and sums[1]. */
+
+  /* ----------------------------------------------------------- */
+
+  int screencapture_init_kernels();                              /* Selects the best kernels for this CPU, or the ones named by the SC_KERNELS environment variable. Only the first call selects; safe to call from multiple threads. Returns 0 on success. */
+  int screencapture_select_kernels(int variant);                 /* Selects the given SC_KERNELS_* variant. Returns < 0 when it's not compiled in or not supported by this CPU. Don't call this while kernels are running. */
+  int screencapture_get_kernels();                               /* Returns the selected SC_KERNELS_* variant. */
+  int screencapture_is_kernels_supported(int variant);           /* Returns 0 when `variant` is compiled in and supported by this CPU, otherwise -1. */
+  int screencapture_get_cpu_features();                          /* Returns the SC_CPU_* features of this CPU. */
+  std::string screencapture_kernels_to_string(int variant);      /* Returns the name of the variant, e.g. "ssse3"; also the value for the SC_KERNELS environment variable. */
+
+  /* ----------------------------------------------------------- */
+
+  /* One variant of all kernels; every Kernels<ISA>.cpp file fills one with `get_functions()`. */
+  struct KernelFunctions {
+    void (*bgra_to_i420_rows)(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, int width, const YuvCoefficients& c);
+    void (*i420_to_bgra_row)(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* dst, int width, const YuvCoefficients& c);
+    void (*nv12_to_bgra_row)(const uint8_t* y, const uint8_t* uv, uint8_t* dst, int width, const YuvCoefficients& c);
+    void (*nv12_to_rgba_row)(const uint8_t* y, const uint8_t* uv, uint8_t* dst, int width, const YuvCoefficients& c);
+    void (*split_uv_row)(const uint8_t* uv, uint8_t* u, uint8_t* v, int width);
+    void (*merge_uv_row)(const uint8_t* u, const uint8_t* v, uint8_t* uv, int width);
+    void (*bgra_to_rgba_row)(const uint8_t* src, uint8_t* dst, int width);
+    void (*bgra_to_rgb24_row)(const uint8_t* src, uint8_t* dst, int width);
+    void (*bgra_to_bgr24_row)(const uint8_t* src, uint8_t* dst, int width);
+    void (*l10r_to_p010_rows)(const uint8_t* src0, const uint8_t* src1, uint16_t* y0, uint16_t* y1, uint16_t* uv, int width, const YuvCoefficients& c);
+    void (*l10r_to_rgb48_row)(const uint8_t* src, uint16_t* dst, int width);
+    void (*l10r_to_bgra_row)(const uint8_t* src, uint8_t* dst, int width, int d0, int d1);
+    void (*scale_rows_v)(const uint8_t* src0, const uint8_t* src1, uint8_t* dst, int nbytes, int frac);
+    void (*scale_row_h)(const uint8_t* src, uint8_t* dst, int width, int bpp, const int* offsets, const int16_t* fracs);
+    void (*box_2x2_row)(const uint8_t* src0, const uint8_t* src1, uint8_t* dst, int width, int bpp);
+    void (*box_sum_rows)(const uint8_t* src, size_t stride, int nrows, uint16_t* sums, int nbytes);
+    void (*box_reduce_row)(const uint16_t* sums, uint8_t* dst, int width, int bpp, int factor);
+    void (*filter_rows_v)(const uint8_t* const* rows, const int16_t* weights, int taps, uint8_t* dst, int nbytes);
+    void (*filter_row_h)(const uint8_t* src, uint8_t* dst, int width, int bpp, const int* offsets, const int16_t* weights, int taps);
+    void (*transpose_block)(const uint8_t* src, ptrdiff_t src_stride, uint8_t* dst, ptrdiff_t dst_stride, int width, int height, int bpp);
+    void (*reverse_row)(const uint8_t* src, uint8_t* dst, int width, int bpp);
+    void (*blend_bgra_row)(const uint8_t* src, uint8_t* dst, int width);
+    void (*mask_bgra_row)(const uint8_t* and_mask, const uint8_t* xor_mask, uint8_t* dst, int width);
+    void (*mono_to_bgra_row)(const uint8_t* and_bits, const uint8_t* xor_bits, uint8_t* dst, int width);
+    void (*mono_to_masks_row)(const uint8_t* and_bits, const uint8_t* xor_bits, uint8_t* and_mask, uint8_t* xor_mask, int width);
+    uint64_t (*hash_block)(const uint8_t* src, size_t stride, int nbytes, int rows);
+    void (*fill_row)(uint8_t* dst, int width, int bpp, const uint8_t* value);
+    void (*box_slide_row)(const uint8_t* add, const uint8_t* sub, uint16_t* sums, uint8_t* dst, int nbytes, int scale);
+    void (*blend_premul_bgra_row)(const uint8_t* src, uint8_t* dst, int width);
+    void (*blend_premul_row)(const uint8_t* src, const uint8_t* alpha, uint8_t* dst, int nbytes);
+    void (*bgra_to_luma_row)(const uint8_t* src, uint8_t* dst, int width, const YuvCoefficients& c);
+    void (*luma_stats_row)(const uint8_t* src, int width, uint32_t* histogram, uint64_t* sums);
+  };
+
+} /* namespace sc */
+
+#endif
@@ -0,0 +1,160 @@
+/*
+  -------------------------------------------------------------------------
+
+  Copyright 2015 roxlu <info#AT#roxlu.com>
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  -------------------------------------------------------------------------
+
+
+  Mask
+  ====
+
+  Redacts parts of the frames, e.g. password fields or chat windows,
+  before they leave the process. `PrivacyMask` holds a list of
+  rectangles in the pixels of the output frames and covers each one,
+  in place, with a solid color, with blocks (pixelate) or with a box
+  blur. `ScreenCapture` applies the mask to every frame before it
+  calls the callback; see `ScreenCapture::setMaskRegions()`.
+
+  ````c++
+
+      std::vector<sc::MaskRegion> regions(1);
+      regions[0].x = 100;
+      regions[0].y = 200;
+      regions[0].width = 300;
+      regions[0].height = 40;
+      regions[0].mode = SC_MASK_PIXELATE;
+      regions[0].size = 16;
+
+      // Any thread, any time; the next frame uses the new regions.
+      cap.setMaskRegions(regions);
+
+  ````
+
+  Modes:
+
+      SC_MASK_FILL       Sets every pixel to `red`, `green`, `blue`.
+      SC_MASK_PIXELATE   Replaces every block of `size` x `size` pixels
+                         with its mean. Nothing of the content inside a
+                         block survives; use this for text.
+      SC_MASK_BLUR       A box blur with a radius of `size` pixels. A box
+                         blur can partially be undone, so don't rely on
+                         it for small text.
+
+  `setRegions()` only copies the list under a lock, so you can change
+  the regions for every frame, from any thread; `update()` picks them
+  up on the capture thread. Masking touches only the rows of the
+  regions: a fill writes a repeated pattern (`kernel_fill_row()`),
+  pixelating sums the rows of a band of blocks with
+  `kernel_box_sum_rows()` and writes one row of means that we copy into
+  the other rows of the band, and the blur slides a window over the
+  rows with `kernel_box_slide_row()`, transposes the region with
+  `kernel_transpose_block()` and slides over the columns the same way.
+  The blur and pixelate only read the pixels inside the region.
+
+  Supported formats: SC_BGRA, SC_RGBA, SC_420V, SC_420F (NV12) and
+  SC_I420. For the 4:2:0 formats we grow the regions to even
+  coordinates so they cover whole chroma samples, and the chroma
+  planes use half the block size and radius. The fill color is
+  converted with the SC_CONVERT_* flags that you pass into `apply()`.
+
+ */
+#ifndef SCREEN_CAPTURE_MASK_H
+#define SCREEN_CAPTURE_MASK_H
+
+#include <vector>
+#include <screencapture/Types.h>
+
+#if defined(_WIN32)
+#  if !defined(WIN32_LEAN_AND_MEAN)
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#endif
+
+#define SC_MASK_FILL 0                                           /* Solid color. */
+#define SC_MASK_PIXELATE 1                                       /* Blocks of `MaskRegion::size` pixels. */
+#define SC_MASK_BLUR 2                                           /* Box blur with a radius of `MaskRegion::size` pixels. */
+#define SC_MASK_MAX_BLOCK 256                                    /* The largest block size; the row sums are 16 bit. */
+#define SC_MASK_MAX_RADIUS 127                                   /* The largest blur radius; the window of 2 * radius + 1 rows must fit the 16 bit sums. */
+
+namespace sc {
+
+  class FrameInfo;
+
+  /* ----------------------------------------------------------- */
+
+  struct MaskRegion {
+    MaskRegion();
+    int x;                                                       /* Left of the region in the pixels of the output frame; the part outside the frame is ignored. */
+    int y;                                                       /* Top of the region. */
+    int width;                                                   /* Width of the region. */
+    int height;                                                  /* Height of the region. */
+    int mode;                                                    /* SC_MASK_FILL (default), SC_MASK_PIXELATE or SC_MASK_BLUR. */
+    int size;                                                    /* The block size (1 - SC_MASK_MAX_BLOCK) or blur radius (1 - SC_MASK_MAX_RADIUS); 16 by default. */
+    int red;                                                     /* The fill color, 0 - 255; black by default. */
+    int green;                                                   /* See `red`. */
+    int blue;                                                    /* See `red`. */
+  };
+
+  /* ----------------------------------------------------------- */
+
+  class PrivacyMask {
+  public:
+    PrivacyMask();
+    ~PrivacyMask();
+    int setRegions(const std::vector<MaskRegion>& regions);     /* Validates and copies the regions; the next `update()` uses them. Can be called from any thread. Returns 0 on success, < 0 when a region is invalid (then the current regions stay). */
+    void clear();                                                /* Removes all regions; the next `update()` uses no regions. */
+    int update();                                                /* Picks up the regions of the last `setRegions()` or `clear()`. Call it once per frame on the thread that calls `apply()`. Returns 0 when there are regions to apply, otherwise -1. */
+    int apply(PixelBuffer& frame, int flags = 0);                /* Masks the regions of `frame`, in place. `flags` are the SC_CONVERT_* flags of the frame, for the fill color of YCbCr frames. Returns 0 on success, < 0 on error; on error you must not use the frame. */
+    void updateInfo(FrameInfo& info, int w, int h);              /* Adds the regions that may look different than in the previous frame to the dirty rects of `info` (a `w` x `h` frame) and turns moves from or into a region into dirty rects. */
+    int canApply(int fmt);                                       /* Returns 0 when we can mask frames with the pixel format `fmt`, otherwise -1. */
+
+  private:
+    void lock();
+    void unlock();
+    int getRect(const MaskRegion& region, int fmt, int w, int h, int& x0, int& y0, int& x1, int& y1);  /* Clips the region to the frame and grows it to even coordinates for 4:2:0. Returns 0 when it's not empty, otherwise -1. */
+    int getFillColor(const MaskRegion& region, int fmt, int flags, uint8_t* value);                    /* Sets `value` to the samples of the fill color: 4 BGRA/RGBA bytes or Y, U and V. Returns 0 on success, < 0 on error. */
+    void fillPlane(uint8_t* plane, size_t stride, int x, int y, int w, int h, int bpp, const uint8_t* value);
+    void pixelatePlane(uint8_t* plane, size_t stride, int x, int y, int w, int h, int bpp, int block);
+    void blurPlane(uint8_t* plane, size_t stride, int x, int y, int w, int h, int bpp, int radius);
+    void blurRows(const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride, int nrows, int nbytes, int radius);  /* Box blurs `nrows` rows of `nbytes` bytes vertically; rows outside the region repeat the first or last row. */
+
+  public:
+    std::vector<MaskRegion> regions;                             /* The regions that `apply()` uses; only touched on the capture thread. */
+    std::vector<MaskRegion> pending;                             /* The regions of the last `setRegions()`, protected by the lock. */
+    std::vector<MaskRegion> prev_regions;                        /* The regions of the previous frame, see `updateInfo()`. */
+    bool has_pending;                                            /* Set when `pending` holds regions that `update()` didn't pick up yet. */
+    bool regions_changed;                                        /* Set by `update()` when the regions differ from the ones of the previous frame. */
+    std::vector<uint8_t> tmp_a;                                  /* The region blurred vertically, and later the transposed region blurred again. */
+    std::vector<uint8_t> tmp_b;                                  /* The transposed region. */
+    std::vector<uint16_t> sums;                                  /* Per byte sums of a band (pixelate) or of the blur window. */
+    std::vector<uint8_t> row;                                    /* One row of block means. */
+    PixelBuffer color_bgra;                                      /* 2 x 2 pixels of the fill color that we convert into the YCbCr format. */
+    PixelBuffer color_yuv;                                       /* See `color_bgra`. */
+    std::vector<uint8_t> color_bgra_mem;
+    std::vector<uint8_t> color_yuv_mem;
+#if defined(_WIN32)
+    CRITICAL_SECTION mutex;
+#else
+    pthread_mutex_t mutex;
+#endif
+  };
+
+} /* namespace sc */
+
+#endif
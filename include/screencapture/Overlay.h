@@ -0,0 +1,146 @@
+/*
+  -------------------------------------------------------------------------
+
+  Copyright 2015 roxlu <info#AT#roxlu.com>
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  -------------------------------------------------------------------------
+
+
+  Overlay
+  =======
+
+  Burns images, e.g. a watermark or a timestamp, into the frames.
+  `Overlays` holds a list of BGRA images with premultiplied alpha,
+  each with an id and a position in the pixels of the output frames,
+  and blends them over every frame, in place. `ScreenCapture` draws
+  them after the privacy mask, right before it calls the callback;
+  see `ScreenCapture::setOverlay()`.
+
+  ````c++
+
+      // Premultiplied BGRA: every color channel <= alpha.
+      cap.setOverlay(1, 16, 16, width, height, width * 4, pixels);
+
+      // Any thread, any time; e.g. a new timestamp once per second.
+      cap.setOverlay(2, 16, 48, text_width, text_height, text_width * 4, text_pixels);
+
+  ````
+
+  `setOverlay()` hashes the pixels and only copies them when they
+  differ from the current image with the same id, so you can call it
+  for every frame with the same pixels at the cost of a hash and a
+  compare. Like `PrivacyMask`, the changes are copied under a lock and
+  picked up by `update()` on the capture thread.
+
+  Blending only touches the rows of the bounding box of every overlay,
+  with `kernel_blend_premul_bgra_row()` for BGRA frames. For the YCbCr
+  frames we convert an overlay once into premultiplied Y, U and V
+  samples with an alpha per sample (`kernel_blend_premul_row()` blends
+  those planes) and convert it again only when its pixels, the pixel
+  format, the SC_CONVERT_* flags or the parity of its position change.
+  The chroma of every 2 x 2 block is the alpha weighted mean of its
+  colors with the mean of the alphas, so the edges of e.g. text keep
+  their color.
+
+  Supported formats: SC_BGRA, SC_RGBA, SC_420V, SC_420F (NV12) and
+  SC_I420.
+
+ */
+#ifndef SCREEN_CAPTURE_OVERLAY_H
+#define SCREEN_CAPTURE_OVERLAY_H
+
+#include <vector>
+#include <screencapture/Types.h>
+#include <screencapture/FrameInfo.h>
+
+#if defined(_WIN32)
+#  if !defined(WIN32_LEAN_AND_MEAN)
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#endif
+
+namespace sc {
+
+  /* ----------------------------------------------------------- */
+
+  class OverlayImage {
+  public:
+    OverlayImage();
+    void setPixels(int w, int h, size_t stride, const uint8_t* src, uint64_t src_hash);  /* Copies the pixels and forgets the converted planes. */
+    int isPixels(int w, int h, size_t stride, const uint8_t* src);                        /* Returns 0 when the pixels are the same as the ones of this image, otherwise -1. */
+
+  public:
+    int id;                                                      /* The id that was passed into `Overlays::setOverlay()`. */
+    int x;                                                       /* Left of the overlay in the output frame; may be negative. */
+    int y;                                                       /* Top of the overlay in the output frame; may be negative. */
+    int width;                                                   /* Width of the overlay. */
+    int height;                                                  /* Height of the overlay. */
+    uint64_t hash;                                               /* The hash of the pixels, see `Overlays::hashPixels()`. */
+    std::vector<uint8_t> pixels;                                 /* The premultiplied BGRA pixels, `width` * 4 bytes per row. */
+    int prepared_fmt;                                            /* The pixel format of `samples`; SC_NONE when we have to convert the pixels again. */
+    int prepared_flags;                                          /* The SC_CONVERT_* flags that we used for `samples`. */
+    int offset_x;                                                /* The column of the first pixel of the overlay in the converted planes; for 4:2:0 `x` & 1 so the planes start at an even position. */
+    int offset_y;                                                /* The row of the first pixel of the overlay in the converted planes. */
+    int prepared_width;                                          /* Width of the converted planes in pixels; even for 4:2:0. */
+    int prepared_height;                                         /* Height of the converted planes in pixels; even for 4:2:0. */
+    std::vector<uint8_t> samples[3];                             /* The premultiplied samples per plane: RGBA for SC_RGBA frames, Y, UV or Y, U, V for 4:2:0. */
+    std::vector<uint8_t> alpha[3];                               /* The alpha per byte of `samples`, for 4:2:0. */
+  };
+
+  /* ----------------------------------------------------------- */
+
+  class Overlays {
+  public:
+    Overlays();
+    ~Overlays();
+    int setOverlay(int id, int x, int y, int w, int h, size_t stride, const uint8_t* pixels);  /* Adds or replaces the overlay with the given id: `w` x `h` premultiplied BGRA pixels, `stride` bytes per row, at `x`, `y` in the output frame. Copies the pixels unless they are the same as the current ones. Can be called from any thread. Returns 0 on success, < 0 on error. */
+    int moveOverlay(int id, int x, int y);                       /* Moves the overlay with the given id. Returns 0 on success, < 0 when there is no overlay with this id. */
+    int removeOverlay(int id);                                   /* Removes the overlay with the given id. Returns 0 on success, < 0 when there is no overlay with this id. */
+    void clear();                                                /* Removes all overlays. */
+    int update();                                                /* Picks up the changes since the previous call. Call it once per frame on the thread that calls `apply()`. Returns 0 when there are overlays to draw, otherwise -1. */
+    int apply(PixelBuffer& frame, int flags = 0);                /* Blends the overlays over `frame`, in the order in which they were added. `flags` are the SC_CONVERT_* flags of the frame. Returns 0 on success, < 0 on error; on error you must not use the frame. */
+    void updateInfo(FrameInfo& info, int w, int h);              /* Adds the overlays that were added, moved, changed or removed to the dirty rects of `info` (a `w` x `h` frame) and turns moves from or into an overlay into dirty rects. */
+    int canApply(int fmt);                                       /* Returns 0 when we can draw into frames with the pixel format `fmt`, otherwise -1. */
+    static uint64_t hashPixels(int w, int h, size_t stride, const uint8_t* pixels);  /* Hashes the rows of the pixels (without the padding) and the size. */
+
+  private:
+    void lock();
+    void unlock();
+    int findPending(int id);                                     /* Returns the index of the overlay with the given id in `pending`, or -1. */
+    int prepare(OverlayImage* img, int fmt, int flags);          /* Converts the pixels of `img` into premultiplied samples of the pixel format `fmt`. Returns 0 on success, < 0 on error. */
+    void addChangedRect(const OverlayImage* img);
+
+  public:
+    std::vector<OverlayImage*> overlays;                         /* The overlays that `apply()` draws; only touched on the capture thread. */
+    std::vector<OverlayImage*> pending;                          /* The overlays as they are set by `setOverlay()`, protected by the lock; without the converted planes. */
+    bool has_pending;                                            /* Set when `pending` changed since the last `update()`. */
+    std::vector<DirtyRect> changed_rects;                        /* The rects (not clipped) of the overlays that `update()` added, moved, changed or removed. */
+    PixelBuffer bgra;                                            /* An overlay with straight alpha that we convert into `yuv`. */
+    PixelBuffer yuv;                                             /* See `bgra`. */
+    std::vector<uint8_t> bgra_mem;                               /* The memory of `bgra`. */
+    std::vector<uint8_t> yuv_mem;                                /* The memory of `yuv`. */
+#if defined(_WIN32)
+    CRITICAL_SECTION mutex;
+#else
+    pthread_mutex_t mutex;
+#endif
+  };
+
+} /* namespace sc */
+
+#endif
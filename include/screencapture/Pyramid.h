@@ -0,0 +1,115 @@
+/*
+  -------------------------------------------------------------------------
+
+  Copyright 2015 roxlu <info#AT#roxlu.com>
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  -------------------------------------------------------------------------
+
+
+
+  Pyramid
+  =======
+
+  Builds smaller copies of a frame, e.g. a preview and a thumbnail
+  next to the full resolution stream, without capturing the display
+  more than once. Every level is half the width and height of the
+  level above it and every sample is the rounded mean of the 2 x 2
+  samples it covers (`kernel_box_2x2_row()`). Level 1 is built from
+  the base frame, level 2 from level 1, and so on.
+
+  ````c++
+
+      sc::Pyramid pyramid;
+      pyramid.init(2560, 1440, SC_420V, 4);
+      pyramid.build(frame);
+
+      // pyramid.levels[0] is 1280 x 720, levels[1] 640 x 360,
+      // levels[2] 320 x 180 and levels[3] 160 x 90.
+
+  ````
+
+  `build()` walks the base frame once: it works in bands of rows
+  that every level can finish on its own (2 rows of the smallest
+  level, 4 of the level above it, ...), so the rows that a level reads
+  were just written by the level above it and are still in the cache.
+  Pass an `Executor` to build the bands in parallel; the result is
+  identical to the serial one.
+
+  A level is `width / 2` x `height / 2` of the level above it (rounded
+  down); for the 4:2:0 formats we round down to even sizes so the
+  chroma samples line up, and the last odd row or column of a level
+  does not contribute to the next one. Use
+  `screencapture_get_pyramid_size()` to get the size of a level before
+  you capture, e.g. to set up encoders.
+
+  `ScreenCapture` builds a pyramid when you set
+  `Settings::pyramid_levels`: after every frame we pass the levels into
+  the callback, from large to small, with `PixelBuffer::level` set to
+  their level and a `PixelBuffer::info` that is mapped into them. Masks
+  and overlays are applied before we build the levels, so they show up
+  in every level.
+
+  Supported pixel formats: SC_BGRA, SC_RGBA, SC_RGB24, SC_BGR24,
+  SC_420V, SC_420F and SC_I420.
+
+ */
+#ifndef SCREEN_CAPTURE_PYRAMID_H
+#define SCREEN_CAPTURE_PYRAMID_H
+
+#include <vector>
+#include <screencapture/Types.h>
+
+#define SC_PYRAMID_MAX_LEVELS 8                                  /* The maximum number of levels below the base frame. */
+
+namespace sc {
+
+  class Executor;
+
+  /* ----------------------------------------------------------- */
+
+  class Pyramid {
+  public:
+    Pyramid();
+    ~Pyramid();
+    int init(int w, int h, int fmt, int nlevels);                /* Allocates `nlevels` levels below a `w` x `h` base frame in `fmt`. Returns 0 on success, < 0 when the format is not supported or the smallest level would be empty. */
+    int isInitFor(int w, int h, int fmt, int nlevels);           /* Returns 0 when `init()` was called with these values, otherwise -1. */
+    int build(PixelBuffer& base, Executor* executor = NULL);     /* Fills all levels from `base`, which must have the size and format of `init()`. Returns 0 on success, < 0 on error. */
+    void buildBands(PixelBuffer& base, int first, int count);    /* Fills the bands [first, first + count) of all levels; used by `build()`. */
+    int isInit();                                                /* Returns 0 when initialized, otherwise -1. */
+
+  public:
+    int base_width;                                              /* The width of the base frame. */
+    int base_height;                                             /* The height of the base frame. */
+    int pixel_format;                                            /* The pixel format of the base frame and the levels. */
+    int num_levels;                                              /* The number of levels below the base frame; 0 when not initialized. */
+    int num_bands;                                               /* The number of bands that `build()` processes, see above. */
+    PixelBuffer levels[SC_PYRAMID_MAX_LEVELS];                   /* `levels[i]` is level `i + 1`: half the size of `levels[i - 1]`, or of the base frame for `levels[0]`. */
+    std::vector<uint8_t> pixels[SC_PYRAMID_MAX_LEVELS];          /* The memory of the levels. */
+  };
+
+  /* ----------------------------------------------------------- */
+
+  int screencapture_can_build_pyramid(int fmt);                  /* Returns 0 when we can build pyramids of frames in `fmt`, otherwise -1. */
+  int screencapture_get_pyramid_size(int w, int h, int fmt, int level, int& level_width, int& level_height);  /* Sets the size of `level` (1 is half the size of the `w` x `h` base frame) of a pyramid in `fmt`. Returns 0 on success, < 0 when the format is not supported or the level would be empty. */
+
+  /* ----------------------------------------------------------- */
+
+  inline int Pyramid::isInit() {
+    return (0 == num_levels) ? -1 : 0;
+  }
+
+} /* namespace sc */
+
+#endif
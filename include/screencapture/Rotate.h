@@ -0,0 +1,78 @@
+/*
+  -------------------------------------------------------------------------
+
+  Copyright 2015 roxlu <info#AT#roxlu.com>
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  -------------------------------------------------------------------------
+
+  Rotate
+  ======
+
+  Rotates `PixelBuffer`s by 90, 180 or 270 degrees (clockwise) and/or
+  mirrors them. The rotation is one of the SC_ROTATE_* values in Types.h,
+  optionally combined with SC_FLIP_HORIZONTAL and SC_FLIP_VERTICAL,
+  which mirror the rotated frame like the four cases of
+  `ScreenCaptureGL::flip()`. Mirroring in both directions is the same as
+  rotating by 180 degrees.
+
+  ````c++
+
+      int w, h;
+      sc::screencapture_get_rotated_size(SC_ROTATE_90, buffer.width, buffer.height, w, h);
+
+      sc::PixelBuffer rotated;
+      std::vector<uint8_t> mem;
+
+      rotated.init(w, h, buffer.pixel_format);
+      mem.resize(rotated.getNumBytes());
+      rotated.setPlanes(&mem.front());
+
+      sc::screencapture_rotate(buffer, rotated, SC_ROTATE_90);
+
+  ````
+
+  Rotating by 90 or 270 degrees turns the rows of the source into the
+  columns of the destination. Doing that per pixel touches a new cache
+  line for every pixel that we write, so we transpose tiles of 64 x 64
+  samples, which fit in the L1 cache, with SIMD kernels that swap 8 x 8
+  (or 4 x 4 for 4 byte pixels) blocks in registers; see
+  `kernel_transpose_block()`. 180 degrees and the mirrors reverse or
+  copy whole rows.
+
+  Supported pixel formats: SC_BGRA, SC_RGBA, SC_L10R, SC_420V, SC_420F,
+  SC_I420 and SC_P010. Pass an `Executor` (see Executor.h) to rotate in
+  parallel slices; the output is identical to the serial one.
+
+  `ScreenCapture` rotates the frames of displays that have a
+  `Display::rotation` (e.g. a portrait mounted monitor) so you always
+  receive upright frames.
+
+ */
+#ifndef SCREEN_CAPTURE_ROTATE_H
+#define SCREEN_CAPTURE_ROTATE_H
+
+#include <screencapture/Types.h>
+
+namespace sc {
+
+  class Executor;
+
+  int screencapture_rotate(PixelBuffer& src, PixelBuffer& dst, int rotation, Executor* executor = NULL);  /* Rotates and/or mirrors `src` into `dst`, which must have the same pixel format and the rotated size. `rotation` is a SC_ROTATE_* value, optionally combined with SC_FLIP_*. `src` and `dst` must not overlap. Returns 0 on success, < 0 on error. */
+  int screencapture_can_rotate(int fmt);                          /* Returns 0 when we can rotate frames in the pixel format `fmt`, otherwise -1. */
+  int screencapture_get_rotated_size(int rotation, int width, int height, int& rotated_width, int& rotated_height);  /* Sets the size of a `width` x `height` frame after the rotation. Returns 0 on success, < 0 when `rotation` is invalid. */
+
+} /* namespace sc */
+
+#endif
@@ -0,0 +1,165 @@
+/*
+  -------------------------------------------------------------------------
+
+  Copyright 2015 roxlu <info#AT#roxlu.com>
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  -------------------------------------------------------------------------
+
+  Scaler
+  ======
+
+  Scales `PixelBuffer`s on the CPU with a separable bilinear filter. The
+  source and destination sizes are given to `init()` which computes the
+  sample positions and weights for every column and row once; `scale()`
+  then only runs the (SIMD) row kernels. Every row of the destination
+  is created by blending two source rows into a temporary row (vertical
+  pass) and sampling that row at the precomputed columns (horizontal pass).
+
+  When a plane is downscaled by exactly 2, 3 or 4 in both directions
+  (e.g. 3840 x 2160 into 1920 x 1080 or 1280 x 720) we use an area
+  average (box filter) instead: every destination sample is the rounded
+  mean of the factor x factor block it covers. Unlike the bilinear path
+  every source pixel contributes so small text doesn't alias, at about
+  the same cost. The choice is made per plane, e.g. the chroma plane of
+  an odd sized NV12 buffer falls back to bilinear while its Y plane
+  uses the box filter.
+
+  ````c++
+
+      sc::Scaler scaler;
+      scaler.init(3840, 2160, 1280, 720, SC_BGRA);
+      scaler.scale(captured, scaled);
+
+  ````
+
+  Higher quality: pass SC_SCALE_BICUBIC or SC_SCALE_LANCZOS3 to `init()`
+  (see `Settings::scale_quality`) to use a separable bicubic or Lanczos-3
+  filter. For every destination column and row we compute a filter of
+  `num_taps` fixed point weights (14 fractional bits); when downscaling
+  the filter is widened so every source sample contributes. Computing
+  these weights is relatively expensive, so the filters are cached per
+  source size, destination size and quality until the scaler is
+  destroyed; calling `init()` again for sizes we used before, e.g. after
+  `ScreenCapture::configure()`, reuses them. These qualities never use
+  the box filter.
+
+  ````c++
+
+      sc::Scaler scaler;
+      scaler.init(3840, 2160, 1920, 1080, SC_420V, SC_SCALE_LANCZOS3);
+      scaler.scale(captured, scaled);
+
+  ````
+
+  Pass an `Executor` to `scale()` to scale every plane in horizontal
+  slices on its threads; the output is identical to the serial one.
+
+  Supported pixel formats: SC_BGRA, SC_RGBA, SC_420V, SC_420F and SC_I420.
+  `ScreenCapture` uses the scaler when a driver delivers frames with a
+  size that differs from the `output_width` and `output_height` settings,
+  so CPU based drivers can simply deliver the native size.
+
+  Use `screencapture_get_fit_rect()` to scale a frame into a buffer
+  with a different aspect ratio without distorting it: it returns the
+  largest centered rect with the aspect ratio of the frame, the
+  renderer of the Direct3D11 driver and the `Compositor` use it.
+
+ */
+#ifndef SCREEN_CAPTURE_SCALER_H
+#define SCREEN_CAPTURE_SCALER_H
+
+#include <vector>
+#include <screencapture/Types.h>
+
+namespace sc {
+
+  class Executor;
+
+  /* ----------------------------------------------------------- */
+
+  struct ScalerFilter {
+    int src_size;                                                /* The number of source samples (width or height). */
+    int dst_size;                                                /* The number of destination samples. */
+    int quality;                                                 /* SC_SCALE_BICUBIC or SC_SCALE_LANCZOS3. */
+    int num_taps;                                                /* The number of weights per destination sample; a multiple of 4, the last ones may be zero. */
+    std::vector<int> offset;                                     /* Per destination sample, the first source sample that we read. */
+    std::vector<int16_t> weights;                                /* Per destination sample `num_taps` weights, 14 fractional bits; they add up to 1 << 14. */
+  };
+
+  /* ----------------------------------------------------------- */
+
+  struct ScalerPlane {
+    int src_width;                                               /* Width of the source plane, in samples (pixels). */
+    int src_height;                                              /* Height of the source plane. */
+    int dst_width;                                               /* Width of the destination plane. */
+    int dst_height;                                              /* Height of the destination plane. */
+    int bpp;                                                     /* Bytes per sample: 4 for BGRA, 2 for interleaved UV, 1 for Y, U or V. */
+    int box_factor;                                              /* When > 0 the plane is downscaled by this integer factor with a box filter and the bilinear coefficients are not used. */
+    ScalerFilter* x_filter;                                      /* When set we use the horizontal and vertical filters instead of the bilinear coefficients. Owned by the scaler. */
+    ScalerFilter* y_filter;                                      /* See `x_filter`. */
+    std::vector<int> x_offset;                                   /* Per destination column, the byte offset of the left source sample. */
+    std::vector<int16_t> x_frac;                                 /* Per destination column, the weight of the right source sample, 7 fractional bits. */
+    std::vector<int> y_offset;                                   /* Per destination row, the top source row. */
+    std::vector<int16_t> y_frac;                                 /* Per destination row, the weight of the bottom source row, 7 fractional bits. */
+  };
+
+  /* ----------------------------------------------------------- */
+
+  struct ScalerScratch {
+    std::vector<uint8_t> row;                                    /* The temporary row that holds the result of the vertical pass. */
+    std::vector<uint16_t> sums;                                  /* The temporary row that holds the vertical sums of the box filter. */
+    std::vector<const uint8_t*> rows;                            /* The source rows of the vertical filter. */
+    std::vector<uint8_t> converted;                              /* The scaled rows that `screencapture_scale_convert()` converts; kept so we don't allocate them for every frame. */
+  };
+
+  /* ----------------------------------------------------------- */
+
+  class Scaler {
+  public:
+    Scaler();
+    ~Scaler();
+    int init(int srcw, int srch, int dstw, int dsth, int fmt, int quality = SC_SCALE_BILINEAR);       /* Computes the coefficients to scale `fmt` buffers from srcw x srch into dstw x dsth with the given SC_SCALE_* quality. Returns 0 on success, < 0 on error. */
+    int shutdown();                                              /* Releases the coefficients; `init()` can be called again. Cached filters are kept. */
+    int scale(PixelBuffer& src, PixelBuffer& dst, Executor* executor = NULL); /* Scales `src` into `dst`; both must match the sizes and format given to `init()`. When `executor` is given the rows are scaled in parallel slices. */
+    int scaleRows(PixelBuffer& src, int plane, int first, int count, uint8_t* dst, size_t stride, int thread = 0); /* Creates `count` rows, starting at row `first`, of the scaled `plane` of `src` into `dst`. Used to scale parts of a frame, e.g. to convert the scaled rows before we create the next ones. `thread` selects the scratch memory; see `setNumThreads()`. Doesn't validate `src`; see `scale()`. */
+    int setNumThreads(int n);                                    /* Makes sure we have scratch memory for `n` threads that call `scaleRows()` at the same time, with `thread` in [0, n). */
+    int isInit();                                                /* Returns 0 when initialized, otherwise -1. */
+    int isInitFor(int srcw, int srch, int dstw, int dsth, int fmt, int quality = SC_SCALE_BILINEAR);  /* Returns 0 when we're initialized for the given sizes, pixel format and quality, otherwise -1. */
+
+  private:
+    ScalerFilter* getFilter(int src_size, int dst_size, int quality); /* Returns the cached filter for the given sizes and quality; creates it when we have none yet. */
+
+  public:
+    int pixel_format;                                            /* The pixel format that we scale. */
+    int quality;                                                 /* The SC_SCALE_* quality. */
+    int num_planes;                                              /* The number of planes of `pixel_format`. */
+    ScalerPlane planes[3];                                       /* The coefficients per plane. */
+    std::vector<ScalerScratch> scratch;                          /* The temporary rows per thread; all have the same size. */
+    std::vector<ScalerFilter*> filters;                          /* The cached filters; see `getFilter()`. */
+  };
+
+  /* ----------------------------------------------------------- */
+
+  int screencapture_get_fit_rect(int srcw, int srch, int dstw, int dsth, int even, int& x, int& y, int& w, int& h); /* Sets `x`, `y`, `w` and `h` to the largest rect with the aspect ratio of `srcw` x `srch` that fits centered in `dstw` x `dsth`. With `even` set the position and size are even (except when the size equals `dstw` or `dsth`) so the chroma planes of 4:2:0 line up. Returns 0 on success, < 0 when a size is invalid. */
+
+  /* ----------------------------------------------------------- */
+
+  inline int Scaler::isInit() {
+    return (SC_NONE == pixel_format) ? -1 : 0;
+  }
+
+} /* namespace sc */
+
+#endif
@@ -59,12 +59,87 @@
   support for rectangles or windows yet.
   **
 
+  Pixel formats:
+  --------------
+  When you configure a pixel format that the driver can't capture
+  natively (e.g. SC_RGB24 or SC_I420 on Windows, or SC_P010 which we
+  convert from SC_L10R on Mac), we configure the
+  driver with a native format that we can convert from and convert
+  every frame in one pass before we call your callback. See Convert.h.
+  `getPixelFormats()` returns the native and the converted formats.
+
+  Drivers should deliver frames at `output_width` x `output_height`;
+  when a driver delivers another size (e.g. the native size of the
+  display) we scale the frame on the CPU first, with the filter that
+  you select with `Settings::scale_quality`. See Scaler.h. When the
+  aspect ratio of the display differs from the output size we
+  letterbox the frame, also when a GPU driver scales it: it's scaled
+  into the centered rect of `screencapture_get_fit_rect()` (with even
+  position and size) and the bars around it are black.
+
+  Scaling and converting a large frame (e.g. 8K) on the capture thread
+  can take longer than a frame interval. Set `Settings::num_threads` to
+  a value > 1, or to 0 to use all CPU cores, to process every frame in
+  horizontal slices on a pool of worker threads. See Executor.h.
+
+  Frames of rotated displays, e.g. a portrait mounted monitor, are
+  rotated upright (see Rotate.h and `Display::rotation`) before we
+  scale and convert them; `output_width` and `output_height` are the
+  size of the upright frames.
+
+  YCbCr frames use the BT.601 matrix unless you set
+  `Settings::color_matrix`; use BT.709 for HD content, that's what
+  most encoders and players assume. `Settings::color_range` selects
+  video or full range for SC_I420 and SC_P010. When the driver can't
+  produce the matrix itself we capture in RGB and convert.
+
+  Set `Settings::drop_static_frames` to skip the frames that are the
+  same as the last frame we passed into your callback, e.g. for a
+  static desktop; we still pass one every `Settings::keepalive_ms`.
+  We trust `PixelBuffer::damage` when the driver sets it and hash
+  the captured frame otherwise. See StaticFrameFilter in Dirty.h.
+
+  Every frame carries a `PixelBuffer::info` with the dirty and moved
+  rectangles, the pointer and the timestamps that the driver knows;
+  we map them into the rotated, scaled frame that you receive. See
+  FrameInfo.h.
+
+  Use `setMaskRegions()` to redact parts of the frames (fill, pixelate
+  or blur) before they reach the callback; see Mask.h. We never pass a
+  frame that we failed to mask. When we would pass the frame of the
+  driver itself we copy it first, because its memory is read only.
+
+  Use `setOverlay()` to burn premultiplied BGRA images, e.g. a
+  watermark or a timestamp, into the frames; we draw them after
+  masking. See Overlay.h.
+
+  Set `Settings::pyramid_levels` to receive smaller copies of every
+  frame from the same capture, e.g. a preview and a thumbnail: after
+  the frame we pass each level, half the size of the previous one,
+  into the callback with `PixelBuffer::level` set. See Pyramid.h.
+
+  Set `Settings::frame_stats` to receive the luma histogram, the mean
+  and variance of 8 x 8 tiles and blank screen detection of every
+  frame in `FrameInfo::stats`. When we convert the frame we compute
+  them in the same pass; they describe the frame before masking and
+  overlays. See Analytics.h.
+
  */
 #ifndef SCREEN_CAPTURE_H
 #define SCREEN_CAPTURE_H
 
+#include <vector>
+#include <algorithm>
 #include <screencapture/Base.h>
 #include <screencapture/Types.h>
+#include <screencapture/Convert.h>
+#include <screencapture/Scaler.h>
+#include <screencapture/Executor.h>
+#include <screencapture/Dirty.h>
+#include <screencapture/FrameInfo.h>
+#include <screencapture/Mask.h>
+#include <screencapture/Overlay.h>
+#include <screencapture/Pyramid.h>
 
 #if defined(__APPLE__)
 #  include <screencapture/mac/ScreenCaptureDisplayStream.h>
@@ -97,6 +172,9 @@ namespace sc {
     int listDisplays();                                                                                 /* Prints out the displays in the console. */
     int listPixelFormats();                                                                             /* Prints out the supposed pixel formats. */
     int isPixelFormatSupported(int fmt);                                                                /* Checks if the given pixel format is supported. See Types.h for available pixel formats. */
+    int setMaskRegions(const std::vector<MaskRegion>& regions);                                         /* Sets the regions of the output frames that we redact, see Mask.h; the next frame uses them. Can be called from any thread, also from the callback. Pass an empty list to stop masking. Returns 0 on success, < 0 when a region is invalid. */
+    int setOverlay(int id, int x, int y, int w, int h, size_t stride, const uint8_t* pixels);           /* Adds or replaces the overlay with the given id: `w` x `h` premultiplied BGRA pixels that we blend over the output frames at `x`, `y`, see Overlay.h. Can be called from any thread, for every frame; we only copy pixels that changed. Returns 0 on success, < 0 on error. */
+    int removeOverlay(int id);                                                                          /* Removes the overlay with the given id. Returns 0 on success, < 0 when there is no such overlay. */
 
     /* Query state. */
     int isInit();                        
@@ -104,9 +182,46 @@ namespace sc {
     int isConfigured();
     int isStarted();
     int isStopped();
+
+    /* Frames. */
+    int selectCaptureFormat(int fmt, int matrix, int range);                                            /* Selects the pixel format that the driver uses to capture frames that we can deliver as `fmt` with the given SC_COLOR_MATRIX_* and SC_COLOR_RANGE_*. Sets `capture_format`. */
+    void processFrame(PixelBuffer& buffer);                                                             /* Gets called by the driver for every captured frame; rotates, scales and converts the frame when necessary and passes it to the callback. */
+    PixelBuffer* rotateFrame(PixelBuffer& buffer);                                                      /* Returns `buffer` when the display isn't rotated, otherwise rotates it upright into `rotated` and returns `rotated`; NULL on error. */
+    PixelBuffer* scaleFrame(PixelBuffer& buffer);                                                       /* Returns `buffer` when it has the output size, otherwise scales it into `scaled`, letterboxed, and returns `scaled`; NULL on error. */
+    int initScaler(PixelBuffer& buffer, int w, int h);                                                  /* Makes sure `scaler` is initialized to scale `buffer` into `w` x `h`. Returns 0 on success, < 0 on error. */
+    int fitFrame(PixelBuffer& buffer, PixelBuffer& frame, PixelBuffer& view);                           /* Sets `view` to the letterboxed rect of `frame` that we scale `buffer` into (see `screencapture_get_fit_rect()`), fills the bars around it with black and initializes `scaler` for it. Returns 0 on success, < 0 on error. */
+    Executor* getExecutor();                                                                            /* Returns `executor` when we process frames on multiple threads, otherwise NULL. */
+    FrameInfo* transformInfo(PixelBuffer& captured);                                                    /* Returns the info of the driver mapped into the frame that we pass into the callback: `captured.info` when we don't rotate, scale or convert into 4:2:0, otherwise `output_info`. NULL when the driver has no info. */
+    void deliverFrame(PixelBuffer& buffer, FrameInfo* info, int has_regions, int has_overlays);         /* Computes the stats of `buffer` unless we did while converting it, masks the regions of `mask` in `buffer` and draws the `overlays` (copying it into `masked` when it's the frame of the driver) and passes it into the callback with `info`. `has_regions` and `has_overlays` are the results of `mask.update()` and `overlays.update()` for this frame. Drops the frame when masking or drawing fails. */
+    void deliverLevels(PixelBuffer& buffer, FrameInfo* info);                                           /* Builds the `pyramid` of the delivered frame `buffer` and passes its levels into the callback, with `info` mapped into them. */
     
   public:
     Base* impl;
+    screencapture_callback callback;                                                                    /* The callback that receives the frames, given to the constructor. */
+    void* user;                                                                                         /* The user pointer that we set on the pixel buffers we pass into the callback. */
+    Settings settings;                                                                                  /* The settings passed into `configure()`. */
+    int capture_format;                                                                                 /* The pixel format the driver captures in; when this is different from `settings.pixel_format` we convert into `output`. */
+    PixelBuffer output;                                                                                 /* The converted frame that we pass into the callback, only used when we need to convert. */
+    std::vector<uint8_t> output_pixels;                                                                 /* The memory for `output`. */
+    int convert_flags;                                                                                  /* The SC_CONVERT_* flags for the color matrix and range of `settings`, that we use to convert the frames. */
+    Scaler scaler;                                                                                      /* Scales the frames of drivers that deliver a different size than the output size. */
+    PixelBuffer scaled;                                                                                 /* The scaled frame, in the capture format. */
+    std::vector<uint8_t> scaled_pixels;                                                                 /* The memory for `scaled`. */
+    uint8_t black[3][4];                                                                                /* The black samples of `black_format` that we fill the bars of the letterboxed frames with, see `fitFrame()`. */
+    int black_format;                                                                                   /* The pixel format of `black`; SC_NONE until we need the bars. */
+    int rotation;                                                                                       /* The `Display::rotation` of the captured display; we rotate the frames upright with it. */
+    PixelBuffer rotated;                                                                                /* The upright frame, in the capture format. */
+    std::vector<uint8_t> rotated_pixels;                                                                /* The memory for `rotated`. */
+    Executor executor;                                                                                  /* Scales and converts the frames in slices on `settings.num_threads` threads; only initialized when we use more than one thread. */
+    StaticFrameFilter static_filter;                                                                    /* Drops the frames that are the same as the last frame we passed into the callback, when `settings.drop_static_frames` is set. */
+    FrameInfo output_info;                                                                              /* The info of the driver mapped into the rotated and/or scaled frame, see `transformInfo()`. */
+    PrivacyMask mask;                                                                                   /* The regions that we redact, see `setMaskRegions()`. */
+    Overlays overlays;                                                                                  /* The images that we burn into the frames, see `setOverlay()`. */
+    PixelBuffer masked;                                                                                 /* A copy of the frame of the driver that we can mask and draw into, only used when we don't rotate, scale or convert. */
+    std::vector<uint8_t> masked_pixels;                                                                 /* The memory for `masked`. */
+    Pyramid pyramid;                                                                                    /* The smaller copies of the frames, when `settings.pyramid_levels` > 0. */
+    FrameInfo level_info;                                                                               /* The info of the frame mapped into the current level of `pyramid`. */
+    FrameAnalyzer analyzer;                                                                             /* Computes the stats of the frames, when `settings.frame_stats` is set. */
   };
 
   /* ----------------------------------------------------------- */
@@ -120,7 +235,24 @@ namespace sc {
     }
 #endif
 
-    return impl->getPixelFormats(formats);
+    std::vector<int> conversions;
+    
+    if (0 != impl->getPixelFormats(formats)) {
+      return -1;
+    }
+
+    /* Add the formats we can convert into. */
+    size_t num_native = formats.size();
+    for (size_t i = 0; i < num_native; ++i) {
+      screencapture_get_conversions(formats[i], conversions);
+      for (size_t k = 0; k < conversions.size(); ++k) {
+        if (std::find(formats.begin(), formats.end(), conversions[k]) == formats.end()) {
+          formats.push_back(conversions[k]);
+        }
+      }
+    }
+
+    return 0;
   }
 
   inline int ScreenCapture::getDisplays(std::vector<Display*>& displays) {
@@ -198,7 +330,11 @@ namespace sc {
 
     return impl->isStopped();
   }
-  
+
+  inline Executor* ScreenCapture::getExecutor() {
+    return (0 == executor.isInit()) ? &executor : NULL;
+  }
+
 } /* namespace sc */
 
 #endif
@@ -174,6 +174,12 @@ namespace sc {
     GLuint tex1;                                                                 /* Second plane, only used when we receive planar data. */
     int unpack_alignment[3];
     int unpack_row_length[3];
+    int texture_format;                                                          /* The pixel format of the texture; frames in other pixel formats (e.g. SC_420F) are converted into this format in the frame callback. */
+    PixelBuffer converted;                                                       /* Describes the converted frame in `pixels` when the captured pixel format isn't the `texture_format`. */
+    int pixels_width;                                                            /* The width of the frames that `pixels` was allocated for; we reallocate when a frame has another size, stride or pixel format. */
+    int pixels_height;                                                           /* The height of the frames that `pixels` was allocated for. */
+    size_t pixels_stride;                                                        /* The stride of the SC_BGRA frames that `pixels` was allocated for. */
+    int pixels_format;                                                           /* The pixel format of the captured frames that `pixels` was allocated for. */
   };
 
   /* --------------------------------------------------------------------------- */
@@ -228,6 +234,7 @@ namespace sc {
   /* --------------------------------------------------------------------------- */
 
   static void sc_gl_frame_callback(PixelBuffer& buffer);
+  static int sc_gl_alloc_pixels(ScreenCaptureGL* gl, PixelBuffer& buffer);      /* (Re)allocates `pixels` and `converted` when `buffer` has another size, stride or pixel format than the frames they were allocated for. Call with the mutex locked. Returns 0 on success, < 0 on error. */
   
   /* --------------------------------------------------------------------------- */
   
@@ -246,6 +253,11 @@ namespace sc {
     ,has_new_frame(false)
     ,tex0(0)
     ,tex1(0)
+    ,texture_format(SC_BGRA)
+    ,pixels_width(0)
+    ,pixels_height(0)
+    ,pixels_stride(0)
+    ,pixels_format(SC_NONE)
   {
     memset(unpack_alignment, 0x00, sizeof(unpack_alignment));
     memset(unpack_row_length, 0x00, sizeof(unpack_row_length));
@@ -305,8 +317,8 @@ namespace sc {
 
     settings = cfg;
 
-    if (SC_BGRA != cfg.pixel_format) {
-      printf("Error: currently we only support SC_BGRA in ScreenCaptureGL.\n");
+    if (texture_format != cfg.pixel_format && 0 != screencapture_can_convert(cfg.pixel_format, texture_format)) {
+      printf("Error: ScreenCaptureGL supports SC_BGRA and the pixel formats that we can convert into SC_BGRA, not %s.\n", screencapture_pixelformat_to_string(cfg.pixel_format).c_str());
       return -1;
     }
     
@@ -370,7 +382,7 @@ namespace sc {
       return -2;
     }
 
-    if (SC_BGRA == settings.pixel_format) {
+    if (SC_BGRA == texture_format) {
       if (0 != create_shader(&frag, GL_FRAGMENT_SHADER, SCREENCAPTURE_GL_FS_BGRA)) {
         printf("Error: failed to create the screencapture fragment shader.\n");
         return -3;
@@ -421,8 +433,7 @@ namespace sc {
       return -3;
     }
 
-    if (SC_BGRA == settings.pixel_format) {
-
+    if (SC_BGRA == texture_format) {
 
       glGenTextures(1, &tex0);
       glBindTexture(GL_TEXTURE_2D, tex0);
@@ -447,7 +458,7 @@ namespace sc {
     cap.update();
 
 #if !defined(NDEBUG)    
-    if (SC_BGRA != settings.pixel_format) {
+    if (SC_BGRA != texture_format) {
       printf("Error: trying to update the ScreenCaptureGL, but we only support uploading of SC_BGRA data atm.\n");
       return;
     }
@@ -471,7 +482,7 @@ namespace sc {
         }
 
         glBindTexture(GL_TEXTURE_2D, tex0);
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, settings.output_width,  settings.output_height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, pixels_width, pixels_height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
         has_new_frame = false;
 
         /* Reset unpack state. */
@@ -498,7 +509,7 @@ namespace sc {
 #endif
     
     /* Based on the pixelf format bind the correct textures. */
-    if (SC_BGRA == settings.pixel_format) {
+    if (SC_BGRA == texture_format) {
       glActiveTexture(GL_TEXTURE0);
       glBindTexture(GL_TEXTURE_2D, tex0);
     }
@@ -738,6 +749,11 @@ namespace sc {
       return;
     }
 
+    /* The texture has the output size; the smaller pyramid levels (see Pyramid.h) are not drawn. */
+    if (0 != buffer.level) {
+      return;
+    }
+
     if (SC_BGRA == buffer.pixel_format) {
      
       if (0 == buffer.nbytes[0]) {
@@ -750,41 +766,99 @@ namespace sc {
         return;
       }
 
-      if (NULL == gl->pixels) {
-        
-        gl->pixels = new uint8_t[buffer.nbytes[0]];
-
-        /* Check if we need to change the alignment. */
-        int vals[] = { 1, 2, 4, 8 } ;
-        int unpack = 0;
-        for (int i = 0; i < 4; ++i) {
-          int p = pow(2, vals[i]);
-          int d = buffer.stride[0] % p;
-          if (0 != d) {
-            break;
-          }
-          unpack = vals[i];
-        }
-        
-        /* 4 is default. */
-        if (4 != unpack) {
-          gl->unpack_alignment[0] = unpack;
-        }
-
-        /* Do we need a different unpack row length? (the 4 is from GL_BGRA) */
-        if (buffer.stride[0] > buffer.width * 4) {
-          gl->unpack_row_length[0] = buffer.stride[0] / 4;
+      gl->lock();
+      {
+        if (0 == sc_gl_alloc_pixels(gl, buffer)) {
+          memcpy(gl->pixels, buffer.plane[0], buffer.nbytes[0]);
+          gl->has_new_frame = true;
         }
       }
+      gl->unlock();
+    }
+    else {
 
+      /* Convert into the texture format, e.g. SC_420F > SC_BGRA. */
       gl->lock();
       {
-        memcpy(gl->pixels, buffer.plane[0], buffer.nbytes[0]);
-        gl->has_new_frame = true;
+        /* The same matrix and range as the pipeline of `cap`, otherwise BT.709, BT.2020 and full range frames get BT.601 video range colors. */
+        int flags = SC_CONVERT_DITHER | screencapture_get_convert_flags(buffer.pixel_format, gl->settings.color_matrix, gl->settings.color_range);
+        if (0 == sc_gl_alloc_pixels(gl, buffer)
+            && 0 == screencapture_convert(buffer, gl->converted, flags))
+          {
+            gl->has_new_frame = true;
+          }
       }
       gl->unlock();
     }
   }
+
+  /* After a reconfigure `pixels` is NULL; frames of another size or pixel format need other memory too. */
+  static int sc_gl_alloc_pixels(ScreenCaptureGL* gl, PixelBuffer& buffer) {
+
+    size_t stride = (SC_BGRA == buffer.pixel_format) ? buffer.stride[0] : 0;
+
+    if (NULL != gl->pixels
+        && (int)buffer.width == gl->pixels_width
+        && (int)buffer.height == gl->pixels_height
+        && stride == gl->pixels_stride
+        && buffer.pixel_format == gl->pixels_format)
+      {
+        return 0;
+      }
+
+    if (NULL != gl->pixels) {
+      delete[] gl->pixels;
+      gl->pixels = NULL;
+    }
+
+    gl->pixels_format = SC_NONE;
+    gl->unpack_alignment[0] = 0;
+    gl->unpack_row_length[0] = 0;
+
+    if (SC_BGRA == buffer.pixel_format) {
+
+      gl->pixels = new uint8_t[buffer.nbytes[0]];
+
+      /* Check if we need to change the alignment. */
+      int vals[] = { 1, 2, 4, 8 } ;
+      int unpack = 0;
+      for (int i = 0; i < 4; ++i) {
+        int p = pow(2, vals[i]);
+        int d = buffer.stride[0] % p;
+        if (0 != d) {
+          break;
+        }
+        unpack = vals[i];
+      }
+        
+      /* 4 is default. */
+      if (4 != unpack) {
+        gl->unpack_alignment[0] = unpack;
+      }
+
+      /* Do we need a different unpack row length? (the 4 is from GL_BGRA) */
+      if (buffer.stride[0] > buffer.width * 4) {
+        gl->unpack_row_length[0] = buffer.stride[0] / 4;
+      }
+    }
+    else {
+
+      if (0 != gl->converted.init(buffer.width, buffer.height, gl->texture_format)) {
+        printf("Error: failed to initialize the buffer for the converted frames in ScreenCaptureGL.\n");
+        return -1;
+      }
+
+      gl->pixels = new uint8_t[gl->converted.getNumBytes()];
+      gl->converted.setPlanes(gl->pixels);
+    }
+
+    gl->pixels_width = (int)buffer.width;
+    gl->pixels_height = (int)buffer.height;
+    gl->pixels_stride = stride;
+    gl->pixels_format = buffer.pixel_format;
+
+    return 0;
+  }
   
   /* --------------------------------------------------------------------------- */
 } /* namespace sc */
@@ -0,0 +1,130 @@
+/*
+  -------------------------------------------------------------------------
+
+  Copyright 2015 roxlu <info#AT#roxlu.com>
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  -------------------------------------------------------------------------
+
+
+  Scroll
+  ======
+
+  Finds the parts of a frame that moved since the previous frame, e.g.
+  a scrolled document or a dragged window, so encoders and remote
+  viewers can copy them from their previous frame instead of sending
+  them again. DXGI reports these moves itself (`GetFrameMoveRects()`);
+  `ScrollDetector` finds them on the CPU for any driver.
+
+  ````c++
+
+      sc::ScrollDetector detector;
+      std::vector<sc::MoveRect> moves;
+
+      detector.init(buffer.width, buffer.height, buffer.pixel_format);
+
+      // For every frame.
+      detector.update(buffer, moves);
+
+      for (size_t i = 0; i < moves.size(); ++i) {
+        copy(moves[i].src_x, moves[i].src_y, moves[i].x, moves[i].y, moves[i].width, moves[i].height);
+      }
+
+  ````
+
+  We split the frame into vertical strips of `strip_size` pixels and
+  hash every row of every strip with `kernel_hash_block()`. A row that
+  changed and whose hash appears exactly once in the same strip of the
+  previous frame votes for the offset between the two rows. For the
+  offsets with the most votes we look for runs of at least `min_lines`
+  rows that match the previous frame at that offset; runs with the
+  same rows in neighbouring strips become one move. Strips make this
+  work for a window that scrolls while the rest of the row doesn't;
+  the strips that the window only partially covers don't match and
+  are left to the dirty rectangles (see Dirty.h). Horizontal moves are
+  found the same way with the columns of horizontal bands; we only
+  hash the columns of the bands that changed. A static frame costs
+  about as much as `DirtyDetector::update()`, a scrolled frame about
+  twice that (see test_scroll).
+
+  A move copies the `width` x `height` pixels at `src_x`, `src_y` of
+  the previous frame to `x`, `y`; the pixels of the current frame in
+  that rectangle are the result. Rows and columns are compared by
+  their 64 bit hashes, so a wrong move is possible but extremely
+  unlikely. For the 4:2:0 formats we only look at the luma plane and
+  only report even offsets, so the chroma samples move along.
+
+ */
+#ifndef SCREEN_CAPTURE_SCROLL_H
+#define SCREEN_CAPTURE_SCROLL_H
+
+#include <vector>
+#include <screencapture/Types.h>
+#include <screencapture/FrameInfo.h>
+
+#define SC_SCROLL_STRIP_SIZE 64                                  /* The default width of the vertical strips and height of the horizontal bands. */
+#define SC_SCROLL_MIN_LINES 16                                   /* The default minimum number of rows (or columns) that must move together. */
+#define SC_SCROLL_MAX_OFFSETS 4                                  /* The maximum number of different offsets per direction that we report for a frame. */
+
+namespace sc {
+
+  /* ----------------------------------------------------------- */
+
+  class ScrollDetector {
+  public:
+    ScrollDetector();
+    ~ScrollDetector();
+    int init(int w, int h, int fmt, int strip = SC_SCROLL_STRIP_SIZE);  /* Prepares to detect the moves of `w` x `h` frames of pixel format `fmt` in strips of `strip` pixels; `strip` must be even. Returns 0 on success, < 0 on error. */
+    int shutdown();                                              /* Releases the hashes; `init()` can be called again. */
+    int update(PixelBuffer& frame, std::vector<MoveRect>& moves);  /* Hashes `frame`, which must match the size and format given to `init()`, and sets `moves` to the rectangles that moved since the previous call; empty when nothing moved. Returns 0 on success, < 0 on error. */
+    void reset();                                                /* Forgets the previous frame; the next call to `update()` reports no moves. */
+    int isInit();                                                /* Returns 0 when initialized, otherwise -1. */
+    int isInitFor(int w, int h, int fmt, int strip = SC_SCROLL_STRIP_SIZE);  /* Returns 0 when we're initialized for the given size, pixel format and strip size, otherwise -1. */
+
+  private:
+    void hashRows(PixelBuffer& frame);                           /* Hashes the row of every strip into `rows`. */
+    void hashColumns(PixelBuffer& frame, int band);              /* Hashes the columns of the band into `cols`. */
+    void findMoves(const uint64_t* prev, const uint64_t* cur, int num, int n, int vertical, std::vector<MoveRect>& moves);  /* Finds the moves of the `num` strips (or bands) of `n` lines each, see the explanation above. */
+
+  public:
+    int width;                                                   /* The width of the frames. */
+    int height;                                                  /* The height of the frames. */
+    int pixel_format;                                            /* The pixel format of the frames. */
+    int strip_size;                                              /* The width of a strip and the height of a band; the ones at the right and bottom may be smaller. */
+    int min_lines;                                               /* The minimum number of rows or columns that must move together, SC_SCROLL_MIN_LINES by default. */
+    int num_strips;                                              /* The number of vertical strips. */
+    int num_bands;                                               /* The number of horizontal bands. */
+    int bpp;                                                     /* The bytes per sample of the first plane. */
+    int step;                                                    /* 2 for the 4:2:0 formats, they only move by even offsets; otherwise 1. */
+    bool has_hashes;                                             /* False until we hashed the first frame, or after `reset()`. */
+    std::vector<uint64_t> rows;                                  /* The hash of every row of every strip, strip by strip. */
+    std::vector<uint64_t> prev_rows;                             /* `rows` of the previous frame. */
+    std::vector<uint64_t> cols;                                  /* The hash of every column of every band, band by band. */
+    std::vector<uint64_t> prev_cols;                             /* `cols` of the previous frame. */
+    std::vector<int> votes;                                      /* The number of lines that vote for an offset, index `offset + n`. */
+    std::vector<uint8_t> claimed;                                /* Per line of every strip (or band) 1 when it's part of a move. */
+    std::vector<int> table_lines;                                /* A hash table of the lines of a strip of the previous frame, to find the line that a line of the current frame was before; -1 is empty, -2 is a hash of more than one line. */
+    std::vector<uint64_t> table_hashes;                          /* The hash of every slot of `table_lines`. */
+    int table_shift;                                             /* 64 minus the number of bits of a slot of the table; the top bits of a hash select the slot. */
+  };
+
+  /* ----------------------------------------------------------- */
+
+  inline int ScrollDetector::isInit() {
+    return (SC_NONE == pixel_format) ? -1 : 0;
+  }
+
+} /* namespace sc */
+
+#endif
@@ -43,6 +43,43 @@
 #define SC_420F 2                                                /* 2-plane "full" range YCbCr 4:2:0 */
 #define SC_BGRA 3                                                /* Packed Little Endian ARGB8888 */
 #define SC_L10R 4                                                /* Packet Little Endian ARGB2101010 */
+#define SC_I420 5                                                /* 3-plane "video" range YCbCr 4:2:0, Y, U (Cb) and V (Cr) planes. */
+#define SC_RGBA 6                                                /* Packed Little Endian ABGR8888, bytes in memory: R, G, B, A. */
+#define SC_RGB24 7                                               /* Packed 24 bit, bytes in memory: R, G, B. */
+#define SC_BGR24 8                                               /* Packed 24 bit, bytes in memory: B, G, R. */
+#define SC_P010 9                                                /* 2-plane 10 bit "video" range YCbCr 4:2:0, 16 bit little endian samples with the value in the upper 10 bits. */
+#define SC_RGB48 10                                              /* Packed 48 bit, 16 bit little endian R, G, B. */
+
+/* Scale quality, see Scaler.h */
+#define SC_SCALE_BILINEAR 0                                      /* Bilinear, or a box filter for 2x, 3x and 4x downscales. Fastest. */
+#define SC_SCALE_BICUBIC 1                                       /* Bicubic (Catmull-Rom) filter. */
+#define SC_SCALE_LANCZOS3 2                                      /* Lanczos filter with 3 lobes. Sharpest, slowest; e.g. for archival recordings. */
+
+/* YCbCr color matrix, see Settings::color_matrix */
+#define SC_COLOR_MATRIX_BT601 0                                  /* SD video. */
+#define SC_COLOR_MATRIX_BT709 1                                  /* HD video; what most encoders and players expect for screen content. */
+#define SC_COLOR_MATRIX_BT2020 2                                 /* UHD / HDR video, non-constant luminance. */
+
+/* YCbCr range, see Settings::color_range */
+#define SC_COLOR_RANGE_AUTO 0                                    /* Follows from the pixel format: SC_420F is full range, the other YCbCr formats video range. */
+#define SC_COLOR_RANGE_VIDEO 1                                   /* Y in 16-235, Cb and Cr in 16-240 (or 64-940 for 10 bit). */
+#define SC_COLOR_RANGE_FULL 2                                    /* Y, Cb and Cr use all values. */
+
+/* Rotation and mirroring, see Rotate.h */
+#define SC_ROTATE_0 0                                            /* Upright, nothing to do. */
+#define SC_ROTATE_90 1                                           /* Rotate 90 degrees clockwise. */
+#define SC_ROTATE_180 2                                          /* Rotate 180 degrees. */
+#define SC_ROTATE_270 3                                          /* Rotate 270 degrees clockwise (90 counter clockwise). */
+#define SC_FLIP_HORIZONTAL (1 << 2)                              /* Mirror left and right after rotating; like `ScreenCaptureGL::flip(true, false)`. */
+#define SC_FLIP_VERTICAL (1 << 3)                                /* Mirror top and bottom after rotating; like `ScreenCaptureGL::flip(false, true)`. */
+
+/* What the driver knows about the changes of a frame, see PixelBuffer::damage. */
+#define SC_DAMAGE_UNKNOWN 0                                      /* The driver doesn't know whether the frame changed; we compare its content when we need to. */
+#define SC_DAMAGE_NONE 1                                         /* The frame is the same as the previous frame of the driver, e.g. only the time stamp changed. */
+#define SC_DAMAGE_CHANGED 2                                      /* The frame differs from the previous frame of the driver. */
+
+/* The alignment (in bytes) that `PixelBuffer::init()` uses for the strides of planar formats; keeps rows SIMD friendly. */
+#define SC_STRIDE_ALIGNMENT 32
                                                                          
 /* Capture state. */                                                     
 #define SC_STATE_INIT          (1 << 0)                          /* Initialised, init() called, memory allocated.  */
@@ -56,29 +93,47 @@ namespace sc {
   /* ----------------------------------------------------------- */
 
   std::string screencapture_pixelformat_to_string(int format);
+  int screencapture_get_plane_layout(int fmt, int* bpp);          /* Returns the number of planes of `fmt` (0 for unknown formats) and sets `bpp[i]` to the bytes per sample of plane i; the second and third plane are the 4:2:0 chroma planes. */
 
   /* ----------------------------------------------------------- */
   
   class PixelBuffer;
+  class FrameInfo;
   
   typedef void(*screencapture_callback)(PixelBuffer& buffer);
 
   /* ----------------------------------------------------------- */
 
+  /*
+    A frame, or a view of a rectangle of another frame (see `getView()`).
+    A view points into the planes of its parent with the parent's strides,
+    so creating one copies no pixels. Views don't own anything and the
+    parent doesn't know about them: keep the parent and its memory alive
+    and don't re-initialize it while you use its views. Views of the
+    frames that you receive in the capture callback are only valid
+    during the callback.
+  */
   class PixelBuffer {
   public:
     PixelBuffer();                                               /* Initializes; resets all members. */
     ~PixelBuffer();                                              /* Cleans up, resets all members. */
-    int init(int w, int h, int fmt);                             /* Sets the given width, height and pixel format members. */
+    int init(int w, int h, int fmt);                             /* Sets the given width, height and pixel format members and computes the strides and number of bytes per plane. */
+    int setPlanes(uint8_t* data);                                /* Points the planes into `data` which must be at least `getNumBytes()` bytes; use this after `init()` when you allocate the memory yourself. */
+    size_t getNumBytes();                                        /* Returns the total number of bytes of all planes. */
+    int getView(int x, int y, int w, int h, PixelBuffer& view);  /* Sets `view` to the `w` x `h` rectangle at `x`, `y` without copying. For the 4:2:0 formats `x` and `y` must be even so the chroma planes line up. The view is valid as long as the planes of this buffer are. Returns 0 on success, < 0 when the rectangle is invalid. */
     
   public:
     int pixel_format;                                            /* The pixel format; should be the same as the requested pixel format you pass to the `configure()` function of the screen capture instance. */
     uint8_t* plane[3];                                           /* Pointers to the base addresses where you can find the pixel data. When we have non-planar data, plane[0] will point to the pixels. */
     size_t stride[3];                                            /* Strides per plane. */
-    size_t nbytes[3];                                            /* Bytes per plane. */
+    size_t nbytes[3];                                            /* Bytes per plane; 0 for views, they don't own their planes. */
     size_t width;                                                /* Width of the captured frame. */
     size_t height;                                               /* Height of the captured frame. */
     void* user;                                                  /* User data; set to the user pointer you pass into the capturer. */ 
+    PixelBuffer* parent;                                         /* The buffer that this is a view of, NULL when this is not a view; a copy of a view is a view of the same parent. Never dereferenced, see `getView()`. */
+    int damage;                                                  /* SC_DAMAGE_* set by drivers that know whether the frame changed; SC_DAMAGE_UNKNOWN by default. */
+    FrameInfo* info;                                             /* The dirty rectangles, moves, cursor and times of the frame (see FrameInfo.h); NULL when the driver doesn't provide them. Not owned. */
+    int level;                                                   /* 0 for the frame at the output size, n for the level of `Settings::pyramid_levels` that is 2^n times smaller; see Pyramid.h. */
   };
 
   /* ----------------------------------------------------------- */
@@ -91,13 +146,23 @@ namespace sc {
     int pixel_format;                                            /* The pixel format that you want to use when capturing. */
     int output_width;                                            /* The width for the buffer you'll receive. */
     int output_height;                                           /* The height fr the buffer you'll receive. */
+    int scale_quality;                                           /* The filter we use when we have to scale the captured frames into output_width x output_height: SC_SCALE_BILINEAR (default), SC_SCALE_BICUBIC or SC_SCALE_LANCZOS3. Every filter letterboxes frames with another aspect ratio the same way: centered, with black bars. */
+    int color_matrix;                                            /* The matrix of the YCbCr frames that you receive: SC_COLOR_MATRIX_BT601 (default), SC_COLOR_MATRIX_BT709 or SC_COLOR_MATRIX_BT2020. */
+    int color_range;                                             /* The range of the YCbCr frames: SC_COLOR_RANGE_AUTO (default), SC_COLOR_RANGE_VIDEO or SC_COLOR_RANGE_FULL. SC_420V and SC_420F only accept AUTO or their own range. */
+    int num_threads;                                             /* The number of threads that we use to scale and convert the captured frames; 1 (default) processes them on the capture thread, 0 uses one thread per CPU core. */
+    int drop_static_frames;                                      /* 1 drops the frames that are the same as the last frame that we passed into the callback, 0 (default) passes every frame. See StaticFrameFilter in Dirty.h. */
+    int keepalive_ms;                                            /* When we drop static frames we still pass one frame every `keepalive_ms` milliseconds, 1000 by default; 0 drops every static frame. */
+    int pyramid_levels;                                          /* The number of smaller frames (0 - SC_PYRAMID_MAX_LEVELS) that we pass into the callback after every frame, each half the size of the previous one; 0 by default. See Pyramid.h. */
+    int frame_stats;                                             /* 1 computes the luma histogram, tile statistics and blank detection of every frame into `FrameInfo::stats`, 0 (default) doesn't. See Analytics.h. */
   };
 
   /* ----------------------------------------------------------- */
   
   struct Display {
+    Display();
     std::string name;                                            /* Human readable name of the display. Set by the driver. */
     void* info;                                                  /* Opaque platform, iplementation specifc info. */
+    int rotation;                                                /* The SC_ROTATE_* value that turns the frames of the driver upright, e.g. for a portrait mounted monitor. Set by the driver; SC_ROTATE_0 by default. */
   };
 
 } /* namespace sc */
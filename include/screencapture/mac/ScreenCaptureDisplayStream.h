@@ -34,6 +34,7 @@
 #include <CoreGraphics/CGDisplayStream.h>
 #include <screencapture/Types.h>
 #include <screencapture/Base.h>
+#include <screencapture/FrameInfo.h>
 
 namespace sc {
 
@@ -62,11 +63,18 @@ namespace sc {
     /* Features */
     int getDisplays(std::vector<Display*>& result);
     int getPixelFormats(std::vector<int>& formats);
+    int canUseColorMatrix(int matrix);
+
+    /* Frames */
+    void updateMetadata(uint64_t time, CGDisplayStreamUpdateRef ref, int w, int h);  /* Fills `metadata` with the times and dirty rects of an update of the stream, scaled into `w` x `h` frames. */
     
   public:
     dispatch_queue_t dq;
     CGDisplayStreamRef stream_ref;
     std::vector<Display*> displays;
+    FrameInfo metadata;                                          /* The dirty rects and times of the frame that we pass into the callback; the pixel buffer points to it. */
+    int display_width;                                           /* The size of the captured display in points, the unit of the dirty rects of the stream. */
+    int display_height;                                          /* See `display_width`. */
   };
   
 }; /* namespace sc */
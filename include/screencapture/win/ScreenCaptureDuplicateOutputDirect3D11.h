@@ -36,6 +36,8 @@
 #include <D3D11.h>   /* For the D3D11* interfaces. */
 #include <screencapture/Types.h>
 #include <screencapture/Base.h>
+#include <screencapture/Cursor.h>
+#include <screencapture/FrameInfo.h>
 #include <screencapture/win/ScreenCaptureRendererDirect3D11.h>
 
 namespace sc {
@@ -60,6 +62,7 @@ namespace sc {
 
   private:
     int updateMouse(DXGI_OUTDUPL_FRAME_INFO* info);            /* Checks the current mouse info. */ 
+    void updateMetadata(ID3D11Texture2D* tex, DirtyRect& prev_pointer);  /* Fills `metadata` with the rects, pointer and present time of `frame_info`, scaled from the desktop image `tex` into the pixel buffer. `prev_pointer` is the area of the pointer before `updateMouse()`. */
 
   public:
     IDXGIFactory1* factory;                                    /* Used to create DXGI objects and e.g. enumerating adapters.*/
@@ -76,8 +79,17 @@ namespace sc {
     std::vector<IDXGIAdapter1*> adapters;                      /* An adapter represents a video card. We use it to retrieve the attached outputs (displays). */
     std::vector<IDXGIOutput*> outputs;                         /* The outputs we retrieved in init(). An IDXGIOutput represents an display/monitor. */
     std::vector<sc::Display*> displays;                        /* We collect the displays in init(). */
-    std::vector<uint8_t> pointer_in_pixels;
-    std::vector<uint8_t> pointer_out_pixels;
+    std::vector<uint8_t> pointer_in_pixels;                    /* The raw pointer shape that we get from GetFramePointerShape(). */
+    CursorCache pointer_cache;                                 /* The decoded pointer shapes; a shape that we saw before is not decoded or uploaded again. */
+    FrameInfo metadata;                                        /* The dirty and move rects, pointer and times of the frame; `pixel_buffer.info` points to it. */
+    std::vector<uint8_t> metadata_buffer;                      /* The move rects followed by the dirty rects that we get from GetFrameMoveRects() and GetFrameDirtyRects(). */
+    int pointer_x;                                             /* The last known position of the top left of the pointer shape, in desktop pixels. */
+    int pointer_y;                                             /* See `pointer_x`. */
+    int pointer_width;                                         /* The size of the last pointer shape; 0 until we received one. */
+    int pointer_height;                                        /* See `pointer_width`. */
+    int pointer_hotspot_x;                                     /* The hotspot of the last pointer shape, relative to `pointer_x`, `pointer_y`. */
+    int pointer_hotspot_y;                                     /* See `pointer_hotspot_x`. */
+    int pointer_visible;                                       /* 1 when the pointer was visible at the last mouse update. */
   }; 
 
   
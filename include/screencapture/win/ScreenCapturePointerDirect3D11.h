@@ -28,6 +28,11 @@
   captured framebuffers; Windows doesn't seem to have this feature so we
   need to draw it manually which is done with this class.
 
+  We keep a texture for each of the last SC_CURSOR_CACHE_SIZE pointer
+  shapes, keyed by the id of the shape in the `CursorCache` of the
+  driver. When a shape reappears, `selectPointer()` makes its texture
+  current again without uploading anything.
+
   Some remarks on D3D11 and Matrices. 
   -----------------------------------
 
@@ -51,6 +56,7 @@
 #include <D3DCompiler.h>
 #include <DirectXMath.h>
 #include <DirectXPackedVector.h>
+#include <screencapture/Cursor.h>
 
 using namespace DirectX;
 
@@ -67,6 +73,8 @@ namespace sc {
   public:
     int width;
     int height;
+    int shape_id;                                                    /* The `CursorCacheEntry::id` of the pixels in the texture, -1 when unknown. */
+    uint64_t last_used;                                              /* The value of `ScreenCapturePointerDirect3D11::clock` when we used this texture the last time. */
     ID3D11Device* device;
     ID3D11DeviceContext* context;
     ID3D11Texture2D* texture;
@@ -84,7 +92,8 @@ namespace sc {
     void draw();
     void setViewport(D3D11_VIEWPORT vp);                             /* Must be called whenever the viewport changes so we can update the orthographic matrix. */
     void setScale(float sx, float sy); /* The viewport scale; needs to be used to scale the pointer.*/
-    int updatePointerPixels(int w, int h, uint8_t* pixels);          /* Change the texture data of the pointer we need to draw. */
+    int updatePointerPixels(int w, int h, uint8_t* pixels, int id = -1);  /* Change the texture data of the pointer we need to draw. `id` is the id of the shape (see `CursorCacheEntry::id`) so we can select it again with `selectPointer()`. */
+    int selectPointer(int id);                                       /* Draw the texture of the shape with the given id; returns 0 when we have a texture for it, otherwise < 0 and the pixels need to be updated. */
     void updatePointerPosition(float x, float y);
     
   private:
@@ -108,7 +117,8 @@ namespace sc {
     float vp_height;
     float vp_width;
     ScreenCapturePointerTextureDirect3D11* curr_pointer;
-    std::vector<ScreenCapturePointerTextureDirect3D11*> pointers;   /* The pointers; we create a different texture whenever the width/height of a pointer changes.*/
+    std::vector<ScreenCapturePointerTextureDirect3D11*> pointers;   /* The textures of the last SC_CURSOR_CACHE_SIZE shapes. */
+    uint64_t clock;                                                  /* Incremented whenever we select or update a pointer, used to find the least recently used texture. */
   };
 
   inline void ScreenCapturePointerDirect3D11::setScale(float xscale, float yscale) {
@@ -76,7 +76,8 @@ namespace sc {
     int shutdown();                                                      /* Cleans up; sets the device and context members to NULL. */
     int scale(ID3D11Texture2D* tex);                                     /* Scale the given texture to the output_width and output_height of the settings passed into init(). */
     int isInit();                                                        /* Returns 0 when we're initialized. */
-    int updatePointerPixels(int w, int h, uint8_t* pixels);              /* Update the pixels of the pointer; pixels is in the BGRA format.*/
+    int updatePointerPixels(int w, int h, uint8_t* pixels, int id = -1); /* Update the pixels of the pointer; pixels is in the BGRA format. `id` identifies the shape, see `selectPointer()`. */
+    int selectPointer(int id);                                           /* Draw the pointer shape that we uploaded before with the given id. Returns 0 on success, < 0 when we don't have it anymore. */
     void updatePointerPosition(float x, float y);                        /* Update the pointer position; the X and Y should be in the original coordinates as they appear on your screen; so no scaling! */
     
   private:
@@ -108,8 +109,12 @@ namespace sc {
     return is_init;
   }
 
-  inline int ScreenCaptureRendererDirect3D11::updatePointerPixels(int w, int h, uint8_t* pixels) {
-    return pointer.updatePointerPixels(w, h, pixels);
+  inline int ScreenCaptureRendererDirect3D11::updatePointerPixels(int w, int h, uint8_t* pixels, int id) {
+    return pointer.updatePointerPixels(w, h, pixels, id);
+  }
+
+  inline int ScreenCaptureRendererDirect3D11::selectPointer(int id) {
+    return pointer.selectPointer(id);
   }
 
   inline void ScreenCaptureRendererDirect3D11::updatePointerPosition(float x, float y) {
@@ -0,0 +1,261 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <screencapture/Analytics.h>
+#include <screencapture/Convert.h>
+#include <screencapture/Executor.h>
+
+namespace sc {
+
+  /* ----------------------------------------------------------- */
+
+  static int get_edge(int tile, int size, int count);
+  static void analyze_task(void* user, int thread, int first, int count);
+
+  /* ----------------------------------------------------------- */
+
+  struct AnalyzeJob {
+    FrameAnalyzer* analyzer;
+    PixelBuffer* frame;
+  };
+
+  /* ----------------------------------------------------------- */
+
+  FrameStats::FrameStats()
+    :mean(0.0f)
+    ,variance(0.0f)
+    ,black_level(0)
+    ,peak_luma(0)
+    ,peak_fraction(0.0f)
+    ,is_uniform(0)
+    ,is_blank(0)
+  {
+    memset(histogram, 0, sizeof(histogram));
+    memset(tile_mean, 0, sizeof(tile_mean));
+    memset(tile_variance, 0, sizeof(tile_variance));
+  }
+
+  /* ----------------------------------------------------------- */
+
+  FrameAnalyzer::FrameAnalyzer()
+    :has_stats(false)
+    ,width(0)
+    ,height(0)
+    ,pixel_format(SC_NONE)
+    ,coefficients(yuv_bt601_video)
+  {
+    memset(tile_x, 0, sizeof(tile_x));
+  }
+
+  FrameAnalyzer::~FrameAnalyzer() {
+
+    for (size_t i = 0; i < scratch.size(); ++i) {
+      delete scratch[i];
+    }
+
+    scratch.clear();
+  }
+
+  int FrameAnalyzer::analyze(PixelBuffer& frame, int flags, Executor* executor) {
+
+    int num_threads = (NULL == executor) ? 1 : executor->getNumThreads();
+
+    if (NULL == frame.plane[0] || 0 == frame.stride[0]) {
+      printf("Error: cannot analyze the frame, it has no pixels.\n");
+      return -1;
+    }
+
+    if (0 != begin((int)frame.width, (int)frame.height, frame.pixel_format, flags, num_threads)) {
+      return -2;
+    }
+
+    AnalyzeJob job;
+    job.analyzer = this;
+    job.frame = &frame;
+
+    if (1 == num_threads) {
+      analyze_task(&job, 0, 0, height);
+    }
+    else if (0 != executor->run(analyze_task, &job, height, screencapture_get_rows_per_slice(frame.stride[0], 2))) {
+      printf("Error: cannot analyze the frame, failed to run the slices.\n");
+      return -3;
+    }
+
+    finish();
+
+    return 0;
+  }
+
+  int FrameAnalyzer::begin(int w, int h, int fmt, int flags, int nthreads) {
+
+    has_stats = false;
+
+    if (0 != canAnalyze(fmt)) {
+      printf("Error: cannot analyze frames in %s.\n", screencapture_pixelformat_to_string(fmt).c_str());
+      return -1;
+    }
+
+    if (0 >= w || 0 >= h || 0 >= nthreads) {
+      printf("Error: cannot analyze a %d x %d frame on %d thread(s).\n", w, h, nthreads);
+      return -2;
+    }
+
+    width = w;
+    height = h;
+    pixel_format = fmt;
+    coefficients = screencapture_get_yuv_coefficients(fmt, flags);
+
+    if (SC_RGBA == fmt) {
+      std::swap(coefficients.yr, coefficients.yb);
+    }
+
+    for (int i = 0; i <= SC_STATS_TILE_COLS; ++i) {
+      tile_x[i] = get_edge(i, w, SC_STATS_TILE_COLS);
+    }
+
+    while ((int)scratch.size() < nthreads) {
+      scratch.push_back(new AnalyzerScratch());
+    }
+
+    for (int i = 0; i < nthreads; ++i) {
+      AnalyzerScratch* s = scratch[i];
+      memset(s->histogram, 0, sizeof(s->histogram));
+      memset(s->tile_sums, 0, sizeof(s->tile_sums));
+      if (SC_BGRA == fmt || SC_RGBA == fmt) {
+        s->luma.resize(w);
+      }
+    }
+
+    stats.black_level = coefficients.y_offset;
+
+    return 0;
+  }
+
+  void FrameAnalyzer::addRows(PixelBuffer& rows, int row, int thread) {
+
+    if (SC_BGRA != pixel_format && SC_RGBA != pixel_format) {
+      addLumaRows(rows.plane[0], rows.stride[0], row, (int)rows.height, thread);
+      return;
+    }
+
+    uint8_t* luma = &scratch[thread]->luma.front();
+
+    for (size_t j = 0; j < rows.height; ++j) {
+      kernel_bgra_to_luma_row(rows.plane[0] + j * rows.stride[0], luma, width, coefficients);
+      addLumaRows(luma, 0, row + (int)j, 1, thread);
+    }
+  }
+
+  void FrameAnalyzer::addLumaRows(const uint8_t* luma, size_t stride, int row, int nrows, int thread) {
+
+    AnalyzerScratch* s = scratch[thread];
+
+    for (int j = 0; j < nrows; ++j) {
+
+      const uint8_t* src = luma + j * stride;
+      int ty = (int)(((int64_t)(row + j) * SC_STATS_TILE_ROWS) / height);
+      uint64_t (*sums)[2] = s->tile_sums + ty * SC_STATS_TILE_COLS;
+
+      for (int tx = 0; tx < SC_STATS_TILE_COLS; ++tx) {
+        if (tile_x[tx] < tile_x[tx + 1]) {
+          kernel_luma_stats_row(src + tile_x[tx], tile_x[tx + 1] - tile_x[tx], s->histogram, sums[tx]);
+        }
+      }
+    }
+  }
+
+  void FrameAnalyzer::finish() {
+
+    uint64_t sums[2] = { 0 };
+    uint64_t num_pixels = (uint64_t)width * height;
+
+    memset(stats.histogram, 0, sizeof(stats.histogram));
+
+    for (int ty = 0; ty < SC_STATS_TILE_ROWS; ++ty) {
+      for (int tx = 0; tx < SC_STATS_TILE_COLS; ++tx) {
+
+        uint64_t tile[2] = { 0 };
+        uint64_t n = (uint64_t)(tile_x[tx + 1] - tile_x[tx]) * (get_edge(ty + 1, height, SC_STATS_TILE_ROWS) - get_edge(ty, height, SC_STATS_TILE_ROWS));
+
+        for (size_t i = 0; i < scratch.size(); ++i) {
+          tile[0] += scratch[i]->tile_sums[ty * SC_STATS_TILE_COLS + tx][0];
+          tile[1] += scratch[i]->tile_sums[ty * SC_STATS_TILE_COLS + tx][1];
+        }
+
+        sums[0] += tile[0];
+        sums[1] += tile[1];
+
+        double mean = (0 == n) ? 0.0 : (double)tile[0] / n;
+        stats.tile_mean[ty][tx] = (float)mean;
+        stats.tile_variance[ty][tx] = (0 == n) ? 0.0f : (float)std::max(0.0, (double)tile[1] / n - mean * mean);
+      }
+    }
+
+    for (size_t i = 0; i < scratch.size(); ++i) {
+      for (int v = 0; v < 256 * 4; ++v) {
+        stats.histogram[v >> 2] += scratch[i]->histogram[v];
+      }
+    }
+
+    double mean = (double)sums[0] / num_pixels;
+    stats.mean = (float)mean;
+    stats.variance = (float)std::max(0.0, (double)sums[1] / num_pixels - mean * mean);
+
+    stats.peak_luma = 0;
+    for (int v = 1; v < 256; ++v) {
+      if (stats.histogram[v] > stats.histogram[stats.peak_luma]) {
+        stats.peak_luma = v;
+      }
+    }
+
+    uint64_t near_peak = 0;
+    for (int v = std::max(0, stats.peak_luma - SC_STATS_PEAK_RANGE); v <= std::min(255, stats.peak_luma + SC_STATS_PEAK_RANGE); ++v) {
+      near_peak += stats.histogram[v];
+    }
+
+    stats.peak_fraction = (float)((double)near_peak / num_pixels);
+    stats.is_uniform = (stats.peak_fraction >= SC_STATS_UNIFORM_FRACTION) ? 1 : 0;
+    stats.is_blank = (1 == stats.is_uniform && stats.peak_luma <= stats.black_level + SC_STATS_BLANK_LUMA) ? 1 : 0;
+
+    has_stats = true;
+  }
+
+  void FrameAnalyzer::reset() {
+    has_stats = false;
+  }
+
+  int FrameAnalyzer::canAnalyze(int fmt) {
+
+    switch (fmt) {
+      case SC_BGRA:
+      case SC_RGBA:
+      case SC_420V:
+      case SC_420F:
+      case SC_I420: {
+        return 0;
+      }
+    }
+
+    return -1;
+  }
+
+  /* ----------------------------------------------------------- */
+
+  /* Analyzes the rows [first, first + count) of the job; `first` is even. */
+  static void analyze_task(void* user, int thread, int first, int count) {
+
+    AnalyzeJob* job = static_cast<AnalyzeJob*>(user);
+    PixelBuffer rows = *job->frame;
+
+    rows.plane[0] = job->frame->plane[0] + first * job->frame->stride[0];
+    rows.height = count;
+
+    job->analyzer->addRows(rows, first, thread);
+  }
+
+  /* The first pixel of `tile` when we split `size` pixels into `count` tiles; pixel x is in tile x * count / size. */
+  static int get_edge(int tile, int size, int count) {
+    return (int)(((int64_t)tile * size + count - 1) / count);
+  }
+
+} /* namespace sc */
@@ -0,0 +1,452 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <screencapture/Compositor.h>
+#include <screencapture/Convert.h>
+#include <screencapture/Kernels.h>
+#include <screencapture/Scaler.h>
+
+namespace sc {
+
+  /* ----------------------------------------------------------- */
+
+  static bool is_420(int fmt);
+
+  /* ----------------------------------------------------------- */
+
+  CompositorSettings::CompositorSettings()
+    :width(0)
+    ,height(0)
+    ,pixel_format(SC_NONE)
+    ,cols(0)
+    ,rows(0)
+    ,scale_quality(SC_SCALE_BILINEAR)
+    ,num_threads(1)
+    ,convert_flags(0)
+    ,keep_aspect(1)
+  {
+  }
+
+  /* ----------------------------------------------------------- */
+
+  CompositorCell::CompositorCell()
+    :x(0)
+    ,y(0)
+    ,width(0)
+    ,height(0)
+    ,frame_x(0)
+    ,frame_y(0)
+    ,frame_width(0)
+    ,frame_height(0)
+    ,source_width(0)
+    ,source_height(0)
+    ,has_new_frame(false)
+    ,is_dirty_whole(false)
+    ,num_frames(0)
+  {
+  }
+
+  /* ----------------------------------------------------------- */
+
+  Compositor::Compositor(screencapture_callback callback, void* user)
+    :callback(callback)
+    ,user(user)
+  {
+    memset(black, 0, sizeof(black));
+
+#if defined(_WIN32)
+    InitializeCriticalSection(&mutex);
+#else
+    pthread_mutex_init(&mutex, NULL);
+#endif
+  }
+
+  Compositor::~Compositor() {
+
+    shutdown();
+
+#if defined(_WIN32)
+    DeleteCriticalSection(&mutex);
+#else
+    pthread_mutex_destroy(&mutex);
+#endif
+  }
+
+  int Compositor::init(CompositorSettings cfg) {
+
+    if (NULL == callback) {
+      printf("Error: cannot initialize the compositor, the callback is NULL.\n");
+      return -1;
+    }
+
+    if (SC_BGRA != cfg.pixel_format
+        && SC_RGBA != cfg.pixel_format
+        && SC_420V != cfg.pixel_format
+        && SC_420F != cfg.pixel_format
+        && SC_I420 != cfg.pixel_format)
+      {
+        printf("Error: cannot initialize the compositor, unsupported pixel format: %s.\n", screencapture_pixelformat_to_string(cfg.pixel_format).c_str());
+        return -2;
+      }
+
+    if (0 >= cfg.cols || 0 >= cfg.rows || SC_COMPOSITOR_MAX_CELLS < cfg.cols * cfg.rows) {
+      printf("Error: cannot initialize the compositor, invalid grid: %d x %d (at most %d cells).\n", cfg.cols, cfg.rows, SC_COMPOSITOR_MAX_CELLS);
+      return -3;
+    }
+
+    /* Every cell must be at least 2 x 2 pixels so the 4:2:0 cells can start at even positions. */
+    if (cfg.width < cfg.cols * 2 || cfg.height < cfg.rows * 2) {
+      printf("Error: cannot initialize the compositor, the canvas of %d x %d is too small for %d x %d cells.\n", cfg.width, cfg.height, cfg.cols, cfg.rows);
+      return -4;
+    }
+
+    if (0 > cfg.num_threads) {
+      printf("Error: cannot initialize the compositor, invalid number of threads: %d.\n", cfg.num_threads);
+      return -5;
+    }
+
+    if (0 != shutdown()) {
+      return -6;
+    }
+
+    lock();
+
+    int r = 0;
+    bool even = is_420(cfg.pixel_format);
+
+    settings = cfg;
+
+    if (0 != canvas.init(cfg.width, cfg.height, cfg.pixel_format)) {
+      printf("Error: failed to initialize the canvas of the compositor.\n");
+      r = -7;
+    }
+
+    if (0 == r) {
+      canvas_pixels.resize(canvas.getNumBytes());
+      canvas.setPlanes(&canvas_pixels.front());
+      canvas.user = user;
+      canvas.info = &canvas_info;
+      r = (0 == screencapture_get_black(cfg.pixel_format, cfg.convert_flags, black)) ? 0 : -8;
+    }
+
+    /* The cells tile the canvas; for 4:2:0 their edges are even. */
+    for (int i = 0; 0 == r && i < cfg.cols * cfg.rows; ++i) {
+
+      int col = i % cfg.cols;
+      int row = i / cfg.cols;
+      int x0 = (col * cfg.width) / cfg.cols;
+      int y0 = (row * cfg.height) / cfg.rows;
+      int x1 = ((col + 1) * cfg.width) / cfg.cols;
+      int y1 = ((row + 1) * cfg.height) / cfg.rows;
+
+      if (true == even) {
+        x0 &= ~1;
+        y0 &= ~1;
+        x1 = (cfg.cols - 1 == col) ? cfg.width : (x1 & ~1);
+        y1 = (cfg.rows - 1 == row) ? cfg.height : (y1 & ~1);
+      }
+
+      CompositorCell* c = new CompositorCell();
+      c->x = x0;
+      c->y = y0;
+      c->width = x1 - x0;
+      c->height = y1 - y0;
+      cells.push_back(c);
+
+      r = fillCell(*c);
+    }
+
+    if (0 == r && 1 != cfg.num_threads && 0 != executor.init(cfg.num_threads)) {
+      printf("Error: failed to create the threads of the compositor.\n");
+      r = -9;
+    }
+
+    unlock();
+
+    if (0 != r) {
+      shutdown();
+    }
+
+    return r;
+  }
+
+  int Compositor::shutdown() {
+
+    lock();
+
+    for (size_t i = 0; i < cells.size(); ++i) {
+      delete cells[i];
+    }
+
+    cells.clear();
+
+    if (0 == executor.isInit()) {
+      executor.shutdown();
+    }
+
+    unlock();
+
+    return 0;
+  }
+
+  int Compositor::setFrame(int cell, PixelBuffer& frame) {
+
+    if (0 != isInit()) {
+      printf("Error: cannot set the frame of cell %d, the compositor is not initialized.\n", cell);
+      return -1;
+    }
+
+    if (0 > cell || (int)cells.size() <= cell) {
+      printf("Error: cannot set the frame of cell %d, we have %lu cells.\n", cell, cells.size());
+      return -2;
+    }
+
+    if (frame.pixel_format != settings.pixel_format) {
+      printf("Error: cannot set the frame of cell %d, it's %s but the canvas is %s.\n", cell,
+             screencapture_pixelformat_to_string(frame.pixel_format).c_str(),
+             screencapture_pixelformat_to_string(settings.pixel_format).c_str());
+      return -3;
+    }
+
+    if (0 == frame.width || 0 == frame.height || NULL == frame.plane[0]) {
+      printf("Error: cannot set the frame of cell %d, the frame has no pixels.\n", cell);
+      return -4;
+    }
+
+    lock();
+
+    int r = 0;
+    CompositorCell& c = *cells[cell];
+    PixelBuffer view;
+
+    if ((int)frame.width != c.source_width || (int)frame.height != c.source_height) {
+      r = layoutFrame(c, (int)frame.width, (int)frame.height);
+    }
+
+    if (0 == r && 0 != canvas.getView(c.frame_x, c.frame_y, c.frame_width, c.frame_height, view)) {
+      r = -5;
+    }
+
+    if (0 == r) {
+
+      if ((int)frame.width == c.frame_width && (int)frame.height == c.frame_height) {
+
+        int layout[3] = { 0 };
+        int num_planes = screencapture_get_plane_layout(frame.pixel_format, layout);
+
+        for (int i = 0; i < num_planes; ++i) {
+          int sub = (0 == i) ? 1 : 2;
+          size_t nbytes = ((frame.width + sub - 1) / sub) * layout[i];
+          size_t nrows = (frame.height + sub - 1) / sub;
+          for (size_t j = 0; j < nrows; ++j) {
+            memcpy(view.plane[i] + j * view.stride[i], frame.plane[i] + j * frame.stride[i], nbytes);
+          }
+        }
+      }
+      else if (0 != c.scaler.scale(frame, view, getExecutor())) {
+        printf("Error: failed to scale the frame of cell %d.\n", cell);
+        r = -6;
+      }
+    }
+
+    if (0 == r) {
+      addDirtyRects(c, frame);
+      c.has_new_frame = true;
+      c.num_frames++;
+    }
+
+    unlock();
+
+    return r;
+  }
+
+  int Compositor::update() {
+
+    if (0 != isInit()) {
+      printf("Error: cannot update the compositor, it's not initialized.\n");
+      return -1;
+    }
+
+    lock();
+
+    bool has_new_frame = false;
+
+    canvas_info.reset();
+    canvas_info.flags = SC_FRAME_HAS_DIRTY_RECTS;
+    canvas_info.capture_time = screencapture_get_time_ns();
+
+    for (size_t i = 0; i < cells.size(); ++i) {
+
+      CompositorCell& c = *cells[i];
+
+      if (false == c.has_new_frame) {
+        continue;
+      }
+
+      if (true == c.is_dirty_whole) {
+        DirtyRect r = { c.x, c.y, c.width, c.height };
+        canvas_info.dirty_rects.push_back(r);
+      }
+      else {
+        canvas_info.dirty_rects.insert(canvas_info.dirty_rects.end(), c.dirty_rects.begin(), c.dirty_rects.end());
+      }
+
+      c.dirty_rects.clear();
+      c.is_dirty_whole = false;
+      c.has_new_frame = false;
+      has_new_frame = true;
+    }
+
+    if (true == has_new_frame) {
+      PixelBuffer result = canvas;
+      callback(result);
+    }
+
+    unlock();
+
+    return (true == has_new_frame) ? 0 : 1;
+  }
+
+  int Compositor::getCellSize(int cell, int& w, int& h) {
+
+    if (0 > cell || (int)cells.size() <= cell) {
+      printf("Error: cannot get the size of cell %d, we have %lu cells.\n", cell, cells.size());
+      return -1;
+    }
+
+    w = cells[cell]->width;
+    h = cells[cell]->height;
+
+    return 0;
+  }
+
+  void Compositor::lock() {
+#if defined(_WIN32)
+    EnterCriticalSection(&mutex);
+#else
+    pthread_mutex_lock(&mutex);
+#endif
+  }
+
+  void Compositor::unlock() {
+#if defined(_WIN32)
+    LeaveCriticalSection(&mutex);
+#else
+    pthread_mutex_unlock(&mutex);
+#endif
+  }
+
+  int Compositor::fillCell(CompositorCell& c) {
+
+    int layout[3] = { 0 };
+    int num_planes = screencapture_get_plane_layout(settings.pixel_format, layout);
+
+    for (int i = 0; i < num_planes; ++i) {
+      int sub = (0 == i) ? 1 : 2;
+      int px = c.x / sub;
+      int nsamples = (c.x + c.width + sub - 1) / sub - px;
+      for (int j = c.y / sub; j < (c.y + c.height + sub - 1) / sub; ++j) {
+        kernel_fill_row(canvas.plane[i] + j * canvas.stride[i] + px * layout[i], nsamples, layout[i], black[i]);
+      }
+    }
+
+    return 0;
+  }
+
+  /* Fits the frame into the cell, centered; for 4:2:0 the rect is even (except at the edges of the canvas). */
+  int Compositor::layoutFrame(CompositorCell& c, int srcw, int srch) {
+
+    int fx = 0;
+    int fy = 0;
+    int fw = c.width;
+    int fh = c.height;
+
+    if (1 == settings.keep_aspect
+        && 0 != screencapture_get_fit_rect(srcw, srch, c.width, c.height, (true == is_420(settings.pixel_format)) ? 1 : 0, fx, fy, fw, fh))
+      {
+        return -1;
+      }
+
+    fx += c.x;
+    fy += c.y;
+
+    /* The old frame may cover parts of the cell that the new one doesn't. */
+    if (fx != c.frame_x || fy != c.frame_y || fw != c.frame_width || fh != c.frame_height) {
+      fillCell(c);
+      c.is_dirty_whole = true;
+      c.has_new_frame = true;
+    }
+
+    c.frame_x = fx;
+    c.frame_y = fy;
+    c.frame_width = fw;
+    c.frame_height = fh;
+    c.source_width = srcw;
+    c.source_height = srch;
+
+    if ((srcw != fw || srch != fh)
+        && 0 != c.scaler.isInitFor(srcw, srch, fw, fh, settings.pixel_format, settings.scale_quality)
+        && 0 != c.scaler.init(srcw, srch, fw, fh, settings.pixel_format, settings.scale_quality))
+      {
+        printf("Error: failed to initialize the scaler of a cell for %d x %d into %d x %d.\n", srcw, srch, fw, fh);
+        c.source_width = 0;
+        c.source_height = 0;
+        return -1;
+      }
+
+    return 0;
+  }
+
+  void Compositor::addDirtyRects(CompositorCell& c, PixelBuffer& frame) {
+
+    if (true == c.is_dirty_whole) {
+      return;
+    }
+
+    if (NULL == frame.info || 0 == (frame.info->flags & SC_FRAME_HAS_DIRTY_RECTS)) {
+      c.is_dirty_whole = true;
+      return;
+    }
+
+    /* Lanczos3 reads 3 output pixels to each side, see `ScreenCapture::transformInfo()`. */
+    int w = (int)frame.width;
+    int h = (int)frame.height;
+    int ratio_x = (w + c.frame_width - 1) / c.frame_width;
+    int ratio_y = (h + c.frame_height - 1) / c.frame_height;
+
+    c.info = *frame.info;
+    c.info.scale(w, h, c.frame_width, c.frame_height, 3 * std::max(1, std::max(ratio_x, ratio_y)));
+
+    if (true == is_420(settings.pixel_format)) {
+      c.info.alignEven(c.frame_width, c.frame_height);
+    }
+
+    /* Moves are only kept when we don't scale; the canvas reports them as dirty. */
+    for (size_t i = 0; i < c.info.move_rects.size(); ++i) {
+      const MoveRect& m = c.info.move_rects[i];
+      DirtyRect r = { m.x, m.y, m.width, m.height };
+      c.info.dirty_rects.push_back(r);
+    }
+
+    if (SC_COMPOSITOR_MAX_DIRTY_RECTS < c.dirty_rects.size() + c.info.dirty_rects.size()) {
+      c.dirty_rects.clear();
+      c.is_dirty_whole = true;
+      return;
+    }
+
+    for (size_t i = 0; i < c.info.dirty_rects.size(); ++i) {
+      DirtyRect r = c.info.dirty_rects[i];
+      r.x += c.frame_x;
+      r.y += c.frame_y;
+      c.dirty_rects.push_back(r);
+    }
+  }
+
+  /* ----------------------------------------------------------- */
+
+  static bool is_420(int fmt) {
+    int layout[3] = { 0 };
+    return 1 < screencapture_get_plane_layout(fmt, layout);
+  }
+
+} /* namespace sc */
@@ -0,0 +1,721 @@
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include <screencapture/Convert.h>
+#include <screencapture/Kernels.h>
+#include <screencapture/Scaler.h>
+#include <screencapture/Executor.h>
+#include <screencapture/Analytics.h>
+
+namespace sc {
+
+  /* ----------------------------------------------------------- */
+
+  static int get_num_planes(int fmt);
+  static void get_slice(PixelBuffer& buf, int first, int count, PixelBuffer& slice);
+  static int convert_frame(PixelBuffer& src, PixelBuffer& dst, int flags);
+  static void convert_task(void* user, int thread, int first, int count);
+  static void scale_convert_task(void* user, int thread, int first, int count);
+  static int convert_bgra_to_yuv(PixelBuffer& src, PixelBuffer& dst, int flags);
+  static void convert_bgra_rows_to_yuv(const uint8_t* src0, const uint8_t* src1, PixelBuffer& dst, int row, const YuvCoefficients& c);
+  static int convert_i420_to_bgra(PixelBuffer& src, PixelBuffer& dst, int flags);
+  static int convert_nv12_to_rgb(PixelBuffer& src, PixelBuffer& dst, int flags);
+  static int convert_nv12_to_i420(PixelBuffer& src, PixelBuffer& dst);
+  static int convert_i420_to_nv12(PixelBuffer& src, PixelBuffer& dst);
+  static int convert_bgra_to_packed(PixelBuffer& src, PixelBuffer& dst);
+  static int convert_l10r_to_p010(PixelBuffer& src, PixelBuffer& dst, int flags);
+  static int convert_l10r_to_rgb48(PixelBuffer& src, PixelBuffer& dst);
+  static int convert_l10r_to_bgra(PixelBuffer& src, PixelBuffer& dst, int flags);
+  static void copy_plane(const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride, size_t nbytes, size_t nrows);
+
+  /* ----------------------------------------------------------- */
+
+  struct ConvertJob {
+    PixelBuffer* src;
+    PixelBuffer* dst;
+    int flags;
+    FrameAnalyzer* analyzer;                                     /* Analyzes every converted slice of `dst`; NULL when not used. */
+  };
+
+  struct ScaleConvertJob {
+    Scaler* scaler;
+    PixelBuffer* src;
+    PixelBuffer* dst;
+    const YuvCoefficients* coefficients;
+    FrameAnalyzer* analyzer;                                     /* Analyzes the Y rows that we convert; NULL when not used. */
+  };
+
+  /* ----------------------------------------------------------- */
+
+  /* The supported conversions: { from, to }. */
+  static const int conversions[][2] = {
+    { SC_BGRA, SC_I420 },
+    { SC_BGRA, SC_420V },
+    { SC_BGRA, SC_420F },
+    { SC_BGRA, SC_RGBA },
+    { SC_BGRA, SC_RGB24 },
+    { SC_BGRA, SC_BGR24 },
+    { SC_I420, SC_BGRA },
+    { SC_I420, SC_420V },
+    { SC_I420, SC_420F },
+    { SC_420V, SC_I420 },
+    { SC_420V, SC_BGRA },
+    { SC_420V, SC_RGBA },
+    { SC_420F, SC_I420 },
+    { SC_420F, SC_BGRA },
+    { SC_420F, SC_RGBA },
+    { SC_L10R, SC_P010 },
+    { SC_L10R, SC_RGB48 },
+    { SC_L10R, SC_BGRA },
+  };
+
+  /* 2x2 ordered dither (Bayer) values that we add before dropping 2 bits. */
+  static const int dither_2x2[2][2] = {
+    { 0, 2 },
+    { 3, 1 },
+  };
+
+  /* The pixels per chunk when we convert BGRA into NV12; the U and V rows of a chunk fit on the stack. */
+  static const int nv12_chunk = 512;
+
+  /* ----------------------------------------------------------- */
+
+  int screencapture_can_convert(int from, int to) {
+
+    for (size_t i = 0; i < sizeof(conversions) / sizeof(conversions[0]); ++i) {
+      if (from == conversions[i][0] && to == conversions[i][1]) {
+        return 0;
+      }
+    }
+
+    return -1;
+  }
+
+  int screencapture_get_conversions(int from, std::vector<int>& formats) {
+
+    formats.clear();
+
+    for (size_t i = 0; i < sizeof(conversions) / sizeof(conversions[0]); ++i) {
+      if (from == conversions[i][0]) {
+        formats.push_back(conversions[i][1]);
+      }
+    }
+
+    return 0;
+  }
+
+  int screencapture_convert(PixelBuffer& src, PixelBuffer& dst, int flags, Executor* executor, FrameAnalyzer* analyzer) {
+
+    if (0 != screencapture_can_convert(src.pixel_format, dst.pixel_format)) {
+      printf("Error: cannot convert from %s to %s.\n",
+             screencapture_pixelformat_to_string(src.pixel_format).c_str(),
+             screencapture_pixelformat_to_string(dst.pixel_format).c_str());
+      return -1;
+    }
+
+    if (0 == src.width || 0 == src.height) {
+      printf("Error: cannot convert, the source buffer has no size.\n");
+      return -2;
+    }
+
+    if (src.width != dst.width || src.height != dst.height) {
+      printf("Error: cannot convert, the source (%lu x %lu) and destination (%lu x %lu) sizes are different.\n",
+             src.width, src.height, dst.width, dst.height);
+      return -3;
+    }
+
+    for (int i = 0; i < get_num_planes(src.pixel_format); ++i) {
+      if (NULL == src.plane[i] || 0 == src.stride[i]) {
+        printf("Error: cannot convert, plane %d of the source buffer is not set.\n", i);
+        return -4;
+      }
+    }
+
+    for (int i = 0; i < get_num_planes(dst.pixel_format); ++i) {
+      if (NULL == dst.plane[i] || 0 == dst.stride[i]) {
+        printf("Error: cannot convert, plane %d of the destination buffer is not set.\n", i);
+        return -5;
+      }
+    }
+
+    if ((flags & SC_CONVERT_BT709) && (flags & SC_CONVERT_BT2020)) {
+      printf("Error: cannot convert, pass either SC_CONVERT_BT709 or SC_CONVERT_BT2020, not both.\n");
+      return -7;
+    }
+
+    int num_threads = (NULL == executor) ? 1 : executor->getNumThreads();
+
+    if (NULL != analyzer && 0 != analyzer->begin((int)dst.width, (int)dst.height, dst.pixel_format, flags, num_threads)) {
+      printf("Error: cannot convert, we cannot analyze the destination.\n");
+      return -8;
+    }
+
+    if (1 == num_threads && NULL == analyzer) {
+      return convert_frame(src, dst, flags);
+    }
+
+    ConvertJob job;
+    job.src = &src;
+    job.dst = &dst;
+    job.flags = flags;
+    job.analyzer = analyzer;
+
+    /* Slices start at an even row so the 4:2:0 chroma rows and the dither pattern line up. */
+    int slice_rows = screencapture_get_rows_per_slice(src.stride[0] + dst.stride[0], 2);
+
+    /* We analyze a slice while it's in the cache, so the analyzer makes us convert in slices on one thread too. */
+    if (1 == num_threads) {
+      for (int j = 0; j < (int)src.height; j += slice_rows) {
+        convert_task(&job, 0, j, std::min(slice_rows, (int)src.height - j));
+      }
+    }
+    else if (0 != executor->run(convert_task, &job, (int)src.height, slice_rows)) {
+      printf("Error: cannot convert, failed to run the slices.\n");
+      return -6;
+    }
+
+    if (NULL != analyzer) {
+      analyzer->finish();
+    }
+
+    return 0;
+  }
+
+  int screencapture_can_scale_convert(int from, int to) {
+
+    if (SC_BGRA == from
+        && (SC_I420 == to || SC_420V == to || SC_420F == to))
+      {
+        return 0;
+      }
+
+    return -1;
+  }
+
+  /* SC_420V and SC_420F have their range in the format; the other formats are video range unless full range is requested. */
+  int screencapture_get_color_range(int fmt, int range) {
+
+    if (SC_420F == fmt) {
+      return SC_COLOR_RANGE_FULL;
+    }
+
+    if (SC_420V == fmt || SC_COLOR_RANGE_FULL != range) {
+      return SC_COLOR_RANGE_VIDEO;
+    }
+
+    return SC_COLOR_RANGE_FULL;
+  }
+
+  int screencapture_get_convert_flags(int fmt, int matrix, int range) {
+
+    int flags = 0;
+
+    if (SC_COLOR_MATRIX_BT709 == matrix) {
+      flags |= SC_CONVERT_BT709;
+    }
+    else if (SC_COLOR_MATRIX_BT2020 == matrix) {
+      flags |= SC_CONVERT_BT2020;
+    }
+
+    if (SC_COLOR_RANGE_FULL == screencapture_get_color_range(fmt, range)) {
+      flags |= SC_CONVERT_FULL_RANGE;
+    }
+
+    return flags;
+  }
+
+  /* The range follows from SC_420V and SC_420F, or from SC_CONVERT_FULL_RANGE for the other formats; the matrix from the flags. */
+  const YuvCoefficients& screencapture_get_yuv_coefficients(int fmt, int flags) {
+
+    bool full_range = (SC_420F == fmt)
+      || (SC_420V != fmt && (flags & SC_CONVERT_FULL_RANGE));
+
+    if (flags & SC_CONVERT_BT2020) {
+      return (full_range) ? yuv_bt2020_full : yuv_bt2020_video;
+    }
+
+    if (flags & SC_CONVERT_BT709) {
+      return (full_range) ? yuv_bt709_full : yuv_bt709_video;
+    }
+
+    return (full_range) ? yuv_bt601_full : yuv_bt601_video;
+  }
+
+  /* For YCbCr we convert black with `flags`; the packed RGB formats are black with all bits zero, except for the alpha. */
+  int screencapture_get_black(int fmt, int flags, uint8_t black[3][4]) {
+
+    int layout[3] = { 0 };
+    int num_planes = screencapture_get_plane_layout(fmt, layout);
+
+    memset(black, 0, sizeof(uint8_t) * 3 * 4);
+
+    if (0 == num_planes || 4 < layout[0]) {
+      printf("Error: cannot get the black samples of %s.\n", screencapture_pixelformat_to_string(fmt).c_str());
+      return -1;
+    }
+
+    if (SC_BGRA == fmt || SC_RGBA == fmt) {
+      black[0][3] = 0xFF;
+      return 0;
+    }
+
+    if (SC_L10R == fmt) {
+      black[0][3] = 0xC0;
+      return 0;
+    }
+
+    if (1 == num_planes) {
+      return 0;
+    }
+
+    PixelBuffer src;
+    PixelBuffer dst;
+    std::vector<uint8_t> src_mem;
+    std::vector<uint8_t> dst_mem;
+
+    if (0 != src.init(2, 2, SC_BGRA) || 0 != dst.init(2, 2, fmt)) {
+      return -2;
+    }
+
+    src_mem.assign(src.getNumBytes(), 0);
+    dst_mem.resize(dst.getNumBytes());
+    src.setPlanes(&src_mem.front());
+    dst.setPlanes(&dst_mem.front());
+
+    if (0 != screencapture_convert(src, dst, flags)) {
+      printf("Error: failed to convert black into %s.\n", screencapture_pixelformat_to_string(fmt).c_str());
+      return -3;
+    }
+
+    for (int i = 0; i < num_planes; ++i) {
+      memcpy(black[i], dst.plane[i], layout[i]);
+    }
+
+    return 0;
+  }
+
+  int screencapture_scale_convert(Scaler& scaler, PixelBuffer& src, PixelBuffer& dst, int flags, Executor* executor, FrameAnalyzer* analyzer) {
+
+    if (0 != screencapture_can_scale_convert(src.pixel_format, dst.pixel_format)) {
+      printf("Error: cannot scale and convert from %s to %s.\n",
+             screencapture_pixelformat_to_string(src.pixel_format).c_str(),
+             screencapture_pixelformat_to_string(dst.pixel_format).c_str());
+      return -1;
+    }
+
+    if (0 != scaler.isInitFor(src.width, src.height, dst.width, dst.height, src.pixel_format, scaler.quality)) {
+      printf("Error: cannot scale and convert, the scaler is not initialized for %lu x %lu > %lu x %lu.\n",
+             src.width, src.height, dst.width, dst.height);
+      return -2;
+    }
+
+    if (NULL == src.plane[0] || 0 == src.stride[0]) {
+      printf("Error: cannot scale and convert, the source buffer is not set.\n");
+      return -3;
+    }
+
+    for (int i = 0; i < get_num_planes(dst.pixel_format); ++i) {
+      if (NULL == dst.plane[i] || 0 == dst.stride[i]) {
+        printf("Error: cannot scale and convert, plane %d of the destination buffer is not set.\n", i);
+        return -4;
+      }
+    }
+
+    if ((flags & SC_CONVERT_BT709) && (flags & SC_CONVERT_BT2020)) {
+      printf("Error: cannot scale and convert, pass either SC_CONVERT_BT709 or SC_CONVERT_BT2020, not both.\n");
+      return -7;
+    }
+
+    int num_threads = (NULL == executor) ? 1 : executor->getNumThreads();
+
+    if (NULL != analyzer && 0 != analyzer->begin((int)dst.width, (int)dst.height, dst.pixel_format, flags, num_threads)) {
+      printf("Error: cannot scale and convert, we cannot analyze the destination.\n");
+      return -8;
+    }
+
+    if (0 != scaler.setNumThreads(num_threads)) {
+      return -5;
+    }
+
+    /* Two scaled BGRA rows per thread; only allocates when the output width changed. */
+    for (int i = 0; i < num_threads; ++i) {
+      scaler.scratch[i].converted.resize(dst.width * 4 * 2);
+    }
+
+    ScaleConvertJob job;
+    job.scaler = &scaler;
+    job.src = &src;
+    job.dst = &dst;
+    job.coefficients = &screencapture_get_yuv_coefficients(dst.pixel_format, flags);
+    job.analyzer = analyzer;
+
+    if (1 == num_threads) {
+      scale_convert_task(&job, 0, 0, (int)dst.height);
+    }
+    else {
+
+      /* Slices are sized by the source rows that they read. */
+      size_t src_bytes = src.stride[0] * std::max<size_t>(1, src.height / dst.height);
+      int slice_rows = screencapture_get_rows_per_slice(src_bytes, 2);
+
+      if (0 != executor->run(scale_convert_task, &job, (int)dst.height, slice_rows)) {
+        printf("Error: cannot scale and convert, failed to run the slices.\n");
+        return -6;
+      }
+    }
+
+    if (NULL != analyzer) {
+      analyzer->finish();
+    }
+
+    return 0;
+  }
+
+  /* ----------------------------------------------------------- */
+
+  static int convert_frame(PixelBuffer& src, PixelBuffer& dst, int flags) {
+
+    switch (src.pixel_format) {
+      case SC_BGRA: {
+        if (SC_I420 == dst.pixel_format
+            || SC_420V == dst.pixel_format
+            || SC_420F == dst.pixel_format)
+          {
+            return convert_bgra_to_yuv(src, dst, flags);
+          }
+        return convert_bgra_to_packed(src, dst);
+      }
+      case SC_I420: {
+        if (SC_BGRA == dst.pixel_format) {
+          return convert_i420_to_bgra(src, dst, flags);
+        }
+        return convert_i420_to_nv12(src, dst);
+      }
+      case SC_420V:
+      case SC_420F: {
+        if (SC_I420 == dst.pixel_format) {
+          return convert_nv12_to_i420(src, dst);
+        }
+        return convert_nv12_to_rgb(src, dst, flags);
+      }
+      case SC_L10R: {
+        if (SC_P010 == dst.pixel_format) {
+          return convert_l10r_to_p010(src, dst, flags);
+        }
+        if (SC_RGB48 == dst.pixel_format) {
+          return convert_l10r_to_rgb48(src, dst);
+        }
+        return convert_l10r_to_bgra(src, dst, flags);
+      }
+    }
+
+    return -6;
+  }
+
+  /* Converts the rows [first, first + count) of the job; `first` is even. */
+  static void convert_task(void* user, int thread, int first, int count) {
+
+    ConvertJob* job = static_cast<ConvertJob*>(user);
+    PixelBuffer src;
+    PixelBuffer dst;
+
+    get_slice(*job->src, first, count, src);
+    get_slice(*job->dst, first, count, dst);
+    convert_frame(src, dst, job->flags);
+
+    if (NULL != job->analyzer) {
+      job->analyzer->addRows(dst, first, thread);
+    }
+  }
+
+  /*
+    We scale two rows into the scratch memory of the thread (see
+    `ScalerScratch::converted`), which is small enough to stay in the
+    cache, and convert them before we scale the next two rows; the
+    scaled BGRA frame is never written to memory. `first` is even.
+  */
+  static void scale_convert_task(void* user, int thread, int first, int count) {
+
+    ScaleConvertJob* job = static_cast<ScaleConvertJob*>(user);
+    PixelBuffer& dst = *job->dst;
+    size_t w = dst.width;
+    uint8_t* scaled = &job->scaler->scratch[thread].converted.front();
+    int end = first + count;
+
+    for (int j = first; j < end; j += 2) {
+
+      int n = std::min(2, end - j);
+
+      if (0 != job->scaler->scaleRows(*job->src, 0, j, n, scaled, w * 4, thread)) {
+        return;
+      }
+
+      convert_bgra_rows_to_yuv(scaled, (2 == n) ? scaled + w * 4 : NULL, dst, j, *job->coefficients);
+
+      if (NULL != job->analyzer) {
+        job->analyzer->addLumaRows(dst.plane[0] + j * dst.stride[0], dst.stride[0], j, n, thread);
+      }
+    }
+  }
+
+  /* ----------------------------------------------------------- */
+
+  static int convert_bgra_to_yuv(PixelBuffer& src, PixelBuffer& dst, int flags) {
+
+    const YuvCoefficients& c = screencapture_get_yuv_coefficients(dst.pixel_format, flags);
+    int h = (int)src.height;
+
+    for (int j = 0; j < h; j += 2) {
+      const uint8_t* src0 = src.plane[0] + j * src.stride[0];
+      const uint8_t* src1 = ((j + 1) < h) ? src0 + src.stride[0] : NULL;
+      convert_bgra_rows_to_yuv(src0, src1, dst, j, c);
+    }
+
+    return 0;
+  }
+
+  /*
+    Converts the BGRA rows `row` and `row + 1` into I420 or NV12; `src1`
+    is NULL when `row` is the last row. For NV12 we create the U and V
+    rows of `nv12_chunk` pixels at a time on the stack and interleave
+    them; the chunks start at an even pixel.
+  */
+  static void convert_bgra_rows_to_yuv(const uint8_t* src0, const uint8_t* src1, PixelBuffer& dst, int row, const YuvCoefficients& c) {
+
+    int w = (int)dst.width;
+    uint8_t* y0 = dst.plane[0] + row * dst.stride[0];
+    uint8_t* y1 = (NULL != src1) ? y0 + dst.stride[0] : NULL;
+
+    if (NULL == src1) {
+      src1 = src0;
+    }
+
+    if (SC_I420 == dst.pixel_format) {
+      uint8_t* u = dst.plane[1] + (row / 2) * dst.stride[1];
+      uint8_t* v = dst.plane[2] + (row / 2) * dst.stride[2];
+      kernel_bgra_to_i420_rows(src0, src1, y0, y1, u, v, w, c);
+      return;
+    }
+
+    uint8_t chroma[nv12_chunk];
+    uint8_t* uv = dst.plane[1] + (row / 2) * dst.stride[1];
+
+    for (int x = 0; x < w; x += nv12_chunk) {
+      int n = std::min(nv12_chunk, w - x);
+      int cw = (n + 1) / 2;
+      kernel_bgra_to_i420_rows(src0 + x * 4, src1 + x * 4, y0 + x, (NULL != y1) ? y1 + x : NULL, chroma, chroma + cw, n, c);
+      kernel_merge_uv_row(chroma, chroma + cw, uv + x, cw);
+    }
+  }
+
+  static int convert_i420_to_bgra(PixelBuffer& src, PixelBuffer& dst, int flags) {
+
+    const YuvCoefficients& c = screencapture_get_yuv_coefficients(src.pixel_format, flags);
+    int w = (int)src.width;
+    int h = (int)src.height;
+
+    for (int j = 0; j < h; ++j) {
+      kernel_i420_to_bgra_row(src.plane[0] + j * src.stride[0],
+                              src.plane[1] + (j / 2) * src.stride[1],
+                              src.plane[2] + (j / 2) * src.stride[2],
+                              dst.plane[0] + j * dst.stride[0],
+                              w,
+                              c);
+    }
+
+    return 0;
+  }
+
+  static int convert_nv12_to_rgb(PixelBuffer& src, PixelBuffer& dst, int flags) {
+
+    const YuvCoefficients& c = screencapture_get_yuv_coefficients(src.pixel_format, flags);
+    void(*kernel)(const uint8_t*, const uint8_t*, uint8_t*, int, const YuvCoefficients&) = NULL;
+
+    if (SC_BGRA == dst.pixel_format) {
+      kernel = kernel_nv12_to_bgra_row;
+    }
+    else if (SC_RGBA == dst.pixel_format) {
+      kernel = kernel_nv12_to_rgba_row;
+    }
+    else {
+      return -1;
+    }
+
+    for (size_t j = 0; j < src.height; ++j) {
+      kernel(src.plane[0] + j * src.stride[0],
+             src.plane[1] + (j / 2) * src.stride[1],
+             dst.plane[0] + j * dst.stride[0],
+             (int)src.width,
+             c);
+    }
+
+    return 0;
+  }
+
+  static int convert_nv12_to_i420(PixelBuffer& src, PixelBuffer& dst) {
+
+    int chroma_width = (int)(src.width + 1) / 2;
+    int chroma_height = (int)(src.height + 1) / 2;
+
+    copy_plane(src.plane[0], src.stride[0], dst.plane[0], dst.stride[0], src.width, src.height);
+
+    for (int j = 0; j < chroma_height; ++j) {
+      kernel_split_uv_row(src.plane[1] + j * src.stride[1],
+                          dst.plane[1] + j * dst.stride[1],
+                          dst.plane[2] + j * dst.stride[2],
+                          chroma_width);
+    }
+
+    return 0;
+  }
+
+  static int convert_i420_to_nv12(PixelBuffer& src, PixelBuffer& dst) {
+
+    int chroma_width = (int)(src.width + 1) / 2;
+    int chroma_height = (int)(src.height + 1) / 2;
+
+    copy_plane(src.plane[0], src.stride[0], dst.plane[0], dst.stride[0], src.width, src.height);
+
+    for (int j = 0; j < chroma_height; ++j) {
+      kernel_merge_uv_row(src.plane[1] + j * src.stride[1],
+                          src.plane[2] + j * src.stride[2],
+                          dst.plane[1] + j * dst.stride[1],
+                          chroma_width);
+    }
+
+    return 0;
+  }
+
+  /* Swizzles BGRA into RGBA or packs it into 24 bit RGB or BGR. */
+  static int convert_bgra_to_packed(PixelBuffer& src, PixelBuffer& dst) {
+
+    void(*kernel)(const uint8_t*, uint8_t*, int) = NULL;
+
+    switch (dst.pixel_format) {
+      case SC_RGBA: {
+        kernel = kernel_bgra_to_rgba_row;
+        break;
+      }
+      case SC_RGB24: {
+        kernel = kernel_bgra_to_rgb24_row;
+        break;
+      }
+      case SC_BGR24: {
+        kernel = kernel_bgra_to_bgr24_row;
+        break;
+      }
+      default: {
+        return -1;
+      }
+    }
+
+    for (size_t j = 0; j < src.height; ++j) {
+      kernel(src.plane[0] + j * src.stride[0], dst.plane[0] + j * dst.stride[0], (int)src.width);
+    }
+
+    return 0;
+  }
+
+  static int convert_l10r_to_p010(PixelBuffer& src, PixelBuffer& dst, int flags) {
+
+    const YuvCoefficients& c = screencapture_get_yuv_coefficients(dst.pixel_format, flags);
+    int w = (int)src.width;
+    int h = (int)src.height;
+
+    for (int j = 0; j < h; j += 2) {
+
+      bool has_next = (j + 1) < h;
+      const uint8_t* src0 = src.plane[0] + j * src.stride[0];
+      const uint8_t* src1 = (has_next) ? src0 + src.stride[0] : src0;
+      uint16_t* y0 = (uint16_t*)(dst.plane[0] + j * dst.stride[0]);
+      uint16_t* y1 = (has_next) ? (uint16_t*)(dst.plane[0] + (j + 1) * dst.stride[0]) : NULL;
+      uint16_t* uv = (uint16_t*)(dst.plane[1] + (j / 2) * dst.stride[1]);
+
+      kernel_l10r_to_p010_rows(src0, src1, y0, y1, uv, w, c);
+    }
+
+    return 0;
+  }
+
+  static int convert_l10r_to_rgb48(PixelBuffer& src, PixelBuffer& dst) {
+
+    for (size_t j = 0; j < src.height; ++j) {
+      kernel_l10r_to_rgb48_row(src.plane[0] + j * src.stride[0], (uint16_t*)(dst.plane[0] + j * dst.stride[0]), (int)src.width);
+    }
+
+    return 0;
+  }
+
+  static int convert_l10r_to_bgra(PixelBuffer& src, PixelBuffer& dst, int flags) {
+
+    bool dither = (flags & SC_CONVERT_DITHER) ? true : false;
+
+    for (size_t j = 0; j < src.height; ++j) {
+      const int* d = dither_2x2[j & 1];
+      kernel_l10r_to_bgra_row(src.plane[0] + j * src.stride[0],
+                              dst.plane[0] + j * dst.stride[0],
+                              (int)src.width,
+                              (dither) ? d[0] : 0,
+                              (dither) ? d[1] : 0);
+    }
+
+    return 0;
+  }
+
+  /* ----------------------------------------------------------- */
+
+  static void copy_plane(const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride, size_t nbytes, size_t nrows) {
+
+    if (src_stride == dst_stride && src_stride == nbytes) {
+      memcpy(dst, src, nbytes * nrows);
+      return;
+    }
+
+    for (size_t j = 0; j < nrows; ++j) {
+      memcpy(dst + j * dst_stride, src + j * src_stride, nbytes);
+    }
+  }
+
+  /*
+    Sets `slice` to the rows [first, first + count) of `buf` without
+    copying; `first` must be even for the 4:2:0 formats.
+  */
+  static void get_slice(PixelBuffer& buf, int first, int count, PixelBuffer& slice) {
+
+    slice = buf;
+    slice.height = count;
+
+    for (int i = 0; i < get_num_planes(buf.pixel_format); ++i) {
+      int row = (0 == i) ? first : first / 2;
+      slice.plane[i] = buf.plane[i] + row * buf.stride[i];
+    }
+  }
+
+  static int get_num_planes(int fmt) {
+
+    switch (fmt) {
+      case SC_BGRA:
+      case SC_L10R:
+      case SC_RGBA:
+      case SC_RGB24:
+      case SC_BGR24:
+      case SC_RGB48: {
+        return 1;
+      }
+      case SC_420V:
+      case SC_420F:
+      case SC_P010: {
+        return 2;
+      }
+      case SC_I420: {
+        return 3;
+      }
+    }
+
+    return 0;
+  }
+
+  /* ----------------------------------------------------------- */
+
+} /* namespace sc */
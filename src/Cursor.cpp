@@ -0,0 +1,551 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <screencapture/Cursor.h>
+#include <screencapture/Convert.h>
+#include <screencapture/Kernels.h>
+
+namespace sc {
+
+  /* ----------------------------------------------------------- */
+
+  static int get_chroma_bpp(int fmt);
+  static int get_shape_row_bytes(int type, int w);
+  static int get_shape_rows(int type, int h);
+  static uint64_t hash_bytes(const uint8_t* data, size_t nbytes, uint64_t h);
+  static uint64_t hash_mix(uint64_t h);
+
+  /* ----------------------------------------------------------- */
+
+  Cursor::Cursor()
+    :type(SC_CURSOR_NONE)
+    ,width(0)
+    ,height(0)
+    ,hotspot_x(0)
+    ,hotspot_y(0)
+  {
+  }
+
+  Cursor::~Cursor() {
+    type = SC_CURSOR_NONE;
+    width = 0;
+    height = 0;
+    hotspot_x = 0;
+    hotspot_y = 0;
+  }
+
+  int Cursor::setShape(int t, int w, int h, int pitch, const uint8_t* pixels, int hotx, int hoty) {
+
+    if (SC_CURSOR_COLOR != t && SC_CURSOR_MASKED_COLOR != t && SC_CURSOR_MONOCHROME != t) {
+      printf("Error: cannot set the pointer shape, invalid type: %d.\n", t);
+      return -1;
+    }
+
+    if (0 >= w || 0 >= h) {
+      printf("Error: cannot set the pointer shape, invalid size: %d x %d.\n", w, h);
+      return -2;
+    }
+
+    if (NULL == pixels) {
+      printf("Error: cannot set the pointer shape, the pixels are NULL.\n");
+      return -3;
+    }
+
+    if (pitch < ((SC_CURSOR_MONOCHROME == t) ? (w + 7) / 8 : w * 4)) {
+      printf("Error: cannot set the pointer shape, the pitch (%d) is too small for a width of %d.\n", pitch, w);
+      return -4;
+    }
+
+    type = t;
+    width = w;
+    height = h;
+    hotspot_x = hotx;
+    hotspot_y = hoty;
+
+    coverage.resize(w * h);
+
+    if (SC_CURSOR_COLOR == type) {
+
+      color.resize(w * h * 4);
+
+      for (int j = 0; j < h; ++j) {
+        const uint8_t* src = pixels + j * pitch;
+        memcpy(&color[j * w * 4], src, w * 4);
+        for (int i = 0; i < w; ++i) {
+          coverage[j * w + i] = (0 != src[i * 4 + 3]) ? 1 : 0;
+        }
+      }
+
+      return 0;
+    }
+
+    and_mask.resize(w * h * 4);
+    xor_mask.resize(w * h * 4);
+
+    for (int j = 0; j < h; ++j) {
+
+      const uint8_t* src = pixels + j * pitch;
+      uint8_t* a = &and_mask[j * w * 4];
+      uint8_t* x = &xor_mask[j * w * 4];
+
+      if (SC_CURSOR_MONOCHROME == type) {
+        kernel_mono_to_masks_row(src, pixels + (h + j) * pitch, a, x, w);
+      }
+      else {
+        /* Masked color: the alpha selects between replacing and XOR-ing with the color. */
+        for (int i = 0; i < w; ++i) {
+          uint8_t keep = (0 != src[i * 4 + 3]) ? 0xFF : 0x00;
+          a[i * 4 + 0] = a[i * 4 + 1] = a[i * 4 + 2] = keep;
+          a[i * 4 + 3] = 0xFF;
+          x[i * 4 + 0] = src[i * 4 + 0];
+          x[i * 4 + 1] = src[i * 4 + 1];
+          x[i * 4 + 2] = src[i * 4 + 2];
+          x[i * 4 + 3] = 0x00;
+        }
+      }
+
+      for (int i = 0; i < w; ++i) {
+        coverage[j * w + i] = (0xFF != a[i * 4] || 0 != x[i * 4 + 0] || 0 != x[i * 4 + 1] || 0 != x[i * 4 + 2]) ? 1 : 0;
+      }
+    }
+
+    return 0;
+  }
+
+  int Cursor::draw(PixelBuffer& frame, int x, int y, int flags) {
+
+    if (SC_CURSOR_NONE == type) {
+      printf("Error: cannot draw the pointer, no shape set.\n");
+      return -1;
+    }
+
+    if (0 != canDraw(frame.pixel_format)) {
+      printf("Error: cannot draw the pointer into a frame with pixel format %s.\n", screencapture_pixelformat_to_string(frame.pixel_format).c_str());
+      return -2;
+    }
+
+    if (NULL == frame.plane[0] || 0 == frame.stride[0]) {
+      printf("Error: cannot draw the pointer, the planes of the frame are not set.\n");
+      return -3;
+    }
+
+    /* The bounding box of the pointer, clipped to the frame. */
+    int left = x - hotspot_x;
+    int top = y - hotspot_y;
+    int x0 = std::max(0, left);
+    int y0 = std::max(0, top);
+    int x1 = std::min((int)frame.width, left + width);
+    int y1 = std::min((int)frame.height, top + height);
+
+    if (x0 >= x1 || y0 >= y1) {
+      return 0;
+    }
+
+    if (SC_BGRA == frame.pixel_format) {
+      drawRows(frame.plane[0] + y0 * frame.stride[0] + x0 * 4, frame.stride[0], x0 - left, y0 - top, x1 - x0, y1 - y0);
+      return 0;
+    }
+
+    return drawYuv(frame, x0, y0, x1, y1, left, top, flags);
+  }
+
+  int Cursor::canDraw(int fmt) {
+    return (SC_BGRA == fmt || 0 != get_chroma_bpp(fmt)) ? 0 : -1;
+  }
+
+  void Cursor::drawRows(uint8_t* dst, size_t stride, int x, int y, int w, int h) {
+
+    for (int j = 0; j < h; ++j) {
+
+      size_t offset = ((y + j) * width + x) * 4;
+
+      if (SC_CURSOR_COLOR == type) {
+        kernel_blend_bgra_row(&color[offset], dst + j * stride, w);
+      }
+      else {
+        kernel_mask_bgra_row(&and_mask[offset], &xor_mask[offset], dst + j * stride, w);
+      }
+    }
+  }
+
+  /*
+    Inverting and blending are defined on RGB, so we convert the bounding
+    box, aligned to whole 2x2 chroma blocks, into BGRA, draw into that and
+    convert it back. A round trip through RGB changes the samples a bit,
+    so we only copy back the luma of the pixels that the pointer changes
+    and the chroma of the 2x2 blocks that contain one of them.
+  */
+  int Cursor::drawYuv(PixelBuffer& frame, int x0, int y0, int x1, int y1, int left, int top, int flags) {
+
+    int bx = x0 & ~1;
+    int by = y0 & ~1;
+    int bw = std::min((int)frame.width, (x1 + 1) & ~1) - bx;
+    int bh = std::min((int)frame.height, (y1 + 1) & ~1) - by;
+    int chroma_bpp = get_chroma_bpp(frame.pixel_format);
+    int num_planes = (SC_I420 == frame.pixel_format) ? 3 : 2;
+    PixelBuffer box;
+
+    if (0 != frame.getView(bx, by, bw, bh, box)) {
+      return -4;
+    }
+
+    if (0 != bgra.init(bw, bh, SC_BGRA) || 0 != yuv.init(bw, bh, frame.pixel_format)) {
+      return -5;
+    }
+
+    if (bgra_mem.size() < bgra.getNumBytes()) {
+      bgra_mem.resize(bgra.getNumBytes());
+    }
+
+    if (yuv_mem.size() < yuv.getNumBytes()) {
+      yuv_mem.resize(yuv.getNumBytes());
+    }
+
+    bgra.setPlanes(&bgra_mem.front());
+    yuv.setPlanes(&yuv_mem.front());
+
+    if (0 != screencapture_convert(box, bgra, flags)) {
+      printf("Error: cannot draw the pointer, failed to convert the frame into BGRA.\n");
+      return -6;
+    }
+
+    drawRows(bgra.plane[0] + (y0 - by) * bgra.stride[0] + (x0 - bx) * 4, bgra.stride[0], x0 - left, y0 - top, x1 - x0, y1 - y0);
+
+    if (0 != screencapture_convert(bgra, yuv, flags)) {
+      printf("Error: cannot draw the pointer, failed to convert the pointer back into %s.\n", screencapture_pixelformat_to_string(frame.pixel_format).c_str());
+      return -7;
+    }
+
+    /* The position of the box in the pointer. */
+    int px = bx - left;
+    int py = by - top;
+
+    for (int j = 0; j < bh; ++j) {
+
+      int cy = py + j;
+
+      if (0 > cy || cy >= height) {
+        continue;
+      }
+
+      const uint8_t* cov = &coverage[cy * width];
+      const uint8_t* src = yuv.plane[0] + j * yuv.stride[0];
+      uint8_t* dst = box.plane[0] + j * box.stride[0];
+
+      for (int i = std::max(0, -px); i < bw && px + i < width; ++i) {
+        if (0 != cov[px + i]) {
+          dst[i] = src[i];
+        }
+      }
+    }
+
+    for (int j = 0; j < (bh + 1) / 2; ++j) {
+      for (int i = 0; i < (bw + 1) / 2; ++i) {
+
+        /* Is one of the pixels of this 2x2 block changed? */
+        int changed = 0;
+
+        for (int k = 0; k < 4 && 0 == changed; ++k) {
+          int ix = i * 2 + (k & 1);
+          int iy = j * 2 + (k >> 1);
+          int cx = px + ix;
+          int cy = py + iy;
+          if (ix < bw && iy < bh && 0 <= cx && cx < width && 0 <= cy && cy < height) {
+            changed = coverage[cy * width + cx];
+          }
+        }
+
+        if (0 == changed) {
+          continue;
+        }
+
+        for (int p = 1; p < num_planes; ++p) {
+          memcpy(box.plane[p] + j * box.stride[p] + i * chroma_bpp, yuv.plane[p] + j * yuv.stride[p] + i * chroma_bpp, chroma_bpp);
+        }
+      }
+    }
+
+    return 0;
+  }
+
+  CursorCacheEntry::CursorCacheEntry()
+    :hash(0)
+    ,id(-1)
+    ,last_used(0)
+  {
+  }
+
+  int CursorCacheEntry::setShape(int t, int w, int h, int pitch, const uint8_t* pixels, int hotx, int hoty) {
+
+    if (0 != cursor.setShape(t, w, h, pitch, pixels, hotx, hoty)) {
+      return -1;
+    }
+
+    int row_bytes = get_shape_row_bytes(t, w);
+    int rows = get_shape_rows(t, h);
+
+    shape.resize(row_bytes * rows);
+
+    for (int j = 0; j < rows; ++j) {
+      memcpy(&shape[j * row_bytes], pixels + j * pitch, row_bytes);
+    }
+
+    bgra.resize(w * h * 4);
+
+    if (SC_CURSOR_MONOCHROME == t) {
+      if (0 != screencapture_decode_monochrome_cursor(pixels, w, h, pitch, &bgra.front(), w * 4)) {
+        return -2;
+      }
+    }
+    else {
+      memcpy(&bgra.front(), &shape.front(), bgra.size());
+    }
+
+    return 0;
+  }
+
+  int CursorCacheEntry::isShape(int t, int w, int h, int pitch, const uint8_t* pixels, int hotx, int hoty) {
+
+    if (t != cursor.type || w != cursor.width || h != cursor.height || hotx != cursor.hotspot_x || hoty != cursor.hotspot_y) {
+      return -1;
+    }
+
+    int row_bytes = get_shape_row_bytes(t, w);
+    int rows = get_shape_rows(t, h);
+
+    for (int j = 0; j < rows; ++j) {
+      if (0 != memcmp(&shape[j * row_bytes], pixels + j * pitch, row_bytes)) {
+        return -1;
+      }
+    }
+
+    return 0;
+  }
+
+  /* ----------------------------------------------------------- */
+
+  CursorCache::CursorCache()
+    :capacity(SC_CURSOR_CACHE_SIZE)
+    ,clock(0)
+    ,next_id(0)
+    ,num_hits(0)
+    ,num_misses(0)
+  {
+  }
+
+  CursorCache::~CursorCache() {
+    clear();
+    capacity = 0;
+    clock = 0;
+    next_id = 0;
+    num_hits = 0;
+    num_misses = 0;
+  }
+
+  int CursorCache::setCapacity(int n) {
+
+    if (0 >= n) {
+      printf("Error: cannot set the capacity of the pointer cache to %d.\n", n);
+      return -1;
+    }
+
+    capacity = n;
+
+    while (entries.size() > capacity) {
+
+      size_t oldest = 0;
+
+      for (size_t i = 1; i < entries.size(); ++i) {
+        if (entries[i]->last_used < entries[oldest]->last_used) {
+          oldest = i;
+        }
+      }
+
+      delete entries[oldest];
+      entries.erase(entries.begin() + oldest);
+    }
+
+    return 0;
+  }
+
+  int CursorCache::get(int t, int w, int h, int pitch, const uint8_t* pixels, int hotx, int hoty, CursorCacheEntry** result) {
+
+    if (NULL == result) {
+      printf("Error: cannot get the pointer from the cache, the result is NULL.\n");
+      return -1;
+    }
+
+    *result = NULL;
+
+    /* Validates the arguments so we can safely hash and compare the shape. */
+    if (SC_CURSOR_COLOR != t && SC_CURSOR_MASKED_COLOR != t && SC_CURSOR_MONOCHROME != t) {
+      printf("Error: cannot get the pointer from the cache, invalid type: %d.\n", t);
+      return -2;
+    }
+
+    if (0 >= w || 0 >= h || NULL == pixels || pitch < get_shape_row_bytes(t, w)) {
+      printf("Error: cannot get the pointer from the cache, invalid shape: %d x %d, pitch: %d.\n", w, h, pitch);
+      return -3;
+    }
+
+    uint64_t hash = hashShape(t, w, h, pitch, pixels, hotx, hoty);
+    CursorCacheEntry* entry = NULL;
+
+    clock++;
+
+    for (size_t i = 0; i < entries.size(); ++i) {
+      if (hash == entries[i]->hash && 0 == entries[i]->isShape(t, w, h, pitch, pixels, hotx, hoty)) {
+        entry = entries[i];
+        break;
+      }
+    }
+
+    if (NULL != entry) {
+      entry->last_used = clock;
+      num_hits++;
+      *result = entry;
+      return 0;
+    }
+
+    /* Reuse the least recently used entry (and its memory) when we're full. */
+    if (entries.size() < capacity) {
+      entry = new CursorCacheEntry();
+      entries.push_back(entry);
+    }
+    else {
+      entry = entries[0];
+      for (size_t i = 1; i < entries.size(); ++i) {
+        if (entries[i]->last_used < entry->last_used) {
+          entry = entries[i];
+        }
+      }
+    }
+
+    if (0 != entry->setShape(t, w, h, pitch, pixels, hotx, hoty)) {
+      printf("Error: cannot get the pointer from the cache, failed to decode the shape.\n");
+      entries.erase(std::find(entries.begin(), entries.end(), entry));
+      delete entry;
+      return -4;
+    }
+
+    entry->hash = hash;
+    entry->id = next_id++;
+    entry->last_used = clock;
+    num_misses++;
+    *result = entry;
+
+    return 1;
+  }
+
+  void CursorCache::clear() {
+
+    for (size_t i = 0; i < entries.size(); ++i) {
+      delete entries[i];
+      entries[i] = NULL;
+    }
+
+    entries.clear();
+    num_hits = 0;
+    num_misses = 0;
+  }
+
+  uint64_t CursorCache::hashShape(int t, int w, int h, int pitch, const uint8_t* pixels, int hotx, int hoty) {
+
+    int row_bytes = get_shape_row_bytes(t, w);
+    int rows = get_shape_rows(t, h);
+    uint64_t hash = hash_mix(((uint64_t)t << 56) ^ ((uint64_t)(w & 0xFFFF) << 40) ^ ((uint64_t)(h & 0xFFFF) << 24) ^ ((uint64_t)(hotx & 0xFFF) << 12) ^ (uint64_t)(hoty & 0xFFF));
+
+    for (int j = 0; j < rows; ++j) {
+      hash = hash_bytes(pixels + j * pitch, row_bytes, hash);
+    }
+
+    return hash_mix(hash);
+  }
+
+  /* ----------------------------------------------------------- */
+
+  int screencapture_decode_monochrome_cursor(const uint8_t* pixels, int w, int h, int pitch, uint8_t* dst, int dst_stride) {
+
+    if (NULL == pixels || NULL == dst) {
+      printf("Error: cannot decode the monochrome pointer, the pixels or destination are NULL.\n");
+      return -1;
+    }
+
+    if (0 >= w || 0 >= h || pitch < (w + 7) / 8 || dst_stride < w * 4) {
+      printf("Error: cannot decode the monochrome pointer, invalid size: %d x %d, pitch: %d, stride: %d.\n", w, h, pitch, dst_stride);
+      return -2;
+    }
+
+    for (int j = 0; j < h; ++j) {
+      kernel_mono_to_bgra_row(pixels + j * pitch, pixels + (h + j) * pitch, dst + j * dst_stride, w);
+    }
+
+    return 0;
+  }
+
+  /* ----------------------------------------------------------- */
+
+  /* Returns the bytes per sample of the chroma planes of the YCbCr formats that we can draw into, otherwise 0. */
+  static int get_chroma_bpp(int fmt) {
+
+    switch (fmt) {
+      case SC_420V:
+      case SC_420F: {
+        return 2;
+      }
+      case SC_I420: {
+        return 1;
+      }
+    }
+
+    return 0;
+  }
+
+  /* The number of bytes per row of a raw shape, without the padding. */
+  static int get_shape_row_bytes(int type, int w) {
+    return (SC_CURSOR_MONOCHROME == type) ? (w + 7) / 8 : w * 4;
+  }
+
+  /* The number of rows of a raw shape; monochrome shapes have an AND and a XOR mask. */
+  static int get_shape_rows(int type, int h) {
+    return (SC_CURSOR_MONOCHROME == type) ? h * 2 : h;
+  }
+
+  /* Hashes 8 bytes at a time; `h` is the hash of the previous bytes. Not a cryptographic hash. */
+  static uint64_t hash_bytes(const uint8_t* data, size_t nbytes, uint64_t h) {
+
+    uint64_t k = 0;
+
+    while (nbytes >= 8) {
+      memcpy(&k, data, 8);
+      h = (h ^ (k * 0x87C37B91114253D5ull)) * 0x9E3779B97F4A7C15ull;
+      h ^= h >> 29;
+      data += 8;
+      nbytes -= 8;
+    }
+
+    k = nbytes;
+
+    for (size_t i = 0; i < nbytes; ++i) {
+      k = (k << 8) | data[i];
+    }
+
+    h = (h ^ (k * 0x87C37B91114253D5ull)) * 0x9E3779B97F4A7C15ull;
+    h ^= h >> 29;
+
+    return h;
+  }
+
+  /* The finalizer of MurmurHash3, spreads every bit of `h` over the whole hash. */
+  static uint64_t hash_mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+  }
+
+  /* ----------------------------------------------------------- */
+
+} /* namespace sc */
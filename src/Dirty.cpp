@@ -0,0 +1,354 @@
+#include <stdio.h>
+#include <algorithm>
+#include <screencapture/Dirty.h>
+#include <screencapture/Kernels.h>
+
+namespace sc {
+
+  /* ----------------------------------------------------------- */
+
+  DirtyDetector::DirtyDetector()
+    :width(0)
+    ,height(0)
+    ,pixel_format(SC_NONE)
+    ,tile_size(0)
+    ,num_cols(0)
+    ,num_rows(0)
+    ,num_planes(0)
+    ,num_dirty(0)
+    ,has_hashes(false)
+  {
+    bpp[0] = bpp[1] = bpp[2] = 0;
+  }
+
+  DirtyDetector::~DirtyDetector() {
+    shutdown();
+  }
+
+  int DirtyDetector::init(int w, int h, int fmt, int tile) {
+
+    int layout[3] = { 0 };
+    int n = screencapture_get_plane_layout(fmt, layout);
+
+    if (0 == n) {
+      printf("Error: cannot initialize the dirty detector, unsupported pixel format: %s.\n", screencapture_pixelformat_to_string(fmt).c_str());
+      return -1;
+    }
+
+    if (0 >= w || 0 >= h) {
+      printf("Error: cannot initialize the dirty detector, invalid size: %d x %d.\n", w, h);
+      return -2;
+    }
+
+    if (2 > tile || 0 != (tile & 1)) {
+      printf("Error: cannot initialize the dirty detector, the tile size must be even: %d.\n", tile);
+      return -3;
+    }
+
+    width = w;
+    height = h;
+    pixel_format = fmt;
+    tile_size = tile;
+    num_cols = (w + tile - 1) / tile;
+    num_rows = (h + tile - 1) / tile;
+    num_planes = n;
+    bpp[0] = layout[0];
+    bpp[1] = layout[1];
+    bpp[2] = layout[2];
+    num_dirty = 0;
+    has_hashes = false;
+
+    hashes.assign(num_cols * num_rows, 0);
+    dirty.assign(num_cols * num_rows, 0);
+
+    return 0;
+  }
+
+  int DirtyDetector::shutdown() {
+
+    width = 0;
+    height = 0;
+    pixel_format = SC_NONE;
+    tile_size = 0;
+    num_cols = 0;
+    num_rows = 0;
+    num_planes = 0;
+    bpp[0] = bpp[1] = bpp[2] = 0;
+    num_dirty = 0;
+    has_hashes = false;
+
+    hashes.clear();
+    dirty.clear();
+    runs.clear();
+    next_runs.clear();
+
+    return 0;
+  }
+
+  int DirtyDetector::update(PixelBuffer& frame, std::vector<DirtyRect>& rects) {
+
+    rects.clear();
+
+    if (0 != isInit()) {
+      printf("Error: cannot detect the dirty regions, not initialized.\n");
+      return -1;
+    }
+
+    if ((int)frame.width != width || (int)frame.height != height || frame.pixel_format != pixel_format) {
+      printf("Error: cannot detect the dirty regions, the frame (%lu x %lu, %s) doesn't match the detector (%d x %d, %s).\n",
+             frame.width, frame.height, screencapture_pixelformat_to_string(frame.pixel_format).c_str(),
+             width, height, screencapture_pixelformat_to_string(pixel_format).c_str());
+      return -2;
+    }
+
+    for (int i = 0; i < num_planes; ++i) {
+      if (NULL == frame.plane[i] || 0 == frame.stride[i]) {
+        printf("Error: cannot detect the dirty regions, plane %d of the frame is not set.\n", i);
+        return -3;
+      }
+    }
+
+    num_dirty = 0;
+
+    for (int row = 0; row < num_rows; ++row) {
+      for (int col = 0; col < num_cols; ++col) {
+
+        int dx = row * num_cols + col;
+        uint64_t hash = hashTile(frame, col, row);
+
+        dirty[dx] = (false == has_hashes || hash != hashes[dx]) ? 1 : 0;
+        hashes[dx] = hash;
+        num_dirty += dirty[dx];
+      }
+    }
+
+    has_hashes = true;
+
+    if (0 != num_dirty) {
+      mergeTiles(rects);
+    }
+
+    return 0;
+  }
+
+  void DirtyDetector::reset() {
+    has_hashes = false;
+  }
+
+  int DirtyDetector::isInitFor(int w, int h, int fmt, int tile) {
+
+    if (0 != isInit()) {
+      return -1;
+    }
+
+    return (w == width && h == height && fmt == pixel_format && tile == tile_size) ? 0 : -1;
+  }
+
+  uint64_t DirtyDetector::hashTile(PixelBuffer& frame, int col, int row) {
+
+    int x = col * tile_size;
+    int y = row * tile_size;
+    int w = std::min(tile_size, width - x);
+    int h = std::min(tile_size, height - y);
+    uint64_t hash = kernel_hash_block(frame.plane[0] + y * frame.stride[0] + x * bpp[0], frame.stride[0], w * bpp[0], h);
+
+    /* The other planes are the 4:2:0 chroma planes; `x` and `y` are even. */
+    for (int i = 1; i < num_planes; ++i) {
+      uint8_t* src = frame.plane[i] + (y / 2) * frame.stride[i] + (x / 2) * bpp[i];
+      hash = (hash * 0x9E3779B97F4A7C15ull) ^ kernel_hash_block(src, frame.stride[i], ((w + 1) / 2) * bpp[i], (h + 1) / 2);
+    }
+
+    return hash;
+  }
+
+  /*
+    We merge in two steps: the dirty tiles of a row of tiles become runs
+    and a run grows the rectangle that ends at the row above when it
+    has exactly the same columns, otherwise it starts a new rectangle.
+    That's one pass without searching and gives one rectangle for a
+    changed rectangular area, e.g. a video or a window that moves.
+    While merging the rectangles are in tiles; we convert them into
+    pixels at the end.
+  */
+  void DirtyDetector::mergeTiles(std::vector<DirtyRect>& rects) {
+
+    runs.clear();
+
+    for (int row = 0; row < num_rows; ++row) {
+
+      const uint8_t* flags = &dirty[row * num_cols];
+      size_t k = 0;
+
+      next_runs.clear();
+
+      for (int col = 0; col < num_cols; ++col) {
+
+        if (0 == flags[col]) {
+          continue;
+        }
+
+        int start = col;
+
+        while (col < num_cols && 0 != flags[col]) {
+          ++col;
+        }
+
+        /* The runs of the row above are ordered by column too. */
+        while (k < runs.size() && rects[runs[k]].x < start) {
+          ++k;
+        }
+
+        if (k < runs.size() && rects[runs[k]].x == start && rects[runs[k]].width == col - start) {
+          rects[runs[k]].height++;
+          next_runs.push_back(runs[k]);
+          ++k;
+          continue;
+        }
+
+        DirtyRect rect;
+        rect.x = start;
+        rect.y = row;
+        rect.width = col - start;
+        rect.height = 1;
+
+        next_runs.push_back((int)rects.size());
+        rects.push_back(rect);
+      }
+
+      runs.swap(next_runs);
+    }
+
+    for (size_t i = 0; i < rects.size(); ++i) {
+      DirtyRect& r = rects[i];
+      int right = std::min(width, (r.x + r.width) * tile_size);
+      int bottom = std::min(height, (r.y + r.height) * tile_size);
+      r.x *= tile_size;
+      r.y *= tile_size;
+      r.width = right - r.x;
+      r.height = bottom - r.y;
+    }
+  }
+
+  /* ----------------------------------------------------------- */
+
+  StaticFrameFilter::StaticFrameFilter()
+    :keepalive_ms(0)
+    ,has_last(false)
+    ,has_hash(false)
+    ,last_hash(0)
+    ,last_time(0)
+    ,last_width(0)
+    ,last_height(0)
+    ,last_format(SC_NONE)
+    ,num_dropped(0)
+    ,num_passed(0)
+  {
+  }
+
+  int StaticFrameFilter::init(int keepalive) {
+
+    if (0 > keepalive) {
+      printf("Error: cannot initialize the static frame filter, invalid keepalive: %d.\n", keepalive);
+      return -1;
+    }
+
+    keepalive_ms = keepalive;
+    num_dropped = 0;
+    num_passed = 0;
+
+    reset();
+
+    return 0;
+  }
+
+  /*
+    The damage of the driver describes the change since the previous
+    frame of the driver, not since the last frame that we let through.
+    That's the same as long as we only drop static frames: every frame
+    in between was the same as the last one that we let through.
+  */
+  int StaticFrameFilter::shouldDrop(PixelBuffer& frame, uint64_t now) {
+
+    bool is_static = false;
+    bool same_layout = (true == has_last
+                        && (int)frame.width == last_width
+                        && (int)frame.height == last_height
+                        && frame.pixel_format == last_format);
+
+    if (SC_DAMAGE_NONE == frame.damage) {
+      is_static = same_layout;
+      has_hash = (true == has_hash && true == same_layout);
+    }
+    else if (SC_DAMAGE_CHANGED == frame.damage) {
+      has_hash = false;
+    }
+    else {
+      uint64_t hash = 0;
+      if (0 != hashFrame(frame, hash)) {
+        has_hash = false;
+      }
+      else {
+        is_static = (true == same_layout && true == has_hash && hash == last_hash);
+        last_hash = hash;
+        has_hash = true;
+      }
+    }
+
+    if (true == is_static
+        && (0 == keepalive_ms || now - last_time < (uint64_t)keepalive_ms))
+      {
+        num_dropped++;
+        return 0;
+      }
+
+    has_last = true;
+    last_time = now;
+    last_width = (int)frame.width;
+    last_height = (int)frame.height;
+    last_format = frame.pixel_format;
+    num_passed++;
+
+    return -1;
+  }
+
+  void StaticFrameFilter::reset() {
+    has_last = false;
+    has_hash = false;
+    last_hash = 0;
+    last_time = 0;
+    last_width = 0;
+    last_height = 0;
+    last_format = SC_NONE;
+  }
+
+  int StaticFrameFilter::hashFrame(PixelBuffer& frame, uint64_t& result) {
+
+    int layout[3] = { 0 };
+    int num_planes = screencapture_get_plane_layout(frame.pixel_format, layout);
+
+    if (0 == num_planes || 0 == frame.width || 0 == frame.height) {
+      return -1;
+    }
+
+    uint64_t hash = 0;
+
+    for (int i = 0; i < num_planes; ++i) {
+
+      if (NULL == frame.plane[i] || 0 == frame.stride[i]) {
+        return -2;
+      }
+
+      /* The other planes are the 4:2:0 chroma planes. */
+      int w = (0 == i) ? (int)frame.width : ((int)frame.width + 1) / 2;
+      int h = (0 == i) ? (int)frame.height : ((int)frame.height + 1) / 2;
+      hash = (hash * 0x9E3779B97F4A7C15ull) ^ kernel_hash_block(frame.plane[i], frame.stride[i], w * layout[i], h);
+    }
+
+    result = hash;
+
+    return 0;
+  }
+
+  /* ----------------------------------------------------------- */
+
+} /* namespace sc */
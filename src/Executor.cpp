@@ -0,0 +1,335 @@
+#include <stdio.h>
+#include <algorithm>
+#include <screencapture/Executor.h>
+
+#if !defined(_WIN32)
+#  include <unistd.h>
+#endif
+
+namespace sc {
+
+  /* ----------------------------------------------------------- */
+
+#if defined(_WIN32)
+  static DWORD WINAPI executor_thread(LPVOID user);
+#else
+  static void* executor_thread(void* user);
+#endif
+
+  /* ----------------------------------------------------------- */
+
+  Executor::Executor()
+    :num_threads(0)
+    ,must_stop(false)
+    ,generation(0)
+    ,num_busy(0)
+    ,task(NULL)
+    ,user(NULL)
+    ,num_rows(0)
+    ,rows_per_slice(0)
+    ,next_row(0)
+  {
+  }
+
+  Executor::~Executor() {
+
+    if (0 == isInit()) {
+      shutdown();
+    }
+  }
+
+  int Executor::init(int nthreads) {
+
+    if (0 == isInit()) {
+      printf("Error: cannot initialize the executor, already initialized.\n");
+      return -1;
+    }
+
+    if (0 > nthreads) {
+      printf("Error: cannot initialize the executor, invalid number of threads: %d.\n", nthreads);
+      return -2;
+    }
+
+    if (0 == nthreads) {
+      nthreads = screencapture_get_num_cpus();
+    }
+
+#if defined(_WIN32)
+    InitializeCriticalSection(&mutex);
+    InitializeConditionVariable(&cond_work);
+    InitializeConditionVariable(&cond_done);
+#else
+    if (0 != pthread_mutex_init(&mutex, NULL)) {
+      printf("Error: failed to create the mutex of the executor.\n");
+      return -3;
+    }
+
+    if (0 != pthread_cond_init(&cond_work, NULL)
+        || 0 != pthread_cond_init(&cond_done, NULL))
+      {
+        printf("Error: failed to create the condition variables of the executor.\n");
+        return -4;
+      }
+#endif
+
+    must_stop = false;
+    generation = 0;
+    num_busy = 0;
+    num_threads = nthreads;
+
+    /* Index 0 is the thread that calls run(). */
+    for (int i = 1; i < nthreads; ++i) {
+
+      ExecutorWorker* worker = new ExecutorWorker();
+      worker->executor = this;
+      worker->index = i;
+
+#if defined(_WIN32)
+      worker->handle = CreateThread(NULL, 0, executor_thread, worker, 0, NULL);
+      if (NULL == worker->handle) {
+#else
+      if (0 != pthread_create(&worker->handle, NULL, executor_thread, worker)) {
+#endif
+        printf("Error: failed to create worker thread %d of the executor.\n", i);
+        delete worker;
+        shutdown();
+        return -5;
+      }
+
+      workers.push_back(worker);
+    }
+
+    return 0;
+  }
+
+  int Executor::shutdown() {
+
+    if (0 != isInit()) {
+      printf("Error: cannot shutdown the executor, not initialized.\n");
+      return -1;
+    }
+
+    lock();
+    {
+      must_stop = true;
+#if defined(_WIN32)
+      WakeAllConditionVariable(&cond_work);
+#else
+      pthread_cond_broadcast(&cond_work);
+#endif
+    }
+    unlock();
+
+    for (size_t i = 0; i < workers.size(); ++i) {
+#if defined(_WIN32)
+      WaitForSingleObject(workers[i]->handle, INFINITE);
+      CloseHandle(workers[i]->handle);
+#else
+      pthread_join(workers[i]->handle, NULL);
+#endif
+      delete workers[i];
+    }
+
+    workers.clear();
+
+#if defined(_WIN32)
+    DeleteCriticalSection(&mutex);
+#else
+    pthread_cond_destroy(&cond_work);
+    pthread_cond_destroy(&cond_done);
+    pthread_mutex_destroy(&mutex);
+#endif
+
+    num_threads = 0;
+
+    return 0;
+  }
+
+  int Executor::run(executor_task task, void* user, int nrows, int slice_rows) {
+
+    if (NULL == task) {
+      printf("Error: cannot run, the task is NULL.\n");
+      return -1;
+    }
+
+    if (0 >= slice_rows) {
+      printf("Error: cannot run, invalid number of rows per slice: %d.\n", slice_rows);
+      return -2;
+    }
+
+    if (0 >= nrows) {
+      return 0;
+    }
+
+    /* Without workers, or with only one slice, we don't need to wake anyone. */
+    if (0 != isInit() || workers.empty() || nrows <= slice_rows) {
+      for (int first = 0; first < nrows; first += slice_rows) {
+        task(user, 0, first, std::min(slice_rows, nrows - first));
+      }
+      return 0;
+    }
+
+    lock();
+    {
+      this->task = task;
+      this->user = user;
+      num_rows = nrows;
+      rows_per_slice = slice_rows;
+      next_row = 0;
+      num_busy = (int)workers.size();
+      generation++;
+#if defined(_WIN32)
+      WakeAllConditionVariable(&cond_work);
+#else
+      pthread_cond_broadcast(&cond_work);
+#endif
+    }
+    unlock();
+
+    processSlices(0);
+
+    /* Wait until the workers finished their last slice. */
+    lock();
+    {
+      while (0 != num_busy) {
+#if defined(_WIN32)
+        SleepConditionVariableCS(&cond_done, &mutex, INFINITE);
+#else
+        pthread_cond_wait(&cond_done, &mutex);
+#endif
+      }
+      this->task = NULL;
+      this->user = NULL;
+    }
+    unlock();
+
+    return 0;
+  }
+
+  void Executor::processSlices(int thread) {
+
+    while (true) {
+
+      int first = 0;
+      int count = 0;
+
+      lock();
+      {
+        first = next_row;
+        count = std::min(rows_per_slice, num_rows - first);
+        next_row += count;
+      }
+      unlock();
+
+      if (0 >= count) {
+        break;
+      }
+
+      task(user, thread, first, count);
+    }
+  }
+
+  void Executor::lock() {
+#if defined(_WIN32)
+    EnterCriticalSection(&mutex);
+#else
+    pthread_mutex_lock(&mutex);
+#endif
+  }
+
+  void Executor::unlock() {
+#if defined(_WIN32)
+    LeaveCriticalSection(&mutex);
+#else
+    pthread_mutex_unlock(&mutex);
+#endif
+  }
+
+  /* ----------------------------------------------------------- */
+
+  int screencapture_get_num_cpus() {
+
+    int n = 1;
+
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    n = (int)info.dwNumberOfProcessors;
+#else
+    n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+    return std::max(1, n);
+  }
+
+  int screencapture_get_rows_per_slice(size_t row_bytes, int alignment) {
+
+    int rows = (int)(SC_EXECUTOR_SLICE_BYTES / std::max<size_t>(1, row_bytes));
+
+    alignment = std::max(1, alignment);
+    rows = std::max(alignment, (rows / alignment) * alignment);
+
+    return rows;
+  }
+
+  /* ----------------------------------------------------------- */
+
+  /*
+    The workers sleep until `generation` changes, run slices until none
+    are left and let run() know when they're done.
+  */
+#if defined(_WIN32)
+  static DWORD WINAPI executor_thread(LPVOID user) {
+#else
+  static void* executor_thread(void* user) {
+#endif
+
+    ExecutorWorker* worker = static_cast<ExecutorWorker*>(user);
+    Executor* ex = worker->executor;
+    int seen = 0;
+
+    while (true) {
+
+      ex->lock();
+      {
+        while (false == ex->must_stop && seen == ex->generation) {
+#if defined(_WIN32)
+          SleepConditionVariableCS(&ex->cond_work, &ex->mutex, INFINITE);
+#else
+          pthread_cond_wait(&ex->cond_work, &ex->mutex);
+#endif
+        }
+
+        if (true == ex->must_stop) {
+          ex->unlock();
+          break;
+        }
+
+        seen = ex->generation;
+      }
+      ex->unlock();
+
+      ex->processSlices(worker->index);
+
+      ex->lock();
+      {
+        ex->num_busy--;
+        if (0 == ex->num_busy) {
+#if defined(_WIN32)
+          WakeAllConditionVariable(&ex->cond_done);
+#else
+          pthread_cond_signal(&ex->cond_done);
+#endif
+        }
+      }
+      ex->unlock();
+    }
+
+#if defined(_WIN32)
+    return 0;
+#else
+    return NULL;
+#endif
+  }
+
+} /* namespace sc */
@@ -0,0 +1,296 @@
+#include <stdio.h>
+#include <algorithm>
+#if defined(__APPLE__)
+#  include <mach/mach_time.h>
+#elif defined(_WIN32)
+#  include <windows.h>
+#else
+#  include <time.h>
+#endif
+#include <screencapture/FrameInfo.h>
+#include <screencapture/Scaler.h>
+
+namespace sc {
+
+  /* ----------------------------------------------------------- */
+
+  static void rotate_rect(int rotation, int w, int h, int& x, int& y, int& rw, int& rh);
+  static void scale_rect(int w, int h, int dst_w, int dst_h, int margin, DirtyRect& r);
+  static void align_rect(int w, int h, DirtyRect& r);
+  static DirtyRect get_destination(const MoveRect& m);
+  static bool rects_intersect(const DirtyRect& a, const DirtyRect& b);
+
+  /* ----------------------------------------------------------- */
+
+  FrameInfo::FrameInfo()
+    :flags(0)
+    ,cursor_x(0)
+    ,cursor_y(0)
+    ,cursor_visible(0)
+    ,capture_time(0)
+    ,present_time(0)
+  {
+  }
+
+  void FrameInfo::reset() {
+    flags = 0;
+    dirty_rects.clear();
+    move_rects.clear();
+    cursor_x = 0;
+    cursor_y = 0;
+    cursor_visible = 0;
+    capture_time = 0;
+    present_time = 0;
+  }
+
+  void FrameInfo::rotate(int rotation, int w, int h) {
+
+    for (size_t i = 0; i < dirty_rects.size(); ++i) {
+      DirtyRect& r = dirty_rects[i];
+      rotate_rect(rotation, w, h, r.x, r.y, r.width, r.height);
+    }
+
+    for (size_t i = 0; i < move_rects.size(); ++i) {
+      MoveRect& m = move_rects[i];
+      int src_w = m.width;
+      int src_h = m.height;
+      rotate_rect(rotation, w, h, m.src_x, m.src_y, src_w, src_h);
+      rotate_rect(rotation, w, h, m.x, m.y, m.width, m.height);
+    }
+
+    if (0 != (flags & SC_FRAME_HAS_CURSOR)) {
+      int cw = 1;
+      int ch = 1;
+      rotate_rect(rotation, w, h, cursor_x, cursor_y, cw, ch);
+    }
+  }
+
+  void FrameInfo::scale(int w, int h, int dst_w, int dst_h, int margin) {
+
+    if (0 >= w || 0 >= h || (w == dst_w && h == dst_h)) {
+      return;
+    }
+
+    for (size_t i = 0; i < dirty_rects.size(); ++i) {
+      scale_rect(w, h, dst_w, dst_h, margin, dirty_rects[i]);
+    }
+
+    /* The scaled pixels of a move are not a copy of the scaled source pixels. */
+    if (0 != (flags & SC_FRAME_HAS_DIRTY_RECTS)) {
+      for (size_t i = 0; i < move_rects.size(); ++i) {
+        DirtyRect r = get_destination(move_rects[i]);
+        scale_rect(w, h, dst_w, dst_h, margin, r);
+        dirty_rects.push_back(r);
+      }
+    }
+
+    move_rects.clear();
+    flags &= ~SC_FRAME_HAS_MOVE_RECTS;
+
+    if (0 != (flags & SC_FRAME_HAS_CURSOR)) {
+      cursor_x = (int)(((int64_t)cursor_x * dst_w) / w);
+      cursor_y = (int)(((int64_t)cursor_y * dst_h) / h);
+    }
+  }
+
+  void FrameInfo::fit(int w, int h, int dst_w, int dst_h, int even, int margin) {
+
+    int fx = 0;
+    int fy = 0;
+    int fw = dst_w;
+    int fh = dst_h;
+
+    if (0 >= w || 0 >= h || 0 != screencapture_get_fit_rect(w, h, dst_w, dst_h, even, fx, fy, fw, fh)) {
+      return;
+    }
+
+    /* The scaled rects are clipped to the fit rect, so they stay inside the frame when we move them past the bars. */
+    scale(w, h, fw, fh, margin);
+
+    for (size_t i = 0; i < dirty_rects.size(); ++i) {
+      dirty_rects[i].x += fx;
+      dirty_rects[i].y += fy;
+    }
+
+    for (size_t i = 0; i < move_rects.size(); ++i) {
+      move_rects[i].src_x += fx;
+      move_rects[i].src_y += fy;
+      move_rects[i].x += fx;
+      move_rects[i].y += fy;
+    }
+
+    if (0 != (flags & SC_FRAME_HAS_CURSOR)) {
+      cursor_x += fx;
+      cursor_y += fy;
+    }
+  }
+
+  /* A replayed move would copy what was drawn over its source, and what we draw over its destination must stay. */
+  int FrameInfo::breakMoves(const DirtyRect& r) {
+
+    size_t num_moves = 0;
+    int num_broken = 0;
+
+    for (size_t i = 0; i < move_rects.size(); ++i) {
+
+      MoveRect& m = move_rects[i];
+      DirtyRect src = { m.src_x, m.src_y, m.width, m.height };
+      DirtyRect dst = get_destination(m);
+
+      if (false == rects_intersect(src, r) && false == rects_intersect(dst, r)) {
+        move_rects[num_moves++] = m;
+        continue;
+      }
+
+      if (0 != (flags & SC_FRAME_HAS_DIRTY_RECTS)) {
+        dirty_rects.push_back(dst);
+      }
+
+      num_broken++;
+    }
+
+    move_rects.resize(num_moves);
+
+    return num_broken;
+  }
+
+  /* A chroma sample of 4:2:0 covers 2 x 2 pixels; a move has to move whole samples. */
+  void FrameInfo::alignEven(int w, int h) {
+
+    for (size_t i = 0; i < dirty_rects.size(); ++i) {
+      align_rect(w, h, dirty_rects[i]);
+    }
+
+    size_t num_moves = 0;
+
+    for (size_t i = 0; i < move_rects.size(); ++i) {
+
+      MoveRect& m = move_rects[i];
+      bool is_even = (0 == ((m.src_x | m.src_y | m.x | m.y) & 1)
+                      && (0 == (m.width & 1) || m.x + m.width == w)
+                      && (0 == (m.height & 1) || m.y + m.height == h));
+
+      if (true == is_even) {
+        move_rects[num_moves++] = m;
+        continue;
+      }
+
+      if (0 != (flags & SC_FRAME_HAS_DIRTY_RECTS)) {
+        DirtyRect r = get_destination(m);
+        align_rect(w, h, r);
+        dirty_rects.push_back(r);
+      }
+    }
+
+    move_rects.resize(num_moves);
+  }
+
+  /* ----------------------------------------------------------- */
+
+  uint64_t screencapture_get_time_ns() {
+
+#if defined(__APPLE__)
+    static mach_timebase_info_data_t timebase = { 0, 0 };
+    if (0 == timebase.denom) {
+      mach_timebase_info(&timebase);
+    }
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+#elif defined(_WIN32)
+    LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (uint64_t)(now.QuadPart / freq.QuadPart) * 1000000000ull + (uint64_t)((now.QuadPart % freq.QuadPart) * 1000000000ll / freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+  }
+
+  /* ----------------------------------------------------------- */
+
+  /* The same mapping as `screencapture_rotate()`: rotate clockwise, then mirror the rotated frame. */
+  static void rotate_rect(int rotation, int w, int h, int& x, int& y, int& rw, int& rh) {
+
+    int turn = rotation & 3;
+    int nx = x;
+    int ny = y;
+    int nw = rw;
+    int nh = rh;
+    int rotated_w = (turn & 1) ? h : w;
+    int rotated_h = (turn & 1) ? w : h;
+
+    if (1 == turn) {
+      nx = h - (y + rh);
+      ny = x;
+      nw = rh;
+      nh = rw;
+    }
+    else if (2 == turn) {
+      nx = w - (x + rw);
+      ny = h - (y + rh);
+    }
+    else if (3 == turn) {
+      nx = y;
+      ny = w - (x + rw);
+      nw = rh;
+      nh = rw;
+    }
+
+    if (0 != (rotation & SC_FLIP_HORIZONTAL)) {
+      nx = rotated_w - (nx + nw);
+    }
+
+    if (0 != (rotation & SC_FLIP_VERTICAL)) {
+      ny = rotated_h - (ny + nh);
+    }
+
+    x = nx;
+    y = ny;
+    rw = nw;
+    rh = nh;
+  }
+
+  /* Grows the rectangle by `margin`, clips it and rounds the scaled edges outwards. */
+  static void scale_rect(int w, int h, int dst_w, int dst_h, int margin, DirtyRect& r) {
+
+    int x0 = std::max(0, r.x - margin);
+    int y0 = std::max(0, r.y - margin);
+    int x1 = std::min(w, r.x + r.width + margin);
+    int y1 = std::min(h, r.y + r.height + margin);
+
+    r.x = (int)(((int64_t)x0 * dst_w) / w);
+    r.y = (int)(((int64_t)y0 * dst_h) / h);
+    r.width = std::max(0, (int)(((int64_t)x1 * dst_w + w - 1) / w) - r.x);
+    r.height = std::max(0, (int)(((int64_t)y1 * dst_h + h - 1) / h) - r.y);
+  }
+
+  static void align_rect(int w, int h, DirtyRect& r) {
+
+    int x1 = std::min(w, (r.x + r.width + 1) & ~1);
+    int y1 = std::min(h, (r.y + r.height + 1) & ~1);
+
+    r.x &= ~1;
+    r.y &= ~1;
+    r.width = x1 - r.x;
+    r.height = y1 - r.y;
+  }
+
+  static DirtyRect get_destination(const MoveRect& m) {
+
+    DirtyRect r;
+    r.x = m.x;
+    r.y = m.y;
+    r.width = m.width;
+    r.height = m.height;
+
+    return r;
+  }
+
+  static bool rects_intersect(const DirtyRect& a, const DirtyRect& b) {
+    return a.x < b.x + b.width && b.x < a.x + a.width
+      && a.y < b.y + b.height && b.y < a.y + a.height;
+  }
+
+} /* namespace sc */
@@ -0,0 +1,532 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <screencapture/Kernels.h>
+
+#if defined(_WIN32)
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#endif
+
+#if defined(SC_ARCH_X86)
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#  else
+#    include <cpuid.h>
+#  endif
+#endif
+
+#if defined(SC_ARCH_ARM) && defined(__linux__)
+#  include <sys/auxv.h>
+#  if !defined(HWCAP_NEON)
+#    define HWCAP_NEON (1 << 12)
+#  endif
+#endif
+
+namespace sc {
+
+  /* The variants of the kernels, see src/kernels/. */
+  namespace kernels_c { void get_functions(KernelFunctions& fn); }
+#if defined(SC_ARCH_X86)
+  namespace kernels_sse2 { void get_functions(KernelFunctions& fn); }
+  namespace kernels_ssse3 { void get_functions(KernelFunctions& fn); }
+  namespace kernels_avx2 { void get_functions(KernelFunctions& fn); }
+#endif
+#if defined(SC_ARCH_ARM)
+  namespace kernels_neon { void get_functions(KernelFunctions& fn); }
+#endif
+
+  /* ----------------------------------------------------------- */
+
+  static int detect_cpu_features();
+  static int get_best_kernels(int features);
+  static int get_kernels_from_string(const char* name);
+  static void select_default_kernels();
+#if defined(_WIN32)
+  static BOOL CALLBACK select_default_kernels_once(PINIT_ONCE once, PVOID param, PVOID* context);
+#endif
+
+  /* ----------------------------------------------------------- */
+
+  static KernelFunctions kernels;                                /* The selected variant; all NULL until we select one. */
+  static int kernels_variant = SC_KERNELS_NONE;                  /* The selected SC_KERNELS_* variant. */
+  static int cpu_features = -1;                                  /* The SC_CPU_* features; -1 until detected. */
+  static int init_result = -1;                                   /* The result of `select_default_kernels()`. */
+#if defined(_WIN32)
+  static INIT_ONCE init_once = INIT_ONCE_STATIC_INIT;            /* Makes sure that only one thread selects the default kernels and that the others see the filled table. */
+#else
+  static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+#endif
+
+  /* ----------------------------------------------------------- */
+
+  /*
+    The coefficients follow from Kr and Kb of every standard (BT.601:
+    0.299, 0.114; BT.709: 0.2126, 0.0722; BT.2020: 0.2627, 0.0593). We
+    round them and, where necessary, move the value with the smallest
+    rounding error by one so the Y weights add up to 220 (video) or 256
+    (full) and the U and V weights to 0.
+  */
+  const YuvCoefficients yuv_bt601_video = {
+    66, 129, 25,                                                 /* Y */
+    -38, -74, 112,                                               /* U */
+    112, -94, -18,                                               /* V */
+    16,                                                          /* Y offset */
+    75, 102, 25, 52, 129                                         /* YUV > RGB */
+  };
+
+  const YuvCoefficients yuv_bt601_full = {
+    77, 150, 29,
+    -43, -85, 128,
+    128, -107, -21,
+    0,
+    64, 90, 22, 46, 113
+  };
+
+  const YuvCoefficients yuv_bt709_video = {
+    47, 157, 16,
+    -26, -86, 112,
+    112, -102, -10,
+    16,
+    75, 115, 14, 34, 135
+  };
+
+  const YuvCoefficients yuv_bt709_full = {
+    54, 183, 19,
+    -29, -99, 128,
+    128, -116, -12,
+    0,
+    64, 101, 12, 30, 119
+  };
+
+  const YuvCoefficients yuv_bt2020_video = {
+    58, 149, 13,
+    -31, -81, 112,
+    112, -103, -9,
+    16,
+    75, 107, 12, 42, 137
+  };
+
+  const YuvCoefficients yuv_bt2020_full = {
+    67, 174, 15,
+    -36, -92, 128,
+    128, -118, -10,
+    0,
+    64, 94, 11, 37, 120
+  };
+
+  /* Byte n expands into 8 bytes, 0xFF for every set bit, most significant bit first. */
+#define SC_MONO_BIT(n, b) (((n) & (b)) ? 0xFF : 0x00)
+#define SC_MONO_1(n) { SC_MONO_BIT(n, 0x80), SC_MONO_BIT(n, 0x40), SC_MONO_BIT(n, 0x20), SC_MONO_BIT(n, 0x10), SC_MONO_BIT(n, 0x08), SC_MONO_BIT(n, 0x04), SC_MONO_BIT(n, 0x02), SC_MONO_BIT(n, 0x01) }
+#define SC_MONO_4(n) SC_MONO_1(n), SC_MONO_1(n + 1), SC_MONO_1(n + 2), SC_MONO_1(n + 3)
+#define SC_MONO_16(n) SC_MONO_4(n), SC_MONO_4(n + 4), SC_MONO_4(n + 8), SC_MONO_4(n + 12)
+#define SC_MONO_64(n) SC_MONO_16(n), SC_MONO_16(n + 16), SC_MONO_16(n + 32), SC_MONO_16(n + 48)
+
+  const uint8_t mono_expand[256][8] = {
+    SC_MONO_64(0), SC_MONO_64(64), SC_MONO_64(128), SC_MONO_64(192)
+  };
+
+#undef SC_MONO_64
+#undef SC_MONO_16
+#undef SC_MONO_4
+#undef SC_MONO_1
+#undef SC_MONO_BIT
+
+  /* Generated once with a seeded random generator; any odd values work as long as every variant uses the same ones. */
+  const uint64_t hash_keys[16][2] = {
+    { 0x1C80317FA3B1799Dull, 0xBDD640FB06671AD1ull },
+    { 0x3EB13B9046685257ull, 0x23B8C1E9392456DFull },
+    { 0x1A3D1FA7BC8960A9ull, 0xBD9C66B3AD3C2D6Dull },
+    { 0x8B9D2434E465E151ull, 0x972A846916419F83ull },
+    { 0x0822E8F36C031199ull, 0x17FC695A07A0CA6Full },
+    { 0x3B8FAA1837F8A88Bull, 0x9A1DE644815EF6D1ull },
+    { 0x8FADC1A606CB0FB3ull, 0xB74D0FB132E70629ull },
+    { 0xB38A088CA65ED389ull, 0x6B65A6A48B8148F7ull },
+    { 0x72FF5D2A386ECBE1ull, 0x4737819096DA1DADull },
+    { 0xDE8A774BCF36D58Bull, 0xC241330B01A9E71Full },
+    { 0x28DF6EC4CE4A2BBDull, 0x6C307511B2B9437Bull },
+    { 0x47229389571AA877ull, 0x371ECD7B27CD8131ull },
+    { 0xC37459EEF50BEA63ull, 0x1A2A73ED562B0F79ull },
+    { 0x6142EA7D17BE3111ull, 0x5BE6128E18C26797ull },
+    { 0x580D7B71D8F56413ull, 0x43B7A3A69A8DCA03ull },
+    { 0x0B1F9163CE9FF57Full, 0x759CDE66BACFB3D1ull },
+  };
+
+  /* ----------------------------------------------------------- */
+
+
+  int screencapture_init_kernels() {
+
+#if defined(_WIN32)
+    InitOnceExecuteOnce(&init_once, select_default_kernels_once, NULL, NULL);
+#else
+    pthread_once(&init_once, select_default_kernels);
+#endif
+
+    return init_result;
+  }
+
+  /* Called once, see screencapture_init_kernels(); keeps the variant when one was selected explicitly before. */
+  static void select_default_kernels() {
+
+    if (SC_KERNELS_NONE != kernels_variant) {
+      init_result = 0;
+      return;
+    }
+
+    int variant = get_best_kernels(screencapture_get_cpu_features());
+    const char* env = getenv("SC_KERNELS");
+
+    if (NULL != env && '\0' != env[0]) {
+
+      int requested = get_kernels_from_string(env);
+
+      if (0 == screencapture_is_kernels_supported(requested)) {
+        variant = requested;
+      }
+      else {
+        printf("Warning: the kernels set with SC_KERNELS (%s) are not supported on this CPU; using %s.\n",
+               env, screencapture_kernels_to_string(variant).c_str());
+      }
+    }
+
+    init_result = screencapture_select_kernels(variant);
+  }
+
+#if defined(_WIN32)
+  static BOOL CALLBACK select_default_kernels_once(PINIT_ONCE /*once*/, PVOID /*param*/, PVOID* /*context*/) {
+    select_default_kernels();
+    return TRUE;
+  }
+#endif
+
+  int screencapture_select_kernels(int variant) {
+
+    if (0 != screencapture_is_kernels_supported(variant)) {
+      printf("Error: cannot select the %s kernels, not supported.\n", screencapture_kernels_to_string(variant).c_str());
+      return -1;
+    }
+
+    switch (variant) {
+      case SC_KERNELS_C:     { kernels_c::get_functions(kernels);     break; }
+#if defined(SC_ARCH_X86)
+      case SC_KERNELS_SSE2:  { kernels_sse2::get_functions(kernels);  break; }
+      case SC_KERNELS_SSSE3: { kernels_ssse3::get_functions(kernels); break; }
+      case SC_KERNELS_AVX2:  { kernels_avx2::get_functions(kernels);  break; }
+#endif
+#if defined(SC_ARCH_ARM)
+      case SC_KERNELS_NEON:  { kernels_neon::get_functions(kernels);  break; }
+#endif
+    }
+
+    kernels_variant = variant;
+
+    return 0;
+  }
+
+  int screencapture_get_kernels() {
+    return kernels_variant;
+  }
+
+  int screencapture_is_kernels_supported(int variant) {
+
+    int features = screencapture_get_cpu_features();
+
+    switch (variant) {
+      case SC_KERNELS_C: {
+        return 0;
+      }
+#if defined(SC_ARCH_X86)
+      case SC_KERNELS_SSE2: {
+        return (features & SC_CPU_SSE2) ? 0 : -1;
+      }
+      case SC_KERNELS_SSSE3: {
+        return (features & SC_CPU_SSSE3) ? 0 : -1;
+      }
+      case SC_KERNELS_AVX2: {
+        return (features & SC_CPU_AVX2) ? 0 : -1;
+      }
+#endif
+#if defined(SC_ARCH_ARM)
+      case SC_KERNELS_NEON: {
+        return (features & SC_CPU_NEON) ? 0 : -1;
+      }
+#endif
+    }
+
+    return -1;
+  }
+
+  int screencapture_get_cpu_features() {
+
+    if (-1 == cpu_features) {
+      cpu_features = detect_cpu_features();
+    }
+
+    return cpu_features;
+  }
+
+  std::string screencapture_kernels_to_string(int variant) {
+
+    switch (variant) {
+      case SC_KERNELS_C:     { return "c";       }
+      case SC_KERNELS_SSE2:  { return "sse2";    }
+      case SC_KERNELS_SSSE3: { return "ssse3";   }
+      case SC_KERNELS_AVX2:  { return "avx2";    }
+      case SC_KERNELS_NEON:  { return "neon";    }
+    }
+
+    return "unknown";
+  }
+
+  /* ----------------------------------------------------------- */
+
+  /*
+    The kernels call the selected variant. They select one themselves
+    when nobody called screencapture_init_kernels() yet. We always go
+    through the once guard so a thread never sees a partly filled
+    table; after the first call that's a single load and compare.
+  */
+  static inline const KernelFunctions& get_kernels() {
+    screencapture_init_kernels();
+    return kernels;
+  }
+
+  void kernel_bgra_to_i420_rows(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, int width, const YuvCoefficients& c) {
+    get_kernels().bgra_to_i420_rows(src0, src1, y0, y1, u, v, width, c);
+  }
+
+  void kernel_i420_to_bgra_row(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* dst, int width, const YuvCoefficients& c) {
+    get_kernels().i420_to_bgra_row(y, u, v, dst, width, c);
+  }
+
+  void kernel_nv12_to_bgra_row(const uint8_t* y, const uint8_t* uv, uint8_t* dst, int width, const YuvCoefficients& c) {
+    get_kernels().nv12_to_bgra_row(y, uv, dst, width, c);
+  }
+
+  void kernel_nv12_to_rgba_row(const uint8_t* y, const uint8_t* uv, uint8_t* dst, int width, const YuvCoefficients& c) {
+    get_kernels().nv12_to_rgba_row(y, uv, dst, width, c);
+  }
+
+  void kernel_split_uv_row(const uint8_t* uv, uint8_t* u, uint8_t* v, int width) {
+    get_kernels().split_uv_row(uv, u, v, width);
+  }
+
+  void kernel_merge_uv_row(const uint8_t* u, const uint8_t* v, uint8_t* uv, int width) {
+    get_kernels().merge_uv_row(u, v, uv, width);
+  }
+
+  void kernel_bgra_to_rgba_row(const uint8_t* src, uint8_t* dst, int width) {
+    get_kernels().bgra_to_rgba_row(src, dst, width);
+  }
+
+  void kernel_bgra_to_rgb24_row(const uint8_t* src, uint8_t* dst, int width) {
+    get_kernels().bgra_to_rgb24_row(src, dst, width);
+  }
+
+  void kernel_bgra_to_bgr24_row(const uint8_t* src, uint8_t* dst, int width) {
+    get_kernels().bgra_to_bgr24_row(src, dst, width);
+  }
+
+  void kernel_l10r_to_p010_rows(const uint8_t* src0, const uint8_t* src1, uint16_t* y0, uint16_t* y1, uint16_t* uv, int width, const YuvCoefficients& c) {
+    get_kernels().l10r_to_p010_rows(src0, src1, y0, y1, uv, width, c);
+  }
+
+  void kernel_l10r_to_rgb48_row(const uint8_t* src, uint16_t* dst, int width) {
+    get_kernels().l10r_to_rgb48_row(src, dst, width);
+  }
+
+  void kernel_l10r_to_bgra_row(const uint8_t* src, uint8_t* dst, int width, int d0, int d1) {
+    get_kernels().l10r_to_bgra_row(src, dst, width, d0, d1);
+  }
+
+  void kernel_scale_rows_v(const uint8_t* src0, const uint8_t* src1, uint8_t* dst, int nbytes, int frac) {
+    get_kernels().scale_rows_v(src0, src1, dst, nbytes, frac);
+  }
+
+  void kernel_scale_row_h(const uint8_t* src, uint8_t* dst, int width, int bpp, const int* offsets, const int16_t* fracs) {
+    get_kernels().scale_row_h(src, dst, width, bpp, offsets, fracs);
+  }
+
+  void kernel_box_2x2_row(const uint8_t* src0, const uint8_t* src1, uint8_t* dst, int width, int bpp) {
+    get_kernels().box_2x2_row(src0, src1, dst, width, bpp);
+  }
+
+  void kernel_box_sum_rows(const uint8_t* src, size_t stride, int nrows, uint16_t* sums, int nbytes) {
+    get_kernels().box_sum_rows(src, stride, nrows, sums, nbytes);
+  }
+
+  void kernel_box_reduce_row(const uint16_t* sums, uint8_t* dst, int width, int bpp, int factor) {
+    get_kernels().box_reduce_row(sums, dst, width, bpp, factor);
+  }
+
+  void kernel_filter_rows_v(const uint8_t* const* rows, const int16_t* weights, int taps, uint8_t* dst, int nbytes) {
+    get_kernels().filter_rows_v(rows, weights, taps, dst, nbytes);
+  }
+
+  void kernel_filter_row_h(const uint8_t* src, uint8_t* dst, int width, int bpp, const int* offsets, const int16_t* weights, int taps) {
+    get_kernels().filter_row_h(src, dst, width, bpp, offsets, weights, taps);
+  }
+
+  void kernel_transpose_block(const uint8_t* src, ptrdiff_t src_stride, uint8_t* dst, ptrdiff_t dst_stride, int width, int height, int bpp) {
+    get_kernels().transpose_block(src, src_stride, dst, dst_stride, width, height, bpp);
+  }
+
+  void kernel_reverse_row(const uint8_t* src, uint8_t* dst, int width, int bpp) {
+    get_kernels().reverse_row(src, dst, width, bpp);
+  }
+
+  void kernel_blend_bgra_row(const uint8_t* src, uint8_t* dst, int width) {
+    get_kernels().blend_bgra_row(src, dst, width);
+  }
+
+  void kernel_mask_bgra_row(const uint8_t* and_mask, const uint8_t* xor_mask, uint8_t* dst, int width) {
+    get_kernels().mask_bgra_row(and_mask, xor_mask, dst, width);
+  }
+
+  void kernel_mono_to_bgra_row(const uint8_t* and_bits, const uint8_t* xor_bits, uint8_t* dst, int width) {
+    get_kernels().mono_to_bgra_row(and_bits, xor_bits, dst, width);
+  }
+
+  void kernel_mono_to_masks_row(const uint8_t* and_bits, const uint8_t* xor_bits, uint8_t* and_mask, uint8_t* xor_mask, int width) {
+    get_kernels().mono_to_masks_row(and_bits, xor_bits, and_mask, xor_mask, width);
+  }
+
+  uint64_t kernel_hash_block(const uint8_t* src, size_t stride, int nbytes, int rows) {
+    return get_kernels().hash_block(src, stride, nbytes, rows);
+  }
+
+  void kernel_fill_row(uint8_t* dst, int width, int bpp, const uint8_t* value) {
+    get_kernels().fill_row(dst, width, bpp, value);
+  }
+
+  void kernel_box_slide_row(const uint8_t* add, const uint8_t* sub, uint16_t* sums, uint8_t* dst, int nbytes, int scale) {
+    get_kernels().box_slide_row(add, sub, sums, dst, nbytes, scale);
+  }
+
+  void kernel_blend_premul_bgra_row(const uint8_t* src, uint8_t* dst, int width) {
+    get_kernels().blend_premul_bgra_row(src, dst, width);
+  }
+
+  void kernel_blend_premul_row(const uint8_t* src, const uint8_t* alpha, uint8_t* dst, int nbytes) {
+    get_kernels().blend_premul_row(src, alpha, dst, nbytes);
+  }
+
+  void kernel_bgra_to_luma_row(const uint8_t* src, uint8_t* dst, int width, const YuvCoefficients& c) {
+    get_kernels().bgra_to_luma_row(src, dst, width, c);
+  }
+
+  void kernel_luma_stats_row(const uint8_t* src, int width, uint32_t* histogram, uint64_t* sums) {
+    get_kernels().luma_stats_row(src, width, histogram, sums);
+  }
+
+  /* ----------------------------------------------------------- */
+
+  static int detect_cpu_features() {
+
+    int features = 0;
+
+#if defined(SC_ARCH_X86)
+
+    unsigned int info[4] = { 0 };                                /* eax, ebx, ecx, edx */
+    unsigned int max_leaf = 0;
+
+#  if defined(_MSC_VER)
+    int regs[4];
+    __cpuid(regs, 0);
+    max_leaf = regs[0];
+    __cpuid(regs, 1);
+    memcpy(info, regs, sizeof(info));
+#  else
+    __cpuid(0, max_leaf, info[1], info[2], info[3]);
+    __cpuid(1, info[0], info[1], info[2], info[3]);
+#  endif
+
+    if (info[3] & (1u << 26)) {
+      features |= SC_CPU_SSE2;
+    }
+
+    if (info[2] & (1u << 9)) {
+      features |= SC_CPU_SSSE3;
+    }
+
+    /* AVX2 also needs the OS to save the YMM registers: OSXSAVE, AVX and XCR0 bits 1 and 2. */
+    bool has_avx = (info[2] & (1u << 27)) && (info[2] & (1u << 28));
+
+    if (true == has_avx && max_leaf >= 7) {
+
+      uint64_t xcr0 = 0;
+      unsigned int ebx7 = 0;
+
+#  if defined(_MSC_VER)
+      xcr0 = _xgetbv(0);
+      __cpuidex(regs, 7, 0);
+      ebx7 = regs[1];
+#  else
+      unsigned int lo = 0;
+      unsigned int hi = 0;
+      unsigned int eax7 = 0, ecx7 = 0, edx7 = 0;
+      __asm__ __volatile__ ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+      xcr0 = ((uint64_t)hi << 32) | lo;
+      __cpuid_count(7, 0, eax7, ebx7, ecx7, edx7);
+#  endif
+
+      if (6 == (xcr0 & 6) && (ebx7 & (1u << 5))) {
+        features |= SC_CPU_AVX2;
+      }
+    }
+
+#elif defined(SC_ARCH_ARM)
+
+#  if defined(__aarch64__) || defined(_M_ARM64)
+    /* NEON (ASIMD) is part of every ARMv8-A CPU. */
+    features |= SC_CPU_NEON;
+#  elif defined(__linux__)
+    if (getauxval(AT_HWCAP) & HWCAP_NEON) {
+      features |= SC_CPU_NEON;
+    }
+#  elif defined(__APPLE__) || defined(_M_ARM)
+    features |= SC_CPU_NEON;
+#  endif
+
+#endif
+
+    return features;
+  }
+
+  static int get_best_kernels(int features) {
+
+#if defined(SC_ARCH_X86)
+    if (features & SC_CPU_AVX2) {
+      return SC_KERNELS_AVX2;
+    }
+    if (features & SC_CPU_SSSE3) {
+      return SC_KERNELS_SSSE3;
+    }
+    if (features & SC_CPU_SSE2) {
+      return SC_KERNELS_SSE2;
+    }
+#elif defined(SC_ARCH_ARM)
+    if (features & SC_CPU_NEON) {
+      return SC_KERNELS_NEON;
+    }
+#endif
+
+    return SC_KERNELS_C;
+  }
+
+  static int get_kernels_from_string(const char* name) {
+
+    for (int i = SC_KERNELS_C; i <= SC_KERNELS_NEON; ++i) {
+      if (screencapture_kernels_to_string(i) == name) {
+        return i;
+      }
+    }
+
+    return SC_KERNELS_NONE;
+  }
+
+  /* ----------------------------------------------------------- */
+
+} /* namespace sc */
@@ -0,0 +1,477 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <screencapture/Mask.h>
+#include <screencapture/FrameInfo.h>
+#include <screencapture/Convert.h>
+#include <screencapture/Kernels.h>
+
+namespace sc {
+
+  /* ----------------------------------------------------------- */
+
+  static bool regions_equal(const std::vector<MaskRegion>& a, const std::vector<MaskRegion>& b);
+  static bool rects_intersect(const DirtyRect& a, const DirtyRect& b);
+  static DirtyRect get_region_rect(const MaskRegion& region, int w, int h);
+
+  /* ----------------------------------------------------------- */
+
+  MaskRegion::MaskRegion()
+    :x(0)
+    ,y(0)
+    ,width(0)
+    ,height(0)
+    ,mode(SC_MASK_FILL)
+    ,size(16)
+    ,red(0)
+    ,green(0)
+    ,blue(0)
+  {
+  }
+
+  /* ----------------------------------------------------------- */
+
+  PrivacyMask::PrivacyMask()
+    :has_pending(false)
+    ,regions_changed(false)
+  {
+#if defined(_WIN32)
+    InitializeCriticalSection(&mutex);
+#else
+    pthread_mutex_init(&mutex, NULL);
+#endif
+  }
+
+  PrivacyMask::~PrivacyMask() {
+#if defined(_WIN32)
+    DeleteCriticalSection(&mutex);
+#else
+    pthread_mutex_destroy(&mutex);
+#endif
+  }
+
+  int PrivacyMask::setRegions(const std::vector<MaskRegion>& list) {
+
+    for (size_t i = 0; i < list.size(); ++i) {
+
+      const MaskRegion& r = list[i];
+
+      if (0 > r.width || 0 > r.height) {
+        printf("Error: the size of mask region %lu is invalid: %d x %d.\n", i, r.width, r.height);
+        return -1;
+      }
+
+      if (SC_MASK_FILL != r.mode && SC_MASK_PIXELATE != r.mode && SC_MASK_BLUR != r.mode) {
+        printf("Error: the mode of mask region %lu is invalid: %d.\n", i, r.mode);
+        return -2;
+      }
+
+      if (SC_MASK_PIXELATE == r.mode && (1 > r.size || SC_MASK_MAX_BLOCK < r.size)) {
+        printf("Error: the block size of mask region %lu must be 1 - %d: %d.\n", i, SC_MASK_MAX_BLOCK, r.size);
+        return -3;
+      }
+
+      if (SC_MASK_BLUR == r.mode && (1 > r.size || SC_MASK_MAX_RADIUS < r.size)) {
+        printf("Error: the blur radius of mask region %lu must be 1 - %d: %d.\n", i, SC_MASK_MAX_RADIUS, r.size);
+        return -4;
+      }
+
+      if (0 > (r.red | r.green | r.blue) || 255 < std::max(r.red, std::max(r.green, r.blue))) {
+        printf("Error: the fill color of mask region %lu must be 0 - 255.\n", i);
+        return -5;
+      }
+    }
+
+    lock();
+    pending = list;
+    has_pending = true;
+    unlock();
+
+    return 0;
+  }
+
+  void PrivacyMask::clear() {
+    lock();
+    pending.clear();
+    has_pending = true;
+    unlock();
+  }
+
+  int PrivacyMask::update() {
+
+    prev_regions = regions;
+    regions_changed = false;
+
+    lock();
+
+    if (true == has_pending) {
+      regions.swap(pending);
+      has_pending = false;
+    }
+
+    unlock();
+
+    regions_changed = (false == regions_equal(prev_regions, regions));
+
+    return (0 == regions.size()) ? -1 : 0;
+  }
+
+  int PrivacyMask::apply(PixelBuffer& frame, int flags) {
+
+    int layout[3] = { 0 };
+    int num_planes = screencapture_get_plane_layout(frame.pixel_format, layout);
+    int w = (int)frame.width;
+    int h = (int)frame.height;
+
+    if (0 == regions.size()) {
+      return 0;
+    }
+
+    if (0 != canApply(frame.pixel_format)) {
+      printf("Error: cannot mask frames with the pixel format %s.\n", screencapture_pixelformat_to_string(frame.pixel_format).c_str());
+      return -1;
+    }
+
+    for (int i = 0; i < num_planes; ++i) {
+      if (NULL == frame.plane[i] || 0 == frame.stride[i]) {
+        printf("Error: cannot mask the frame, plane %d is not set.\n", i);
+        return -2;
+      }
+    }
+
+    for (size_t k = 0; k < regions.size(); ++k) {
+
+      const MaskRegion& region = regions[k];
+      uint8_t color[4] = { 0 };
+      int x0 = 0;
+      int y0 = 0;
+      int x1 = 0;
+      int y1 = 0;
+
+      if (0 != getRect(region, frame.pixel_format, w, h, x0, y0, x1, y1)) {
+        continue;
+      }
+
+      if (SC_MASK_FILL == region.mode && 0 != getFillColor(region, frame.pixel_format, flags, color)) {
+        return -3;
+      }
+
+      for (int i = 0; i < num_planes; ++i) {
+
+        /* The chroma planes of 4:2:0; the rect is even so this covers whole samples. The Y, U and V of the fill color are in plane order, NV12 takes U and V together. */
+        int sub = (0 == i) ? 1 : 2;
+        int px = x0 / sub;
+        int py = y0 / sub;
+        int pw = (x1 + sub - 1) / sub - px;
+        int ph = (y1 + sub - 1) / sub - py;
+        int size = std::max(1, region.size / sub);
+
+        switch (region.mode) {
+          case SC_MASK_FILL: {
+            fillPlane(frame.plane[i], frame.stride[i], px, py, pw, ph, layout[i], (1 == num_planes) ? color : color + i);
+            break;
+          }
+          case SC_MASK_PIXELATE: {
+            pixelatePlane(frame.plane[i], frame.stride[i], px, py, pw, ph, layout[i], size);
+            break;
+          }
+          case SC_MASK_BLUR: {
+            blurPlane(frame.plane[i], frame.stride[i], px, py, pw, ph, layout[i], size);
+            break;
+          }
+        }
+      }
+    }
+
+    return 0;
+  }
+
+  /*
+    Pixelated and blurred regions mix all pixels of a block or window,
+    so when anything inside such a region changed the whole region may
+    look different. A move that copies pixels from or into a region
+    doesn't copy the masked pixels, so it becomes a dirty rect.
+  */
+  void PrivacyMask::updateInfo(FrameInfo& info, int w, int h) {
+
+    size_t num_moves = 0;
+    bool has_dirty = (0 != (info.flags & SC_FRAME_HAS_DIRTY_RECTS));
+
+    for (size_t i = 0; i < info.move_rects.size(); ++i) {
+
+      MoveRect& m = info.move_rects[i];
+      DirtyRect src = { m.src_x, m.src_y, m.width, m.height };
+      DirtyRect dst = { m.x, m.y, m.width, m.height };
+      bool touches = false;
+
+      for (size_t k = 0; k < regions.size() && false == touches; ++k) {
+        DirtyRect r = get_region_rect(regions[k], w, h);
+        touches = (true == rects_intersect(src, r) || true == rects_intersect(dst, r));
+      }
+
+      if (false == touches) {
+        info.move_rects[num_moves++] = m;
+      }
+      else if (true == has_dirty) {
+        info.dirty_rects.push_back(dst);
+      }
+    }
+
+    info.move_rects.resize(num_moves);
+
+    if (false == has_dirty) {
+      return;
+    }
+
+    /* The old regions show the content again, the new ones hide it. */
+    if (true == regions_changed) {
+      for (size_t k = 0; k < prev_regions.size(); ++k) {
+        info.dirty_rects.push_back(get_region_rect(prev_regions[k], w, h));
+      }
+      for (size_t k = 0; k < regions.size(); ++k) {
+        info.dirty_rects.push_back(get_region_rect(regions[k], w, h));
+      }
+      return;
+    }
+
+    size_t num_dirty = info.dirty_rects.size();
+
+    for (size_t k = 0; k < regions.size(); ++k) {
+
+      if (SC_MASK_FILL == regions[k].mode) {
+        continue;
+      }
+
+      DirtyRect r = get_region_rect(regions[k], w, h);
+
+      for (size_t i = 0; i < num_dirty; ++i) {
+        if (true == rects_intersect(info.dirty_rects[i], r)) {
+          info.dirty_rects.push_back(r);
+          break;
+        }
+      }
+    }
+  }
+
+  int PrivacyMask::canApply(int fmt) {
+
+    switch (fmt) {
+      case SC_BGRA:
+      case SC_RGBA:
+      case SC_420V:
+      case SC_420F:
+      case SC_I420: {
+        return 0;
+      }
+    }
+
+    return -1;
+  }
+
+  void PrivacyMask::lock() {
+#if defined(_WIN32)
+    EnterCriticalSection(&mutex);
+#else
+    pthread_mutex_lock(&mutex);
+#endif
+  }
+
+  void PrivacyMask::unlock() {
+#if defined(_WIN32)
+    LeaveCriticalSection(&mutex);
+#else
+    pthread_mutex_unlock(&mutex);
+#endif
+  }
+
+  int PrivacyMask::getRect(const MaskRegion& region, int fmt, int w, int h, int& x0, int& y0, int& x1, int& y1) {
+
+    x0 = std::max(0, region.x);
+    y0 = std::max(0, region.y);
+    x1 = std::min(w, region.x + region.width);
+    y1 = std::min(h, region.y + region.height);
+
+    if (SC_BGRA != fmt && SC_RGBA != fmt) {
+      x0 &= ~1;
+      y0 &= ~1;
+      x1 = std::min(w, (x1 + 1) & ~1);
+      y1 = std::min(h, (y1 + 1) & ~1);
+    }
+
+    return (x1 > x0 && y1 > y0) ? 0 : -1;
+  }
+
+  /* For YCbCr we convert 2 x 2 pixels of the color with the conversions of the frame. */
+  int PrivacyMask::getFillColor(const MaskRegion& region, int fmt, int flags, uint8_t* value) {
+
+    if (SC_BGRA == fmt || SC_RGBA == fmt) {
+      value[0] = (uint8_t)((SC_BGRA == fmt) ? region.blue : region.red);
+      value[1] = (uint8_t)region.green;
+      value[2] = (uint8_t)((SC_BGRA == fmt) ? region.red : region.blue);
+      value[3] = 0xFF;
+      return 0;
+    }
+
+    if (SC_BGRA != color_bgra.pixel_format) {
+      if (0 != color_bgra.init(2, 2, SC_BGRA)) {
+        return -1;
+      }
+      color_bgra_mem.resize(color_bgra.getNumBytes());
+      color_bgra.setPlanes(&color_bgra_mem.front());
+    }
+
+    if (fmt != color_yuv.pixel_format) {
+      if (0 != color_yuv.init(2, 2, fmt)) {
+        return -2;
+      }
+      color_yuv_mem.resize(color_yuv.getNumBytes());
+      color_yuv.setPlanes(&color_yuv_mem.front());
+    }
+
+    for (int i = 0; i < 4; ++i) {
+      uint8_t* p = color_bgra.plane[0] + (i / 2) * color_bgra.stride[0] + (i % 2) * 4;
+      p[0] = (uint8_t)region.blue;
+      p[1] = (uint8_t)region.green;
+      p[2] = (uint8_t)region.red;
+      p[3] = 0xFF;
+    }
+
+    if (0 != screencapture_convert(color_bgra, color_yuv, flags)) {
+      printf("Error: failed to convert the fill color of a mask region.\n");
+      return -3;
+    }
+
+    value[0] = color_yuv.plane[0][0];
+    value[1] = color_yuv.plane[1][0];
+    value[2] = (SC_I420 == fmt) ? color_yuv.plane[2][0] : color_yuv.plane[1][1];
+
+    return 0;
+  }
+
+  void PrivacyMask::fillPlane(uint8_t* plane, size_t stride, int x, int y, int w, int h, int bpp, const uint8_t* value) {
+    for (int j = y; j < y + h; ++j) {
+      kernel_fill_row(plane + j * stride + x * bpp, w, bpp, value);
+    }
+  }
+
+  /* The blocks start at the top left of the region; the last row and column of blocks may be smaller. */
+  void PrivacyMask::pixelatePlane(uint8_t* plane, size_t stride, int x, int y, int w, int h, int bpp, int block) {
+
+    int nbytes = w * bpp;
+
+    sums.resize(nbytes);
+    row.resize(nbytes);
+
+    for (int by = 0; by < h; by += block) {
+
+      int bh = std::min(block, h - by);
+      uint8_t* src = plane + (y + by) * stride + x * bpp;
+
+      kernel_box_sum_rows(src, stride, bh, &sums.front(), nbytes);
+
+      for (int bx = 0; bx < w; bx += block) {
+
+        int bw = std::min(block, w - bx);
+        int n = bw * bh;
+        uint8_t mean[4] = { 0 };
+
+        for (int c = 0; c < bpp; ++c) {
+          uint32_t total = 0;
+          for (int k = 0; k < bw; ++k) {
+            total += sums[(bx + k) * bpp + c];
+          }
+          mean[c] = (uint8_t)((total + n / 2) / n);
+        }
+
+        kernel_fill_row(&row[bx * bpp], bw, bpp, mean);
+      }
+
+      for (int j = 0; j < bh; ++j) {
+        memcpy(src + j * stride, &row.front(), nbytes);
+      }
+    }
+  }
+
+  /* Blurs the rows, transposes so the columns become rows, blurs those and transposes back into the frame. */
+  void PrivacyMask::blurPlane(uint8_t* plane, size_t stride, int x, int y, int w, int h, int bpp, int radius) {
+
+    int nbytes = w * bpp;
+    int tbytes = h * bpp;
+    uint8_t* region = plane + y * stride + x * bpp;
+
+    tmp_a.resize((size_t)nbytes * h);
+    tmp_b.resize((size_t)nbytes * h);
+
+    blurRows(region, stride, &tmp_a.front(), nbytes, h, nbytes, radius);
+    kernel_transpose_block(&tmp_a.front(), nbytes, &tmp_b.front(), tbytes, w, h, bpp);
+    blurRows(&tmp_b.front(), tbytes, &tmp_a.front(), tbytes, w, tbytes, radius);
+    kernel_transpose_block(&tmp_a.front(), tbytes, region, stride, h, w, bpp);
+  }
+
+  void PrivacyMask::blurRows(const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride, int nrows, int nbytes, int radius) {
+
+    int window = 2 * radius + 1;
+    int scale = (65536 + window - 1) / window;
+    int num_below = std::min(radius, nrows - 1);
+    const uint8_t* first = src;
+    const uint8_t* last = src + (nrows - 1) * src_stride;
+
+    sums.resize(nbytes);
+
+    /* The window of the first row: the first row repeated above it and the rows below it. */
+    if (0 < num_below) {
+      kernel_box_sum_rows(src + src_stride, src_stride, num_below, &sums.front(), nbytes);
+    }
+    else {
+      std::fill(sums.begin(), sums.end(), 0);
+    }
+
+    for (int i = 0; i < nbytes; ++i) {
+      sums[i] = (uint16_t)(sums[i] + (radius + 1) * first[i] + (radius - num_below) * last[i]);
+    }
+
+    for (int j = 0; j < nrows; ++j) {
+      const uint8_t* add = src + std::min(j + radius + 1, nrows - 1) * src_stride;
+      const uint8_t* sub = src + std::max(j - radius, 0) * src_stride;
+      kernel_box_slide_row(add, sub, &sums.front(), dst + j * dst_stride, nbytes, scale);
+    }
+  }
+
+  /* ----------------------------------------------------------- */
+
+  static bool regions_equal(const std::vector<MaskRegion>& a, const std::vector<MaskRegion>& b) {
+
+    if (a.size() != b.size()) {
+      return false;
+    }
+
+    for (size_t i = 0; i < a.size(); ++i) {
+      if (a[i].x != b[i].x || a[i].y != b[i].y || a[i].width != b[i].width || a[i].height != b[i].height
+          || a[i].mode != b[i].mode || a[i].size != b[i].size
+          || a[i].red != b[i].red || a[i].green != b[i].green || a[i].blue != b[i].blue)
+        {
+          return false;
+        }
+    }
+
+    return true;
+  }
+
+  static bool rects_intersect(const DirtyRect& a, const DirtyRect& b) {
+    return a.x < b.x + b.width && b.x < a.x + a.width
+      && a.y < b.y + b.height && b.y < a.y + a.height;
+  }
+
+  /* The region clipped to the frame and grown to even coordinates, which covers the rect of every format. */
+  static DirtyRect get_region_rect(const MaskRegion& region, int w, int h) {
+
+    int x0 = std::max(0, region.x) & ~1;
+    int y0 = std::max(0, region.y) & ~1;
+    int x1 = std::min(w, (region.x + region.width + 1) & ~1);
+    int y1 = std::min(h, (region.y + region.height + 1) & ~1);
+    DirtyRect r = { x0, y0, std::max(0, x1 - x0), std::max(0, y1 - y0) };
+
+    return r;
+  }
+
+} /* namespace sc */
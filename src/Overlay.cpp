@@ -0,0 +1,642 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <screencapture/Overlay.h>
+#include <screencapture/Convert.h>
+#include <screencapture/Kernels.h>
+
+namespace sc {
+
+  /* ----------------------------------------------------------- */
+
+  static uint8_t premultiply(int v, int a);
+  static uint8_t unpremultiply(int v, int a);
+  static bool rects_intersect(const DirtyRect& a, const DirtyRect& b);
+  static DirtyRect get_overlay_rect(const OverlayImage* img);
+
+  /* ----------------------------------------------------------- */
+
+  OverlayImage::OverlayImage()
+    :id(0)
+    ,x(0)
+    ,y(0)
+    ,width(0)
+    ,height(0)
+    ,hash(0)
+    ,prepared_fmt(SC_NONE)
+    ,prepared_flags(0)
+    ,offset_x(0)
+    ,offset_y(0)
+    ,prepared_width(0)
+    ,prepared_height(0)
+  {
+  }
+
+  void OverlayImage::setPixels(int w, int h, size_t stride, const uint8_t* src, uint64_t src_hash) {
+
+    width = w;
+    height = h;
+    hash = src_hash;
+    prepared_fmt = SC_NONE;
+    pixels.resize(w * h * 4);
+
+    for (int j = 0; j < h; ++j) {
+      memcpy(&pixels[j * w * 4], src + j * stride, w * 4);
+    }
+  }
+
+  int OverlayImage::isPixels(int w, int h, size_t stride, const uint8_t* src) {
+
+    if (w != width || h != height) {
+      return -1;
+    }
+
+    for (int j = 0; j < h; ++j) {
+      if (0 != memcmp(&pixels[j * w * 4], src + j * stride, w * 4)) {
+        return -1;
+      }
+    }
+
+    return 0;
+  }
+
+  /* ----------------------------------------------------------- */
+
+  Overlays::Overlays()
+    :has_pending(false)
+  {
+#if defined(_WIN32)
+    InitializeCriticalSection(&mutex);
+#else
+    pthread_mutex_init(&mutex, NULL);
+#endif
+  }
+
+  Overlays::~Overlays() {
+
+    for (size_t i = 0; i < overlays.size(); ++i) {
+      delete overlays[i];
+    }
+
+    for (size_t i = 0; i < pending.size(); ++i) {
+      delete pending[i];
+    }
+
+    overlays.clear();
+    pending.clear();
+
+#if defined(_WIN32)
+    DeleteCriticalSection(&mutex);
+#else
+    pthread_mutex_destroy(&mutex);
+#endif
+  }
+
+  int Overlays::setOverlay(int id, int x, int y, int w, int h, size_t stride, const uint8_t* src) {
+
+    if (NULL == src) {
+      printf("Error: cannot set overlay %d, the pixels are NULL.\n", id);
+      return -1;
+    }
+
+    if (0 >= w || 0 >= h || stride < (size_t)w * 4) {
+      printf("Error: cannot set overlay %d, invalid size: %d x %d, stride: %lu.\n", id, w, h, stride);
+      return -2;
+    }
+
+    uint64_t src_hash = hashPixels(w, h, stride, src);
+
+    lock();
+
+    int dx = findPending(id);
+    OverlayImage* img = (-1 == dx) ? NULL : pending[dx];
+
+    if (NULL == img) {
+      img = new OverlayImage();
+      img->id = id;
+      pending.push_back(img);
+    }
+
+    if (src_hash != img->hash || 0 != img->isPixels(w, h, stride, src)) {
+      img->setPixels(w, h, stride, src, src_hash);
+      has_pending = true;
+    }
+
+    if (x != img->x || y != img->y) {
+      img->x = x;
+      img->y = y;
+      has_pending = true;
+    }
+
+    unlock();
+
+    return 0;
+  }
+
+  int Overlays::moveOverlay(int id, int x, int y) {
+
+    int r = 0;
+
+    lock();
+
+    int dx = findPending(id);
+
+    if (-1 == dx) {
+      r = -1;
+    }
+    else if (x != pending[dx]->x || y != pending[dx]->y) {
+      pending[dx]->x = x;
+      pending[dx]->y = y;
+      has_pending = true;
+    }
+
+    unlock();
+
+    if (0 != r) {
+      printf("Error: cannot move overlay %d, we don't have it.\n", id);
+    }
+
+    return r;
+  }
+
+  int Overlays::removeOverlay(int id) {
+
+    int r = 0;
+
+    lock();
+
+    int dx = findPending(id);
+
+    if (-1 == dx) {
+      r = -1;
+    }
+    else {
+      delete pending[dx];
+      pending.erase(pending.begin() + dx);
+      has_pending = true;
+    }
+
+    unlock();
+
+    if (0 != r) {
+      printf("Error: cannot remove overlay %d, we don't have it.\n", id);
+    }
+
+    return r;
+  }
+
+  void Overlays::clear() {
+
+    lock();
+
+    for (size_t i = 0; i < pending.size(); ++i) {
+      delete pending[i];
+    }
+
+    pending.clear();
+    has_pending = true;
+
+    unlock();
+  }
+
+  /*
+    Makes `overlays` match `pending`. We keep the images (and their
+    converted planes) whose pixels didn't change and only copy the
+    pixels of new or changed ones.
+  */
+  int Overlays::update() {
+
+    changed_rects.clear();
+
+    lock();
+
+    if (true == has_pending) {
+
+      std::vector<OverlayImage*> result;
+
+      for (size_t i = 0; i < pending.size(); ++i) {
+
+        OverlayImage* src = pending[i];
+        OverlayImage* img = NULL;
+
+        for (size_t k = 0; k < overlays.size(); ++k) {
+          if (NULL != overlays[k] && overlays[k]->id == src->id) {
+            img = overlays[k];
+            overlays[k] = NULL;
+            break;
+          }
+        }
+
+        bool same_pixels = (NULL != img && src->hash == img->hash && src->pixels == img->pixels);
+
+        if (NULL == img) {
+          img = new OverlayImage();
+          img->id = src->id;
+        }
+        else if (true == same_pixels && src->x == img->x && src->y == img->y) {
+          result.push_back(img);
+          continue;
+        }
+        else {
+          addChangedRect(img);
+        }
+
+        if (false == same_pixels) {
+          img->setPixels(src->width, src->height, src->width * 4, &src->pixels.front(), src->hash);
+        }
+
+        img->x = src->x;
+        img->y = src->y;
+        addChangedRect(img);
+        result.push_back(img);
+      }
+
+      /* The overlays that were removed. */
+      for (size_t k = 0; k < overlays.size(); ++k) {
+        if (NULL != overlays[k]) {
+          addChangedRect(overlays[k]);
+          delete overlays[k];
+        }
+      }
+
+      overlays.swap(result);
+      has_pending = false;
+    }
+
+    unlock();
+
+    return (0 == overlays.size()) ? -1 : 0;
+  }
+
+  int Overlays::apply(PixelBuffer& frame, int flags) {
+
+    int layout[3] = { 0 };
+    int num_planes = screencapture_get_plane_layout(frame.pixel_format, layout);
+    int w = (int)frame.width;
+    int h = (int)frame.height;
+
+    if (0 == overlays.size()) {
+      return 0;
+    }
+
+    if (0 != canApply(frame.pixel_format)) {
+      printf("Error: cannot draw overlays into frames with the pixel format %s.\n", screencapture_pixelformat_to_string(frame.pixel_format).c_str());
+      return -1;
+    }
+
+    for (int i = 0; i < num_planes; ++i) {
+      if (NULL == frame.plane[i] || 0 == frame.stride[i]) {
+        printf("Error: cannot draw overlays, plane %d is not set.\n", i);
+        return -2;
+      }
+    }
+
+    for (size_t k = 0; k < overlays.size(); ++k) {
+
+      OverlayImage* img = overlays[k];
+
+      /* BGRA frames use the pixels as they are. */
+      if (SC_BGRA == frame.pixel_format) {
+
+        int x0 = std::max(0, img->x);
+        int y0 = std::max(0, img->y);
+        int x1 = std::min(w, img->x + img->width);
+        int y1 = std::min(h, img->y + img->height);
+
+        for (int j = y0; j < y1 && x0 < x1; ++j) {
+          const uint8_t* src = &img->pixels.front() + ((j - img->y) * img->width + (x0 - img->x)) * 4;
+          kernel_blend_premul_bgra_row(src, frame.plane[0] + j * frame.stride[0] + x0 * 4, x1 - x0);
+        }
+
+        continue;
+      }
+
+      if (img->prepared_fmt != frame.pixel_format
+          || img->prepared_flags != flags
+          || (SC_RGBA != frame.pixel_format && (img->offset_x != (img->x & 1) || img->offset_y != (img->y & 1))))
+        {
+          if (0 != prepare(img, frame.pixel_format, flags)) {
+            return -3;
+          }
+        }
+
+      /* The converted planes start at an even position for 4:2:0; that covers whole chroma samples. */
+      int left = img->x - img->offset_x;
+      int top = img->y - img->offset_y;
+      int x0 = std::max(0, left);
+      int y0 = std::max(0, top);
+      int x1 = std::min(w, left + img->prepared_width);
+      int y1 = std::min(h, top + img->prepared_height);
+
+      if (x0 >= x1 || y0 >= y1) {
+        continue;
+      }
+
+      for (int i = 0; i < num_planes; ++i) {
+
+        int sub = (0 == i) ? 1 : 2;
+        int bpp = layout[i];
+        int px = x0 / sub;
+        int py = y0 / sub;
+        int nbytes = ((x1 + sub - 1) / sub - px) * bpp;
+        int nrows = (y1 + sub - 1) / sub - py;
+        size_t src_stride = (img->prepared_width / sub) * bpp;
+        size_t src_offset = (py - top / sub) * src_stride + (px - left / sub) * bpp;
+
+        for (int j = 0; j < nrows; ++j) {
+
+          uint8_t* dst = frame.plane[i] + (py + j) * frame.stride[i] + px * bpp;
+          const uint8_t* src = &img->samples[i][src_offset + j * src_stride];
+
+          if (SC_RGBA == frame.pixel_format) {
+            kernel_blend_premul_bgra_row(src, dst, nbytes / 4);
+          }
+          else {
+            kernel_blend_premul_row(src, &img->alpha[i][src_offset + j * src_stride], dst, nbytes);
+          }
+        }
+      }
+    }
+
+    return 0;
+  }
+
+  /*
+    A move copies the pixels of the previous frame, overlays included,
+    so a move from or into an overlay (where it is now or where it was
+    before `update()`) becomes a dirty rect.
+  */
+  void Overlays::updateInfo(FrameInfo& info, int w, int h) {
+
+    size_t num_moves = 0;
+    bool has_dirty = (0 != (info.flags & SC_FRAME_HAS_DIRTY_RECTS));
+
+    for (size_t i = 0; i < info.move_rects.size(); ++i) {
+
+      MoveRect& m = info.move_rects[i];
+      DirtyRect src = { m.src_x, m.src_y, m.width, m.height };
+      DirtyRect dst = { m.x, m.y, m.width, m.height };
+      bool touches = false;
+
+      for (size_t k = 0; k < overlays.size() && false == touches; ++k) {
+        DirtyRect r = get_overlay_rect(overlays[k]);
+        touches = (true == rects_intersect(src, r) || true == rects_intersect(dst, r));
+      }
+
+      for (size_t k = 0; k < changed_rects.size() && false == touches; ++k) {
+        touches = (true == rects_intersect(src, changed_rects[k]) || true == rects_intersect(dst, changed_rects[k]));
+      }
+
+      if (false == touches) {
+        info.move_rects[num_moves++] = m;
+      }
+      else if (true == has_dirty) {
+        info.dirty_rects.push_back(dst);
+      }
+    }
+
+    info.move_rects.resize(num_moves);
+
+    if (false == has_dirty) {
+      return;
+    }
+
+    for (size_t k = 0; k < changed_rects.size(); ++k) {
+
+      const DirtyRect& c = changed_rects[k];
+      int x0 = std::max(0, c.x);
+      int y0 = std::max(0, c.y);
+      int x1 = std::min(w, c.x + c.width);
+      int y1 = std::min(h, c.y + c.height);
+
+      if (x0 < x1 && y0 < y1) {
+        DirtyRect r = { x0, y0, x1 - x0, y1 - y0 };
+        info.dirty_rects.push_back(r);
+      }
+    }
+  }
+
+  int Overlays::canApply(int fmt) {
+
+    switch (fmt) {
+      case SC_BGRA:
+      case SC_RGBA:
+      case SC_420V:
+      case SC_420F:
+      case SC_I420: {
+        return 0;
+      }
+    }
+
+    return -1;
+  }
+
+  uint64_t Overlays::hashPixels(int w, int h, size_t stride, const uint8_t* pixels) {
+    uint64_t size = ((uint64_t)(uint32_t)w << 32) | (uint32_t)h;
+    return kernel_hash_block(pixels, stride, w * 4, h) ^ (size * 0x9E3779B97F4A7C15ULL);
+  }
+
+  void Overlays::lock() {
+#if defined(_WIN32)
+    EnterCriticalSection(&mutex);
+#else
+    pthread_mutex_lock(&mutex);
+#endif
+  }
+
+  void Overlays::unlock() {
+#if defined(_WIN32)
+    LeaveCriticalSection(&mutex);
+#else
+    pthread_mutex_unlock(&mutex);
+#endif
+  }
+
+  int Overlays::findPending(int id) {
+
+    for (size_t i = 0; i < pending.size(); ++i) {
+      if (pending[i]->id == id) {
+        return (int)i;
+      }
+    }
+
+    return -1;
+  }
+
+  /*
+    RGBA only swaps the channels. For 4:2:0 we place the overlay at
+    `x` & 1, `y` & 1 of an even sized image, convert its straight
+    colors and premultiply Y with the alpha of the pixel. For the
+    chroma we convert a second image where every 2 x 2 block has the
+    alpha weighted mean of its colors and premultiply with the mean
+    alpha of the block; converting the straight colors would mix in
+    the (black) color of transparent pixels.
+  */
+  int Overlays::prepare(OverlayImage* img, int fmt, int flags) {
+
+    if (SC_RGBA == fmt) {
+      img->samples[0].resize(img->pixels.size());
+      kernel_bgra_to_rgba_row(&img->pixels.front(), &img->samples[0].front(), img->width * img->height);
+      img->offset_x = 0;
+      img->offset_y = 0;
+      img->prepared_width = img->width;
+      img->prepared_height = img->height;
+      img->prepared_fmt = fmt;
+      img->prepared_flags = flags;
+      return 0;
+    }
+
+    int ox = img->x & 1;
+    int oy = img->y & 1;
+    int pw = (ox + img->width + 1) & ~1;
+    int ph = (oy + img->height + 1) & ~1;
+    int cw = pw / 2;
+    int ch = ph / 2;
+
+    if (0 != bgra.init(pw, ph, SC_BGRA) || 0 != yuv.init(pw, ph, fmt)) {
+      printf("Error: failed to convert overlay %d.\n", img->id);
+      return -1;
+    }
+
+    bgra_mem.assign(bgra.getNumBytes(), 0);
+    yuv_mem.resize(yuv.getNumBytes());
+
+    if (0 != bgra.setPlanes(&bgra_mem.front()) || 0 != yuv.setPlanes(&yuv_mem.front())) {
+      return -2;
+    }
+
+    /* Luma: the straight colors, the padding stays transparent black. */
+    for (int j = 0; j < img->height; ++j) {
+
+      const uint8_t* src = &img->pixels[j * img->width * 4];
+      uint8_t* dst = bgra.plane[0] + (j + oy) * bgra.stride[0] + ox * 4;
+
+      for (int i = 0; i < img->width; ++i) {
+        int a = src[i * 4 + 3];
+        dst[i * 4 + 0] = unpremultiply(src[i * 4 + 0], a);
+        dst[i * 4 + 1] = unpremultiply(src[i * 4 + 1], a);
+        dst[i * 4 + 2] = unpremultiply(src[i * 4 + 2], a);
+        dst[i * 4 + 3] = (uint8_t)a;
+      }
+    }
+
+    if (0 != screencapture_convert(bgra, yuv, flags)) {
+      printf("Error: failed to convert overlay %d.\n", img->id);
+      return -3;
+    }
+
+    img->samples[0].resize(pw * ph);
+    img->alpha[0].resize(pw * ph);
+
+    for (int j = 0; j < ph; ++j) {
+      for (int i = 0; i < pw; ++i) {
+        int a = bgra.plane[0][j * bgra.stride[0] + i * 4 + 3];
+        img->samples[0][j * pw + i] = premultiply(yuv.plane[0][j * yuv.stride[0] + i], a);
+        img->alpha[0][j * pw + i] = (uint8_t)a;
+      }
+    }
+
+    /* Chroma: the alpha weighted mean color of every 2 x 2 block; we reuse the alpha of `bgra` below. */
+    std::vector<uint8_t> block_alpha(cw * ch);
+
+    for (int j = 0; j < ch; ++j) {
+      for (int i = 0; i < cw; ++i) {
+
+        uint8_t* p0 = bgra.plane[0] + (j * 2) * bgra.stride[0] + i * 8;
+        uint8_t* p1 = p0 + bgra.stride[0];
+        int sum_a = p0[3] + p0[7] + p1[3] + p1[7];
+        uint8_t color[4] = { 0, 0, 0, 0xFF };
+
+        for (int c = 0; c < 3; ++c) {
+          int sum = p0[c] * p0[3] + p0[c + 4] * p0[7] + p1[c] * p1[3] + p1[c + 4] * p1[7];
+          color[c] = (0 == sum_a) ? 0 : (uint8_t)std::min(255, (sum + sum_a / 2) / sum_a);
+        }
+
+        memcpy(p0, color, 4);
+        memcpy(p0 + 4, color, 4);
+        memcpy(p1, color, 4);
+        memcpy(p1 + 4, color, 4);
+
+        block_alpha[j * cw + i] = (uint8_t)((sum_a + 2) / 4);
+      }
+    }
+
+    if (0 != screencapture_convert(bgra, yuv, flags)) {
+      printf("Error: failed to convert overlay %d.\n", img->id);
+      return -4;
+    }
+
+    if (SC_I420 == fmt) {
+      for (int p = 1; p < 3; ++p) {
+        img->samples[p].resize(cw * ch);
+        img->alpha[p].resize(cw * ch);
+        for (int j = 0; j < ch; ++j) {
+          for (int i = 0; i < cw; ++i) {
+            int a = block_alpha[j * cw + i];
+            img->samples[p][j * cw + i] = premultiply(yuv.plane[p][j * yuv.stride[p] + i], a);
+            img->alpha[p][j * cw + i] = (uint8_t)a;
+          }
+        }
+      }
+    }
+    else {
+      img->samples[1].resize(cw * 2 * ch);
+      img->alpha[1].resize(cw * 2 * ch);
+      for (int j = 0; j < ch; ++j) {
+        for (int i = 0; i < cw * 2; ++i) {
+          int a = block_alpha[j * cw + i / 2];
+          img->samples[1][j * cw * 2 + i] = premultiply(yuv.plane[1][j * yuv.stride[1] + i], a);
+          img->alpha[1][j * cw * 2 + i] = (uint8_t)a;
+        }
+      }
+    }
+
+    img->offset_x = ox;
+    img->offset_y = oy;
+    img->prepared_width = pw;
+    img->prepared_height = ph;
+    img->prepared_fmt = fmt;
+    img->prepared_flags = flags;
+
+    return 0;
+  }
+
+  void Overlays::addChangedRect(const OverlayImage* img) {
+    changed_rects.push_back(get_overlay_rect(img));
+  }
+
+  /* ----------------------------------------------------------- */
+
+  /* v * a / 255, rounded like the blend kernels. */
+  static uint8_t premultiply(int v, int a) {
+    int t = v * a + 128;
+    return (uint8_t)((t + (t >> 8)) >> 8);
+  }
+
+  static uint8_t unpremultiply(int v, int a) {
+
+    if (0 == a) {
+      return 0;
+    }
+
+    return (uint8_t)std::min(255, (v * 255 + a / 2) / a);
+  }
+
+  static bool rects_intersect(const DirtyRect& a, const DirtyRect& b) {
+    return a.x < b.x + b.width && b.x < a.x + a.width
+      && a.y < b.y + b.height && b.y < a.y + a.height;
+  }
+
+  /* The overlay grown to even coordinates, which covers what we draw into 4:2:0 frames. */
+  static DirtyRect get_overlay_rect(const OverlayImage* img) {
+
+    int x0 = img->x & ~1;
+    int y0 = img->y & ~1;
+    int x1 = (img->x + img->width + 1) & ~1;
+    int y1 = (img->y + img->height + 1) & ~1;
+    DirtyRect r = { x0, y0, x1 - x0, y1 - y0 };
+
+    return r;
+  }
+
+} /* namespace sc */
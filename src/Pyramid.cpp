@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <algorithm>
+#include <screencapture/Pyramid.h>
+#include <screencapture/Kernels.h>
+#include <screencapture/Executor.h>
+
+namespace sc {
+
+  /* ----------------------------------------------------------- */
+
+  static int get_planes(int fmt, int* bpp);
+  static void pyramid_task(void* user, int thread, int first, int count);
+
+  /* ----------------------------------------------------------- */
+
+  struct PyramidJob {
+    Pyramid* pyramid;
+    PixelBuffer* base;
+  };
+
+  /* ----------------------------------------------------------- */
+
+  Pyramid::Pyramid()
+    :base_width(0)
+    ,base_height(0)
+    ,pixel_format(SC_NONE)
+    ,num_levels(0)
+    ,num_bands(0)
+  {
+  }
+
+  Pyramid::~Pyramid() {
+  }
+
+  int Pyramid::init(int w, int h, int fmt, int nlevels) {
+
+    int lw = 0;
+    int lh = 0;
+
+    num_levels = 0;
+
+    if (0 != screencapture_can_build_pyramid(fmt)) {
+      printf("Error: cannot initialize the pyramid, unsupported pixel format: %s.\n", screencapture_pixelformat_to_string(fmt).c_str());
+      return -1;
+    }
+
+    if (1 > nlevels || SC_PYRAMID_MAX_LEVELS < nlevels) {
+      printf("Error: cannot initialize the pyramid, invalid number of levels: %d (1 - %d).\n", nlevels, SC_PYRAMID_MAX_LEVELS);
+      return -2;
+    }
+
+    if (0 != screencapture_get_pyramid_size(w, h, fmt, nlevels, lw, lh)) {
+      printf("Error: cannot initialize the pyramid, level %d of a %d x %d frame would be empty.\n", nlevels, w, h);
+      return -3;
+    }
+
+    for (int i = 0; i < nlevels; ++i) {
+
+      screencapture_get_pyramid_size(w, h, fmt, i + 1, lw, lh);
+
+      if (0 != levels[i].init(lw, lh, fmt)) {
+        printf("Error: cannot initialize the pyramid, failed to initialize level %d.\n", i + 1);
+        return -4;
+      }
+
+      pixels[i].resize(levels[i].getNumBytes());
+      levels[i].setPlanes(&pixels[i].front());
+      levels[i].level = i + 1;
+    }
+
+    /* A band has 2 rows of the smallest level, so the 4:2:0 chroma rows of every level are whole too. */
+    int band_rows = 2 << (nlevels - 1);
+
+    base_width = w;
+    base_height = h;
+    pixel_format = fmt;
+    num_levels = nlevels;
+    num_bands = ((int)levels[0].height + band_rows - 1) / band_rows;
+
+    return 0;
+  }
+
+  int Pyramid::isInitFor(int w, int h, int fmt, int nlevels) {
+
+    if (0 != isInit()
+        || w != base_width
+        || h != base_height
+        || fmt != pixel_format
+        || nlevels != num_levels)
+      {
+        return -1;
+      }
+
+    return 0;
+  }
+
+  int Pyramid::build(PixelBuffer& base, Executor* executor) {
+
+    int bpp[3] = { 0 };
+    int num_planes = get_planes(base.pixel_format, bpp);
+
+    if (0 != isInit()) {
+      printf("Error: cannot build the pyramid, it's not initialized.\n");
+      return -1;
+    }
+
+    if ((int)base.width != base_width
+        || (int)base.height != base_height
+        || base.pixel_format != pixel_format)
+      {
+        printf("Error: cannot build the pyramid, the base frame is %lu x %lu %s but we were initialized for %d x %d %s.\n",
+               base.width, base.height, screencapture_pixelformat_to_string(base.pixel_format).c_str(),
+               base_width, base_height, screencapture_pixelformat_to_string(pixel_format).c_str());
+        return -2;
+      }
+
+    for (int i = 0; i < num_planes; ++i) {
+      if (NULL == base.plane[i] || 0 == base.stride[i]) {
+        printf("Error: cannot build the pyramid, plane %d of the base frame is not set.\n", i);
+        return -3;
+      }
+    }
+
+    if (NULL == executor || 1 == executor->getNumThreads()) {
+      buildBands(base, 0, num_bands);
+      return 0;
+    }
+
+    PyramidJob job;
+    job.pyramid = this;
+    job.base = &base;
+
+    /* A band reads 2 << num_levels rows of the base frame; the smaller levels add less than that again. */
+    size_t band_bytes = (size_t)(2 << num_levels) * base.stride[0];
+    for (int i = 1; i < num_planes; ++i) {
+      band_bytes += (size_t)(1 << num_levels) * base.stride[i];
+    }
+
+    if (0 != executor->run(pyramid_task, &job, num_bands, screencapture_get_rows_per_slice(band_bytes, 1))) {
+      printf("Error: cannot build the pyramid, failed to run the slices.\n");
+      return -4;
+    }
+
+    return 0;
+  }
+
+  /*
+    Level k (1 is the first level below the base) has `2 << (num_levels - k)`
+    rows per band and reads twice as many rows of the level above it,
+    which the same band just wrote. The last band of a level can be
+    shorter; the rows of a level beyond twice the next level's height
+    are never read.
+  */
+  void Pyramid::buildBands(PixelBuffer& base, int first, int count) {
+
+    int bpp[3] = { 0 };
+    int num_planes = get_planes(pixel_format, bpp);
+
+    for (int band = first; band < first + count; ++band) {
+      for (int k = 0; k < num_levels; ++k) {
+
+        PixelBuffer& src = (0 == k) ? base : levels[k - 1];
+        PixelBuffer& dst = levels[k];
+        int band_rows = 2 << (num_levels - 1 - k);
+        int row0 = band * band_rows;
+        int row1 = std::min(row0 + band_rows, (int)dst.height);
+
+        if (row0 >= row1) {
+          break;
+        }
+
+        for (int i = 0; i < num_planes; ++i) {
+
+          /* The other planes are the 4:2:0 chroma planes; the levels have even sizes. */
+          int sub = (0 == i) ? 1 : 2;
+          int width = (int)dst.width / sub;
+          const uint8_t* src_plane = src.plane[i];
+          size_t src_stride = src.stride[i];
+
+          for (int j = row0 / sub; j < row1 / sub; ++j) {
+            const uint8_t* src_row = src_plane + 2 * j * src_stride;
+            kernel_box_2x2_row(src_row, src_row + src_stride, dst.plane[i] + j * dst.stride[i], width, bpp[i]);
+          }
+        }
+      }
+    }
+  }
+
+  /* ----------------------------------------------------------- */
+
+  int screencapture_can_build_pyramid(int fmt) {
+    int bpp[3] = { 0 };
+    return (0 == get_planes(fmt, bpp)) ? -1 : 0;
+  }
+
+  int screencapture_get_pyramid_size(int w, int h, int fmt, int level, int& level_width, int& level_height) {
+
+    int bpp[3] = { 0 };
+    int num_planes = get_planes(fmt, bpp);
+
+    if (0 == num_planes || 0 > level) {
+      return -1;
+    }
+
+    /* 4:2:0 levels have even sizes so every chroma sample covers 2 x 2 samples of the level. */
+    int mask = (1 < num_planes) ? ~1 : ~0;
+
+    for (int i = 0; i < level; ++i) {
+      w = (w / 2) & mask;
+      h = (h / 2) & mask;
+    }
+
+    if (0 >= w || 0 >= h) {
+      return -2;
+    }
+
+    level_width = w;
+    level_height = h;
+
+    return 0;
+  }
+
+  /* ----------------------------------------------------------- */
+
+  static void pyramid_task(void* user, int /*thread*/, int first, int count) {
+    PyramidJob* job = static_cast<PyramidJob*>(user);
+    job->pyramid->buildBands(*job->base, first, count);
+  }
+
+  /* Sets the bytes per sample of every plane; returns the number of planes, 0 for the formats that we can't average per byte. */
+  static int get_planes(int fmt, int* bpp) {
+
+    switch (fmt) {
+      case SC_BGRA:
+      case SC_RGBA:
+      case SC_RGB24:
+      case SC_BGR24:
+      case SC_420V:
+      case SC_420F:
+      case SC_I420: {
+        return screencapture_get_plane_layout(fmt, bpp);
+      }
+    }
+
+    return 0;
+  }
+
+} /* namespace sc */
@@ -0,0 +1,260 @@
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <algorithm>
+#include <screencapture/Rotate.h>
+#include <screencapture/Kernels.h>
+#include <screencapture/Executor.h>
+
+/* The number of rows and columns of the tiles that we transpose; a tile of 4 byte samples and its transposed copy (2 x 16 KB) fit in the L1 cache. */
+#define SC_ROTATE_TILE 64
+
+namespace sc {
+
+  /* ----------------------------------------------------------- */
+
+  static int get_planes(int fmt, int* bpp);
+  static int normalize_rotation(int rotation);
+  static void rotate_task(void* user, int thread, int first, int count);
+  static void rotate_rows(PixelBuffer& src, PixelBuffer& dst, int rotation, int first, int count);
+  static void rotate_plane(const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride, int width, int height, int bpp, int rotation, int first, int last);
+
+  /* ----------------------------------------------------------- */
+
+  struct RotateJob {
+    PixelBuffer* src;
+    PixelBuffer* dst;
+    int rotation;                                                /* Normalized, see normalize_rotation(). */
+  };
+
+  /* ----------------------------------------------------------- */
+
+  int screencapture_rotate(PixelBuffer& src, PixelBuffer& dst, int rotation, Executor* executor) {
+
+    int bpp[3] = { 0 };
+    int num_planes = get_planes(src.pixel_format, bpp);
+    int w = 0;
+    int h = 0;
+
+    if (0 == num_planes) {
+      printf("Error: cannot rotate, unsupported pixel format %s.\n", screencapture_pixelformat_to_string(src.pixel_format).c_str());
+      return -1;
+    }
+
+    if (src.pixel_format != dst.pixel_format) {
+      printf("Error: cannot rotate, the source and destination pixel formats are different.\n");
+      return -2;
+    }
+
+    if (0 != screencapture_get_rotated_size(rotation, (int)src.width, (int)src.height, w, h)) {
+      printf("Error: cannot rotate, invalid rotation: %d.\n", rotation);
+      return -3;
+    }
+
+    if (0 == src.width || 0 == src.height) {
+      printf("Error: cannot rotate, the source buffer has no size.\n");
+      return -4;
+    }
+
+    if ((size_t)w != dst.width || (size_t)h != dst.height) {
+      printf("Error: cannot rotate, the destination should be %d x %d but is %lu x %lu.\n", w, h, dst.width, dst.height);
+      return -5;
+    }
+
+    for (int i = 0; i < num_planes; ++i) {
+      if (NULL == src.plane[i] || 0 == src.stride[i] || NULL == dst.plane[i] || 0 == dst.stride[i]) {
+        printf("Error: cannot rotate, plane %d of the source or destination buffer is not set.\n", i);
+        return -6;
+      }
+      if (src.plane[i] == dst.plane[i]) {
+        printf("Error: cannot rotate in place.\n");
+        return -7;
+      }
+    }
+
+    rotation = normalize_rotation(rotation);
+
+    if (NULL == executor || 1 == executor->getNumThreads()) {
+      rotate_rows(src, dst, rotation, 0, h);
+      return 0;
+    }
+
+    RotateJob job;
+    job.src = &src;
+    job.dst = &dst;
+    job.rotation = rotation;
+
+    /* A transposed slice is one row of tiles; otherwise slices are sized like the conversions. */
+    int slice_rows = (rotation & 1) ? SC_ROTATE_TILE : screencapture_get_rows_per_slice(src.stride[0] + dst.stride[0], 2);
+
+    if (0 != executor->run(rotate_task, &job, h, slice_rows)) {
+      printf("Error: cannot rotate, failed to run the slices.\n");
+      return -8;
+    }
+
+    return 0;
+  }
+
+  int screencapture_can_rotate(int fmt) {
+    int bpp[3] = { 0 };
+    return (0 == get_planes(fmt, bpp)) ? -1 : 0;
+  }
+
+  int screencapture_get_rotated_size(int rotation, int width, int height, int& rotated_width, int& rotated_height) {
+
+    if (0 != (rotation & ~(3 | SC_FLIP_HORIZONTAL | SC_FLIP_VERTICAL))) {
+      return -1;
+    }
+
+    rotated_width = (rotation & 1) ? height : width;
+    rotated_height = (rotation & 1) ? width : height;
+
+    return 0;
+  }
+
+  /* ----------------------------------------------------------- */
+
+  static void rotate_task(void* user, int /*thread*/, int first, int count) {
+    RotateJob* job = static_cast<RotateJob*>(user);
+    rotate_rows(*job->src, *job->dst, job->rotation, first, count);
+  }
+
+  /* Rotates the destination rows [first, first + count); `first` is even so the 4:2:0 chroma rows line up. */
+  static void rotate_rows(PixelBuffer& src, PixelBuffer& dst, int rotation, int first, int count) {
+
+    int bpp[3] = { 0 };
+    int num_planes = get_planes(src.pixel_format, bpp);
+
+    for (int i = 0; i < num_planes; ++i) {
+
+      int w = (int)src.width;
+      int h = (int)src.height;
+      int dst_h = (int)dst.height;
+      int row0 = first;
+      int row1 = first + count;
+
+      /* The other planes are the 4:2:0 chroma planes. */
+      if (0 != i) {
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+        dst_h = (dst_h + 1) / 2;
+        row0 = first / 2;
+        row1 = std::min(dst_h, (row1 + 1) / 2);
+      }
+
+      rotate_plane(src.plane[i], src.stride[i], dst.plane[i], dst.stride[i], w, h, bpp[i], rotation, row0, row1);
+    }
+  }
+
+  /*
+    Writes the destination rows [first, last) of a plane. For 0 and 180
+    degrees every destination row is a (reversed) source row. For 90
+    and 270 degrees destination row j is a source column, which we
+    create by transposing tiles; the source rows and/or the columns
+    are walked backwards to rotate instead of only transposing:
+
+        90:               column j, rows bottom to top
+        270:              column (width - 1 - j), rows top to bottom
+        90 + mirrored:    column j, rows top to bottom (a transpose)
+        270 + mirrored:   column (width - 1 - j), rows bottom to top
+  */
+  static void rotate_plane(const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride, int width, int height, int bpp, int rotation, int first, int last) {
+
+    int turn = rotation & 3;
+    bool mirror = (0 != (rotation & SC_FLIP_HORIZONTAL));
+
+    if (0 == (turn & 1)) {
+
+      bool flip_rows = (2 == turn);
+      bool reverse = (2 == turn) != mirror;
+
+      for (int j = first; j < last; ++j) {
+
+        const uint8_t* s = src + (flip_rows ? (height - 1 - j) : j) * src_stride;
+        uint8_t* d = dst + j * dst_stride;
+
+        if (true == reverse) {
+          kernel_reverse_row(s, d, width, bpp);
+        }
+        else {
+          memcpy(d, s, width * bpp);
+        }
+      }
+
+      return;
+    }
+
+    bool reverse_columns = (3 == turn);
+    bool reverse_rows = (1 == turn) != mirror;
+    ptrdiff_t src_step = (true == reverse_rows) ? -(ptrdiff_t)src_stride : (ptrdiff_t)src_stride;
+    ptrdiff_t dst_step = (true == reverse_columns) ? -(ptrdiff_t)dst_stride : (ptrdiff_t)dst_stride;
+
+    /* The first source column that we read and the destination row it becomes. */
+    int column = (true == reverse_columns) ? (width - last) : first;
+    uint8_t* dst_row = dst + ((true == reverse_columns) ? (last - 1) : first) * dst_stride;
+    int num_columns = last - first;
+
+    for (int c = 0; c < num_columns; c += SC_ROTATE_TILE) {
+
+      int nc = std::min(SC_ROTATE_TILE, num_columns - c);
+
+      for (int k = 0; k < height; k += SC_ROTATE_TILE) {
+
+        int nr = std::min(SC_ROTATE_TILE, height - k);
+        const uint8_t* s = src + ((true == reverse_rows) ? (height - 1 - k) : k) * src_stride + (column + c) * bpp;
+        uint8_t* d = dst_row + c * dst_step + k * bpp;
+
+        kernel_transpose_block(s, src_step, d, dst_step, nc, nr, bpp);
+      }
+    }
+  }
+
+  /* Turns the flips into a rotation plus an optional horizontal mirror; mirroring vertically is rotating by 180 degrees and mirroring horizontally. */
+  static int normalize_rotation(int rotation) {
+
+    int turn = rotation & 3;
+    bool mirror = (0 != (rotation & SC_FLIP_HORIZONTAL));
+
+    if (0 != (rotation & SC_FLIP_VERTICAL)) {
+      turn = (turn + 2) & 3;
+      mirror = !mirror;
+    }
+
+    return turn | ((true == mirror) ? SC_FLIP_HORIZONTAL : 0);
+  }
+
+  /* Returns the number of planes of `fmt` and sets the bytes per sample of each plane, or returns 0 when we can't rotate `fmt`. */
+  static int get_planes(int fmt, int* bpp) {
+
+    switch (fmt) {
+      case SC_BGRA:
+      case SC_RGBA:
+      case SC_L10R: {
+        bpp[0] = 4;
+        return 1;
+      }
+      case SC_420V:
+      case SC_420F: {
+        bpp[0] = 1;
+        bpp[1] = 2;
+        return 2;
+      }
+      case SC_P010: {
+        bpp[0] = 2;
+        bpp[1] = 4;
+        return 2;
+      }
+      case SC_I420: {
+        bpp[0] = 1;
+        bpp[1] = 1;
+        bpp[2] = 1;
+        return 3;
+      }
+    }
+
+    return 0;
+  }
+
+  /* ----------------------------------------------------------- */
+
+} /* namespace sc */
@@ -0,0 +1,554 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <screencapture/Scaler.h>
+#include <screencapture/Kernels.h>
+#include <screencapture/Executor.h>
+
+namespace sc {
+
+  /* ----------------------------------------------------------- */
+
+  static int init_plane(ScalerPlane& plane, int srcw, int srch, int dstw, int dsth, int bpp);
+  static int get_box_factor(int srcw, int srch, int dstw, int dsth);
+  static void compute_coefficients(int src_size, int dst_size, int bpp, std::vector<int>& offsets, std::vector<int16_t>& fracs);
+  static void compute_filter(ScalerFilter& filter);
+  static double filter_kernel(int quality, double x);
+  static void scale_task(void* user, int thread, int first, int count);
+
+  /* ----------------------------------------------------------- */
+
+  struct ScaleJob {
+    Scaler* scaler;
+    PixelBuffer* src;
+    int plane;
+    uint8_t* dst;
+    size_t stride;
+  };
+
+  /* ----------------------------------------------------------- */
+
+  Scaler::Scaler()
+    :pixel_format(SC_NONE)
+    ,quality(SC_SCALE_BILINEAR)
+    ,num_planes(0)
+  {
+  }
+
+  Scaler::~Scaler() {
+
+    shutdown();
+
+    for (size_t i = 0; i < filters.size(); ++i) {
+      delete filters[i];
+    }
+
+    filters.clear();
+  }
+
+  int Scaler::init(int srcw, int srch, int dstw, int dsth, int fmt, int quality) {
+
+    if (0 >= srcw || 0 >= srch) {
+      printf("Error: cannot initialize the scaler, invalid source size: %d x %d.\n", srcw, srch);
+      return -1;
+    }
+
+    if (0 >= dstw || 0 >= dsth) {
+      printf("Error: cannot initialize the scaler, invalid destination size: %d x %d.\n", dstw, dsth);
+      return -2;
+    }
+
+    if (SC_SCALE_BILINEAR != quality
+        && SC_SCALE_BICUBIC != quality
+        && SC_SCALE_LANCZOS3 != quality)
+      {
+        printf("Error: cannot initialize the scaler, invalid quality: %d.\n", quality);
+        return -4;
+      }
+
+    shutdown();
+
+    int chroma_srcw = (srcw + 1) / 2;
+    int chroma_srch = (srch + 1) / 2;
+    int chroma_dstw = (dstw + 1) / 2;
+    int chroma_dsth = (dsth + 1) / 2;
+
+    switch (fmt) {
+      case SC_BGRA:
+      case SC_RGBA: {
+        num_planes = 1;
+        init_plane(planes[0], srcw, srch, dstw, dsth, 4);
+        break;
+      }
+      case SC_420V:
+      case SC_420F: {
+        num_planes = 2;
+        init_plane(planes[0], srcw, srch, dstw, dsth, 1);
+        init_plane(planes[1], chroma_srcw, chroma_srch, chroma_dstw, chroma_dsth, 2);
+        break;
+      }
+      case SC_I420: {
+        num_planes = 3;
+        init_plane(planes[0], srcw, srch, dstw, dsth, 1);
+        init_plane(planes[1], chroma_srcw, chroma_srch, chroma_dstw, chroma_dsth, 1);
+        init_plane(planes[2], chroma_srcw, chroma_srch, chroma_dstw, chroma_dsth, 1);
+        break;
+      }
+      default: {
+        printf("Error: cannot initialize the scaler, unsupported pixel format: %s.\n", screencapture_pixelformat_to_string(fmt).c_str());
+        return -3;
+      }
+    }
+
+    /* The temporary row has one extra sample so the horizontal pass can always read the right neighbour. */
+    size_t row_size = (planes[0].src_width + 1) * planes[0].bpp;
+    for (int i = 1; i < num_planes; ++i) {
+      row_size = std::max<size_t>(row_size, (planes[i].src_width + 1) * planes[i].bpp);
+    }
+
+    size_t sums_size = row_size;
+    size_t num_rows = 0;
+
+    if (SC_SCALE_BILINEAR != quality) {
+      for (int i = 0; i < num_planes; ++i) {
+
+        ScalerPlane& p = planes[i];
+        p.box_factor = 0;
+        p.x_filter = getFilter(p.src_width, p.dst_width, quality);
+        p.y_filter = getFilter(p.src_height, p.dst_height, quality);
+
+        /* The horizontal filter reads `num_taps` samples from its offset; the last (zero weighted) taps may be past the end of the row. */
+        row_size = std::max<size_t>(row_size, (p.src_width + p.x_filter->num_taps) * p.bpp);
+        num_rows = std::max<size_t>(num_rows, p.y_filter->num_taps);
+      }
+    }
+
+    /* Keep the number of threads that we had scratch memory for. */
+    size_t num_threads = std::max<size_t>(1, scratch.size());
+
+    scratch.resize(1);
+    scratch[0].row.assign(row_size, 0);
+    scratch[0].sums.assign(sums_size, 0);
+    scratch[0].rows.assign(num_rows, (const uint8_t*)NULL);
+    scratch.resize(num_threads, scratch[0]);
+
+    pixel_format = fmt;
+    this->quality = quality;
+
+    return 0;
+  }
+
+  int Scaler::shutdown() {
+
+    for (int i = 0; i < 3; ++i) {
+      planes[i].x_offset.clear();
+      planes[i].x_frac.clear();
+      planes[i].y_offset.clear();
+      planes[i].y_frac.clear();
+      planes[i].x_filter = NULL;
+      planes[i].y_filter = NULL;
+    }
+
+    scratch.clear();
+    pixel_format = SC_NONE;
+    quality = SC_SCALE_BILINEAR;
+    num_planes = 0;
+
+    return 0;
+  }
+
+  int Scaler::isInitFor(int srcw, int srch, int dstw, int dsth, int fmt, int quality) {
+
+    if (fmt != pixel_format
+        || quality != this->quality
+        || srcw != planes[0].src_width
+        || srch != planes[0].src_height
+        || dstw != planes[0].dst_width
+        || dsth != planes[0].dst_height)
+      {
+        return -1;
+      }
+
+    return 0;
+  }
+
+  int Scaler::scale(PixelBuffer& src, PixelBuffer& dst, Executor* executor) {
+
+    if (0 != isInit()) {
+      printf("Error: cannot scale, the scaler is not initialized.\n");
+      return -1;
+    }
+
+    if (0 != isInitFor(src.width, src.height, dst.width, dst.height, src.pixel_format, quality)
+        || dst.pixel_format != src.pixel_format)
+      {
+        printf("Error: cannot scale, the buffers don't match the sizes or pixel format that were passed into init().\n");
+        return -2;
+      }
+
+    for (int i = 0; i < num_planes; ++i) {
+      if (NULL == src.plane[i] || NULL == dst.plane[i]) {
+        printf("Error: cannot scale, plane %d of the source or destination is not set.\n", i);
+        return -3;
+      }
+    }
+
+    if (NULL == executor || 1 == executor->getNumThreads()) {
+      for (int i = 0; i < num_planes; ++i) {
+        scaleRows(src, i, 0, planes[i].dst_height, dst.plane[i], dst.stride[i]);
+      }
+      return 0;
+    }
+
+    setNumThreads(executor->getNumThreads());
+
+    for (int i = 0; i < num_planes; ++i) {
+
+      ScaleJob job;
+      job.scaler = this;
+      job.src = &src;
+      job.plane = i;
+      job.dst = dst.plane[i];
+      job.stride = dst.stride[i];
+
+      /* Slices are sized by the source rows that they read. */
+      size_t src_bytes = src.stride[i] * std::max(1, planes[i].src_height / planes[i].dst_height);
+      int slice_rows = screencapture_get_rows_per_slice(src_bytes, 1);
+
+      if (0 != executor->run(scale_task, &job, planes[i].dst_height, slice_rows)) {
+        printf("Error: failed to scale plane %d on the executor.\n", i);
+        return -4;
+      }
+    }
+
+    return 0;
+  }
+
+  int Scaler::scaleRows(PixelBuffer& src, int plane, int first, int count, uint8_t* dst, size_t stride, int thread) {
+
+    if (0 > plane || plane >= num_planes) {
+      printf("Error: cannot scale rows, invalid plane: %d.\n", plane);
+      return -1;
+    }
+
+    ScalerPlane& p = planes[plane];
+
+    if (0 > first || 0 > count || first + count > p.dst_height) {
+      printf("Error: cannot scale rows, the rows %d - %d are out of range.\n", first, first + count);
+      return -2;
+    }
+
+    if (0 > thread || thread >= (int)scratch.size()) {
+      printf("Error: cannot scale rows, invalid thread: %d, see setNumThreads().\n", thread);
+      return -3;
+    }
+
+    ScalerScratch& work = scratch[thread];
+    std::vector<const uint8_t*>& rows = work.rows;
+    std::vector<uint16_t>& sums = work.sums;
+    const uint8_t* src_plane = src.plane[plane];
+    size_t src_stride = src.stride[plane];
+    int row_bytes = p.src_width * p.bpp;
+    int end = first + count;
+    uint8_t* tmp = &work.row.front();
+
+    if (NULL != p.x_filter) {
+
+      ScalerFilter* fx = p.x_filter;
+      ScalerFilter* fy = p.y_filter;
+
+      for (int j = first; j < end; ++j) {
+        for (int k = 0; k < fy->num_taps; ++k) {
+          rows[k] = src_plane + std::min(fy->offset[j] + k, p.src_height - 1) * src_stride;
+        }
+        kernel_filter_rows_v(&rows.front(), &fy->weights[j * fy->num_taps], fy->num_taps, tmp, row_bytes);
+        kernel_filter_row_h(tmp, dst + (j - first) * stride, p.dst_width, p.bpp, &fx->offset.front(), &fx->weights.front(), fx->num_taps);
+      }
+
+      return 0;
+    }
+
+    if (2 == p.box_factor) {
+      for (int j = first; j < end; ++j) {
+        const uint8_t* src_row = src_plane + j * 2 * src_stride;
+        kernel_box_2x2_row(src_row, src_row + src_stride, dst + (j - first) * stride, p.dst_width, p.bpp);
+      }
+      return 0;
+    }
+
+    if (0 < p.box_factor) {
+      for (int j = first; j < end; ++j) {
+        kernel_box_sum_rows(src_plane + j * p.box_factor * src_stride, src_stride, p.box_factor, &sums.front(), row_bytes);
+        kernel_box_reduce_row(&sums.front(), dst + (j - first) * stride, p.dst_width, p.bpp, p.box_factor);
+      }
+      return 0;
+    }
+
+    int last_y = -1;
+    int last_frac = -1;
+
+    /* Rows without a vertical blend can be sampled directly when we never read past the end of the source row. */
+    bool can_sample_source = (p.x_offset[p.dst_width - 1] + p.bpp) < row_bytes;
+
+    for (int j = first; j < end; ++j) {
+
+      int y0 = p.y_offset[j];
+      int y1 = std::min(y0 + 1, p.src_height - 1);
+      uint8_t* dst_row = dst + (j - first) * stride;
+
+      if (0 == p.y_frac[j] && true == can_sample_source) {
+        kernel_scale_row_h(src_plane + y0 * src_stride, dst_row, p.dst_width, p.bpp, &p.x_offset.front(), &p.x_frac.front());
+        continue;
+      }
+
+      /* When upscaling, neighbouring rows often use the same vertical blend. */
+      if (y0 != last_y || p.y_frac[j] != last_frac) {
+        kernel_scale_rows_v(src_plane + y0 * src_stride, src_plane + y1 * src_stride, tmp, row_bytes, p.y_frac[j]);
+        memcpy(tmp + row_bytes, tmp + row_bytes - p.bpp, p.bpp);
+        last_y = y0;
+        last_frac = p.y_frac[j];
+      }
+
+      kernel_scale_row_h(tmp, dst_row, p.dst_width, p.bpp, &p.x_offset.front(), &p.x_frac.front());
+    }
+
+    return 0;
+  }
+
+  int Scaler::setNumThreads(int n) {
+
+    if (0 != isInit()) {
+      printf("Error: cannot set the number of threads, the scaler is not initialized.\n");
+      return -1;
+    }
+
+    if (0 >= n) {
+      printf("Error: cannot set the number of threads, invalid value: %d.\n", n);
+      return -2;
+    }
+
+    if ((size_t)n > scratch.size()) {
+      scratch.resize(n, scratch[0]);
+    }
+
+    return 0;
+  }
+
+  ScalerFilter* Scaler::getFilter(int src_size, int dst_size, int quality) {
+
+    for (size_t i = 0; i < filters.size(); ++i) {
+      if (filters[i]->src_size == src_size
+          && filters[i]->dst_size == dst_size
+          && filters[i]->quality == quality)
+        {
+          return filters[i];
+        }
+    }
+
+    ScalerFilter* filter = new ScalerFilter();
+    filter->src_size = src_size;
+    filter->dst_size = dst_size;
+    filter->quality = quality;
+
+    compute_filter(*filter);
+    filters.push_back(filter);
+
+    return filter;
+  }
+
+  /* ----------------------------------------------------------- */
+
+  int screencapture_get_fit_rect(int srcw, int srch, int dstw, int dsth, int even, int& x, int& y, int& w, int& h) {
+
+    if (0 >= srcw || 0 >= srch || 0 >= dstw || 0 >= dsth) {
+      printf("Error: cannot fit %d x %d into %d x %d, invalid size.\n", srcw, srch, dstw, dsth);
+      return -1;
+    }
+
+    w = dstw;
+    h = dsth;
+
+    if ((int64_t)srcw * dsth > (int64_t)srch * dstw) {
+      h = (int)(((int64_t)dstw * srch + srcw / 2) / srcw);
+    }
+    else {
+      w = (int)(((int64_t)dsth * srcw + srch / 2) / srch);
+    }
+
+    if (0 != even) {
+      w = (w < dstw) ? (w & ~1) : w;
+      h = (h < dsth) ? (h & ~1) : h;
+    }
+
+    w = std::max(std::min(w, dstw), (0 != even) ? std::min(2, dstw) : 1);
+    h = std::max(std::min(h, dsth), (0 != even) ? std::min(2, dsth) : 1);
+    x = (dstw - w) / 2;
+    y = (dsth - h) / 2;
+
+    if (0 != even) {
+      x &= ~1;
+      y &= ~1;
+    }
+
+    return 0;
+  }
+
+  /* ----------------------------------------------------------- */
+
+  static int init_plane(ScalerPlane& plane, int srcw, int srch, int dstw, int dsth, int bpp) {
+
+    plane.src_width = srcw;
+    plane.src_height = srch;
+    plane.dst_width = dstw;
+    plane.dst_height = dsth;
+    plane.bpp = bpp;
+    plane.x_filter = NULL;
+    plane.y_filter = NULL;
+    plane.box_factor = get_box_factor(srcw, srch, dstw, dsth);
+
+    if (0 < plane.box_factor) {
+      return 0;
+    }
+
+    compute_coefficients(srcw, dstw, bpp, plane.x_offset, plane.x_frac);
+    compute_coefficients(srch, dsth, 1, plane.y_offset, plane.y_frac);
+
+    return 0;
+  }
+
+  /* Returns 2, 3 or 4 when we downscale by exactly this factor in both directions, otherwise 0. */
+  static int get_box_factor(int srcw, int srch, int dstw, int dsth) {
+
+    for (int factor = 2; factor <= 4; ++factor) {
+      if (srcw == dstw * factor && srch == dsth * factor) {
+        return factor;
+      }
+    }
+
+    return 0;
+  }
+
+  /*
+    Maps the centers of the destination samples onto the source
+    (16.16 fixed point) and stores the left/top sample, multiplied by
+    `bpp`, and the weight of its right/bottom neighbour.
+  */
+  static void compute_coefficients(int src_size, int dst_size, int bpp, std::vector<int>& offsets, std::vector<int16_t>& fracs) {
+
+    offsets.resize(dst_size);
+    fracs.resize(dst_size);
+
+    for (int i = 0; i < dst_size; ++i) {
+
+      int64_t pos = ((((int64_t)(2 * i + 1) * src_size) << 16) / (2 * dst_size)) - 32768;
+      if (pos < 0) {
+        pos = 0;
+      }
+
+      int index = (int)(pos >> 16);
+      int frac = (int)((pos & 0xFFFF) >> 9);
+
+      if (index >= src_size - 1) {
+        index = src_size - 1;
+        frac = 0;
+      }
+
+      offsets[i] = index * bpp;
+      fracs[i] = (int16_t)frac;
+    }
+  }
+
+  /*
+    Computes the weights of a bicubic or Lanczos-3 filter. The sample
+    centers are aligned like in compute_coefficients(). When we
+    downscale, the filter is stretched by the scale factor. Source
+    samples outside the image are clamped to the edge, which means we
+    add their weights to the first or last sample of the window. The
+    weights are rounded to 14 bits; the rounding error is added to the
+    largest weight so they always add up to exactly 1 << 14.
+  */
+  static void compute_filter(ScalerFilter& filter) {
+
+    double scale = (double)filter.src_size / filter.dst_size;
+    double stretch = std::max(1.0, scale);
+    double radius = (SC_SCALE_BICUBIC == filter.quality) ? 2.0 : 3.0;
+    double support = radius * stretch;
+    int num_samples = std::min(filter.src_size, (int)ceil(2.0 * support));
+    std::vector<double> w(num_samples);
+
+    filter.num_taps = (num_samples + 3) & ~3;
+    filter.offset.resize(filter.dst_size);
+    filter.weights.assign(filter.dst_size * filter.num_taps, 0);
+
+    for (int i = 0; i < filter.dst_size; ++i) {
+
+      double center = (i + 0.5) * scale - 0.5;
+      int first = (int)floor(center - support) + 1;
+      int start = std::max(0, std::min(first, filter.src_size - num_samples));
+      double sum = 0.0;
+
+      std::fill(w.begin(), w.end(), 0.0);
+
+      for (int k = 0; k < num_samples; ++k) {
+        int index = std::max(0, std::min(first + k, filter.src_size - 1));
+        double v = filter_kernel(filter.quality, (first + k - center) / stretch);
+        w[index - start] += v;
+        sum += v;
+      }
+
+      int16_t* dst = &filter.weights[i * filter.num_taps];
+      int total = 0;
+      int largest = 0;
+
+      for (int k = 0; k < num_samples; ++k) {
+        dst[k] = (int16_t)floor((w[k] / sum) * 16384.0 + 0.5);
+        total += dst[k];
+        if (dst[k] > dst[largest]) {
+          largest = k;
+        }
+      }
+
+      dst[largest] += (int16_t)(16384 - total);
+      filter.offset[i] = start;
+    }
+  }
+
+  static double filter_kernel(int quality, double x) {
+
+    const double pi = 3.14159265358979323846;
+
+    x = fabs(x);
+
+    if (SC_SCALE_BICUBIC == quality) {
+      /* Keys' cubic with a = -0.5 (Catmull-Rom). */
+      if (x < 1.0) {
+        return (1.5 * x - 2.5) * x * x + 1.0;
+      }
+      if (x < 2.0) {
+        return ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;
+      }
+      return 0.0;
+    }
+
+    if (x < 1e-8) {
+      return 1.0;
+    }
+
+    if (x < 3.0) {
+      return (3.0 * sin(pi * x) * sin(pi * x / 3.0)) / (pi * pi * x * x);
+    }
+
+    return 0.0;
+  }
+
+  static void scale_task(void* user, int thread, int first, int count) {
+
+    ScaleJob* job = static_cast<ScaleJob*>(user);
+
+    job->scaler->scaleRows(*job->src, job->plane, first, count, job->dst + first * job->stride, job->stride, thread);
+  }
+
+  /* ----------------------------------------------------------- */
+
+} /* namespace sc */
@@ -1,10 +1,28 @@
 #include <stdlib.h>
+#include <string.h>
+#include <algorithm>
 #include <screencapture/ScreenCapture.h>
+#include <screencapture/Kernels.h>
+#include <screencapture/Rotate.h>
 
 namespace sc {
 
+  /* ----------------------------------------------------------- */
+
+  static void screencapture_on_frame(PixelBuffer& buffer);
+  static int screencapture_is_yuv(int fmt);
+  static int screencapture_copy_frame(PixelBuffer& src, PixelBuffer& dst, std::vector<uint8_t>& mem);
+  
+  /* ----------------------------------------------------------- */
+
   ScreenCapture::ScreenCapture(screencapture_callback callback, void* user, int driver)
     :impl(NULL)
+    ,callback(callback)
+    ,user(user)
+    ,capture_format(SC_NONE)
+    ,convert_flags(0)
+    ,black_format(SC_NONE)
+    ,rotation(SC_ROTATE_0)
   {
     
 #if defined(__APPLE__)
@@ -22,7 +40,13 @@ namespace sc {
       exit(EXIT_FAILURE);
     }
 
-    if (0 != impl->setCallback(callback, user)) {
+    if (NULL == callback) {
+      printf("Error: the given screencapture callback is NULL.\n");
+      exit(EXIT_FAILURE);
+    }
+
+    /* The driver passes its frames to us; see `processFrame()`. */
+    if (0 != impl->setCallback(screencapture_on_frame, this)) {
       printf("Error: failed to set the callback on the screencapture driver. Not supposed to happen..\n");
       exit(EXIT_FAILURE);
     }
@@ -50,6 +74,9 @@ namespace sc {
       return -2;
     }
 
+    /* Selects the kernels that we use to scale and convert frames, see Kernels.h. */
+    screencapture_init_kernels();
+
     impl->state |= SC_STATE_INIT;
 
     return 0;
@@ -82,21 +109,561 @@ namespace sc {
       return -5;
     }
 
-    if (NULL == impl->callback) {
+    if (SC_SCALE_BILINEAR != settings.scale_quality
+        && SC_SCALE_BICUBIC != settings.scale_quality
+        && SC_SCALE_LANCZOS3 != settings.scale_quality)
+      {
+        printf("Error: invalid scale quality set for ScreenCapture (%d).\n", settings.scale_quality);
+        return -10;
+      }
+
+    if (0 > settings.num_threads) {
+      printf("Error: invalid number of threads set for ScreenCapture (%d).\n", settings.num_threads);
+      return -11;
+    }
+
+    if (SC_COLOR_MATRIX_BT601 != settings.color_matrix
+        && SC_COLOR_MATRIX_BT709 != settings.color_matrix
+        && SC_COLOR_MATRIX_BT2020 != settings.color_matrix)
+      {
+        printf("Error: invalid color matrix set for ScreenCapture (%d).\n", settings.color_matrix);
+        return -13;
+      }
+
+    if (SC_COLOR_RANGE_AUTO != settings.color_range
+        && screencapture_get_color_range(settings.pixel_format, settings.color_range) != settings.color_range)
+      {
+        printf("Error: invalid color range set for ScreenCapture (%d); SC_420V is always video and SC_420F always full range.\n", settings.color_range);
+        return -14;
+      }
+
+    if (0 > settings.keepalive_ms) {
+      printf("Error: invalid keepalive set for ScreenCapture (%d).\n", settings.keepalive_ms);
+      return -16;
+    }
+
+    if (0 > settings.pyramid_levels || SC_PYRAMID_MAX_LEVELS < settings.pyramid_levels) {
+      printf("Error: invalid number of pyramid levels set for ScreenCapture (%d), at most %d.\n", settings.pyramid_levels, SC_PYRAMID_MAX_LEVELS);
+      return -17;
+    }
+
+    if (0 < settings.pyramid_levels && 0 != screencapture_can_build_pyramid(settings.pixel_format)) {
+      printf("Error: cannot build pyramid levels of frames in %s.\n", screencapture_pixelformat_to_string(settings.pixel_format).c_str());
+      return -18;
+    }
+
+    if (0 != settings.frame_stats && 0 != analyzer.canAnalyze(settings.pixel_format)) {
+      printf("Error: cannot compute the stats of frames in %s.\n", screencapture_pixelformat_to_string(settings.pixel_format).c_str());
+      return -19;
+    }
+
+    if (NULL == callback) {
       printf("Error: cannot configure screencapture, because the frame callback is NULL.\n");
       return -6;
     }
 
-    if (0 != impl->configure(settings)) {
+    if (0 != selectCaptureFormat(settings.pixel_format, settings.color_matrix, settings.color_range)) {
+      printf("Error: the pixel format %s is not supported by the driver and we cannot convert into it.\n", screencapture_pixelformat_to_string(settings.pixel_format).c_str());
+      return -8;
+    }
+
+    /* Frames of rotated displays are turned upright before we scale and convert them. */
+    std::vector<Display*> displays;
+    rotation = SC_ROTATE_0;
+
+    if (0 == impl->getDisplays(displays) && settings.display < (int)displays.size()) {
+      rotation = displays[settings.display]->rotation;
+    }
+
+    if (SC_ROTATE_0 != rotation && 0 != screencapture_can_rotate(capture_format)) {
+      printf("Error: the display is rotated but we cannot rotate frames in %s.\n", screencapture_pixelformat_to_string(capture_format).c_str());
+      return -15;
+    }
+
+    /* When we convert, the driver captures in `capture_format` and we convert into `output`. */
+    Settings driver_settings = settings;
+    driver_settings.pixel_format = capture_format;
+
+    if (capture_format != settings.pixel_format) {
+
+      if (0 != output.init(settings.output_width, settings.output_height, settings.pixel_format)) {
+        printf("Error: failed to initialize the buffer for the converted frames.\n");
+        return -9;
+      }
+
+      output_pixels.resize(output.getNumBytes());
+      output.setPlanes(&output_pixels.front());
+
+#if !defined(NDEBUG)
+      printf("Info: capturing in %s and converting into %s.\n",
+             screencapture_pixelformat_to_string(capture_format).c_str(),
+             screencapture_pixelformat_to_string(settings.pixel_format).c_str());
+#endif
+    }
+
+    if (0 != impl->configure(driver_settings)) {
       printf("Error: failed to setup the screencapture.\n");
       return -7;
     }
 
+    /* (Re)create the worker threads when the number of threads changed. */
+    if (0 == executor.isInit()) {
+      executor.shutdown();
+    }
+
+    if (1 != settings.num_threads && 0 != executor.init(settings.num_threads)) {
+      printf("Error: failed to create the threads that process the frames.\n");
+      return -12;
+    }
+
+    /* The matrix and range of the frames that we convert. */
+    convert_flags = screencapture_get_convert_flags(settings.pixel_format, settings.color_matrix, settings.color_range);
+    black_format = SC_NONE;
+
+    /* Also forgets the last frame; the next frame always reaches the callback. */
+    if (0 != static_filter.init(settings.keepalive_ms)) {
+      printf("Error: failed to initialize the static frame filter.\n");
+      return -20;
+    }
+
+    this->settings = settings;
+
     impl->state |= SC_STATE_CONFIGURED;
 
     return 0;
   }
 
+  /* 
+     Selects the pixel format that the driver captures in. When the 
+     driver supports `fmt` we use it directly; otherwise we use a format
+     which we can convert into `fmt` and prefer one of the same family
+     (RGB or YCbCr) because those conversions are cheapest. We only use
+     a YCbCr format of the driver when the driver can produce `matrix`,
+     and only repack it into another YCbCr format when the ranges match
+     because repacking doesn't touch the values.
+  */
+  int ScreenCapture::selectCaptureFormat(int fmt, int matrix, int range) {
+
+    std::vector<int> formats;
+
+    capture_format = SC_NONE;
+    
+    if (0 != impl->getPixelFormats(formats)) {
+      printf("Error: failed to retrieve the pixel formats of the driver.\n");
+      return -1;
+    }
+
+    bool has_matrix = (0 == impl->canUseColorMatrix(matrix));
+
+    if (std::find(formats.begin(), formats.end(), fmt) != formats.end()
+        && (0 == screencapture_is_yuv(fmt) || true == has_matrix))
+      {
+        capture_format = fmt;
+        return 0;
+      }
+
+    for (int pass = 0; pass < 2; ++pass) {
+      for (size_t i = 0; i < formats.size(); ++i) {
+        if (0 != screencapture_can_convert(formats[i], fmt)) {
+          continue;
+        }
+        if (1 == screencapture_is_yuv(formats[i])) {
+          if (false == has_matrix) {
+            continue;
+          }
+          if (1 == screencapture_is_yuv(fmt)
+              && screencapture_get_color_range(formats[i], SC_COLOR_RANGE_AUTO) != screencapture_get_color_range(fmt, range))
+            {
+              continue;
+            }
+        }
+        if (0 == pass && screencapture_is_yuv(formats[i]) != screencapture_is_yuv(fmt)) {
+          continue;
+        }
+        capture_format = formats[i];
+        return 0;
+      }
+    }
+
+    return -2;
+  }
+
+  void ScreenCapture::processFrame(PixelBuffer& captured) {
+
+    /* Once per frame, also for the frames we drop; see deliverFrame(). */
+    int has_regions = mask.update();
+    int has_overlays = overlays.update();
+
+    /* Before we rotate, scale or convert; that's the work we save. A changed mask or overlay must reach the callback, even when the desktop is static. */
+    if (0 != settings.drop_static_frames) {
+
+      if (true == mask.regions_changed || 0 != overlays.changed_rects.size()) {
+        static_filter.reset();
+      }
+
+      if (0 == static_filter.shouldDrop(captured, screencapture_get_time_ns() / 1000000ull)) {
+        return;
+      }
+    }
+
+    PixelBuffer* upright = rotateFrame(captured);
+    if (NULL == upright) {
+      return;
+    }
+
+    PixelBuffer& buffer = *upright;
+    bool needs_scale = ((int)buffer.width != settings.output_width || (int)buffer.height != settings.output_height);
+    FrameInfo* info = transformInfo(captured);
+    FrameAnalyzer* stats = (0 != settings.frame_stats) ? &analyzer : NULL;
+
+    analyzer.reset();
+
+    /* Scale and convert in one pass when we can; see Convert.h */
+    if (true == needs_scale
+        && capture_format != settings.pixel_format
+        && 0 == screencapture_can_scale_convert(buffer.pixel_format, settings.pixel_format))
+      {
+        PixelBuffer view;
+        if (0 != fitFrame(buffer, output, view)) {
+          return;
+        }
+
+        /* The bars aren't part of the view; the analyzer computes the stats of the whole frame in deliverFrame(). */
+        if (view.width != output.width || view.height != output.height) {
+          stats = NULL;
+        }
+
+        if (0 != screencapture_scale_convert(scaler, buffer, view, convert_flags, getExecutor(), stats)) {
+          printf("Error: failed to scale and convert the captured frame.\n");
+          return;
+        }
+
+        deliverFrame(output, info, has_regions, has_overlays);
+        return;
+      }
+
+    PixelBuffer* frame = scaleFrame(buffer);
+    if (NULL == frame) {
+      return;
+    }
+
+    if (capture_format == settings.pixel_format) {
+      deliverFrame(*frame, info, has_regions, has_overlays);
+      return;
+    }
+
+    if (0 != screencapture_convert(*frame, output, convert_flags, getExecutor(), stats)) {
+      printf("Error: failed to convert the captured frame.\n");
+      return;
+    }
+
+    deliverFrame(output, info, has_regions, has_overlays);
+  }
+
+  void ScreenCapture::deliverFrame(PixelBuffer& buffer, FrameInfo* info, int has_regions, int has_overlays) {
+
+    PixelBuffer* result = &buffer;
+
+    /* Before masking; the conversions compute the stats while they write the frame. */
+    if (0 != settings.frame_stats
+        && false == analyzer.has_stats
+        && 0 != analyzer.analyze(buffer, convert_flags, getExecutor()))
+      {
+        printf("Error: failed to compute the stats of the frame, we pass it without.\n");
+      }
+
+    /* The memory of the driver is read only. */
+    if ((0 == has_regions || 0 == has_overlays)
+        && &buffer != &output && &buffer != &scaled && &buffer != &rotated)
+      {
+        if (0 != screencapture_copy_frame(buffer, masked, masked_pixels)) {
+          return;
+        }
+        result = &masked;
+      }
+
+    if (0 == has_regions && 0 != mask.apply(*result, convert_flags)) {
+      printf("Error: failed to mask the frame, we drop it.\n");
+      return;
+    }
+
+    if (0 == has_overlays && 0 != overlays.apply(*result, convert_flags)) {
+      printf("Error: failed to draw the overlays, we drop the frame.\n");
+      return;
+    }
+
+    if (NULL != info
+        && (0 == has_regions || true == mask.regions_changed || 0 == has_overlays || 0 != overlays.changed_rects.size()))
+      {
+        if (info != &output_info) {
+          output_info = *info;
+          info = &output_info;
+        }
+        mask.updateInfo(output_info, (int)result->width, (int)result->height);
+        overlays.updateInfo(output_info, (int)result->width, (int)result->height);
+      }
+
+    if (true == analyzer.has_stats) {
+      if (NULL == info) {
+        output_info.reset();
+      }
+      else if (info != &output_info) {
+        output_info = *info;
+      }
+      info = &output_info;
+      output_info.stats = analyzer.stats;
+      output_info.flags |= SC_FRAME_HAS_STATS;
+    }
+
+    PixelBuffer frame = *result;
+    frame.user = user;
+    frame.info = info;
+    callback(frame);
+
+    if (0 < settings.pyramid_levels) {
+      deliverLevels(*result, info);
+    }
+  }
+
+  /* The levels are built from the masked frame with the overlays, after its callback so it isn't delayed. */
+  void ScreenCapture::deliverLevels(PixelBuffer& buffer, FrameInfo* info) {
+
+    int w = (int)buffer.width;
+    int h = (int)buffer.height;
+
+    if (0 != pyramid.isInitFor(w, h, buffer.pixel_format, settings.pyramid_levels)
+        && 0 != pyramid.init(w, h, buffer.pixel_format, settings.pyramid_levels))
+      {
+        printf("Error: failed to initialize the pyramid levels, we only pass the frame.\n");
+        return;
+      }
+
+    if (0 != pyramid.build(buffer, getExecutor())) {
+      printf("Error: failed to build the pyramid levels, we only pass the frame.\n");
+      return;
+    }
+
+    if (NULL != info) {
+      level_info = *info;
+    }
+
+    for (int i = 0; i < pyramid.num_levels; ++i) {
+
+      PixelBuffer frame = pyramid.levels[i];
+      frame.user = user;
+      frame.info = NULL;
+
+      /* A sample of a level covers 2 x 2 samples of the previous one; the margin covers the rounding of odd sizes. */
+      if (NULL != info) {
+        level_info.scale(w, h, (int)frame.width, (int)frame.height, 2);
+        if (1 == screencapture_is_yuv(frame.pixel_format)) {
+          level_info.alignEven((int)frame.width, (int)frame.height);
+        }
+        frame.info = &level_info;
+        w = (int)frame.width;
+        h = (int)frame.height;
+      }
+
+      callback(frame);
+    }
+  }
+
+  /*
+    The rectangles and cursor of the driver are in the pixels of the
+    captured frame; we map them into the frame that we pass into the
+    callback. When we don't rotate, scale or convert into 4:2:0 that's
+    the same frame and we pass the info of the driver.
+  */
+  FrameInfo* ScreenCapture::transformInfo(PixelBuffer& captured) {
+
+    if (NULL == captured.info) {
+      return NULL;
+    }
+
+    int w = (int)captured.width;
+    int h = (int)captured.height;
+    bool to_yuv = (capture_format != settings.pixel_format && 1 == screencapture_is_yuv(settings.pixel_format));
+
+    if (SC_ROTATE_0 != rotation && 0 != screencapture_get_rotated_size(rotation, (int)captured.width, (int)captured.height, w, h)) {
+      return NULL;
+    }
+
+    if (SC_ROTATE_0 == rotation
+        && false == to_yuv
+        && w == settings.output_width
+        && h == settings.output_height)
+      {
+        return captured.info;
+      }
+
+    output_info = *captured.info;
+    output_info.rotate(rotation, (int)captured.width, (int)captured.height);
+
+    /* Lanczos3 reads 3 output pixels to each side, that's more source pixels when we downscale. */
+    int ratio_x = (w + settings.output_width - 1) / settings.output_width;
+    int ratio_y = (h + settings.output_height - 1) / settings.output_height;
+    output_info.fit(w, h, settings.output_width, settings.output_height, 1, 3 * std::max(1, std::max(ratio_x, ratio_y)));
+
+    if (true == to_yuv) {
+      output_info.alignEven(settings.output_width, settings.output_height);
+    }
+
+    return &output_info;
+  }
+
+  PixelBuffer* ScreenCapture::rotateFrame(PixelBuffer& buffer) {
+
+    int w = 0;
+    int h = 0;
+
+    if (SC_ROTATE_0 == rotation) {
+      return &buffer;
+    }
+
+    if (0 != screencapture_get_rotated_size(rotation, (int)buffer.width, (int)buffer.height, w, h)) {
+      return NULL;
+    }
+
+    if ((int)rotated.width != w
+        || (int)rotated.height != h
+        || rotated.pixel_format != buffer.pixel_format)
+      {
+        if (0 != rotated.init(w, h, buffer.pixel_format)) {
+          printf("Error: failed to initialize the buffer for the rotated frames.\n");
+          return NULL;
+        }
+
+        rotated_pixels.resize(rotated.getNumBytes());
+        rotated.setPlanes(&rotated_pixels.front());
+      }
+
+    if (0 != screencapture_rotate(buffer, rotated, rotation, getExecutor())) {
+      printf("Error: failed to rotate the captured frame.\n");
+      return NULL;
+    }
+
+    return &rotated;
+  }
+
+  PixelBuffer* ScreenCapture::scaleFrame(PixelBuffer& buffer) {
+
+    int w = settings.output_width;
+    int h = settings.output_height;
+
+    if ((int)buffer.width == w && (int)buffer.height == h) {
+      return &buffer;
+    }
+
+    if ((int)scaled.width != w
+        || (int)scaled.height != h
+        || scaled.pixel_format != buffer.pixel_format)
+      {
+        if (0 != scaled.init(w, h, buffer.pixel_format)) {
+          printf("Error: failed to initialize the buffer for the scaled frames.\n");
+          return NULL;
+        }
+
+        scaled_pixels.resize(scaled.getNumBytes());
+        scaled.setPlanes(&scaled_pixels.front());
+      }
+
+    PixelBuffer view;
+    if (0 != fitFrame(buffer, scaled, view)) {
+      return NULL;
+    }
+
+    if (0 != scaler.scale(buffer, view, getExecutor())) {
+      printf("Error: failed to scale the captured frame.\n");
+      return NULL;
+    }
+
+    return &scaled;
+  }
+
+  /* (Re)creates the scaler when the size of the captured frames or the quality changes; the scaler caches its filters. */
+  int ScreenCapture::initScaler(PixelBuffer& buffer, int w, int h) {
+
+    if (0 == scaler.isInitFor(buffer.width, buffer.height, w, h, buffer.pixel_format, settings.scale_quality)) {
+      return 0;
+    }
+
+    if (0 != scaler.init(buffer.width, buffer.height, w, h, buffer.pixel_format, settings.scale_quality)) {
+      printf("Error: failed to initialize the scaler for the captured frames.\n");
+      return -1;
+    }
+
+    return 0;
+  }
+
+  /*
+    Like the renderer of the GPU drivers we letterbox the frames: we
+    scale into the largest centered rect with the aspect ratio of the
+    captured frame and the bars around it are black. The mask and
+    overlays draw into `frame`, so we clear the bars of every frame.
+  */
+  int ScreenCapture::fitFrame(PixelBuffer& buffer, PixelBuffer& frame, PixelBuffer& view) {
+
+    int x = 0;
+    int y = 0;
+    int w = 0;
+    int h = 0;
+
+    if (0 != screencapture_get_fit_rect((int)buffer.width, (int)buffer.height, (int)frame.width, (int)frame.height, 1, x, y, w, h)) {
+      printf("Error: failed to fit the captured frame into the output size.\n");
+      return -1;
+    }
+
+    if (0 != frame.getView(x, y, w, h, view)) {
+      return -2;
+    }
+
+    if (0 != initScaler(buffer, w, h)) {
+      return -3;
+    }
+
+    if (w == (int)frame.width && h == (int)frame.height) {
+      return 0;
+    }
+
+    if (frame.pixel_format != black_format) {
+      if (0 != screencapture_get_black(frame.pixel_format, convert_flags, black)) {
+        printf("Error: failed to get the black of the bars around the scaled frame.\n");
+        return -4;
+      }
+      black_format = frame.pixel_format;
+    }
+
+    int layout[3] = { 0 };
+    int num_planes = screencapture_get_plane_layout(frame.pixel_format, layout);
+
+    for (int i = 0; i < num_planes; ++i) {
+
+      /* The other planes are the 4:2:0 chroma planes; the rect is even. */
+      int sub = (0 == i) ? 1 : 2;
+      int plane_w = ((int)frame.width + sub - 1) / sub;
+      int plane_h = ((int)frame.height + sub - 1) / sub;
+      int x0 = x / sub;
+      int x1 = (x + w + sub - 1) / sub;
+      int y0 = y / sub;
+      int y1 = (y + h + sub - 1) / sub;
+
+      for (int j = 0; j < plane_h; ++j) {
+
+        uint8_t* row = frame.plane[i] + j * frame.stride[i];
+
+        if (j < y0 || j >= y1) {
+          kernel_fill_row(row, plane_w, layout[i], black[i]);
+          continue;
+        }
+
+        kernel_fill_row(row, x0, layout[i], black[i]);
+        kernel_fill_row(row + x1 * layout[i], plane_w - x1, layout[i], black[i]);
+      }
+    }
+
+    return 0;
+  }
+
   int ScreenCapture::listDisplays() {
 
     if (0 != isInit()) {
@@ -159,6 +726,45 @@ namespace sc {
     return -3;
   }
 
+  int ScreenCapture::setMaskRegions(const std::vector<MaskRegion>& regions) {
+
+    if (0 != regions.size()
+        && NULL != impl
+        && 0 == isConfigured()
+        && 0 != mask.canApply(settings.pixel_format))
+      {
+        printf("Error: cannot mask frames with the pixel format %s.\n", screencapture_pixelformat_to_string(settings.pixel_format).c_str());
+        return -1;
+      }
+
+    if (0 != mask.setRegions(regions)) {
+      return -2;
+    }
+
+    return 0;
+  }
+
+  int ScreenCapture::setOverlay(int id, int x, int y, int w, int h, size_t stride, const uint8_t* pixels) {
+
+    if (NULL != impl
+        && 0 == isConfigured()
+        && 0 != overlays.canApply(settings.pixel_format))
+      {
+        printf("Error: cannot draw overlays into frames with the pixel format %s.\n", screencapture_pixelformat_to_string(settings.pixel_format).c_str());
+        return -1;
+      }
+
+    if (0 != overlays.setOverlay(id, x, y, w, h, stride, pixels)) {
+      return -2;
+    }
+
+    return 0;
+  }
+
+  int ScreenCapture::removeOverlay(int id) {
+    return overlays.removeOverlay(id);
+  }
+
   int ScreenCapture::shutdown() {
 
     int r = 0;
@@ -181,6 +787,10 @@ namespace sc {
       }
     }
 
+    if (0 == executor.isInit()) {
+      executor.shutdown();
+    }
+
     impl->state &= ~SC_STATE_INIT;
     impl->state |= SC_STATE_SHUTDOWN;
 
@@ -247,5 +857,55 @@ namespace sc {
 
     return r;
   }
+
+  /* ----------------------------------------------------------- */
+
+  static void screencapture_on_frame(PixelBuffer& buffer) {
+
+    ScreenCapture* cap = static_cast<ScreenCapture*>(buffer.user);
+    if (NULL == cap) {
+      printf("Error: failed to cast the user pointer of the captured frame to ScreenCapture*. Not supposed to happen.\n");
+      return;
+    }
+
+    cap->processFrame(buffer);
+  }
+
+  static int screencapture_is_yuv(int fmt) {
+    return (SC_420V == fmt || SC_420F == fmt || SC_I420 == fmt || SC_P010 == fmt) ? 1 : 0;
+  }
+
+  /* Copies the pixels of `src` into `dst`, which we (re)allocate in `mem` when the size or format changes. */
+  static int screencapture_copy_frame(PixelBuffer& src, PixelBuffer& dst, std::vector<uint8_t>& mem) {
+
+    int layout[3] = { 0 };
+    int num_planes = screencapture_get_plane_layout(src.pixel_format, layout);
+
+    if (dst.width != src.width
+        || dst.height != src.height
+        || dst.pixel_format != src.pixel_format)
+      {
+        if (0 != dst.init(src.width, src.height, src.pixel_format)) {
+          printf("Error: failed to initialize the buffer for the masked frames.\n");
+          return -1;
+        }
+
+        mem.resize(dst.getNumBytes());
+        dst.setPlanes(&mem.front());
+      }
+
+    for (int i = 0; i < num_planes; ++i) {
+
+      int sub = (0 == i) ? 1 : 2;
+      size_t nbytes = ((src.width + sub - 1) / sub) * layout[i];
+      size_t nrows = (src.height + sub - 1) / sub;
+
+      for (size_t j = 0; j < nrows; ++j) {
+        memcpy(dst.plane[i] + j * dst.stride[i], src.plane[i] + j * src.stride[i], nbytes);
+      }
+    }
+
+    return 0;
+  }
   
 } /* namespace sc */
@@ -0,0 +1,397 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <screencapture/Scroll.h>
+#include <screencapture/Kernels.h>
+
+namespace sc {
+
+  /* ----------------------------------------------------------- */
+
+  ScrollDetector::ScrollDetector()
+    :width(0)
+    ,height(0)
+    ,pixel_format(SC_NONE)
+    ,strip_size(0)
+    ,min_lines(SC_SCROLL_MIN_LINES)
+    ,num_strips(0)
+    ,num_bands(0)
+    ,bpp(0)
+    ,step(1)
+    ,has_hashes(false)
+    ,table_shift(0)
+  {
+  }
+
+  ScrollDetector::~ScrollDetector() {
+    shutdown();
+  }
+
+  int ScrollDetector::init(int w, int h, int fmt, int strip) {
+
+    int layout[3] = { 0 };
+    int n = screencapture_get_plane_layout(fmt, layout);
+
+    if (0 == n) {
+      printf("Error: cannot initialize the scroll detector, unsupported pixel format: %s.\n", screencapture_pixelformat_to_string(fmt).c_str());
+      return -1;
+    }
+
+    if (0 >= w || 0 >= h) {
+      printf("Error: cannot initialize the scroll detector, invalid size: %d x %d.\n", w, h);
+      return -2;
+    }
+
+    if (2 > strip || 0 != (strip & 1)) {
+      printf("Error: cannot initialize the scroll detector, the strip size must be even: %d.\n", strip);
+      return -3;
+    }
+
+    width = w;
+    height = h;
+    pixel_format = fmt;
+    strip_size = strip;
+    num_strips = (w + strip - 1) / strip;
+    num_bands = (h + strip - 1) / strip;
+    bpp = layout[0];
+    step = (1 == n) ? 1 : 2;
+    has_hashes = false;
+
+    rows.assign(num_strips * h, 0);
+    prev_rows.assign(num_strips * h, 0);
+    cols.assign(num_bands * w, 0);
+    prev_cols.assign(num_bands * w, 0);
+
+    return 0;
+  }
+
+  int ScrollDetector::shutdown() {
+
+    width = 0;
+    height = 0;
+    pixel_format = SC_NONE;
+    strip_size = 0;
+    num_strips = 0;
+    num_bands = 0;
+    bpp = 0;
+    step = 1;
+    has_hashes = false;
+
+    rows.clear();
+    prev_rows.clear();
+    cols.clear();
+    prev_cols.clear();
+    votes.clear();
+    claimed.clear();
+    table_lines.clear();
+    table_hashes.clear();
+
+    return 0;
+  }
+
+  int ScrollDetector::update(PixelBuffer& frame, std::vector<MoveRect>& moves) {
+
+    moves.clear();
+
+    if (0 != isInit()) {
+      printf("Error: cannot detect the moves, not initialized.\n");
+      return -1;
+    }
+
+    if ((int)frame.width != width || (int)frame.height != height || frame.pixel_format != pixel_format) {
+      printf("Error: cannot detect the moves, the frame (%lu x %lu, %s) doesn't match the detector (%d x %d, %s).\n",
+             frame.width, frame.height, screencapture_pixelformat_to_string(frame.pixel_format).c_str(),
+             width, height, screencapture_pixelformat_to_string(pixel_format).c_str());
+      return -2;
+    }
+
+    if (NULL == frame.plane[0] || 0 == frame.stride[0]) {
+      printf("Error: cannot detect the moves, the first plane of the frame is not set.\n");
+      return -3;
+    }
+
+    prev_rows.swap(rows);
+    hashRows(frame);
+
+    /* The columns of a band that didn't change are the same as before. */
+    prev_cols.swap(cols);
+
+    for (int band = 0; band < num_bands; ++band) {
+
+      int y0 = band * strip_size;
+      int y1 = std::min(height, y0 + strip_size);
+      bool changed = (false == has_hashes);
+
+      for (int s = 0; s < num_strips && false == changed; ++s) {
+        changed = (false == std::equal(&rows[s * height + y0], &rows[s * height + y1], &prev_rows[s * height + y0]));
+      }
+
+      if (true == changed) {
+        hashColumns(frame, band);
+      }
+      else {
+        std::copy(&prev_cols[band * width], &prev_cols[band * width] + width, &cols[band * width]);
+      }
+    }
+
+    if (false == has_hashes) {
+      has_hashes = true;
+      return 0;
+    }
+
+    findMoves(&prev_rows.front(), &rows.front(), num_strips, height, 1, moves);
+    findMoves(&prev_cols.front(), &cols.front(), num_bands, width, 0, moves);
+
+    return 0;
+  }
+
+  void ScrollDetector::reset() {
+    has_hashes = false;
+  }
+
+  int ScrollDetector::isInitFor(int w, int h, int fmt, int strip) {
+
+    if (0 != isInit()) {
+      return -1;
+    }
+
+    return (w == width && h == height && fmt == pixel_format && strip == strip_size) ? 0 : -1;
+  }
+
+  /* Row by row so we read the memory in order; strip by strip touches another page for every row. */
+  void ScrollDetector::hashRows(PixelBuffer& frame) {
+
+    int nbytes = strip_size * bpp;
+    int last_nbytes = (width - (num_strips - 1) * strip_size) * bpp;
+
+    for (int y = 0; y < height; ++y) {
+
+      uint8_t* src = frame.plane[0] + y * frame.stride[0];
+      uint64_t* dst = &rows[y];
+
+      for (int s = 0; s < num_strips; ++s) {
+        dst[s * height] = kernel_hash_block(src + s * nbytes, frame.stride[0], (s + 1 == num_strips) ? last_nbytes : nbytes, 1);
+      }
+    }
+  }
+
+  /* We walk the rows of the band and mix every sample into the hash of its column, so we read the memory in order. */
+  void ScrollDetector::hashColumns(PixelBuffer& frame, int band) {
+
+    int y0 = band * strip_size;
+    int y1 = std::min(height, y0 + strip_size);
+    uint64_t* dst = &cols[band * width];
+
+    std::fill(dst, dst + width, 0);
+
+    for (int y = y0; y < y1; ++y) {
+
+      const uint8_t* src = frame.plane[0] + y * frame.stride[0];
+
+      if (4 == bpp) {
+        for (int x = 0; x < width; ++x) {
+          uint32_t v;
+          memcpy(&v, src + x * 4, 4);
+          dst[x] = (dst[x] ^ v) * 0x9E3779B97F4A7C15ull;
+        }
+        continue;
+      }
+
+      if (1 == bpp) {
+        for (int x = 0; x < width; ++x) {
+          dst[x] = (dst[x] ^ src[x]) * 0x9E3779B97F4A7C15ull;
+        }
+        continue;
+      }
+
+      for (int x = 0; x < width; ++x) {
+
+        uint64_t v = 0;
+
+        for (int k = 0; k < bpp; ++k) {
+          v |= (uint64_t)src[k] << (k * 8);
+        }
+
+        dst[x] = (dst[x] ^ v) * 0x9E3779B97F4A7C15ull;
+        src += bpp;
+      }
+    }
+  }
+
+  /*
+    `prev` and `cur` hold `n` lines (rows or columns) for each of the
+    `num` strips (or bands). When `vertical` is 1 the lines are rows
+    and the strips are vertical, otherwise the lines are columns and
+    the bands are horizontal. Runs of the same lines in neighbouring
+    strips become one move.
+  */
+  void ScrollDetector::findMoves(const uint64_t* prev, const uint64_t* cur, int num, int n, int vertical, std::vector<MoveRect>& moves) {
+
+    bool has_changes = false;
+
+    votes.assign(2 * n + 1, 0);
+    claimed.assign(num * n, 0);
+
+    /* At most half full; the slot is the top bits of the hash. */
+    table_shift = 63;
+    while ((1 << (64 - table_shift)) < 2 * n) {
+      --table_shift;
+    }
+
+    table_lines.resize((size_t)1 << (64 - table_shift));
+    table_hashes.resize(table_lines.size());
+
+    for (int s = 0; s < num; ++s) {
+
+      const uint64_t* p = prev + s * n;
+      const uint64_t* c = cur + s * n;
+      int i = 0;
+
+      while (i < n && c[i] == p[i]) {
+        ++i;
+      }
+
+      if (i == n) {
+        continue;
+      }
+
+      has_changes = true;
+
+      /* An open addressing table of the lines of the previous frame; -2 marks hashes that appear more than once. */
+      std::fill(table_lines.begin(), table_lines.end(), -1);
+
+      for (int j = 0; j < n; ++j) {
+
+        size_t slot = (size_t)(p[j] >> table_shift);
+
+        while (-1 != table_lines[slot] && table_hashes[slot] != p[j]) {
+          slot = (slot + 1) & (table_lines.size() - 1);
+        }
+
+        table_lines[slot] = (-1 == table_lines[slot]) ? j : -2;
+        table_hashes[slot] = p[j];
+      }
+
+      /* Lines that appear more than once (e.g. a plain background) could have moved by any offset; they don't vote. */
+      for (; i < n; ++i) {
+
+        if (c[i] == p[i]) {
+          continue;
+        }
+
+        size_t slot = (size_t)(c[i] >> table_shift);
+
+        while (-1 != table_lines[slot] && table_hashes[slot] != c[i]) {
+          slot = (slot + 1) & (table_lines.size() - 1);
+        }
+
+        if (0 > table_lines[slot]) {
+          continue;
+        }
+
+        int offset = i - table_lines[slot];
+
+        if (0 == offset % step) {
+          votes[offset + n]++;
+        }
+      }
+    }
+
+    if (false == has_changes) {
+      return;
+    }
+
+    int extent = (1 == vertical) ? width : height;
+
+    for (int k = 0; k < SC_SCROLL_MAX_OFFSETS; ++k) {
+
+      std::vector<int>::iterator best = std::max_element(votes.begin(), votes.end());
+
+      if (*best < min_lines) {
+        break;
+      }
+
+      int offset = (int)(best - votes.begin()) - n;
+      size_t first = moves.size();
+      *best = 0;
+
+      for (int s = 0; s < num; ++s) {
+
+        const uint64_t* p = prev + s * n;
+        const uint64_t* c = cur + s * n;
+        uint8_t* taken = &claimed[s * n];
+        int end = n + std::min(0, offset);
+        int i = std::max(0, offset);
+
+        while (i < end) {
+
+          if (0 != taken[i] || c[i] != p[i - offset]) {
+            ++i;
+            continue;
+          }
+
+          int start = i;
+          bool changed = false;
+
+          while (i < end && 0 == taken[i] && c[i] == p[i - offset]) {
+            changed = (true == changed || c[i] != p[i]);
+            ++i;
+          }
+
+          /* The 4:2:0 formats move whole chroma samples. */
+          int run_start = start + (start % step);
+          int run_end = (i == n) ? i : i - (i % step);
+
+          if (false == changed || run_end - run_start < min_lines) {
+            continue;
+          }
+
+          std::fill(taken + run_start, taken + run_end, 1);
+
+          MoveRect m;
+          int across = s * strip_size;
+          int across_size = std::min(strip_size, extent - across);
+          bool merged = false;
+
+          for (size_t j = first; j < moves.size() && false == merged; ++j) {
+            MoveRect& r = moves[j];
+            if (1 == vertical && r.y == run_start && r.height == run_end - run_start && r.x + r.width == across) {
+              r.width += across_size;
+              merged = true;
+            }
+            else if (0 == vertical && r.x == run_start && r.width == run_end - run_start && r.y + r.height == across) {
+              r.height += across_size;
+              merged = true;
+            }
+          }
+
+          if (true == merged) {
+            continue;
+          }
+
+          if (1 == vertical) {
+            m.x = across;
+            m.y = run_start;
+            m.width = across_size;
+            m.height = run_end - run_start;
+            m.src_x = m.x;
+            m.src_y = m.y - offset;
+          }
+          else {
+            m.x = run_start;
+            m.y = across;
+            m.width = run_end - run_start;
+            m.height = across_size;
+            m.src_x = m.x - offset;
+            m.src_y = m.y;
+          }
+
+          moves.push_back(m);
+        }
+      }
+    }
+  }
+
+  /* ----------------------------------------------------------- */
+
+} /* namespace sc */
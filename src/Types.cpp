@@ -1,12 +1,23 @@
+#include <stdio.h>
 #include <screencapture/Types.h>
 
 namespace sc {
 
+  /* ----------------------------------------------------------- */
+
+  static size_t align_stride(size_t nbytes);
+
+  /* ----------------------------------------------------------- */
+
   PixelBuffer::PixelBuffer()
     :pixel_format(SC_NONE)
     ,width(0)
     ,height(0)
     ,user(NULL)
+    ,parent(NULL)
+    ,damage(SC_DAMAGE_UNKNOWN)
+    ,info(NULL)
+    ,level(0)
   {
     plane[0] = NULL;
     plane[1] = NULL;
@@ -31,6 +42,10 @@ namespace sc {
     nbytes[1] = 0;
     nbytes[2] = 0;
     user = NULL;
+    damage = SC_DAMAGE_UNKNOWN;
+    info = NULL;
+    parent = NULL;
+    level = 0;
   }
 
   int PixelBuffer::init(int w, int h, int fmt) {
@@ -45,10 +60,44 @@ namespace sc {
       return -2;
     }
 
-    if (SC_BGRA == fmt) {
+    stride[0] = stride[1] = stride[2] = 0;
+    nbytes[0] = nbytes[1] = nbytes[2] = 0;
+
+    if (SC_BGRA == fmt || SC_RGBA == fmt || SC_L10R == fmt) {
       /* This may be overwritten by the capture driver. */
+      stride[0] = w * 4;
       nbytes[0] = w * h * 4;
     }
+    else if (SC_RGB24 == fmt || SC_BGR24 == fmt) {
+      stride[0] = w * 3;
+      nbytes[0] = w * h * 3;
+    }
+    else if (SC_RGB48 == fmt) {
+      stride[0] = w * 6;
+      nbytes[0] = w * h * 6;
+    }
+    else if (SC_420V == fmt || SC_420F == fmt) {
+      /* Y plane + interleaved UV plane; the chroma planes are rounded up for odd sizes. */
+      stride[0] = align_stride(w);
+      stride[1] = align_stride(((w + 1) / 2) * 2);
+      nbytes[0] = stride[0] * h;
+      nbytes[1] = stride[1] * ((h + 1) / 2);
+    }
+    else if (SC_P010 == fmt) {
+      /* Same layout as SC_420V but with 2 bytes per sample. */
+      stride[0] = align_stride(w * 2);
+      stride[1] = align_stride(((w + 1) / 2) * 4);
+      nbytes[0] = stride[0] * h;
+      nbytes[1] = stride[1] * ((h + 1) / 2);
+    }
+    else if (SC_I420 == fmt) {
+      stride[0] = align_stride(w);
+      stride[1] = align_stride((w + 1) / 2);
+      stride[2] = stride[1];
+      nbytes[0] = stride[0] * h;
+      nbytes[1] = stride[1] * ((h + 1) / 2);
+      nbytes[2] = nbytes[1];
+    }
     else {
       printf("Error: pixel buffer has no initialisation for the given format: %s\n", screencapture_pixelformat_to_string(fmt).c_str());
       return -3;
@@ -58,14 +107,97 @@ namespace sc {
     height = h;
     pixel_format = fmt;
 
+    /* A view that we initialize becomes a buffer of its own. */
+    parent = NULL;
+
     return 0;
   }
-  
+
+  int PixelBuffer::setPlanes(uint8_t* data) {
+
+    if (NULL == data) {
+      printf("Error: cannot set the planes of the pixel buffer because the given data is NULL.\n");
+      return -1;
+    }
+
+    if (0 == nbytes[0]) {
+      printf("Error: cannot set the planes of the pixel buffer because it's not initialized. Call init() first.\n");
+      return -2;
+    }
+
+    plane[0] = data;
+    plane[1] = (0 == nbytes[1]) ? NULL : plane[0] + nbytes[0];
+    plane[2] = (0 == nbytes[2]) ? NULL : plane[1] + nbytes[1];
+
+    return 0;
+  }
+
+  size_t PixelBuffer::getNumBytes() {
+    return nbytes[0] + nbytes[1] + nbytes[2];
+  }
+
+  int PixelBuffer::getView(int x, int y, int w, int h, PixelBuffer& view) {
+
+    int bpp[3] = { 0 };
+    int num_planes = screencapture_get_plane_layout(pixel_format, bpp);
+
+    if (0 == num_planes || NULL == plane[0]) {
+      printf("Error: cannot create a view, the pixel buffer is not initialized or has no planes.\n");
+      return -1;
+    }
+
+    if (0 > x || 0 > y || 0 >= w || 0 >= h || (size_t)(x + w) > width || (size_t)(y + h) > height) {
+      printf("Error: cannot create a view of %d x %d at %d, %d in a pixel buffer of %lu x %lu.\n", w, h, x, y, width, height);
+      return -2;
+    }
+
+    if (1 < num_planes && (0 != (x & 1) || 0 != (y & 1))) {
+      printf("Error: cannot create a view at %d, %d; the position must be even for %s.\n", x, y, screencapture_pixelformat_to_string(pixel_format).c_str());
+      return -3;
+    }
+
+    if (&view == this) {
+      printf("Error: cannot create a view into the buffer itself.\n");
+      return -4;
+    }
+
+    /* A view of a view points into the same parent. */
+    view = *this;
+    view.width = w;
+    view.height = h;
+
+    for (int i = 0; i < num_planes; ++i) {
+      /* The other planes are the 4:2:0 chroma planes. */
+      int col = (0 == i) ? x : x / 2;
+      int row = (0 == i) ? y : y / 2;
+      view.plane[i] = plane[i] + row * stride[i] + col * bpp[i];
+      view.nbytes[i] = 0;
+    }
+
+    view.parent = (NULL == parent) ? this : parent;
+
+    return 0;
+  }
+
   Settings::Settings()
     :display(-1)
     ,pixel_format(-1)
     ,output_width(-1)
     ,output_height(-1)
+    ,scale_quality(SC_SCALE_BILINEAR)
+    ,color_matrix(SC_COLOR_MATRIX_BT601)
+    ,color_range(SC_COLOR_RANGE_AUTO)
+    ,num_threads(1)
+    ,drop_static_frames(0)
+    ,keepalive_ms(1000)
+    ,pyramid_levels(0)
+    ,frame_stats(0)
+  {
+  }
+
+  Display::Display()
+    :info(NULL)
+    ,rotation(SC_ROTATE_0)
   {
   }
 
@@ -78,10 +210,62 @@ namespace sc {
       case SC_420F: { return "SC_420F"; }
       case SC_BGRA: { return "SC_BGRA"; }
       case SC_L10R: { return "SC_L10R"; }
+      case SC_I420: { return "SC_I420"; }
+      case SC_RGBA: { return "SC_RGBA"; }
+      case SC_RGB24: { return "SC_RGB24"; }
+      case SC_BGR24: { return "SC_BGR24"; }
+      case SC_P010: { return "SC_P010"; }
+      case SC_RGB48: { return "SC_RGB48"; }
       default: { return "UNKNOWN PIXEL FORMAT"; } 
     }
   }
 
+  int screencapture_get_plane_layout(int fmt, int* bpp) {
+
+    switch (fmt) {
+      case SC_BGRA:
+      case SC_RGBA:
+      case SC_L10R: {
+        bpp[0] = 4;
+        return 1;
+      }
+      case SC_RGB24:
+      case SC_BGR24: {
+        bpp[0] = 3;
+        return 1;
+      }
+      case SC_RGB48: {
+        bpp[0] = 6;
+        return 1;
+      }
+      case SC_420V:
+      case SC_420F: {
+        bpp[0] = 1;
+        bpp[1] = 2;
+        return 2;
+      }
+      case SC_P010: {
+        bpp[0] = 2;
+        bpp[1] = 4;
+        return 2;
+      }
+      case SC_I420: {
+        bpp[0] = 1;
+        bpp[1] = 1;
+        bpp[2] = 1;
+        return 3;
+      }
+    }
+
+    return 0;
+  }
+
+  /* ----------------------------------------------------------- */
+
+  static size_t align_stride(size_t nbytes) {
+    return (nbytes + (SC_STRIDE_ALIGNMENT - 1)) & ~((size_t)SC_STRIDE_ALIGNMENT - 1);
+  }
+
   /* ----------------------------------------------------------- */
     
 } /* namespace sc */
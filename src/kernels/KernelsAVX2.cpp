@@ -0,0 +1,15 @@
+/* The SSSE3 kernels with VEX encoding plus the 256 bit AVX2 paths of the hot kernels; compile this file with -mavx2 (or /arch:AVX2). */
+#include <screencapture/Kernels.h>
+
+#if defined(SC_ARCH_X86)
+
+#  if defined(__GNUC__) && !defined(__AVX2__)
+#    error "KernelsAVX2.cpp must be compiled with -mavx2."
+#  endif
+
+#  define SC_KERNELS_NAMESPACE kernels_avx2
+#  define SC_KERNELS_USE_SSE2
+#  define SC_KERNELS_USE_SSSE3
+#  define SC_KERNELS_USE_AVX2
+#  include "KernelsImpl.h"
+#endif
@@ -0,0 +1,3 @@
+/* The kernels without SIMD; available on every CPU. */
+#define SC_KERNELS_NAMESPACE kernels_c
+#include "KernelsImpl.h"
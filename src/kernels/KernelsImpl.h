@@ -0,0 +1,2649 @@
+/*
+  Kernels (implementation)
+  ------------------------
+
+  The pixel kernels; included by the Kernels<ISA>.cpp files in this
+  directory which compile them once per instruction set. Before
+  including this file they define SC_KERNELS_NAMESPACE, the namespace
+  that receives this variant of the kernels, and the SC_KERNELS_USE_*
+  macros of the SIMD paths that we compile in. Kernels.cpp selects one
+  of the variants at runtime; see Kernels.h.
+
+  The SIMD paths are selected with the SC_HAVE_* macros below; every
+  kernel keeps its plain C version for the pixels at the end of a row
+  and for the variants without SIMD.
+
+ */
+#ifndef SCREEN_CAPTURE_KERNELS_IMPL_H
+#define SCREEN_CAPTURE_KERNELS_IMPL_H
+
+#include <stddef.h>
+#include <string.h>
+#include <screencapture/Kernels.h>
+
+#if !defined(SC_KERNELS_NAMESPACE)
+#  error "Define SC_KERNELS_NAMESPACE before including KernelsImpl.h"
+#endif
+
+#if defined(SC_KERNELS_USE_SSE2)
+#  define SC_HAVE_SSE2 1
+#  include <emmintrin.h>
+#endif
+
+#if defined(SC_KERNELS_USE_SSSE3)
+#  define SC_HAVE_SSSE3 1
+#  include <tmmintrin.h>
+#endif
+
+#if defined(SC_KERNELS_USE_AVX2)
+#  define SC_HAVE_AVX2 1
+#  include <immintrin.h>
+#endif
+
+#if defined(SC_KERNELS_USE_NEON)
+#  define SC_HAVE_NEON 1
+#  include <arm_neon.h>
+#endif
+
+namespace sc {
+namespace SC_KERNELS_NAMESPACE {
+
+  /* ----------------------------------------------------------- */
+
+  static inline uint8_t clamp_u8(int v) {
+    return (v < 0) ? 0 : ((v > 255) ? 255 : (uint8_t)v);
+  }
+
+  /* Y for one pixel. */
+  static inline uint8_t rgb_to_y(int r, int g, int b, const YuvCoefficients& c) {
+    return clamp_u8(((c.yr * r + c.yg * g + c.yb * b + 128) >> 8) + c.y_offset);
+  }
+
+  /* U or V for the sum of four pixels (2x2 block). */
+  static inline uint8_t rgb4_to_chroma(int r4, int g4, int b4, int cr, int cg, int cb) {
+    return clamp_u8(((cr * r4 + cg * g4 + cb * b4 + 512) >> 10) + 128);
+  }
+
+  /* One YCbCr sample > BGRA, or RGBA when `swap_rb` is set. */
+  static inline void yuv_to_pixel(int y, int u, int v, uint8_t* dst, int swap_rb, const YuvCoefficients& c) {
+    int yy = (y - c.y_offset) * c.y_scale;
+    u -= 128;
+    v -= 128;
+    dst[swap_rb ? 2 : 0] = clamp_u8((yy + c.u_to_b * u + 32) >> 6);
+    dst[1] = clamp_u8((yy - c.u_to_g * u - c.v_to_g * v + 32) >> 6);
+    dst[swap_rb ? 0 : 2] = clamp_u8((yy + c.v_to_r * v + 32) >> 6);
+    dst[3] = 0xFF;
+  }
+
+  /* ----------------------------------------------------------- */
+
+#if defined(SC_HAVE_SSE2)
+
+  /* Adds the neighbouring 32 bit lanes of `a` and `b`: [a0+a1, a2+a3, b0+b1, b2+b3]. */
+  static inline __m128i sse2_add_pairs_epi32(__m128i a, __m128i b) {
+    __m128 fa = _mm_castsi128_ps(a);
+    __m128 fb = _mm_castsi128_ps(b);
+    __m128i even = _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(2, 0, 2, 0)));
+    __m128i odd = _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(3, 1, 3, 1)));
+    return _mm_add_epi32(even, odd);
+  }
+
+  /* Weighted sum of the B, G, R channels of 4 BGRA pixels; `coeff` holds (b, g, r, 0) twice. */
+  static inline __m128i sse2_dot_bgra4(__m128i px, __m128i coeff) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(px, zero), coeff);
+    __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(px, zero), coeff);
+    return sse2_add_pairs_epi32(lo, hi);
+  }
+
+  /* Sums the 2x2 blocks of 4 pixels in `a` (top) and `b` (bottom): two blocks of 16 bit B, G, R, A. */
+  static inline __m128i sse2_sum_2x2(__m128i a, __m128i b) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+    __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+    lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+    hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+    return _mm_unpacklo_epi64(lo, hi);
+  }
+
+  /* 16 BGRA pixels > 16 Y values. */
+  static inline __m128i sse2_bgra16_to_y(const uint8_t* src, __m128i coeff, __m128i offset) {
+    __m128i round = _mm_set1_epi32(128);
+    __m128i y0 = _mm_srai_epi32(_mm_add_epi32(sse2_dot_bgra4(_mm_loadu_si128((const __m128i*)(src + 0)), coeff), round), 8);
+    __m128i y1 = _mm_srai_epi32(_mm_add_epi32(sse2_dot_bgra4(_mm_loadu_si128((const __m128i*)(src + 16)), coeff), round), 8);
+    __m128i y2 = _mm_srai_epi32(_mm_add_epi32(sse2_dot_bgra4(_mm_loadu_si128((const __m128i*)(src + 32)), coeff), round), 8);
+    __m128i y3 = _mm_srai_epi32(_mm_add_epi32(sse2_dot_bgra4(_mm_loadu_si128((const __m128i*)(src + 48)), coeff), round), 8);
+    __m128i lo = _mm_add_epi16(_mm_packs_epi32(y0, y1), offset);
+    __m128i hi = _mm_add_epi16(_mm_packs_epi32(y2, y3), offset);
+    return _mm_packus_epi16(lo, hi);
+  }
+
+  /* Four 2x2 sums (see sse2_sum_2x2) > 8 chroma values in the lower 64 bits. */
+  static inline __m128i sse2_sums_to_chroma(__m128i s0, __m128i s1, __m128i s2, __m128i s3, __m128i coeff) {
+    __m128i round = _mm_set1_epi32(512);
+    __m128i c0 = sse2_add_pairs_epi32(_mm_madd_epi16(s0, coeff), _mm_madd_epi16(s1, coeff));
+    __m128i c1 = sse2_add_pairs_epi32(_mm_madd_epi16(s2, coeff), _mm_madd_epi16(s3, coeff));
+    c0 = _mm_srai_epi32(_mm_add_epi32(c0, round), 10);
+    c1 = _mm_srai_epi32(_mm_add_epi32(c1, round), 10);
+    __m128i c = _mm_add_epi16(_mm_packs_epi32(c0, c1), _mm_set1_epi16(128));
+    return _mm_packus_epi16(c, c);
+  }
+
+#endif
+
+#if defined(SC_HAVE_AVX2)
+
+  /*
+    The AVX2 instructions work on two 128 bit lanes; the packs and
+    horizontal adds below mix the lanes so we restore the order of
+    the pixels with a permute at the end. The results are the same
+    as those of the SSE2 helpers above.
+  */
+
+  /* Weighted sum of the B, G, R channels of 8 BGRA pixels; `coeff` holds (b, g, r, 0) four times. */
+  static inline __m256i avx2_dot_bgra8(__m256i px, __m256i coeff) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi8(px, zero), coeff);
+    __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi8(px, zero), coeff);
+    return _mm256_hadd_epi32(lo, hi);
+  }
+
+  /* Sums the 2x2 blocks of 8 pixels in `a` (top) and `b` (bottom): four blocks of 16 bit B, G, R, A. */
+  static inline __m256i avx2_sum_2x2(__m256i a, __m256i b) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero));
+    __m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero));
+    return _mm256_add_epi16(_mm256_unpacklo_epi64(lo, hi), _mm256_unpackhi_epi64(lo, hi));
+  }
+
+  /* 32 BGRA pixels > 32 Y values. */
+  static inline __m256i avx2_bgra32_to_y(const uint8_t* src, __m256i coeff, __m256i offset) {
+    __m256i round = _mm256_set1_epi32(128);
+    __m256i y0 = _mm256_srai_epi32(_mm256_add_epi32(avx2_dot_bgra8(_mm256_loadu_si256((const __m256i*)(src + 0)), coeff), round), 8);
+    __m256i y1 = _mm256_srai_epi32(_mm256_add_epi32(avx2_dot_bgra8(_mm256_loadu_si256((const __m256i*)(src + 32)), coeff), round), 8);
+    __m256i y2 = _mm256_srai_epi32(_mm256_add_epi32(avx2_dot_bgra8(_mm256_loadu_si256((const __m256i*)(src + 64)), coeff), round), 8);
+    __m256i y3 = _mm256_srai_epi32(_mm256_add_epi32(avx2_dot_bgra8(_mm256_loadu_si256((const __m256i*)(src + 96)), coeff), round), 8);
+    __m256i lo = _mm256_add_epi16(_mm256_packs_epi32(y0, y1), offset);
+    __m256i hi = _mm256_add_epi16(_mm256_packs_epi32(y2, y3), offset);
+    return _mm256_permutevar8x32_epi32(_mm256_packus_epi16(lo, hi), _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+  }
+
+  /* Four 2x2 sums (see avx2_sum_2x2) > 16 chroma values. */
+  static inline __m128i avx2_sums_to_chroma(__m256i s0, __m256i s1, __m256i s2, __m256i s3, __m256i coeff) {
+    __m256i round = _mm256_set1_epi32(512);
+    __m256i c0 = _mm256_hadd_epi32(_mm256_madd_epi16(s0, coeff), _mm256_madd_epi16(s1, coeff));
+    __m256i c1 = _mm256_hadd_epi32(_mm256_madd_epi16(s2, coeff), _mm256_madd_epi16(s3, coeff));
+    c0 = _mm256_srai_epi32(_mm256_add_epi32(_mm256_permute4x64_epi64(c0, _MM_SHUFFLE(3, 1, 2, 0)), round), 10);
+    c1 = _mm256_srai_epi32(_mm256_add_epi32(_mm256_permute4x64_epi64(c1, _MM_SHUFFLE(3, 1, 2, 0)), round), 10);
+    __m256i c = _mm256_add_epi16(_mm256_packs_epi32(c0, c1), _mm256_set1_epi16(128));
+    c = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(c, c), _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+    return _mm256_castsi256_si128(c);
+  }
+
+#endif
+
+  /* ----------------------------------------------------------- */
+
+  void kernel_bgra_to_i420_rows(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, int width, const YuvCoefficients& c) {
+
+    int x = 0;
+
+#if defined(SC_HAVE_SSE2)
+
+    __m128i cy = _mm_setr_epi16(c.yb, c.yg, c.yr, 0, c.yb, c.yg, c.yr, 0);
+    __m128i cu = _mm_setr_epi16(c.ub, c.ug, c.ur, 0, c.ub, c.ug, c.ur, 0);
+    __m128i cv = _mm_setr_epi16(c.vb, c.vg, c.vr, 0, c.vb, c.vg, c.vr, 0);
+    __m128i offset = _mm_set1_epi16(c.y_offset);
+
+#if defined(SC_HAVE_AVX2)
+
+    __m256i cy8 = _mm256_broadcastsi128_si256(cy);
+    __m256i cu8 = _mm256_broadcastsi128_si256(cu);
+    __m256i cv8 = _mm256_broadcastsi128_si256(cv);
+    __m256i offset8 = _mm256_broadcastsi128_si256(offset);
+
+    for (; x + 32 <= width; x += 32) {
+
+      const uint8_t* a = src0 + x * 4;
+      const uint8_t* b = src1 + x * 4;
+
+      _mm256_storeu_si256((__m256i*)(y0 + x), avx2_bgra32_to_y(a, cy8, offset8));
+      if (NULL != y1) {
+        _mm256_storeu_si256((__m256i*)(y1 + x), avx2_bgra32_to_y(b, cy8, offset8));
+      }
+
+      __m256i s0 = avx2_sum_2x2(_mm256_loadu_si256((const __m256i*)(a + 0)), _mm256_loadu_si256((const __m256i*)(b + 0)));
+      __m256i s1 = avx2_sum_2x2(_mm256_loadu_si256((const __m256i*)(a + 32)), _mm256_loadu_si256((const __m256i*)(b + 32)));
+      __m256i s2 = avx2_sum_2x2(_mm256_loadu_si256((const __m256i*)(a + 64)), _mm256_loadu_si256((const __m256i*)(b + 64)));
+      __m256i s3 = avx2_sum_2x2(_mm256_loadu_si256((const __m256i*)(a + 96)), _mm256_loadu_si256((const __m256i*)(b + 96)));
+
+      _mm_storeu_si128((__m128i*)(u + x / 2), avx2_sums_to_chroma(s0, s1, s2, s3, cu8));
+      _mm_storeu_si128((__m128i*)(v + x / 2), avx2_sums_to_chroma(s0, s1, s2, s3, cv8));
+    }
+
+#endif
+
+    for (; x + 16 <= width; x += 16) {
+
+      const uint8_t* a = src0 + x * 4;
+      const uint8_t* b = src1 + x * 4;
+
+      _mm_storeu_si128((__m128i*)(y0 + x), sse2_bgra16_to_y(a, cy, offset));
+      if (NULL != y1) {
+        _mm_storeu_si128((__m128i*)(y1 + x), sse2_bgra16_to_y(b, cy, offset));
+      }
+
+      __m128i s0 = sse2_sum_2x2(_mm_loadu_si128((const __m128i*)(a + 0)), _mm_loadu_si128((const __m128i*)(b + 0)));
+      __m128i s1 = sse2_sum_2x2(_mm_loadu_si128((const __m128i*)(a + 16)), _mm_loadu_si128((const __m128i*)(b + 16)));
+      __m128i s2 = sse2_sum_2x2(_mm_loadu_si128((const __m128i*)(a + 32)), _mm_loadu_si128((const __m128i*)(b + 32)));
+      __m128i s3 = sse2_sum_2x2(_mm_loadu_si128((const __m128i*)(a + 48)), _mm_loadu_si128((const __m128i*)(b + 48)));
+
+      _mm_storel_epi64((__m128i*)(u + x / 2), sse2_sums_to_chroma(s0, s1, s2, s3, cu));
+      _mm_storel_epi64((__m128i*)(v + x / 2), sse2_sums_to_chroma(s0, s1, s2, s3, cv));
+    }
+
+#elif defined(SC_HAVE_NEON)
+
+    /* All standard matrices have positive Y weights so we can accumulate Y in 16 bits. */
+    for (; x + 16 <= width; x += 16) {
+
+      uint8x16x4_t a = vld4q_u8(src0 + x * 4);
+      uint8x16x4_t b = vld4q_u8(src1 + x * 4);
+      uint8x16x4_t* rows[2] = { &a, &b };
+      uint8_t* ydst[2] = { y0 + x, (NULL == y1) ? NULL : y1 + x };
+
+      for (int i = 0; i < 2; ++i) {
+        if (NULL == ydst[i]) {
+          continue;
+        }
+        uint8x16x4_t& p = *rows[i];
+        uint16x8_t lo = vdupq_n_u16(128);
+        uint16x8_t hi = vdupq_n_u16(128);
+        lo = vmlaq_n_u16(lo, vmovl_u8(vget_low_u8(p.val[0])), c.yb);
+        hi = vmlaq_n_u16(hi, vmovl_u8(vget_high_u8(p.val[0])), c.yb);
+        lo = vmlaq_n_u16(lo, vmovl_u8(vget_low_u8(p.val[1])), c.yg);
+        hi = vmlaq_n_u16(hi, vmovl_u8(vget_high_u8(p.val[1])), c.yg);
+        lo = vmlaq_n_u16(lo, vmovl_u8(vget_low_u8(p.val[2])), c.yr);
+        hi = vmlaq_n_u16(hi, vmovl_u8(vget_high_u8(p.val[2])), c.yr);
+        uint8x16_t y = vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8));
+        vst1q_u8(ydst[i], vqaddq_u8(y, vdupq_n_u8((uint8_t)c.y_offset)));
+      }
+
+      /* 2x2 sums, max 1020 so they fit in a signed 16 bit value. */
+      int16x8_t sb = vreinterpretq_s16_u16(vaddq_u16(vpaddlq_u8(a.val[0]), vpaddlq_u8(b.val[0])));
+      int16x8_t sg = vreinterpretq_s16_u16(vaddq_u16(vpaddlq_u8(a.val[1]), vpaddlq_u8(b.val[1])));
+      int16x8_t sr = vreinterpretq_s16_u16(vaddq_u16(vpaddlq_u8(a.val[2]), vpaddlq_u8(b.val[2])));
+      const int16_t coeffs[2][3] = { { c.ub, c.ug, c.ur }, { c.vb, c.vg, c.vr } };
+      uint8_t* cdst[2] = { u + x / 2, v + x / 2 };
+
+      for (int i = 0; i < 2; ++i) {
+        int32x4_t lo = vdupq_n_s32(512);
+        int32x4_t hi = vdupq_n_s32(512);
+        lo = vmlal_n_s16(lo, vget_low_s16(sb), coeffs[i][0]);
+        hi = vmlal_n_s16(hi, vget_high_s16(sb), coeffs[i][0]);
+        lo = vmlal_n_s16(lo, vget_low_s16(sg), coeffs[i][1]);
+        hi = vmlal_n_s16(hi, vget_high_s16(sg), coeffs[i][1]);
+        lo = vmlal_n_s16(lo, vget_low_s16(sr), coeffs[i][2]);
+        hi = vmlal_n_s16(hi, vget_high_s16(sr), coeffs[i][2]);
+        int16x8_t ch = vcombine_s16(vmovn_s32(vshrq_n_s32(lo, 10)), vmovn_s32(vshrq_n_s32(hi, 10)));
+        vst1_u8(cdst[i], vqmovun_s16(vaddq_s16(ch, vdupq_n_s16(128))));
+      }
+    }
+
+#endif
+
+    /* Remaining pixels; an odd last column is treated as if it was duplicated. */
+    for (; x < width; x += 2) {
+
+      int x1 = (x + 1 < width) ? x + 1 : x;
+      const uint8_t* a0 = src0 + x * 4;
+      const uint8_t* a1 = src0 + x1 * 4;
+      const uint8_t* b0 = src1 + x * 4;
+      const uint8_t* b1 = src1 + x1 * 4;
+
+      y0[x] = rgb_to_y(a0[2], a0[1], a0[0], c);
+      if (x1 != x) {
+        y0[x1] = rgb_to_y(a1[2], a1[1], a1[0], c);
+      }
+
+      if (NULL != y1) {
+        y1[x] = rgb_to_y(b0[2], b0[1], b0[0], c);
+        if (x1 != x) {
+          y1[x1] = rgb_to_y(b1[2], b1[1], b1[0], c);
+        }
+      }
+
+      int b4 = a0[0] + a1[0] + b0[0] + b1[0];
+      int g4 = a0[1] + a1[1] + b0[1] + b1[1];
+      int r4 = a0[2] + a1[2] + b0[2] + b1[2];
+      u[x / 2] = rgb4_to_chroma(r4, g4, b4, c.ur, c.ug, c.ub);
+      v[x / 2] = rgb4_to_chroma(r4, g4, b4, c.vr, c.vg, c.vb);
+    }
+  }
+
+  /* ----------------------------------------------------------- */
+
+#if defined(SC_HAVE_SSE2)
+
+  /*
+    16 Y values and 8 U and V values (16 bit, minus 128) > 16 B, G and
+    R bytes. The intermediate values use saturating adds; they only
+    saturate when the result would be clamped to 0 or 255 anyway.
+  */
+  static inline void sse2_yuv16_to_rgb(__m128i yy, __m128i uu, __m128i vv, const YuvCoefficients& c, __m128i& b8, __m128i& g8, __m128i& r8) {
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i offset = _mm_set1_epi16(c.y_offset);
+    __m128i scale = _mm_set1_epi16(c.y_scale);
+    __m128i round = _mm_set1_epi16(32);
+    __m128i v_to_r = _mm_set1_epi16(c.v_to_r);
+    __m128i u_to_g = _mm_set1_epi16(c.u_to_g);
+    __m128i v_to_g = _mm_set1_epi16(c.v_to_g);
+    __m128i u_to_b = _mm_set1_epi16(c.u_to_b);
+
+    __m128i ys[2] = { _mm_unpacklo_epi8(yy, zero), _mm_unpackhi_epi8(yy, zero) };
+    __m128i us[2] = { _mm_unpacklo_epi16(uu, uu), _mm_unpackhi_epi16(uu, uu) };
+    __m128i vs[2] = { _mm_unpacklo_epi16(vv, vv), _mm_unpackhi_epi16(vv, vv) };
+    __m128i bs[2], gs[2], rs[2];
+
+    for (int i = 0; i < 2; ++i) {
+      __m128i yc = _mm_mullo_epi16(_mm_sub_epi16(ys[i], offset), scale);
+      __m128i b = _mm_adds_epi16(yc, _mm_mullo_epi16(us[i], u_to_b));
+      __m128i g = _mm_subs_epi16(_mm_subs_epi16(yc, _mm_mullo_epi16(us[i], u_to_g)), _mm_mullo_epi16(vs[i], v_to_g));
+      __m128i r = _mm_adds_epi16(yc, _mm_mullo_epi16(vs[i], v_to_r));
+      bs[i] = _mm_srai_epi16(_mm_adds_epi16(b, round), 6);
+      gs[i] = _mm_srai_epi16(_mm_adds_epi16(g, round), 6);
+      rs[i] = _mm_srai_epi16(_mm_adds_epi16(r, round), 6);
+    }
+
+    b8 = _mm_packus_epi16(bs[0], bs[1]);
+    g8 = _mm_packus_epi16(gs[0], gs[1]);
+    r8 = _mm_packus_epi16(rs[0], rs[1]);
+  }
+
+  /* Interleaves 16 values of 4 channels into 16 pixels of 4 bytes, `c0` first. */
+  static inline void sse2_store_4x16(uint8_t* dst, __m128i c0, __m128i c1, __m128i c2, __m128i c3) {
+    __m128i lo01 = _mm_unpacklo_epi8(c0, c1);
+    __m128i hi01 = _mm_unpackhi_epi8(c0, c1);
+    __m128i lo23 = _mm_unpacklo_epi8(c2, c3);
+    __m128i hi23 = _mm_unpackhi_epi8(c2, c3);
+    _mm_storeu_si128((__m128i*)(dst + 0), _mm_unpacklo_epi16(lo01, lo23));
+    _mm_storeu_si128((__m128i*)(dst + 16), _mm_unpackhi_epi16(lo01, lo23));
+    _mm_storeu_si128((__m128i*)(dst + 32), _mm_unpacklo_epi16(hi01, hi23));
+    _mm_storeu_si128((__m128i*)(dst + 48), _mm_unpackhi_epi16(hi01, hi23));
+  }
+
+#elif defined(SC_HAVE_NEON)
+
+  /* See sse2_yuv16_to_rgb(). */
+  static inline void neon_yuv16_to_rgb(uint8x16_t yy, int16x8_t uu, int16x8_t vv, const YuvCoefficients& c, uint8x16_t& b8, uint8x16_t& g8, uint8x16_t& r8) {
+
+    int16x8x2_t us = vzipq_s16(uu, uu);
+    int16x8x2_t vs = vzipq_s16(vv, vv);
+    int16x8_t ys[2] = {
+      vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(yy))),
+      vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(yy)))
+    };
+    uint8x8_t bs[2], gs[2], rs[2];
+
+    for (int i = 0; i < 2; ++i) {
+      int16x8_t yc = vmulq_n_s16(vsubq_s16(ys[i], vdupq_n_s16(c.y_offset)), c.y_scale);
+      int16x8_t b = vqaddq_s16(yc, vmulq_n_s16(us.val[i], c.u_to_b));
+      int16x8_t g = vqsubq_s16(vqsubq_s16(yc, vmulq_n_s16(us.val[i], c.u_to_g)), vmulq_n_s16(vs.val[i], c.v_to_g));
+      int16x8_t r = vqaddq_s16(yc, vmulq_n_s16(vs.val[i], c.v_to_r));
+      bs[i] = vqmovun_s16(vshrq_n_s16(vqaddq_s16(b, vdupq_n_s16(32)), 6));
+      gs[i] = vqmovun_s16(vshrq_n_s16(vqaddq_s16(g, vdupq_n_s16(32)), 6));
+      rs[i] = vqmovun_s16(vshrq_n_s16(vqaddq_s16(r, vdupq_n_s16(32)), 6));
+    }
+
+    b8 = vcombine_u8(bs[0], bs[1]);
+    g8 = vcombine_u8(gs[0], gs[1]);
+    r8 = vcombine_u8(rs[0], rs[1]);
+  }
+
+#endif
+
+  void kernel_i420_to_bgra_row(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* dst, int width, const YuvCoefficients& c) {
+
+    int x = 0;
+
+#if defined(SC_HAVE_SSE2)
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i center = _mm_set1_epi16(128);
+    __m128i alpha = _mm_set1_epi8((char)0xFF);
+
+    for (; x + 16 <= width; x += 16) {
+      __m128i b8, g8, r8;
+      __m128i uu = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(u + x / 2)), zero), center);
+      __m128i vv = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(v + x / 2)), zero), center);
+      sse2_yuv16_to_rgb(_mm_loadu_si128((const __m128i*)(y + x)), uu, vv, c, b8, g8, r8);
+      sse2_store_4x16(dst + x * 4, b8, g8, r8, alpha);
+    }
+
+#elif defined(SC_HAVE_NEON)
+
+    for (; x + 16 <= width; x += 16) {
+      uint8x16x4_t out;
+      int16x8_t uu = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(u + x / 2))), vdupq_n_s16(128));
+      int16x8_t vv = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(v + x / 2))), vdupq_n_s16(128));
+      neon_yuv16_to_rgb(vld1q_u8(y + x), uu, vv, c, out.val[0], out.val[1], out.val[2]);
+      out.val[3] = vdupq_n_u8(0xFF);
+      vst4q_u8(dst + x * 4, out);
+    }
+
+#endif
+
+    for (; x < width; ++x) {
+      yuv_to_pixel(y[x], u[x / 2], v[x / 2], dst + x * 4, 0, c);
+    }
+  }
+
+  /* Shared by the NV12 > BGRA and RGBA kernels; `swap_rb` is a constant so the compiler removes the branches. */
+  static inline void nv12_to_4ch_row(const uint8_t* y, const uint8_t* uv, uint8_t* dst, int width, int swap_rb, const YuvCoefficients& c) {
+
+    int x = 0;
+
+#if defined(SC_HAVE_SSE2)
+
+    __m128i mask = _mm_set1_epi16(0x00FF);
+    __m128i center = _mm_set1_epi16(128);
+    __m128i alpha = _mm_set1_epi8((char)0xFF);
+
+    for (; x + 16 <= width; x += 16) {
+      __m128i b8, g8, r8;
+      __m128i pairs = _mm_loadu_si128((const __m128i*)(uv + x));
+      __m128i uu = _mm_sub_epi16(_mm_and_si128(pairs, mask), center);
+      __m128i vv = _mm_sub_epi16(_mm_srli_epi16(pairs, 8), center);
+      sse2_yuv16_to_rgb(_mm_loadu_si128((const __m128i*)(y + x)), uu, vv, c, b8, g8, r8);
+      if (swap_rb) {
+        sse2_store_4x16(dst + x * 4, r8, g8, b8, alpha);
+      }
+      else {
+        sse2_store_4x16(dst + x * 4, b8, g8, r8, alpha);
+      }
+    }
+
+#elif defined(SC_HAVE_NEON)
+
+    for (; x + 16 <= width; x += 16) {
+      uint8x16x4_t out;
+      uint8x8x2_t pairs = vld2_u8(uv + x);
+      int16x8_t uu = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(pairs.val[0])), vdupq_n_s16(128));
+      int16x8_t vv = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(pairs.val[1])), vdupq_n_s16(128));
+      neon_yuv16_to_rgb(vld1q_u8(y + x), uu, vv, c, out.val[swap_rb ? 2 : 0], out.val[1], out.val[swap_rb ? 0 : 2]);
+      out.val[3] = vdupq_n_u8(0xFF);
+      vst4q_u8(dst + x * 4, out);
+    }
+
+#endif
+
+    for (; x < width; ++x) {
+      yuv_to_pixel(y[x], uv[(x / 2) * 2 + 0], uv[(x / 2) * 2 + 1], dst + x * 4, swap_rb, c);
+    }
+  }
+
+  void kernel_nv12_to_bgra_row(const uint8_t* y, const uint8_t* uv, uint8_t* dst, int width, const YuvCoefficients& c) {
+    nv12_to_4ch_row(y, uv, dst, width, 0, c);
+  }
+
+  void kernel_nv12_to_rgba_row(const uint8_t* y, const uint8_t* uv, uint8_t* dst, int width, const YuvCoefficients& c) {
+    nv12_to_4ch_row(y, uv, dst, width, 1, c);
+  }
+
+  /* ----------------------------------------------------------- */
+
+  void kernel_split_uv_row(const uint8_t* uv, uint8_t* u, uint8_t* v, int width) {
+
+    int x = 0;
+
+#if defined(SC_HAVE_SSE2)
+
+    __m128i mask = _mm_set1_epi16(0x00FF);
+
+    for (; x + 16 <= width; x += 16) {
+      __m128i a = _mm_loadu_si128((const __m128i*)(uv + x * 2));
+      __m128i b = _mm_loadu_si128((const __m128i*)(uv + x * 2 + 16));
+      _mm_storeu_si128((__m128i*)(u + x), _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask)));
+      _mm_storeu_si128((__m128i*)(v + x), _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+    }
+
+#elif defined(SC_HAVE_NEON)
+
+    for (; x + 16 <= width; x += 16) {
+      uint8x16x2_t p = vld2q_u8(uv + x * 2);
+      vst1q_u8(u + x, p.val[0]);
+      vst1q_u8(v + x, p.val[1]);
+    }
+
+#endif
+
+    for (; x < width; ++x) {
+      u[x] = uv[x * 2 + 0];
+      v[x] = uv[x * 2 + 1];
+    }
+  }
+
+  void kernel_merge_uv_row(const uint8_t* u, const uint8_t* v, uint8_t* uv, int width) {
+
+    int x = 0;
+
+#if defined(SC_HAVE_SSE2)
+
+    for (; x + 16 <= width; x += 16) {
+      __m128i a = _mm_loadu_si128((const __m128i*)(u + x));
+      __m128i b = _mm_loadu_si128((const __m128i*)(v + x));
+      _mm_storeu_si128((__m128i*)(uv + x * 2), _mm_unpacklo_epi8(a, b));
+      _mm_storeu_si128((__m128i*)(uv + x * 2 + 16), _mm_unpackhi_epi8(a, b));
+    }
+
+#elif defined(SC_HAVE_NEON)
+
+    for (; x + 16 <= width; x += 16) {
+      uint8x16x2_t p;
+      p.val[0] = vld1q_u8(u + x);
+      p.val[1] = vld1q_u8(v + x);
+      vst2q_u8(uv + x * 2, p);
+    }
+
+#endif
+
+    for (; x < width; ++x) {
+      uv[x * 2 + 0] = u[x];
+      uv[x * 2 + 1] = v[x];
+    }
+  }
+
+  /* ----------------------------------------------------------- */
+
+  void kernel_bgra_to_rgba_row(const uint8_t* src, uint8_t* dst, int width) {
+
+    int x = 0;
+
+#if defined(SC_HAVE_SSSE3)
+
+    __m128i shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+    for (; x + 4 <= width; x += 4) {
+      __m128i p = _mm_loadu_si128((const __m128i*)(src + x * 4));
+      _mm_storeu_si128((__m128i*)(dst + x * 4), _mm_shuffle_epi8(p, shuffle));
+    }
+
+#elif defined(SC_HAVE_SSE2)
+
+    __m128i mask_ga = _mm_set1_epi32(0xFF00FF00);
+    __m128i mask_rb = _mm_set1_epi32(0x00FF00FF);
+
+    for (; x + 4 <= width; x += 4) {
+      __m128i p = _mm_loadu_si128((const __m128i*)(src + x * 4));
+      __m128i rb = _mm_and_si128(p, mask_rb);
+      rb = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+      _mm_storeu_si128((__m128i*)(dst + x * 4), _mm_or_si128(_mm_and_si128(p, mask_ga), rb));
+    }
+
+#elif defined(SC_HAVE_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+
+    static const uint8_t shuffle_indices[16] = { 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15 };
+    uint8x16_t shuffle = vld1q_u8(shuffle_indices);
+
+    for (; x + 4 <= width; x += 4) {
+      vst1q_u8(dst + x * 4, vqtbl1q_u8(vld1q_u8(src + x * 4), shuffle));
+    }
+
+#elif defined(SC_HAVE_NEON)
+
+    for (; x + 16 <= width; x += 16) {
+      uint8x16x4_t p = vld4q_u8(src + x * 4);
+      uint8x16_t b = p.val[0];
+      p.val[0] = p.val[2];
+      p.val[2] = b;
+      vst4q_u8(dst + x * 4, p);
+    }
+
+#endif
+
+    for (; x < width; ++x) {
+      uint8_t b = src[x * 4 + 0];
+      dst[x * 4 + 0] = src[x * 4 + 2];
+      dst[x * 4 + 1] = src[x * 4 + 1];
+      dst[x * 4 + 2] = b;
+      dst[x * 4 + 3] = src[x * 4 + 3];
+    }
+  }
+
+#if defined(SC_HAVE_SSSE3)
+
+  /*
+    Packs 16 pixels into 48 bytes; `shuffle` moves the three colour
+    bytes of each pixel into the lower 12 bytes and zeros the upper 4.
+  */
+  static inline void ssse3_pack_bgra16_to_24(const uint8_t* src, uint8_t* dst, __m128i shuffle) {
+    __m128i a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 0)), shuffle);
+    __m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 16)), shuffle);
+    __m128i c = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 32)), shuffle);
+    __m128i d = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 48)), shuffle);
+    _mm_storeu_si128((__m128i*)(dst + 0), _mm_or_si128(a, _mm_slli_si128(b, 12)));
+    _mm_storeu_si128((__m128i*)(dst + 16), _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8)));
+    _mm_storeu_si128((__m128i*)(dst + 32), _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(d, 4)));
+  }
+
+#endif
+
+  void kernel_bgra_to_rgb24_row(const uint8_t* src, uint8_t* dst, int width) {
+
+    int x = 0;
+
+#if defined(SC_HAVE_SSSE3)
+
+    __m128i shuffle = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+    for (; x + 16 <= width; x += 16) {
+      ssse3_pack_bgra16_to_24(src + x * 4, dst + x * 3, shuffle);
+    }
+
+#elif defined(SC_HAVE_NEON)
+
+    for (; x + 16 <= width; x += 16) {
+      uint8x16x4_t p = vld4q_u8(src + x * 4);
+      uint8x16x3_t out;
+      out.val[0] = p.val[2];
+      out.val[1] = p.val[1];
+      out.val[2] = p.val[0];
+      vst3q_u8(dst + x * 3, out);
+    }
+
+#endif
+
+    for (; x < width; ++x) {
+      dst[x * 3 + 0] = src[x * 4 + 2];
+      dst[x * 3 + 1] = src[x * 4 + 1];
+      dst[x * 3 + 2] = src[x * 4 + 0];
+    }
+  }
+
+  void kernel_bgra_to_bgr24_row(const uint8_t* src, uint8_t* dst, int width) {
+
+    int x = 0;
+
+#if defined(SC_HAVE_SSSE3)
+
+    __m128i shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+    for (; x + 16 <= width; x += 16) {
+      ssse3_pack_bgra16_to_24(src + x * 4, dst + x * 3, shuffle);
+    }
+
+#elif defined(SC_HAVE_NEON)
+
+    for (; x + 16 <= width; x += 16) {
+      uint8x16x4_t p = vld4q_u8(src + x * 4);
+      uint8x16x3_t out;
+      out.val[0] = p.val[0];
+      out.val[1] = p.val[1];
+      out.val[2] = p.val[2];
+      vst3q_u8(dst + x * 3, out);
+    }
+
+#endif
+
+    for (; x < width; ++x) {
+      dst[x * 3 + 0] = src[x * 4 + 0];
+      dst[x * 3 + 1] = src[x * 4 + 1];
+      dst[x * 3 + 2] = src[x * 4 + 2];
+    }
+  }
+
+  /* ----------------------------------------------------------- */
+
+  /*
+    L10R is a little endian 32 bit word per pixel: 2 bits alpha in the
+    most significant bits followed by 10 bits R, G and B.
+  */
+
+  static inline uint16_t clamp_u10(int v) {
+    return (v < 0) ? 0 : ((v > 1023) ? 1023 : (uint16_t)v);
+  }
+
+  /* 10 bit Y for one pixel, stored in the upper bits of a 16 bit sample. */
+  static inline uint16_t rgb10_to_y(int r, int g, int b, const YuvCoefficients& c) {
+    return clamp_u10(((c.yr * r + c.yg * g + c.yb * b + 128) >> 8) + (c.y_offset << 2)) << 6;
+  }
+
+  /* 10 bit U or V for the sum of four pixels (2x2 block), stored in the upper bits of a 16 bit sample. */
+  static inline uint16_t rgb10x4_to_chroma(int r4, int g4, int b4, int cr, int cg, int cb) {
+    return clamp_u10(((cr * r4 + cg * g4 + cb * b4 + 512) >> 10) + 512) << 6;
+  }
+
+  /* Replicates the upper bits so 0x3FF becomes 0xFFFF. */
+  static inline uint16_t expand_u10(uint32_t v) {
+    return (uint16_t)((v << 6) | (v >> 4));
+  }
+
+#if defined(SC_HAVE_SSE2)
+
+  /* Splits 4 L10R pixels into 32 bit R, G and B lanes. */
+  static inline void sse2_unpack_l10r(__m128i p, __m128i& r, __m128i& g, __m128i& b) {
+    __m128i mask = _mm_set1_epi32(0x3FF);
+    b = _mm_and_si128(p, mask);
+    g = _mm_and_si128(_mm_srli_epi32(p, 10), mask);
+    r = _mm_and_si128(_mm_srli_epi32(p, 20), mask);
+  }
+
+  /*
+    Weighted sum of 4 R, G, B values (max 4092) using madd: `crg` holds
+    the (r, g) coefficient pairs and `cb` the (b, rounding) pairs.
+  */
+  static inline __m128i sse2_dot_rgb32(__m128i r, __m128i g, __m128i b, __m128i crg, __m128i cb) {
+    __m128i rg = _mm_or_si128(r, _mm_slli_epi32(g, 16));
+    __m128i b1 = _mm_or_si128(b, _mm_set1_epi32(0x10000));
+    return _mm_add_epi32(_mm_madd_epi16(rg, crg), _mm_madd_epi16(b1, cb));
+  }
+
+  /* Clamps 8 signed 16 bit values to 10 bits and moves them into the upper bits. */
+  static inline __m128i sse2_clamp_u10_msb(__m128i v) {
+    v = _mm_min_epi16(_mm_max_epi16(v, _mm_setzero_si128()), _mm_set1_epi16(1023));
+    return _mm_slli_epi16(v, 6);
+  }
+
+#endif
+
+  void kernel_l10r_to_p010_rows(const uint8_t* src0, const uint8_t* src1, uint16_t* y0, uint16_t* y1, uint16_t* uv, int width, const YuvCoefficients& c) {
+
+    const uint32_t* a = (const uint32_t*)src0;
+    const uint32_t* b = (const uint32_t*)src1;
+    int x = 0;
+
+#if defined(SC_HAVE_SSE2)
+
+    __m128i cy_rg = _mm_setr_epi16(c.yr, c.yg, c.yr, c.yg, c.yr, c.yg, c.yr, c.yg);
+    __m128i cy_b = _mm_setr_epi16(c.yb, 128, c.yb, 128, c.yb, 128, c.yb, 128);
+    __m128i cu_rg = _mm_setr_epi16(c.ur, c.ug, c.ur, c.ug, c.ur, c.ug, c.ur, c.ug);
+    __m128i cu_b = _mm_setr_epi16(c.ub, 512, c.ub, 512, c.ub, 512, c.ub, 512);
+    __m128i cv_rg = _mm_setr_epi16(c.vr, c.vg, c.vr, c.vg, c.vr, c.vg, c.vr, c.vg);
+    __m128i cv_b = _mm_setr_epi16(c.vb, 512, c.vb, 512, c.vb, 512, c.vb, 512);
+    __m128i y_offset = _mm_set1_epi16(c.y_offset << 2);
+    __m128i c_offset = _mm_set1_epi16(512);
+
+    for (; x + 8 <= width; x += 8) {
+
+      __m128i r[4], g[4], bl[4];
+      sse2_unpack_l10r(_mm_loadu_si128((const __m128i*)(a + x + 0)), r[0], g[0], bl[0]);
+      sse2_unpack_l10r(_mm_loadu_si128((const __m128i*)(a + x + 4)), r[1], g[1], bl[1]);
+      sse2_unpack_l10r(_mm_loadu_si128((const __m128i*)(b + x + 0)), r[2], g[2], bl[2]);
+      sse2_unpack_l10r(_mm_loadu_si128((const __m128i*)(b + x + 4)), r[3], g[3], bl[3]);
+
+      uint16_t* ydst[2] = { y0 + x, (NULL == y1) ? NULL : y1 + x };
+
+      for (int i = 0; i < 2; ++i) {
+        if (NULL == ydst[i]) {
+          continue;
+        }
+        __m128i lo = _mm_srai_epi32(sse2_dot_rgb32(r[i * 2 + 0], g[i * 2 + 0], bl[i * 2 + 0], cy_rg, cy_b), 8);
+        __m128i hi = _mm_srai_epi32(sse2_dot_rgb32(r[i * 2 + 1], g[i * 2 + 1], bl[i * 2 + 1], cy_rg, cy_b), 8);
+        __m128i yy = _mm_add_epi16(_mm_packs_epi32(lo, hi), y_offset);
+        _mm_storeu_si128((__m128i*)ydst[i], sse2_clamp_u10_msb(yy));
+      }
+
+      /* 2x2 sums; the vertical sum first, then the neighbouring pixels. */
+      __m128i r4 = sse2_add_pairs_epi32(_mm_add_epi32(r[0], r[2]), _mm_add_epi32(r[1], r[3]));
+      __m128i g4 = sse2_add_pairs_epi32(_mm_add_epi32(g[0], g[2]), _mm_add_epi32(g[1], g[3]));
+      __m128i b4 = sse2_add_pairs_epi32(_mm_add_epi32(bl[0], bl[2]), _mm_add_epi32(bl[1], bl[3]));
+      __m128i uu = _mm_srai_epi32(sse2_dot_rgb32(r4, g4, b4, cu_rg, cu_b), 10);
+      __m128i vv = _mm_srai_epi32(sse2_dot_rgb32(r4, g4, b4, cv_rg, cv_b), 10);
+      __m128i uv16 = _mm_add_epi16(_mm_packs_epi32(uu, vv), c_offset);
+
+      /* uv16 holds U0-U3 and V0-V3; interleave them. */
+      uv16 = _mm_unpacklo_epi16(uv16, _mm_srli_si128(uv16, 8));
+      _mm_storeu_si128((__m128i*)(uv + x), sse2_clamp_u10_msb(uv16));
+    }
+
+#elif defined(SC_HAVE_NEON)
+
+    int16x8_t y_offset = vdupq_n_s16(c.y_offset << 2);
+    int16x8_t max = vdupq_n_s16(1023);
+    int16x8_t zero = vdupq_n_s16(0);
+    uint32x4_t mask = vdupq_n_u32(0x3FF);
+
+    for (; x + 8 <= width; x += 8) {
+
+      int32x4_t r[4], g[4], bl[4];
+      const uint32_t* src[4] = { a + x, a + x + 4, b + x, b + x + 4 };
+
+      for (int i = 0; i < 4; ++i) {
+        uint32x4_t p = vld1q_u32(src[i]);
+        bl[i] = vreinterpretq_s32_u32(vandq_u32(p, mask));
+        g[i] = vreinterpretq_s32_u32(vandq_u32(vshrq_n_u32(p, 10), mask));
+        r[i] = vreinterpretq_s32_u32(vandq_u32(vshrq_n_u32(p, 20), mask));
+      }
+
+      uint16_t* ydst[2] = { y0 + x, (NULL == y1) ? NULL : y1 + x };
+
+      for (int i = 0; i < 2; ++i) {
+        if (NULL == ydst[i]) {
+          continue;
+        }
+        int32x4_t half[2];
+        for (int k = 0; k < 2; ++k) {
+          int32x4_t acc = vdupq_n_s32(128);
+          acc = vmlaq_n_s32(acc, r[i * 2 + k], c.yr);
+          acc = vmlaq_n_s32(acc, g[i * 2 + k], c.yg);
+          acc = vmlaq_n_s32(acc, bl[i * 2 + k], c.yb);
+          half[k] = vshrq_n_s32(acc, 8);
+        }
+        int16x8_t yy = vaddq_s16(vcombine_s16(vmovn_s32(half[0]), vmovn_s32(half[1])), y_offset);
+        yy = vminq_s16(vmaxq_s16(yy, zero), max);
+        vst1q_u16(ydst[i], vshlq_n_u16(vreinterpretq_u16_s16(yy), 6));
+      }
+
+      int32x4_t sr[2] = { vaddq_s32(r[0], r[2]), vaddq_s32(r[1], r[3]) };
+      int32x4_t sg[2] = { vaddq_s32(g[0], g[2]), vaddq_s32(g[1], g[3]) };
+      int32x4_t sb[2] = { vaddq_s32(bl[0], bl[2]), vaddq_s32(bl[1], bl[3]) };
+      int32x4_t r4 = vcombine_s32(vpadd_s32(vget_low_s32(sr[0]), vget_high_s32(sr[0])), vpadd_s32(vget_low_s32(sr[1]), vget_high_s32(sr[1])));
+      int32x4_t g4 = vcombine_s32(vpadd_s32(vget_low_s32(sg[0]), vget_high_s32(sg[0])), vpadd_s32(vget_low_s32(sg[1]), vget_high_s32(sg[1])));
+      int32x4_t b4 = vcombine_s32(vpadd_s32(vget_low_s32(sb[0]), vget_high_s32(sb[0])), vpadd_s32(vget_low_s32(sb[1]), vget_high_s32(sb[1])));
+      const int16_t coeffs[2][3] = { { c.ur, c.ug, c.ub }, { c.vr, c.vg, c.vb } };
+      int16x4_t ch[2];
+
+      for (int i = 0; i < 2; ++i) {
+        int32x4_t acc = vdupq_n_s32(512);
+        acc = vmlaq_n_s32(acc, r4, coeffs[i][0]);
+        acc = vmlaq_n_s32(acc, g4, coeffs[i][1]);
+        acc = vmlaq_n_s32(acc, b4, coeffs[i][2]);
+        ch[i] = vadd_s16(vmovn_s32(vshrq_n_s32(acc, 10)), vdup_n_s16(512));
+        ch[i] = vmin_s16(vmax_s16(ch[i], vdup_n_s16(0)), vdup_n_s16(1023));
+      }
+
+      uint16x4x2_t out;
+      out.val[0] = vshl_n_u16(vreinterpret_u16_s16(ch[0]), 6);
+      out.val[1] = vshl_n_u16(vreinterpret_u16_s16(ch[1]), 6);
+      vst2_u16(uv + x, out);
+    }
+
+#endif
+
+    /* Remaining pixels; an odd last column is treated as if it was duplicated. */
+    for (; x < width; x += 2) {
+
+      int x1 = (x + 1 < width) ? x + 1 : x;
+      uint32_t p[4] = { a[x], a[x1], b[x], b[x1] };
+      int r4 = 0, g4 = 0, b4 = 0;
+
+      for (int i = 0; i < 4; ++i) {
+        b4 += (p[i] >> 0) & 0x3FF;
+        g4 += (p[i] >> 10) & 0x3FF;
+        r4 += (p[i] >> 20) & 0x3FF;
+      }
+
+      y0[x] = rgb10_to_y((p[0] >> 20) & 0x3FF, (p[0] >> 10) & 0x3FF, p[0] & 0x3FF, c);
+      if (x1 != x) {
+        y0[x1] = rgb10_to_y((p[1] >> 20) & 0x3FF, (p[1] >> 10) & 0x3FF, p[1] & 0x3FF, c);
+      }
+
+      if (NULL != y1) {
+        y1[x] = rgb10_to_y((p[2] >> 20) & 0x3FF, (p[2] >> 10) & 0x3FF, p[2] & 0x3FF, c);
+        if (x1 != x) {
+          y1[x1] = rgb10_to_y((p[3] >> 20) & 0x3FF, (p[3] >> 10) & 0x3FF, p[3] & 0x3FF, c);
+        }
+      }
+
+      uv[x + 0] = rgb10x4_to_chroma(r4, g4, b4, c.ur, c.ug, c.ub);
+      uv[x + 1] = rgb10x4_to_chroma(r4, g4, b4, c.vr, c.vg, c.vb);
+    }
+  }
+
+  void kernel_l10r_to_rgb48_row(const uint8_t* src, uint16_t* dst, int width) {
+
+    const uint32_t* p = (const uint32_t*)src;
+    int x = 0;
+
+#if defined(SC_HAVE_SSSE3)
+
+    /* Each output vector gets its 16 bit R, G and B samples from three shuffles; see the R, G, B order of RGB48. */
+    const __m128i shuffle[3][3] = {
+      { _mm_setr_epi8(0, 1, -1, -1, -1, -1, 2, 3, -1, -1, -1, -1, 4, 5, -1, -1),
+        _mm_setr_epi8(-1, -1, 0, 1, -1, -1, -1, -1, 2, 3, -1, -1, -1, -1, 4, 5),
+        _mm_setr_epi8(-1, -1, -1, -1, 0, 1, -1, -1, -1, -1, 2, 3, -1, -1, -1, -1) },
+      { _mm_setr_epi8(-1, -1, 6, 7, -1, -1, -1, -1, 8, 9, -1, -1, -1, -1, 10, 11),
+        _mm_setr_epi8(-1, -1, -1, -1, 6, 7, -1, -1, -1, -1, 8, 9, -1, -1, -1, -1),
+        _mm_setr_epi8(4, 5, -1, -1, -1, -1, 6, 7, -1, -1, -1, -1, 8, 9, -1, -1) },
+      { _mm_setr_epi8(-1, -1, -1, -1, 12, 13, -1, -1, -1, -1, 14, 15, -1, -1, -1, -1),
+        _mm_setr_epi8(10, 11, -1, -1, -1, -1, 12, 13, -1, -1, -1, -1, 14, 15, -1, -1),
+        _mm_setr_epi8(-1, -1, 10, 11, -1, -1, -1, -1, 12, 13, -1, -1, -1, -1, 14, 15) }
+    };
+
+    for (; x + 8 <= width; x += 8) {
+
+      __m128i r0, g0, b0, r1, g1, b1;
+      sse2_unpack_l10r(_mm_loadu_si128((const __m128i*)(p + x + 0)), r0, g0, b0);
+      sse2_unpack_l10r(_mm_loadu_si128((const __m128i*)(p + x + 4)), r1, g1, b1);
+
+      __m128i rgb[3] = { _mm_packs_epi32(r0, r1), _mm_packs_epi32(g0, g1), _mm_packs_epi32(b0, b1) };
+
+      for (int i = 0; i < 3; ++i) {
+        rgb[i] = _mm_or_si128(_mm_slli_epi16(rgb[i], 6), _mm_srli_epi16(rgb[i], 4));
+      }
+
+      for (int k = 0; k < 3; ++k) {
+        __m128i out = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(rgb[0], shuffle[k][0]),
+                                                _mm_shuffle_epi8(rgb[1], shuffle[k][1])),
+                                   _mm_shuffle_epi8(rgb[2], shuffle[k][2]));
+        _mm_storeu_si128((__m128i*)(dst + x * 3 + k * 8), out);
+      }
+    }
+
+#elif defined(SC_HAVE_NEON)
+
+    uint32x4_t mask = vdupq_n_u32(0x3FF);
+
+    for (; x + 8 <= width; x += 8) {
+
+      uint32x4_t lo = vld1q_u32(p + x);
+      uint32x4_t hi = vld1q_u32(p + x + 4);
+      uint16x8_t b = vcombine_u16(vmovn_u32(vandq_u32(lo, mask)), vmovn_u32(vandq_u32(hi, mask)));
+      uint16x8_t g = vcombine_u16(vmovn_u32(vandq_u32(vshrq_n_u32(lo, 10), mask)), vmovn_u32(vandq_u32(vshrq_n_u32(hi, 10), mask)));
+      uint16x8_t r = vcombine_u16(vmovn_u32(vandq_u32(vshrq_n_u32(lo, 20), mask)), vmovn_u32(vandq_u32(vshrq_n_u32(hi, 20), mask)));
+
+      uint16x8x3_t out;
+      out.val[0] = vorrq_u16(vshlq_n_u16(r, 6), vshrq_n_u16(r, 4));
+      out.val[1] = vorrq_u16(vshlq_n_u16(g, 6), vshrq_n_u16(g, 4));
+      out.val[2] = vorrq_u16(vshlq_n_u16(b, 6), vshrq_n_u16(b, 4));
+      vst3q_u16(dst + x * 3, out);
+    }
+
+#endif
+
+    for (; x < width; ++x) {
+      dst[x * 3 + 0] = expand_u10((p[x] >> 20) & 0x3FF);
+      dst[x * 3 + 1] = expand_u10((p[x] >> 10) & 0x3FF);
+      dst[x * 3 + 2] = expand_u10(p[x] & 0x3FF);
+    }
+  }
+
+  void kernel_l10r_to_bgra_row(const uint8_t* src, uint8_t* dst, int width, int d0, int d1) {
+
+    const uint32_t* p = (const uint32_t*)src;
+    int x = 0;
+
+#if defined(SC_HAVE_SSE2)
+
+    /* The values fit in the lower 16 bits of each lane so we can use the 16 bit min and multiply. */
+    __m128i dither = _mm_setr_epi32(d0, d1, d0, d1);
+    __m128i max = _mm_set1_epi32(255);
+    __m128i alpha_scale = _mm_set1_epi32(85);
+
+    for (; x + 4 <= width; x += 4) {
+      __m128i px = _mm_loadu_si128((const __m128i*)(p + x));
+      __m128i r, g, b;
+      sse2_unpack_l10r(px, r, g, b);
+      b = _mm_min_epi16(_mm_srli_epi32(_mm_add_epi32(b, dither), 2), max);
+      g = _mm_min_epi16(_mm_srli_epi32(_mm_add_epi32(g, dither), 2), max);
+      r = _mm_min_epi16(_mm_srli_epi32(_mm_add_epi32(r, dither), 2), max);
+      __m128i a = _mm_mullo_epi16(_mm_srli_epi32(px, 30), alpha_scale);
+      __m128i bgra = _mm_or_si128(_mm_or_si128(b, _mm_slli_epi32(g, 8)), _mm_or_si128(_mm_slli_epi32(r, 16), _mm_slli_epi32(a, 24)));
+      _mm_storeu_si128((__m128i*)(dst + x * 4), bgra);
+    }
+
+#elif defined(SC_HAVE_NEON)
+
+    const uint32_t dither_values[4] = { (uint32_t)d0, (uint32_t)d1, (uint32_t)d0, (uint32_t)d1 };
+    uint32x4_t dither = vld1q_u32(dither_values);
+    uint32x4_t mask = vdupq_n_u32(0x3FF);
+    uint32x4_t max = vdupq_n_u32(255);
+
+    for (; x + 4 <= width; x += 4) {
+      uint32x4_t px = vld1q_u32(p + x);
+      uint32x4_t b = vminq_u32(vshrq_n_u32(vaddq_u32(vandq_u32(px, mask), dither), 2), max);
+      uint32x4_t g = vminq_u32(vshrq_n_u32(vaddq_u32(vandq_u32(vshrq_n_u32(px, 10), mask), dither), 2), max);
+      uint32x4_t r = vminq_u32(vshrq_n_u32(vaddq_u32(vandq_u32(vshrq_n_u32(px, 20), mask), dither), 2), max);
+      uint32x4_t a = vmulq_n_u32(vshrq_n_u32(px, 30), 85);
+      uint32x4_t bgra = vorrq_u32(vorrq_u32(b, vshlq_n_u32(g, 8)), vorrq_u32(vshlq_n_u32(r, 16), vshlq_n_u32(a, 24)));
+      vst1q_u8(dst + x * 4, vreinterpretq_u8_u32(bgra));
+    }
+
+#endif
+
+    for (; x < width; ++x) {
+      uint32_t d = (x & 1) ? d1 : d0;
+      uint32_t b = ((p[x] & 0x3FF) + d) >> 2;
+      uint32_t g = (((p[x] >> 10) & 0x3FF) + d) >> 2;
+      uint32_t r = (((p[x] >> 20) & 0x3FF) + d) >> 2;
+      dst[x * 4 + 0] = (b > 255) ? 255 : b;
+      dst[x * 4 + 1] = (g > 255) ? 255 : g;
+      dst[x * 4 + 2] = (r > 255) ? 255 : r;
+      dst[x * 4 + 3] = (p[x] >> 30) * 85;
+    }
+  }
+
+  /* ----------------------------------------------------------- */
+
+  /* Bilinear weights use 7 fractional bits so a * 128 + (b - a) * frac fits in a signed 16 bit value. */
+  static inline uint8_t lerp_u8(int a, int b, int frac) {
+    return (uint8_t)(((a << 7) + (b - a) * frac + 64) >> 7);
+  }
+
+  static inline uint32_t load_u32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+  }
+
+#if defined(SC_HAVE_SSE2)
+
+  /* 8 lerps of 16 bit values; see lerp_u8(). */
+  static inline __m128i sse2_lerp_epi16(__m128i a, __m128i b, __m128i frac) {
+    __m128i v = _mm_add_epi16(_mm_slli_epi16(a, 7), _mm_mullo_epi16(_mm_sub_epi16(b, a), frac));
+    return _mm_srli_epi16(_mm_add_epi16(v, _mm_set1_epi16(64)), 7);
+  }
+
+  /* `p` holds two pairs of 4 byte samples (a0, b0, a1, b1) > blended a0-b0 and a1-b1 as 16 bit values. */
+  static inline __m128i sse2_lerp_pairs4(__m128i p, __m128i frac) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_unpacklo_epi8(p, zero);
+    __m128i hi = _mm_unpackhi_epi8(p, zero);
+    return sse2_lerp_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi), frac);
+  }
+
+#endif
+
+  void kernel_scale_rows_v(const uint8_t* src0, const uint8_t* src1, uint8_t* dst, int nbytes, int frac) {
+
+    int x = 0;
+
+    if (0 == frac) {
+      memcpy(dst, src0, nbytes);
+      return;
+    }
+
+#if defined(SC_HAVE_SSE2)
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i f = _mm_set1_epi16(frac);
+
+    for (; x + 16 <= nbytes; x += 16) {
+      __m128i a = _mm_loadu_si128((const __m128i*)(src0 + x));
+      __m128i b = _mm_loadu_si128((const __m128i*)(src1 + x));
+      __m128i lo = sse2_lerp_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), f);
+      __m128i hi = sse2_lerp_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), f);
+      _mm_storeu_si128((__m128i*)(dst + x), _mm_packus_epi16(lo, hi));
+    }
+
+#elif defined(SC_HAVE_NEON)
+
+    /* a * (128 - frac) + b * frac is the same as the lerp_u8() formula and stays unsigned. */
+    uint8x8_t fb = vdup_n_u8((uint8_t)frac);
+    uint8x8_t fa = vdup_n_u8((uint8_t)(128 - frac));
+
+    for (; x + 16 <= nbytes; x += 16) {
+      uint8x16_t a = vld1q_u8(src0 + x);
+      uint8x16_t b = vld1q_u8(src1 + x);
+      uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(a), fa), vget_low_u8(b), fb);
+      uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(a), fa), vget_high_u8(b), fb);
+      vst1q_u8(dst + x, vcombine_u8(vrshrn_n_u16(lo, 7), vrshrn_n_u16(hi, 7)));
+    }
+
+#endif
+
+    for (; x < nbytes; ++x) {
+      dst[x] = lerp_u8(src0[x], src1[x], frac);
+    }
+  }
+
+  void kernel_scale_row_h(const uint8_t* src, uint8_t* dst, int width, int bpp, const int* offsets, const int16_t* fracs) {
+
+    int x = 0;
+
+#if defined(SC_HAVE_SSE2)
+
+    if (4 == bpp) {
+
+      /* Two destination pixels per 128 bits: each 8 byte load holds a pixel and its right neighbour. */
+      for (; x + 4 <= width; x += 4) {
+        __m128i p01 = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)(src + offsets[x + 0])), _mm_loadl_epi64((const __m128i*)(src + offsets[x + 1])));
+        __m128i p23 = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)(src + offsets[x + 2])), _mm_loadl_epi64((const __m128i*)(src + offsets[x + 3])));
+        __m128i f01 = _mm_unpacklo_epi64(_mm_set1_epi16(fracs[x + 0]), _mm_set1_epi16(fracs[x + 1]));
+        __m128i f23 = _mm_unpacklo_epi64(_mm_set1_epi16(fracs[x + 2]), _mm_set1_epi16(fracs[x + 3]));
+        _mm_storeu_si128((__m128i*)(dst + x * 4), _mm_packus_epi16(sse2_lerp_pairs4(p01, f01), sse2_lerp_pairs4(p23, f23)));
+      }
+    }
+    else if (2 == bpp) {
+
+      /* Four interleaved UV samples; every 4 byte load holds a sample and its right neighbour. */
+      for (; x + 4 <= width; x += 4) {
+        __m128i zero = _mm_setzero_si128();
+        __m128i p = _mm_setr_epi32(load_u32(src + offsets[x + 0]), load_u32(src + offsets[x + 1]), load_u32(src + offsets[x + 2]), load_u32(src + offsets[x + 3]));
+        __m128 lo = _mm_castsi128_ps(_mm_unpacklo_epi8(p, zero));
+        __m128 hi = _mm_castsi128_ps(_mm_unpackhi_epi8(p, zero));
+        __m128i a = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i b = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+        __m128i f = _mm_loadl_epi64((const __m128i*)(fracs + x));
+        __m128i r = sse2_lerp_epi16(a, b, _mm_unpacklo_epi16(f, f));
+        _mm_storel_epi64((__m128i*)(dst + x * 2), _mm_packus_epi16(r, r));
+      }
+    }
+    else if (1 == bpp) {
+
+      /* Eight samples; every 16 bit value holds a sample and its right neighbour. */
+      for (; x + 8 <= width; x += 8) {
+        __m128i p = _mm_setzero_si128();
+        p = _mm_insert_epi16(p, src[offsets[x + 0]] | (src[offsets[x + 0] + 1] << 8), 0);
+        p = _mm_insert_epi16(p, src[offsets[x + 1]] | (src[offsets[x + 1] + 1] << 8), 1);
+        p = _mm_insert_epi16(p, src[offsets[x + 2]] | (src[offsets[x + 2] + 1] << 8), 2);
+        p = _mm_insert_epi16(p, src[offsets[x + 3]] | (src[offsets[x + 3] + 1] << 8), 3);
+        p = _mm_insert_epi16(p, src[offsets[x + 4]] | (src[offsets[x + 4] + 1] << 8), 4);
+        p = _mm_insert_epi16(p, src[offsets[x + 5]] | (src[offsets[x + 5] + 1] << 8), 5);
+        p = _mm_insert_epi16(p, src[offsets[x + 6]] | (src[offsets[x + 6] + 1] << 8), 6);
+        p = _mm_insert_epi16(p, src[offsets[x + 7]] | (src[offsets[x + 7] + 1] << 8), 7);
+        __m128i a = _mm_and_si128(p, _mm_set1_epi16(0x00FF));
+        __m128i b = _mm_srli_epi16(p, 8);
+        __m128i r = sse2_lerp_epi16(a, b, _mm_loadu_si128((const __m128i*)(fracs + x)));
+        _mm_storel_epi64((__m128i*)(dst + x), _mm_packus_epi16(r, r));
+      }
+    }
+
+#elif defined(SC_HAVE_NEON)
+
+    if (4 == bpp) {
+
+      for (; x + 2 <= width; x += 2) {
+        uint32x2x2_t p = vzip_u32(vreinterpret_u32_u8(vld1_u8(src + offsets[x + 0])), vreinterpret_u32_u8(vld1_u8(src + offsets[x + 1])));
+        uint32x2_t f32 = vset_lane_u32((uint32_t)fracs[x + 1] * 0x01010101, vdup_n_u32((uint32_t)fracs[x + 0] * 0x01010101), 1);
+        uint8x8_t fb = vreinterpret_u8_u32(f32);
+        uint8x8_t fa = vsub_u8(vdup_n_u8(128), fb);
+        uint16x8_t v = vmlal_u8(vmull_u8(vreinterpret_u8_u32(p.val[0]), fa), vreinterpret_u8_u32(p.val[1]), fb);
+        vst1_u8(dst + x * 4, vrshrn_n_u16(v, 7));
+      }
+    }
+
+#endif
+
+    for (; x < width; ++x) {
+      const uint8_t* p = src + offsets[x];
+      for (int k = 0; k < bpp; ++k) {
+        dst[x * bpp + k] = lerp_u8(p[k], p[k + bpp], fracs[x]);
+      }
+    }
+  }
+
+  /* ----------------------------------------------------------- */
+
+  /*
+    Rounded mean of a factor x factor block sum; for 3 x 3 blocks
+    (s + 4) * 7282 >> 16 is the same as (s + 4) / 9 for all sums
+    of 9 bytes.
+  */
+  static inline uint8_t box_normalize(int sum, int factor) {
+    switch (factor) {
+      case 2: { return (uint8_t)((sum + 2) >> 2); }
+      case 3: { return (uint8_t)(((sum + 4) * 7282) >> 16); }
+      case 4: { return (uint8_t)((sum + 8) >> 4); }
+    }
+    return 0;
+  }
+
+#if defined(SC_HAVE_SSE2)
+
+  /* See box_normalize(). */
+  static inline __m128i sse2_box_normalize(__m128i sum, int factor) {
+    switch (factor) {
+      case 2: { return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2); }
+      case 3: { return _mm_mulhi_epu16(_mm_add_epi16(sum, _mm_set1_epi16(4)), _mm_set1_epi16(7282)); }
+      case 4: { return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(8)), 4); }
+    }
+    return _mm_setzero_si128();
+  }
+
+  /* Adds the neighbouring 32 bit lanes of two vectors, see sse2_add_pairs_epi32(); used on pairs of 16 bit values. */
+  static inline __m128i sse2_add_pairs_epi16x2(__m128i a, __m128i b) {
+    __m128 fa = _mm_castsi128_ps(a);
+    __m128 fb = _mm_castsi128_ps(b);
+    __m128i even = _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(2, 0, 2, 0)));
+    __m128i odd = _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(3, 1, 3, 1)));
+    return _mm_add_epi16(even, odd);
+  }
+
+#if defined(SC_HAVE_SSSE3)
+
+  /* Combines the bytes that `m0`, `m1` and `m2` select from `v0`, `v1` and `v2`; the masks select disjoint lanes. */
+  static inline __m128i ssse3_gather3(__m128i v0, __m128i v1, __m128i v2, __m128i m0, __m128i m1, __m128i m2) {
+    return _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, m0), _mm_shuffle_epi8(v1, m1)), _mm_shuffle_epi8(v2, m2));
+  }
+
+#endif
+
+#endif
+
+  void kernel_box_2x2_row(const uint8_t* src0, const uint8_t* src1, uint8_t* dst, int width, int bpp) {
+
+    int x = 0;
+
+#if defined(SC_HAVE_SSE2)
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i round = _mm_set1_epi16(2);
+
+    if (4 == bpp) {
+#if defined(SC_HAVE_AVX2)
+      for (; x + 8 <= width; x += 8) {
+        __m256i s0 = avx2_sum_2x2(_mm256_loadu_si256((const __m256i*)(src0 + x * 8)), _mm256_loadu_si256((const __m256i*)(src1 + x * 8)));
+        __m256i s1 = avx2_sum_2x2(_mm256_loadu_si256((const __m256i*)(src0 + x * 8 + 32)), _mm256_loadu_si256((const __m256i*)(src1 + x * 8 + 32)));
+        s0 = _mm256_srli_epi16(_mm256_add_epi16(s0, _mm256_set1_epi16(2)), 2);
+        s1 = _mm256_srli_epi16(_mm256_add_epi16(s1, _mm256_set1_epi16(2)), 2);
+        _mm256_storeu_si256((__m256i*)(dst + x * 4), _mm256_permute4x64_epi64(_mm256_packus_epi16(s0, s1), _MM_SHUFFLE(3, 1, 2, 0)));
+      }
+#endif
+      for (; x + 4 <= width; x += 4) {
+        __m128i s0 = sse2_sum_2x2(_mm_loadu_si128((const __m128i*)(src0 + x * 8)), _mm_loadu_si128((const __m128i*)(src1 + x * 8)));
+        __m128i s1 = sse2_sum_2x2(_mm_loadu_si128((const __m128i*)(src0 + x * 8 + 16)), _mm_loadu_si128((const __m128i*)(src1 + x * 8 + 16)));
+        s0 = _mm_srli_epi16(_mm_add_epi16(s0, round), 2);
+        s1 = _mm_srli_epi16(_mm_add_epi16(s1, round), 2);
+        _mm_storeu_si128((__m128i*)(dst + x * 4), _mm_packus_epi16(s0, s1));
+      }
+    }
+    else if (2 == bpp) {
+#if defined(SC_HAVE_AVX2)
+      for (; x + 8 <= width; x += 8) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(src0 + x * 4));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(src1 + x * 4));
+        __m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(a, _mm256_setzero_si256()), _mm256_unpacklo_epi8(b, _mm256_setzero_si256()));
+        __m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(a, _mm256_setzero_si256()), _mm256_unpackhi_epi8(b, _mm256_setzero_si256()));
+        __m256 flo = _mm256_castsi256_ps(lo);
+        __m256 fhi = _mm256_castsi256_ps(hi);
+        __m256i even = _mm256_castps_si256(_mm256_shuffle_ps(flo, fhi, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m256i odd = _mm256_castps_si256(_mm256_shuffle_ps(flo, fhi, _MM_SHUFFLE(3, 1, 3, 1)));
+        __m256i r = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(even, odd), _mm256_set1_epi16(2)), 2);
+        r = _mm256_permute4x64_epi64(_mm256_packus_epi16(r, r), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm_storeu_si128((__m128i*)(dst + x * 2), _mm256_castsi256_si128(r));
+      }
+#endif
+      for (; x + 4 <= width; x += 4) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src0 + x * 4));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src1 + x * 4));
+        __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+        __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+        __m128i r = _mm_srli_epi16(_mm_add_epi16(sse2_add_pairs_epi16x2(lo, hi), round), 2);
+        _mm_storel_epi64((__m128i*)(dst + x * 2), _mm_packus_epi16(r, r));
+      }
+    }
+    else if (1 == bpp) {
+#if defined(SC_HAVE_AVX2)
+      for (; x + 16 <= width; x += 16) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(src0 + x * 2));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(src1 + x * 2));
+        __m256i even = _mm256_add_epi16(_mm256_and_si256(a, _mm256_set1_epi16(0x00FF)), _mm256_and_si256(b, _mm256_set1_epi16(0x00FF)));
+        __m256i odd = _mm256_add_epi16(_mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8));
+        __m256i r = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(even, odd), _mm256_set1_epi16(2)), 2);
+        r = _mm256_permute4x64_epi64(_mm256_packus_epi16(r, r), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm_storeu_si128((__m128i*)(dst + x), _mm256_castsi256_si128(r));
+      }
+#endif
+      __m128i mask = _mm_set1_epi16(0x00FF);
+      for (; x + 8 <= width; x += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src0 + x * 2));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src1 + x * 2));
+        __m128i even = _mm_add_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+        __m128i odd = _mm_add_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+        __m128i r = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(even, odd), round), 2);
+        _mm_storel_epi64((__m128i*)(dst + x), _mm_packus_epi16(r, r));
+      }
+    }
+
+#elif defined(SC_HAVE_NEON)
+
+    if (4 == bpp) {
+      for (; x + 2 <= width; x += 2) {
+        uint8x16_t a = vld1q_u8(src0 + x * 8);
+        uint8x16_t b = vld1q_u8(src1 + x * 8);
+        uint16x8_t lo = vaddl_u8(vget_low_u8(a), vget_low_u8(b));
+        uint16x8_t hi = vaddl_u8(vget_high_u8(a), vget_high_u8(b));
+        uint16x8_t s = vcombine_u16(vadd_u16(vget_low_u16(lo), vget_high_u16(lo)), vadd_u16(vget_low_u16(hi), vget_high_u16(hi)));
+        vst1_u8(dst + x * 4, vrshrn_n_u16(s, 2));
+      }
+    }
+    else if (2 == bpp) {
+      for (; x + 4 <= width; x += 4) {
+        uint8x16_t a = vld1q_u8(src0 + x * 4);
+        uint8x16_t b = vld1q_u8(src1 + x * 4);
+        uint16x8_t lo = vaddl_u8(vget_low_u8(a), vget_low_u8(b));
+        uint16x8_t hi = vaddl_u8(vget_high_u8(a), vget_high_u8(b));
+        uint32x4x2_t uv = vuzpq_u32(vreinterpretq_u32_u16(lo), vreinterpretq_u32_u16(hi));
+        uint16x8_t s = vaddq_u16(vreinterpretq_u16_u32(uv.val[0]), vreinterpretq_u16_u32(uv.val[1]));
+        vst1_u8(dst + x * 2, vrshrn_n_u16(s, 2));
+      }
+    }
+    else if (1 == bpp) {
+      for (; x + 8 <= width; x += 8) {
+        uint16x8_t s = vpaddlq_u8(vld1q_u8(src0 + x * 2));
+        s = vpadalq_u8(s, vld1q_u8(src1 + x * 2));
+        vst1_u8(dst + x, vrshrn_n_u16(s, 2));
+      }
+    }
+
+#endif
+
+    for (; x < width; ++x) {
+      for (int c = 0; c < bpp; ++c) {
+        int i = x * 2 * bpp + c;
+        dst[x * bpp + c] = box_normalize(src0[i] + src0[i + bpp] + src1[i] + src1[i + bpp], 2);
+      }
+    }
+  }
+
+  void kernel_box_sum_rows(const uint8_t* src, size_t stride, int nrows, uint16_t* sums, int nbytes) {
+
+    int x = 0;
+
+#if defined(SC_HAVE_SSE2)
+
+    __m128i zero = _mm_setzero_si128();
+
+    for (; x + 16 <= nbytes; x += 16) {
+      __m128i lo = zero;
+      __m128i hi = zero;
+      for (int j = 0; j < nrows; ++j) {
+        __m128i p = _mm_loadu_si128((const __m128i*)(src + j * stride + x));
+        lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(p, zero));
+        hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(p, zero));
+      }
+      _mm_storeu_si128((__m128i*)(sums + x), lo);
+      _mm_storeu_si128((__m128i*)(sums + x + 8), hi);
+    }
+
+#elif defined(SC_HAVE_NEON)
+
+    for (; x + 16 <= nbytes; x += 16) {
+      uint16x8_t lo = vdupq_n_u16(0);
+      uint16x8_t hi = vdupq_n_u16(0);
+      for (int j = 0; j < nrows; ++j) {
+        uint8x16_t p = vld1q_u8(src + j * stride + x);
+        lo = vaddw_u8(lo, vget_low_u8(p));
+        hi = vaddw_u8(hi, vget_high_u8(p));
+      }
+      vst1q_u16(sums + x, lo);
+      vst1q_u16(sums + x + 8, hi);
+    }
+
+#endif
+
+    for (; x < nbytes; ++x) {
+      uint16_t s = 0;
+      for (int j = 0; j < nrows; ++j) {
+        s += src[j * stride + x];
+      }
+      sums[x] = s;
+    }
+  }
+
+  void kernel_box_reduce_row(const uint16_t* sums, uint8_t* dst, int width, int bpp, int factor) {
+
+    int x = 0;
+
+#if defined(SC_HAVE_SSE2)
+
+    if (4 == bpp) {
+
+      /* Two pixels per vector; every 64 bit load holds the B, G, R, A sums of one source pixel. */
+      for (; x + 2 <= width; x += 2) {
+        const uint16_t* a = sums + (x + 0) * factor * 4;
+        const uint16_t* b = sums + (x + 1) * factor * 4;
+        __m128i s = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)a), _mm_loadl_epi64((const __m128i*)b));
+        for (int k = 1; k < factor; ++k) {
+          s = _mm_add_epi16(s, _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)(a + k * 4)), _mm_loadl_epi64((const __m128i*)(b + k * 4))));
+        }
+        __m128i r = sse2_box_normalize(s, factor);
+        _mm_storel_epi64((__m128i*)(dst + x * 4), _mm_packus_epi16(r, r));
+      }
+    }
+    else if (2 == bpp && 3 != factor) {
+
+      /* Four UV samples; add neighbouring (u, v) pairs once or twice. */
+      for (; x + 4 <= width; x += 4) {
+        const __m128i* p = (const __m128i*)(sums + x * factor * 2);
+        __m128i s = sse2_add_pairs_epi16x2(_mm_loadu_si128(p + 0), _mm_loadu_si128(p + 1));
+        if (4 == factor) {
+          __m128i t = sse2_add_pairs_epi16x2(_mm_loadu_si128(p + 2), _mm_loadu_si128(p + 3));
+          s = sse2_add_pairs_epi16x2(s, t);
+        }
+        __m128i r = sse2_box_normalize(s, factor);
+        _mm_storel_epi64((__m128i*)(dst + x * 2), _mm_packus_epi16(r, r));
+      }
+    }
+    else if (1 == bpp && 3 != factor) {
+
+      /* Eight samples; madd with ones adds neighbouring samples into 32 bit lanes. */
+      __m128i ones = _mm_set1_epi16(1);
+
+      for (; x + 8 <= width; x += 8) {
+        const __m128i* p = (const __m128i*)(sums + x * factor);
+        __m128i s0 = _mm_madd_epi16(_mm_loadu_si128(p + 0), ones);
+        __m128i s1 = _mm_madd_epi16(_mm_loadu_si128(p + 1), ones);
+        if (4 == factor) {
+          s0 = sse2_add_pairs_epi32(s0, s1);
+          s1 = sse2_add_pairs_epi32(_mm_madd_epi16(_mm_loadu_si128(p + 2), ones), _mm_madd_epi16(_mm_loadu_si128(p + 3), ones));
+        }
+        __m128i r = sse2_box_normalize(_mm_packs_epi32(s0, s1), factor);
+        _mm_storel_epi64((__m128i*)(dst + x), _mm_packus_epi16(r, r));
+      }
+    }
+
+#if defined(SC_HAVE_SSSE3)
+
+    /* 3x: gather the first, second and third sample of every block from 3 vectors of sums. */
+    else if (1 == bpp) {
+
+      for (; x + 8 <= width; x += 8) {
+        const __m128i* p = (const __m128i*)(sums + x * 3);
+        __m128i v0 = _mm_loadu_si128(p + 0);
+        __m128i v1 = _mm_loadu_si128(p + 1);
+        __m128i v2 = _mm_loadu_si128(p + 2);
+        __m128i a = ssse3_gather3(v0, v1, v2,
+                                  _mm_setr_epi8(0, 1, 6, 7, 12, 13, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128),
+                                  _mm_setr_epi8(-128, -128, -128, -128, -128, -128, 2, 3, 8, 9, 14, 15, -128, -128, -128, -128),
+                                  _mm_setr_epi8(-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 4, 5, 10, 11));
+        __m128i b = ssse3_gather3(v0, v1, v2,
+                                  _mm_setr_epi8(2, 3, 8, 9, 14, 15, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128),
+                                  _mm_setr_epi8(-128, -128, -128, -128, -128, -128, 4, 5, 10, 11, -128, -128, -128, -128, -128, -128),
+                                  _mm_setr_epi8(-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 0, 1, 6, 7, 12, 13));
+        __m128i c = ssse3_gather3(v0, v1, v2,
+                                  _mm_setr_epi8(4, 5, 10, 11, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128),
+                                  _mm_setr_epi8(-128, -128, -128, -128, 0, 1, 6, 7, 12, 13, -128, -128, -128, -128, -128, -128),
+                                  _mm_setr_epi8(-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 2, 3, 8, 9, 14, 15));
+        __m128i r = sse2_box_normalize(_mm_add_epi16(_mm_add_epi16(a, b), c), 3);
+        _mm_storel_epi64((__m128i*)(dst + x), _mm_packus_epi16(r, r));
+      }
+    }
+    else if (2 == bpp) {
+
+      for (; x + 4 <= width; x += 4) {
+        const __m128i* p = (const __m128i*)(sums + x * 6);
+        __m128i v0 = _mm_loadu_si128(p + 0);
+        __m128i v1 = _mm_loadu_si128(p + 1);
+        __m128i v2 = _mm_loadu_si128(p + 2);
+        __m128i a = ssse3_gather3(v0, v1, v2,
+                                  _mm_setr_epi8(0, 1, 2, 3, 12, 13, 14, 15, -128, -128, -128, -128, -128, -128, -128, -128),
+                                  _mm_setr_epi8(-128, -128, -128, -128, -128, -128, -128, -128, 8, 9, 10, 11, -128, -128, -128, -128),
+                                  _mm_setr_epi8(-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 4, 5, 6, 7));
+        __m128i b = ssse3_gather3(v0, v1, v2,
+                                  _mm_setr_epi8(4, 5, 6, 7, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128),
+                                  _mm_setr_epi8(-128, -128, -128, -128, 0, 1, 2, 3, 12, 13, 14, 15, -128, -128, -128, -128),
+                                  _mm_setr_epi8(-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 8, 9, 10, 11));
+        __m128i c = ssse3_gather3(v0, v1, v2,
+                                  _mm_setr_epi8(8, 9, 10, 11, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128),
+                                  _mm_setr_epi8(-128, -128, -128, -128, 4, 5, 6, 7, -128, -128, -128, -128, -128, -128, -128, -128),
+                                  _mm_setr_epi8(-128, -128, -128, -128, -128, -128, -128, -128, 0, 1, 2, 3, 12, 13, 14, 15));
+        __m128i r = sse2_box_normalize(_mm_add_epi16(_mm_add_epi16(a, b), c), 3);
+        _mm_storel_epi64((__m128i*)(dst + x * 2), _mm_packus_epi16(r, r));
+      }
+    }
+
+#endif
+
+#elif defined(SC_HAVE_NEON)
+
+    if (4 == bpp) {
+
+      for (; x < width; ++x) {
+        const uint16_t* a = sums + x * factor * 4;
+        uint16x4_t s = vld1_u16(a);
+        for (int k = 1; k < factor; ++k) {
+          s = vadd_u16(s, vld1_u16(a + k * 4));
+        }
+        uint32_t out[2];
+        uint16x8_t r;
+        switch (factor) {
+          case 2: { r = vcombine_u16(vrshr_n_u16(s, 2), vdup_n_u16(0)); break; }
+          case 4: { r = vcombine_u16(vrshr_n_u16(s, 4), vdup_n_u16(0)); break; }
+          default: { r = vcombine_u16(vshrn_n_u32(vmull_n_u16(vadd_u16(s, vdup_n_u16(4)), 7282), 16), vdup_n_u16(0)); break; }
+        }
+        vst1_u32(out, vreinterpret_u32_u8(vmovn_u16(r)));
+        memcpy(dst + x * 4, out, 4);
+      }
+    }
+
+#endif
+
+    /* The SIMD paths above don't handle 3x for Y, U, V and UV planes. */
+    if (3 == factor && 1 == bpp) {
+      for (; x < width; ++x) {
+        const uint16_t* p = sums + x * 3;
+        dst[x] = box_normalize(p[0] + p[1] + p[2], 3);
+      }
+    }
+    else if (3 == factor && 2 == bpp) {
+      for (; x < width; ++x) {
+        const uint16_t* p = sums + x * 6;
+        dst[x * 2 + 0] = box_normalize(p[0] + p[2] + p[4], 3);
+        dst[x * 2 + 1] = box_normalize(p[1] + p[3] + p[5], 3);
+      }
+    }
+
+    for (; x < width; ++x) {
+      for (int c = 0; c < bpp; ++c) {
+        const uint16_t* p = sums + x * factor * bpp + c;
+        int s = 0;
+        for (int k = 0; k < factor; ++k) {
+          s += p[k * bpp];
+        }
+        dst[x * bpp + c] = box_normalize(s, factor);
+      }
+    }
+  }
+
+  /* ----------------------------------------------------------- */
+
+  void kernel_filter_rows_v(const uint8_t* const* rows, const int16_t* weights, int taps, uint8_t* dst, int nbytes) {
+
+    int x = 0;
+
+#if defined(SC_HAVE_SSE2)
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i round = _mm_set1_epi32(1 << 13);
+
+    for (; x + 16 <= nbytes; x += 16) {
+
+      __m128i acc0 = round;
+      __m128i acc1 = round;
+      __m128i acc2 = round;
+      __m128i acc3 = round;
+
+      /* Interleave two rows so madd multiplies and adds two taps at once. */
+      for (int k = 0; k < taps; k += 2) {
+        __m128i w = _mm_set1_epi32((uint16_t)weights[k] | ((uint32_t)(uint16_t)weights[k + 1] << 16));
+        __m128i a = _mm_loadu_si128((const __m128i*)(rows[k + 0] + x));
+        __m128i b = _mm_loadu_si128((const __m128i*)(rows[k + 1] + x));
+        __m128i lo = _mm_unpacklo_epi8(a, b);
+        __m128i hi = _mm_unpackhi_epi8(a, b);
+        acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), w));
+        acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), w));
+        acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), w));
+        acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), w));
+      }
+
+      __m128i r0 = _mm_packs_epi32(_mm_srai_epi32(acc0, 14), _mm_srai_epi32(acc1, 14));
+      __m128i r1 = _mm_packs_epi32(_mm_srai_epi32(acc2, 14), _mm_srai_epi32(acc3, 14));
+      _mm_storeu_si128((__m128i*)(dst + x), _mm_packus_epi16(r0, r1));
+    }
+
+#elif defined(SC_HAVE_NEON)
+
+    for (; x + 8 <= nbytes; x += 8) {
+
+      int32x4_t acc0 = vdupq_n_s32(0);
+      int32x4_t acc1 = vdupq_n_s32(0);
+
+      for (int k = 0; k < taps; ++k) {
+        int16x8_t p = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(rows[k] + x)));
+        acc0 = vmlal_n_s16(acc0, vget_low_s16(p), weights[k]);
+        acc1 = vmlal_n_s16(acc1, vget_high_s16(p), weights[k]);
+      }
+
+      int16x8_t r = vcombine_s16(vqmovn_s32(vrshrq_n_s32(acc0, 14)), vqmovn_s32(vrshrq_n_s32(acc1, 14)));
+      vst1_u8(dst + x, vqmovun_s16(r));
+    }
+
+#endif
+
+    for (; x < nbytes; ++x) {
+      int s = 1 << 13;
+      for (int k = 0; k < taps; ++k) {
+        s += rows[k][x] * weights[k];
+      }
+      dst[x] = clamp_u8(s >> 14);
+    }
+  }
+
+  void kernel_filter_row_h(const uint8_t* src, uint8_t* dst, int width, int bpp, const int* offsets, const int16_t* weights, int taps) {
+
+    int x = 0;
+
+#if defined(SC_HAVE_SSE2)
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i round = _mm_set1_epi32(1 << 13);
+
+    if (4 == bpp) {
+
+      for (; x < width; ++x) {
+
+        const uint8_t* p = src + offsets[x] * 4;
+        const int16_t* w = weights + x * taps;
+        __m128i acc = round;
+
+        /* Two pixels per step, interleaved into (b0, b1, g0, g1, r0, r1, a0, a1). */
+        for (int k = 0; k < taps; k += 2) {
+          __m128i px = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(p + k * 4)), zero);
+          px = _mm_unpacklo_epi16(px, _mm_srli_si128(px, 8));
+          __m128i wk = _mm_set1_epi32((uint16_t)w[k] | ((uint32_t)(uint16_t)w[k + 1] << 16));
+          acc = _mm_add_epi32(acc, _mm_madd_epi16(px, wk));
+        }
+
+        __m128i r = _mm_packs_epi32(_mm_srai_epi32(acc, 14), zero);
+        uint32_t out = (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(r, r));
+        memcpy(dst + x * 4, &out, 4);
+      }
+    }
+    else if (2 == bpp) {
+
+      for (; x < width; ++x) {
+
+        const uint8_t* p = src + offsets[x] * 2;
+        const int16_t* w = weights + x * taps;
+        __m128i acc = zero;
+
+        /* Four UV samples per step, reordered into (u0, u1, v0, v1, u2, u3, v2, v3). */
+        for (int k = 0; k < taps; k += 4) {
+          __m128i uv = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(p + k * 2)), zero);
+          uv = _mm_shufflelo_epi16(uv, _MM_SHUFFLE(3, 1, 2, 0));
+          uv = _mm_shufflehi_epi16(uv, _MM_SHUFFLE(3, 1, 2, 0));
+          __m128i wk = _mm_loadl_epi64((const __m128i*)(w + k));
+          acc = _mm_add_epi32(acc, _mm_madd_epi16(uv, _mm_unpacklo_epi32(wk, wk)));
+        }
+
+        acc = _mm_add_epi32(_mm_add_epi32(acc, _mm_srli_si128(acc, 8)), round);
+        __m128i r = _mm_packs_epi32(_mm_srai_epi32(acc, 14), zero);
+        uint32_t out = (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(r, r));
+        dst[x * 2 + 0] = (uint8_t)(out & 0xFF);
+        dst[x * 2 + 1] = (uint8_t)((out >> 8) & 0xFF);
+      }
+    }
+    else if (1 == bpp) {
+
+      for (; x < width; ++x) {
+
+        const uint8_t* p = src + offsets[x];
+        const int16_t* w = weights + x * taps;
+        __m128i acc = zero;
+
+        for (int k = 0; k < taps; k += 4) {
+          __m128i px = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)load_u32(p + k)), zero);
+          acc = _mm_add_epi32(acc, _mm_madd_epi16(px, _mm_loadl_epi64((const __m128i*)(w + k))));
+        }
+
+        acc = _mm_add_epi32(acc, _mm_srli_si128(acc, 4));
+        dst[x] = clamp_u8((_mm_cvtsi128_si32(acc) + (1 << 13)) >> 14);
+      }
+    }
+
+#elif defined(SC_HAVE_NEON)
+
+    if (4 == bpp) {
+
+      for (; x < width; ++x) {
+
+        const uint8_t* p = src + offsets[x] * 4;
+        const int16_t* w = weights + x * taps;
+        int32x4_t acc = vdupq_n_s32(0);
+
+        for (int k = 0; k < taps; ++k) {
+          int16x4_t px = vget_low_s16(vreinterpretq_s16_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(load_u32(p + k * 4))))));
+          acc = vmlal_n_s16(acc, px, w[k]);
+        }
+
+        int16x4_t r = vqmovn_s32(vrshrq_n_s32(acc, 14));
+        uint32_t out = vget_lane_u32(vreinterpret_u32_u8(vqmovun_s16(vcombine_s16(r, r))), 0);
+        memcpy(dst + x * 4, &out, 4);
+      }
+    }
+
+#endif
+
+    for (; x < width; ++x) {
+      for (int c = 0; c < bpp; ++c) {
+        const uint8_t* p = src + offsets[x] * bpp + c;
+        const int16_t* w = weights + x * taps;
+        int s = 1 << 13;
+        for (int k = 0; k < taps; ++k) {
+          s += p[k * bpp] * w[k];
+        }
+        dst[x * bpp + c] = clamp_u8(s >> 14);
+      }
+    }
+  }
+
+  /* ----------------------------------------------------------- */
+
+  /*
+    Rotation. The transposes work on square blocks of 8x8 samples (4x4
+    for 4 byte samples) that we load into registers, shuffle and store
+    as columns; the caller (see Rotate.cpp) feeds them tiles that fit
+    in the L1 cache. Samples are 1, 2 or 4 bytes.
+  */
+  static inline void copy_sample(uint8_t* dst, const uint8_t* src, int bpp) {
+    switch (bpp) {
+      case 1: {
+        dst[0] = src[0];
+        break;
+      }
+      case 2: {
+        memcpy(dst, src, 2);
+        break;
+      }
+      case 4: {
+        memcpy(dst, src, 4);
+        break;
+      }
+      default: {
+        memcpy(dst, src, bpp);
+        break;
+      }
+    }
+  }
+
+  static inline void transpose_c(const uint8_t* src, ptrdiff_t src_stride, uint8_t* dst, ptrdiff_t dst_stride, int width, int height, int bpp) {
+    for (int j = 0; j < height; ++j) {
+      for (int i = 0; i < width; ++i) {
+        copy_sample(dst + i * dst_stride + j * bpp, src + j * src_stride + i * bpp, bpp);
+      }
+    }
+  }
+
+#if defined(SC_HAVE_SSE2)
+
+  static inline void sse2_transpose_8x8_u8(const uint8_t* src, ptrdiff_t ss, uint8_t* dst, ptrdiff_t ds) {
+    __m128i a0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src + 0 * ss)), _mm_loadl_epi64((const __m128i*)(src + 1 * ss)));
+    __m128i a1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src + 2 * ss)), _mm_loadl_epi64((const __m128i*)(src + 3 * ss)));
+    __m128i a2 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src + 4 * ss)), _mm_loadl_epi64((const __m128i*)(src + 5 * ss)));
+    __m128i a3 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src + 6 * ss)), _mm_loadl_epi64((const __m128i*)(src + 7 * ss)));
+    __m128i b0 = _mm_unpacklo_epi16(a0, a1);                     /* Columns 0-3 of rows 0-3. */
+    __m128i b1 = _mm_unpackhi_epi16(a0, a1);                     /* Columns 4-7 of rows 0-3. */
+    __m128i b2 = _mm_unpacklo_epi16(a2, a3);
+    __m128i b3 = _mm_unpackhi_epi16(a2, a3);
+    __m128i c0 = _mm_unpacklo_epi32(b0, b2);                     /* Columns 0 and 1. */
+    __m128i c1 = _mm_unpackhi_epi32(b0, b2);
+    __m128i c2 = _mm_unpacklo_epi32(b1, b3);
+    __m128i c3 = _mm_unpackhi_epi32(b1, b3);
+    _mm_storel_epi64((__m128i*)(dst + 0 * ds), c0);
+    _mm_storel_epi64((__m128i*)(dst + 1 * ds), _mm_unpackhi_epi64(c0, c0));
+    _mm_storel_epi64((__m128i*)(dst + 2 * ds), c1);
+    _mm_storel_epi64((__m128i*)(dst + 3 * ds), _mm_unpackhi_epi64(c1, c1));
+    _mm_storel_epi64((__m128i*)(dst + 4 * ds), c2);
+    _mm_storel_epi64((__m128i*)(dst + 5 * ds), _mm_unpackhi_epi64(c2, c2));
+    _mm_storel_epi64((__m128i*)(dst + 6 * ds), c3);
+    _mm_storel_epi64((__m128i*)(dst + 7 * ds), _mm_unpackhi_epi64(c3, c3));
+  }
+
+  static inline void sse2_transpose_8x8_u16(const uint8_t* src, ptrdiff_t ss, uint8_t* dst, ptrdiff_t ds) {
+    __m128i r0 = _mm_loadu_si128((const __m128i*)(src + 0 * ss));
+    __m128i r1 = _mm_loadu_si128((const __m128i*)(src + 1 * ss));
+    __m128i r2 = _mm_loadu_si128((const __m128i*)(src + 2 * ss));
+    __m128i r3 = _mm_loadu_si128((const __m128i*)(src + 3 * ss));
+    __m128i r4 = _mm_loadu_si128((const __m128i*)(src + 4 * ss));
+    __m128i r5 = _mm_loadu_si128((const __m128i*)(src + 5 * ss));
+    __m128i r6 = _mm_loadu_si128((const __m128i*)(src + 6 * ss));
+    __m128i r7 = _mm_loadu_si128((const __m128i*)(src + 7 * ss));
+    __m128i a0 = _mm_unpacklo_epi16(r0, r1);
+    __m128i a1 = _mm_unpackhi_epi16(r0, r1);
+    __m128i a2 = _mm_unpacklo_epi16(r2, r3);
+    __m128i a3 = _mm_unpackhi_epi16(r2, r3);
+    __m128i a4 = _mm_unpacklo_epi16(r4, r5);
+    __m128i a5 = _mm_unpackhi_epi16(r4, r5);
+    __m128i a6 = _mm_unpacklo_epi16(r6, r7);
+    __m128i a7 = _mm_unpackhi_epi16(r6, r7);
+    __m128i b0 = _mm_unpacklo_epi32(a0, a2);                     /* Columns 0 and 1 of rows 0-3. */
+    __m128i b1 = _mm_unpackhi_epi32(a0, a2);
+    __m128i b2 = _mm_unpacklo_epi32(a1, a3);
+    __m128i b3 = _mm_unpackhi_epi32(a1, a3);
+    __m128i b4 = _mm_unpacklo_epi32(a4, a6);                     /* Columns 0 and 1 of rows 4-7. */
+    __m128i b5 = _mm_unpackhi_epi32(a4, a6);
+    __m128i b6 = _mm_unpacklo_epi32(a5, a7);
+    __m128i b7 = _mm_unpackhi_epi32(a5, a7);
+    _mm_storeu_si128((__m128i*)(dst + 0 * ds), _mm_unpacklo_epi64(b0, b4));
+    _mm_storeu_si128((__m128i*)(dst + 1 * ds), _mm_unpackhi_epi64(b0, b4));
+    _mm_storeu_si128((__m128i*)(dst + 2 * ds), _mm_unpacklo_epi64(b1, b5));
+    _mm_storeu_si128((__m128i*)(dst + 3 * ds), _mm_unpackhi_epi64(b1, b5));
+    _mm_storeu_si128((__m128i*)(dst + 4 * ds), _mm_unpacklo_epi64(b2, b6));
+    _mm_storeu_si128((__m128i*)(dst + 5 * ds), _mm_unpackhi_epi64(b2, b6));
+    _mm_storeu_si128((__m128i*)(dst + 6 * ds), _mm_unpacklo_epi64(b3, b7));
+    _mm_storeu_si128((__m128i*)(dst + 7 * ds), _mm_unpackhi_epi64(b3, b7));
+  }
+
+  static inline void sse2_transpose_4x4_u32(const uint8_t* src, ptrdiff_t ss, uint8_t* dst, ptrdiff_t ds) {
+    __m128i r0 = _mm_loadu_si128((const __m128i*)(src + 0 * ss));
+    __m128i r1 = _mm_loadu_si128((const __m128i*)(src + 1 * ss));
+    __m128i r2 = _mm_loadu_si128((const __m128i*)(src + 2 * ss));
+    __m128i r3 = _mm_loadu_si128((const __m128i*)(src + 3 * ss));
+    __m128i a0 = _mm_unpacklo_epi32(r0, r1);                     /* Columns 0 and 1 of rows 0 and 1. */
+    __m128i a1 = _mm_unpackhi_epi32(r0, r1);
+    __m128i a2 = _mm_unpacklo_epi32(r2, r3);
+    __m128i a3 = _mm_unpackhi_epi32(r2, r3);
+    _mm_storeu_si128((__m128i*)(dst + 0 * ds), _mm_unpacklo_epi64(a0, a2));
+    _mm_storeu_si128((__m128i*)(dst + 1 * ds), _mm_unpackhi_epi64(a0, a2));
+    _mm_storeu_si128((__m128i*)(dst + 2 * ds), _mm_unpacklo_epi64(a1, a3));
+    _mm_storeu_si128((__m128i*)(dst + 3 * ds), _mm_unpackhi_epi64(a1, a3));
+  }
+
+#elif defined(SC_HAVE_NEON)
+
+  static inline void neon_transpose_8x8_u8(const uint8_t* src, ptrdiff_t ss, uint8_t* dst, ptrdiff_t ds) {
+    uint8x8x2_t t01 = vtrn_u8(vld1_u8(src + 0 * ss), vld1_u8(src + 1 * ss));
+    uint8x8x2_t t23 = vtrn_u8(vld1_u8(src + 2 * ss), vld1_u8(src + 3 * ss));
+    uint8x8x2_t t45 = vtrn_u8(vld1_u8(src + 4 * ss), vld1_u8(src + 5 * ss));
+    uint8x8x2_t t67 = vtrn_u8(vld1_u8(src + 6 * ss), vld1_u8(src + 7 * ss));
+    uint16x4x2_t u02 = vtrn_u16(vreinterpret_u16_u8(t01.val[0]), vreinterpret_u16_u8(t23.val[0]));  /* Columns 0, 4 and 2, 6 of rows 0-3. */
+    uint16x4x2_t u13 = vtrn_u16(vreinterpret_u16_u8(t01.val[1]), vreinterpret_u16_u8(t23.val[1]));  /* Columns 1, 5 and 3, 7 of rows 0-3. */
+    uint16x4x2_t u46 = vtrn_u16(vreinterpret_u16_u8(t45.val[0]), vreinterpret_u16_u8(t67.val[0]));
+    uint16x4x2_t u57 = vtrn_u16(vreinterpret_u16_u8(t45.val[1]), vreinterpret_u16_u8(t67.val[1]));
+    uint32x2x2_t v04 = vtrn_u32(vreinterpret_u32_u16(u02.val[0]), vreinterpret_u32_u16(u46.val[0]));
+    uint32x2x2_t v26 = vtrn_u32(vreinterpret_u32_u16(u02.val[1]), vreinterpret_u32_u16(u46.val[1]));
+    uint32x2x2_t v15 = vtrn_u32(vreinterpret_u32_u16(u13.val[0]), vreinterpret_u32_u16(u57.val[0]));
+    uint32x2x2_t v37 = vtrn_u32(vreinterpret_u32_u16(u13.val[1]), vreinterpret_u32_u16(u57.val[1]));
+    vst1_u8(dst + 0 * ds, vreinterpret_u8_u32(v04.val[0]));
+    vst1_u8(dst + 1 * ds, vreinterpret_u8_u32(v15.val[0]));
+    vst1_u8(dst + 2 * ds, vreinterpret_u8_u32(v26.val[0]));
+    vst1_u8(dst + 3 * ds, vreinterpret_u8_u32(v37.val[0]));
+    vst1_u8(dst + 4 * ds, vreinterpret_u8_u32(v04.val[1]));
+    vst1_u8(dst + 5 * ds, vreinterpret_u8_u32(v15.val[1]));
+    vst1_u8(dst + 6 * ds, vreinterpret_u8_u32(v26.val[1]));
+    vst1_u8(dst + 7 * ds, vreinterpret_u8_u32(v37.val[1]));
+  }
+
+  static inline void neon_transpose_8x8_u16(const uint8_t* src, ptrdiff_t ss, uint8_t* dst, ptrdiff_t ds) {
+    uint16x8x2_t t01 = vtrnq_u16(vld1q_u16((const uint16_t*)(src + 0 * ss)), vld1q_u16((const uint16_t*)(src + 1 * ss)));
+    uint16x8x2_t t23 = vtrnq_u16(vld1q_u16((const uint16_t*)(src + 2 * ss)), vld1q_u16((const uint16_t*)(src + 3 * ss)));
+    uint16x8x2_t t45 = vtrnq_u16(vld1q_u16((const uint16_t*)(src + 4 * ss)), vld1q_u16((const uint16_t*)(src + 5 * ss)));
+    uint16x8x2_t t67 = vtrnq_u16(vld1q_u16((const uint16_t*)(src + 6 * ss)), vld1q_u16((const uint16_t*)(src + 7 * ss)));
+    uint32x4x2_t u02 = vtrnq_u32(vreinterpretq_u32_u16(t01.val[0]), vreinterpretq_u32_u16(t23.val[0]));  /* Columns 0, 4 and 2, 6 of rows 0-3. */
+    uint32x4x2_t u13 = vtrnq_u32(vreinterpretq_u32_u16(t01.val[1]), vreinterpretq_u32_u16(t23.val[1]));  /* Columns 1, 5 and 3, 7 of rows 0-3. */
+    uint32x4x2_t u46 = vtrnq_u32(vreinterpretq_u32_u16(t45.val[0]), vreinterpretq_u32_u16(t67.val[0]));
+    uint32x4x2_t u57 = vtrnq_u32(vreinterpretq_u32_u16(t45.val[1]), vreinterpretq_u32_u16(t67.val[1]));
+    vst1q_u32((uint32_t*)(dst + 0 * ds), vcombine_u32(vget_low_u32(u02.val[0]), vget_low_u32(u46.val[0])));
+    vst1q_u32((uint32_t*)(dst + 1 * ds), vcombine_u32(vget_low_u32(u13.val[0]), vget_low_u32(u57.val[0])));
+    vst1q_u32((uint32_t*)(dst + 2 * ds), vcombine_u32(vget_low_u32(u02.val[1]), vget_low_u32(u46.val[1])));
+    vst1q_u32((uint32_t*)(dst + 3 * ds), vcombine_u32(vget_low_u32(u13.val[1]), vget_low_u32(u57.val[1])));
+    vst1q_u32((uint32_t*)(dst + 4 * ds), vcombine_u32(vget_high_u32(u02.val[0]), vget_high_u32(u46.val[0])));
+    vst1q_u32((uint32_t*)(dst + 5 * ds), vcombine_u32(vget_high_u32(u13.val[0]), vget_high_u32(u57.val[0])));
+    vst1q_u32((uint32_t*)(dst + 6 * ds), vcombine_u32(vget_high_u32(u02.val[1]), vget_high_u32(u46.val[1])));
+    vst1q_u32((uint32_t*)(dst + 7 * ds), vcombine_u32(vget_high_u32(u13.val[1]), vget_high_u32(u57.val[1])));
+  }
+
+  static inline void neon_transpose_4x4_u32(const uint8_t* src, ptrdiff_t ss, uint8_t* dst, ptrdiff_t ds) {
+    uint32x4x2_t t01 = vtrnq_u32(vld1q_u32((const uint32_t*)(src + 0 * ss)), vld1q_u32((const uint32_t*)(src + 1 * ss)));
+    uint32x4x2_t t23 = vtrnq_u32(vld1q_u32((const uint32_t*)(src + 2 * ss)), vld1q_u32((const uint32_t*)(src + 3 * ss)));
+    vst1q_u32((uint32_t*)(dst + 0 * ds), vcombine_u32(vget_low_u32(t01.val[0]), vget_low_u32(t23.val[0])));
+    vst1q_u32((uint32_t*)(dst + 1 * ds), vcombine_u32(vget_low_u32(t01.val[1]), vget_low_u32(t23.val[1])));
+    vst1q_u32((uint32_t*)(dst + 2 * ds), vcombine_u32(vget_high_u32(t01.val[0]), vget_high_u32(t23.val[0])));
+    vst1q_u32((uint32_t*)(dst + 3 * ds), vcombine_u32(vget_high_u32(t01.val[1]), vget_high_u32(t23.val[1])));
+  }
+
+#endif
+
+  void kernel_transpose_block(const uint8_t* src, ptrdiff_t src_stride, uint8_t* dst, ptrdiff_t dst_stride, int width, int height, int bpp) {
+
+    int j = 0;
+
+#if defined(SC_HAVE_SSE2) || defined(SC_HAVE_NEON)
+
+    int n = (4 == bpp) ? 4 : 8;
+
+    for (; (1 == bpp || 2 == bpp || 4 == bpp) && j + n <= height; j += n) {
+
+      int i = 0;
+
+      for (; i + n <= width; i += n) {
+
+        const uint8_t* s = src + j * src_stride + i * bpp;
+        uint8_t* d = dst + i * dst_stride + j * bpp;
+
+#  if defined(SC_HAVE_SSE2)
+        if (1 == bpp) {
+          sse2_transpose_8x8_u8(s, src_stride, d, dst_stride);
+        }
+        else if (2 == bpp) {
+          sse2_transpose_8x8_u16(s, src_stride, d, dst_stride);
+        }
+        else {
+          sse2_transpose_4x4_u32(s, src_stride, d, dst_stride);
+        }
+#  else
+        if (1 == bpp) {
+          neon_transpose_8x8_u8(s, src_stride, d, dst_stride);
+        }
+        else if (2 == bpp) {
+          neon_transpose_8x8_u16(s, src_stride, d, dst_stride);
+        }
+        else {
+          neon_transpose_4x4_u32(s, src_stride, d, dst_stride);
+        }
+#  endif
+      }
+
+      /* The columns that don't fill a block. */
+      transpose_c(src + j * src_stride + i * bpp, src_stride, dst + i * dst_stride + j * bpp, dst_stride, width - i, n, bpp);
+    }
+
+#endif
+
+    transpose_c(src + j * src_stride, src_stride, dst + j * bpp, dst_stride, width, height - j, bpp);
+  }
+
+  void kernel_reverse_row(const uint8_t* src, uint8_t* dst, int width, int bpp) {
+
+    int x = 0;
+
+#if defined(SC_HAVE_SSE2)
+
+    if (4 == bpp) {
+      for (; x + 4 <= width; x += 4) {
+        __m128i p = _mm_loadu_si128((const __m128i*)(src + (width - x - 4) * 4));
+        _mm_storeu_si128((__m128i*)(dst + x * 4), _mm_shuffle_epi32(p, _MM_SHUFFLE(0, 1, 2, 3)));
+      }
+    }
+    else if (2 == bpp) {
+      for (; x + 8 <= width; x += 8) {
+        __m128i p = _mm_loadu_si128((const __m128i*)(src + (width - x - 8) * 2));
+        p = _mm_shufflehi_epi16(_mm_shufflelo_epi16(p, _MM_SHUFFLE(0, 1, 2, 3)), _MM_SHUFFLE(0, 1, 2, 3));
+        _mm_storeu_si128((__m128i*)(dst + x * 2), _mm_shuffle_epi32(p, _MM_SHUFFLE(1, 0, 3, 2)));
+      }
+    }
+    else if (1 == bpp) {
+#  if defined(SC_HAVE_SSSE3)
+      __m128i shuffle = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+      for (; x + 16 <= width; x += 16) {
+        __m128i p = _mm_loadu_si128((const __m128i*)(src + width - x - 16));
+        _mm_storeu_si128((__m128i*)(dst + x), _mm_shuffle_epi8(p, shuffle));
+      }
+#  else
+      for (; x + 16 <= width; x += 16) {
+        __m128i p = _mm_loadu_si128((const __m128i*)(src + width - x - 16));
+        p = _mm_shufflehi_epi16(_mm_shufflelo_epi16(p, _MM_SHUFFLE(0, 1, 2, 3)), _MM_SHUFFLE(0, 1, 2, 3));
+        p = _mm_shuffle_epi32(p, _MM_SHUFFLE(1, 0, 3, 2));
+        _mm_storeu_si128((__m128i*)(dst + x), _mm_or_si128(_mm_slli_epi16(p, 8), _mm_srli_epi16(p, 8)));
+      }
+#  endif
+    }
+
+#elif defined(SC_HAVE_NEON)
+
+    if (4 == bpp) {
+      for (; x + 4 <= width; x += 4) {
+        uint32x4_t p = vrev64q_u32(vld1q_u32((const uint32_t*)(src + (width - x - 4) * 4)));
+        vst1q_u32((uint32_t*)(dst + x * 4), vcombine_u32(vget_high_u32(p), vget_low_u32(p)));
+      }
+    }
+    else if (2 == bpp) {
+      for (; x + 8 <= width; x += 8) {
+        uint16x8_t p = vrev64q_u16(vld1q_u16((const uint16_t*)(src + (width - x - 8) * 2)));
+        vst1q_u16((uint16_t*)(dst + x * 2), vcombine_u16(vget_high_u16(p), vget_low_u16(p)));
+      }
+    }
+    else if (1 == bpp) {
+      for (; x + 16 <= width; x += 16) {
+        uint8x16_t p = vrev64q_u8(vld1q_u8(src + width - x - 16));
+        vst1q_u8(dst + x, vcombine_u8(vget_high_u8(p), vget_low_u8(p)));
+      }
+    }
+
+#endif
+
+    for (; x < width; ++x) {
+      copy_sample(dst + x * bpp, src + (width - 1 - x) * bpp, bpp);
+    }
+  }
+
+  /* ----------------------------------------------------------- */
+
+  /*
+    Cursor compositing (see Cursor.cpp). The blend uses straight alpha
+    and divides by 255 with rounding: (v + 128 + ((v + 128) >> 8)) >> 8
+    is exact for every v <= 255 * 255, so we need no division and the
+    16 bit lanes don't overflow.
+  */
+  static inline uint8_t blend_u8(int s, int d, int a) {
+    int v = s * a + d * (255 - a) + 128;
+    return (uint8_t)((v + (v >> 8)) >> 8);
+  }
+
+#if defined(SC_HAVE_SSE2)
+
+  /* Blends 2 pixels, as 8 unpacked 16 bit channels. */
+  static inline __m128i sse2_blend_2px(__m128i s, __m128i d) {
+    __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    __m128i ia = _mm_sub_epi16(_mm_set1_epi16(255), a);
+    __m128i v = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(s, a), _mm_mullo_epi16(d, ia)), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(v, _mm_srli_epi16(v, 8)), 8);
+  }
+
+#endif
+
+  void kernel_blend_bgra_row(const uint8_t* src, uint8_t* dst, int width) {
+
+    int x = 0;
+
+#if defined(SC_HAVE_SSE2)
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+
+    for (; x + 4 <= width; x += 4) {
+      __m128i s = _mm_loadu_si128((const __m128i*)(src + x * 4));
+      __m128i d = _mm_loadu_si128((const __m128i*)(dst + x * 4));
+      __m128i lo = sse2_blend_2px(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+      __m128i hi = sse2_blend_2px(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+      __m128i p = _mm_packus_epi16(lo, hi);
+      _mm_storeu_si128((__m128i*)(dst + x * 4), _mm_or_si128(_mm_andnot_si128(alpha, p), _mm_and_si128(alpha, d)));
+    }
+
+#elif defined(SC_HAVE_NEON)
+
+    uint16x8_t round = vdupq_n_u16(128);
+
+    for (; x + 8 <= width; x += 8) {
+      uint8x8x4_t s = vld4_u8(src + x * 4);
+      uint8x8x4_t d = vld4_u8(dst + x * 4);
+      uint8x8_t ia = vmvn_u8(s.val[3]);
+      for (int c = 0; c < 3; ++c) {
+        uint16x8_t v = vaddq_u16(vmlal_u8(vmull_u8(s.val[c], s.val[3]), d.val[c], ia), round);
+        d.val[c] = vshrn_n_u16(vaddq_u16(v, vshrq_n_u16(v, 8)), 8);
+      }
+      vst4_u8(dst + x * 4, d);
+    }
+
+#endif
+
+    for (; x < width; ++x) {
+      const uint8_t* s = src + x * 4;
+      uint8_t* d = dst + x * 4;
+      d[0] = blend_u8(s[0], d[0], s[3]);
+      d[1] = blend_u8(s[1], d[1], s[3]);
+      d[2] = blend_u8(s[2], d[2], s[3]);
+    }
+  }
+
+  void kernel_mask_bgra_row(const uint8_t* and_mask, const uint8_t* xor_mask, uint8_t* dst, int width) {
+
+    int n = width * 4;
+    int x = 0;
+
+#if defined(SC_HAVE_SSE2)
+
+    for (; x + 16 <= n; x += 16) {
+      __m128i d = _mm_loadu_si128((const __m128i*)(dst + x));
+      d = _mm_and_si128(d, _mm_loadu_si128((const __m128i*)(and_mask + x)));
+      _mm_storeu_si128((__m128i*)(dst + x), _mm_xor_si128(d, _mm_loadu_si128((const __m128i*)(xor_mask + x))));
+    }
+
+#elif defined(SC_HAVE_NEON)
+
+    for (; x + 16 <= n; x += 16) {
+      uint8x16_t d = vandq_u8(vld1q_u8(dst + x), vld1q_u8(and_mask + x));
+      vst1q_u8(dst + x, veorq_u8(d, vld1q_u8(xor_mask + x)));
+    }
+
+#endif
+
+    for (; x < n; ++x) {
+      dst[x] = (dst[x] & and_mask[x]) ^ xor_mask[x];
+    }
+  }
+
+  /* ----------------------------------------------------------- */
+
+  /*
+    Monochrome pointers. Every byte of the AND and XOR bitplanes expands
+    into 8 mask bytes with the `mono_expand` table (see Kernels.cpp), so
+    we handle 8 pixels with two lookups instead of testing every bit, and
+    interleave the masks into BGRA:
+
+        BGRA:      color = ~AND & XOR, alpha = ~AND | XOR
+        masks:     AND, AND, AND, 0xFF and XOR, XOR, XOR, 0x00
+  */
+#if defined(SC_HAVE_SSE2)
+
+  /* Stores 8 BGRA pixels with the color bytes `c` and alpha bytes `a` (the low 8 bytes of both). */
+  static inline void sse2_store_mono_8px(uint8_t* dst, __m128i c, __m128i a) {
+    __m128i cc = _mm_unpacklo_epi8(c, c);
+    __m128i ca = _mm_unpacklo_epi8(c, a);
+    _mm_storeu_si128((__m128i*)(dst + 0), _mm_unpacklo_epi16(cc, ca));
+    _mm_storeu_si128((__m128i*)(dst + 16), _mm_unpackhi_epi16(cc, ca));
+  }
+
+#endif
+
+  void kernel_mono_to_bgra_row(const uint8_t* and_bits, const uint8_t* xor_bits, uint8_t* dst, int width) {
+
+    int x = 0;
+
+#if defined(SC_HAVE_SSE2)
+
+    __m128i ones = _mm_set1_epi8((char)0xFF);
+
+    for (; x + 8 <= width; x += 8) {
+      __m128i a = _mm_loadl_epi64((const __m128i*)mono_expand[and_bits[x >> 3]]);
+      __m128i o = _mm_loadl_epi64((const __m128i*)mono_expand[xor_bits[x >> 3]]);
+      sse2_store_mono_8px(dst + x * 4, _mm_andnot_si128(a, o), _mm_or_si128(_mm_xor_si128(a, ones), o));
+    }
+
+#elif defined(SC_HAVE_NEON)
+
+    for (; x + 8 <= width; x += 8) {
+      uint8x8_t a = vld1_u8(mono_expand[and_bits[x >> 3]]);
+      uint8x8_t o = vld1_u8(mono_expand[xor_bits[x >> 3]]);
+      uint8x8x4_t p;
+      p.val[0] = vbic_u8(o, a);
+      p.val[1] = p.val[0];
+      p.val[2] = p.val[0];
+      p.val[3] = vorn_u8(o, a);
+      vst4_u8(dst + x * 4, p);
+    }
+
+#endif
+
+    for (; x < width; ++x) {
+      uint8_t a = mono_expand[and_bits[x >> 3]][x & 7];
+      uint8_t o = mono_expand[xor_bits[x >> 3]][x & 7];
+      uint8_t* d = dst + x * 4;
+      d[0] = d[1] = d[2] = (uint8_t)(~a & o);
+      d[3] = (uint8_t)(~a | o);
+    }
+  }
+
+  void kernel_mono_to_masks_row(const uint8_t* and_bits, const uint8_t* xor_bits, uint8_t* and_mask, uint8_t* xor_mask, int width) {
+
+    int x = 0;
+
+#if defined(SC_HAVE_SSE2)
+
+    __m128i ones = _mm_set1_epi8((char)0xFF);
+    __m128i zero = _mm_setzero_si128();
+
+    for (; x + 8 <= width; x += 8) {
+      sse2_store_mono_8px(and_mask + x * 4, _mm_loadl_epi64((const __m128i*)mono_expand[and_bits[x >> 3]]), ones);
+      sse2_store_mono_8px(xor_mask + x * 4, _mm_loadl_epi64((const __m128i*)mono_expand[xor_bits[x >> 3]]), zero);
+    }
+
+#elif defined(SC_HAVE_NEON)
+
+    for (; x + 8 <= width; x += 8) {
+      uint8x8x4_t a;
+      uint8x8x4_t o;
+      a.val[0] = a.val[1] = a.val[2] = vld1_u8(mono_expand[and_bits[x >> 3]]);
+      a.val[3] = vdup_n_u8(0xFF);
+      o.val[0] = o.val[1] = o.val[2] = vld1_u8(mono_expand[xor_bits[x >> 3]]);
+      o.val[3] = vdup_n_u8(0x00);
+      vst4_u8(and_mask + x * 4, a);
+      vst4_u8(xor_mask + x * 4, o);
+    }
+
+#endif
+
+    for (; x < width; ++x) {
+      uint8_t* a = and_mask + x * 4;
+      uint8_t* o = xor_mask + x * 4;
+      a[0] = a[1] = a[2] = mono_expand[and_bits[x >> 3]][x & 7];
+      a[3] = 0xFF;
+      o[0] = o[1] = o[2] = mono_expand[xor_bits[x >> 3]][x & 7];
+      o[3] = 0x00;
+    }
+  }
+
+  /* ----------------------------------------------------------- */
+
+  /*
+    Privacy masks (see Mask.cpp). A fill repeats one sample of 1, 2 or
+    4 bytes, so a 16 byte register holds a whole number of samples.
+    The box blur slides a window of `n` rows over the region: `sums`
+    holds the sum of the rows in the window per byte and we divide by
+    multiplying with `scale` = ceil(65536 / n) and keeping the high 16
+    bits, which is what _mm_mulhi_epu16 does. That's never more than
+    255 as long as n <= 257 and exact for flat areas.
+  */
+  void kernel_fill_row(uint8_t* dst, int width, int bpp, const uint8_t* value) {
+
+    int n = width * bpp;
+    int x = 0;
+
+#if defined(SC_HAVE_SSE2) || defined(SC_HAVE_NEON)
+
+    if (1 == bpp || 2 == bpp || 4 == bpp) {
+
+      uint8_t pattern[16];
+
+      for (int i = 0; i < 16; ++i) {
+        pattern[i] = value[i % bpp];
+      }
+
+#  if defined(SC_HAVE_SSE2)
+      __m128i p = _mm_loadu_si128((const __m128i*)pattern);
+      for (; x + 16 <= n; x += 16) {
+        _mm_storeu_si128((__m128i*)(dst + x), p);
+      }
+#  else
+      uint8x16_t p = vld1q_u8(pattern);
+      for (; x + 16 <= n; x += 16) {
+        vst1q_u8(dst + x, p);
+      }
+#  endif
+    }
+
+#endif
+
+    for (; x < n; ++x) {
+      dst[x] = value[x % bpp];
+    }
+  }
+
+  void kernel_box_slide_row(const uint8_t* add, const uint8_t* sub, uint16_t* sums, uint8_t* dst, int nbytes, int scale) {
+
+    int x = 0;
+
+#if defined(SC_HAVE_SSE2)
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i mul = _mm_set1_epi16((short)scale);
+
+    for (; x + 16 <= nbytes; x += 16) {
+      __m128i lo = _mm_loadu_si128((const __m128i*)(sums + x));
+      __m128i hi = _mm_loadu_si128((const __m128i*)(sums + x + 8));
+      __m128i a = _mm_loadu_si128((const __m128i*)(add + x));
+      __m128i s = _mm_loadu_si128((const __m128i*)(sub + x));
+      _mm_storeu_si128((__m128i*)(dst + x), _mm_packus_epi16(_mm_mulhi_epu16(lo, mul), _mm_mulhi_epu16(hi, mul)));
+      lo = _mm_sub_epi16(_mm_add_epi16(lo, _mm_unpacklo_epi8(a, zero)), _mm_unpacklo_epi8(s, zero));
+      hi = _mm_sub_epi16(_mm_add_epi16(hi, _mm_unpackhi_epi8(a, zero)), _mm_unpackhi_epi8(s, zero));
+      _mm_storeu_si128((__m128i*)(sums + x), lo);
+      _mm_storeu_si128((__m128i*)(sums + x + 8), hi);
+    }
+
+#elif defined(SC_HAVE_NEON)
+
+    uint16x4_t mul = vdup_n_u16((uint16_t)scale);
+
+    for (; x + 16 <= nbytes; x += 16) {
+      uint16x8_t lo = vld1q_u16(sums + x);
+      uint16x8_t hi = vld1q_u16(sums + x + 8);
+      uint8x16_t a = vld1q_u8(add + x);
+      uint8x16_t s = vld1q_u8(sub + x);
+      uint16x8_t lo_mean = vcombine_u16(vshrn_n_u32(vmull_u16(vget_low_u16(lo), mul), 16), vshrn_n_u32(vmull_u16(vget_high_u16(lo), mul), 16));
+      uint16x8_t hi_mean = vcombine_u16(vshrn_n_u32(vmull_u16(vget_low_u16(hi), mul), 16), vshrn_n_u32(vmull_u16(vget_high_u16(hi), mul), 16));
+      vst1q_u8(dst + x, vcombine_u8(vmovn_u16(lo_mean), vmovn_u16(hi_mean)));
+      lo = vsubw_u8(vaddw_u8(lo, vget_low_u8(a)), vget_low_u8(s));
+      hi = vsubw_u8(vaddw_u8(hi, vget_high_u8(a)), vget_high_u8(s));
+      vst1q_u16(sums + x, lo);
+      vst1q_u16(sums + x + 8, hi);
+    }
+
+#endif
+
+    for (; x < nbytes; ++x) {
+      dst[x] = (uint8_t)(((uint32_t)sums[x] * (uint32_t)scale) >> 16);
+      sums[x] = (uint16_t)(sums[x] + add[x] - sub[x]);
+    }
+  }
+
+  /* ----------------------------------------------------------- */
+
+  /*
+    Overlays (see Overlay.cpp) are premultiplied, so blending is
+    dst = src + dst * (255 - a) / 255 for every channel, also for the
+    alpha of BGRA. We divide by 255 with the same rounding as
+    blend_u8(). A valid premultiplied sample is never larger than its
+    alpha so the sum fits a byte; we saturate when it doesn't.
+  */
+  static inline uint8_t blend_premul_u8(int s, int d, int a) {
+    int v = d * (255 - a) + 128;
+    v = s + ((v + (v >> 8)) >> 8);
+    return (uint8_t)((v > 255) ? 255 : v);
+  }
+
+#if defined(SC_HAVE_SSE2)
+
+  /* Multiplies 8 unpacked 16 bit values with 8 factors (0-255) and divides by 255. */
+  static inline __m128i sse2_scale_8x16(__m128i v, __m128i f) {
+    v = _mm_add_epi16(_mm_mullo_epi16(v, f), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(v, _mm_srli_epi16(v, 8)), 8);
+  }
+
+#endif
+
+  void kernel_blend_premul_bgra_row(const uint8_t* src, uint8_t* dst, int width) {
+
+    int x = 0;
+
+#if defined(SC_HAVE_SSE2)
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i max = _mm_set1_epi16(255);
+
+    for (; x + 4 <= width; x += 4) {
+      __m128i s = _mm_loadu_si128((const __m128i*)(src + x * 4));
+      __m128i d = _mm_loadu_si128((const __m128i*)(dst + x * 4));
+      __m128i a_lo = _mm_unpacklo_epi8(s, zero);
+      __m128i a_hi = _mm_unpackhi_epi8(s, zero);
+      a_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(a_lo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+      a_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(a_hi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+      __m128i lo = sse2_scale_8x16(_mm_unpacklo_epi8(d, zero), _mm_sub_epi16(max, a_lo));
+      __m128i hi = sse2_scale_8x16(_mm_unpackhi_epi8(d, zero), _mm_sub_epi16(max, a_hi));
+      _mm_storeu_si128((__m128i*)(dst + x * 4), _mm_adds_epu8(s, _mm_packus_epi16(lo, hi)));
+    }
+
+#elif defined(SC_HAVE_NEON)
+
+    uint16x8_t round = vdupq_n_u16(128);
+
+    for (; x + 8 <= width; x += 8) {
+      uint8x8x4_t s = vld4_u8(src + x * 4);
+      uint8x8x4_t d = vld4_u8(dst + x * 4);
+      uint8x8_t ia = vmvn_u8(s.val[3]);
+      for (int c = 0; c < 4; ++c) {
+        uint16x8_t v = vaddq_u16(vmull_u8(d.val[c], ia), round);
+        d.val[c] = vqadd_u8(s.val[c], vshrn_n_u16(vaddq_u16(v, vshrq_n_u16(v, 8)), 8));
+      }
+      vst4_u8(dst + x * 4, d);
+    }
+
+#endif
+
+    for (; x < width; ++x) {
+      const uint8_t* s = src + x * 4;
+      uint8_t* d = dst + x * 4;
+      d[0] = blend_premul_u8(s[0], d[0], s[3]);
+      d[1] = blend_premul_u8(s[1], d[1], s[3]);
+      d[2] = blend_premul_u8(s[2], d[2], s[3]);
+      d[3] = blend_premul_u8(s[3], d[3], s[3]);
+    }
+  }
+
+  void kernel_blend_premul_row(const uint8_t* src, const uint8_t* alpha, uint8_t* dst, int nbytes) {
+
+    int x = 0;
+
+#if defined(SC_HAVE_SSE2)
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i ones = _mm_set1_epi8((char)0xFF);
+
+    for (; x + 16 <= nbytes; x += 16) {
+      __m128i s = _mm_loadu_si128((const __m128i*)(src + x));
+      __m128i d = _mm_loadu_si128((const __m128i*)(dst + x));
+      __m128i ia = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(alpha + x)), ones);
+      __m128i lo = sse2_scale_8x16(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(ia, zero));
+      __m128i hi = sse2_scale_8x16(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(ia, zero));
+      _mm_storeu_si128((__m128i*)(dst + x), _mm_adds_epu8(s, _mm_packus_epi16(lo, hi)));
+    }
+
+#elif defined(SC_HAVE_NEON)
+
+    uint16x8_t round = vdupq_n_u16(128);
+
+    for (; x + 16 <= nbytes; x += 16) {
+      uint8x16_t d = vld1q_u8(dst + x);
+      uint8x16_t ia = vmvnq_u8(vld1q_u8(alpha + x));
+      uint16x8_t lo = vaddq_u16(vmull_u8(vget_low_u8(d), vget_low_u8(ia)), round);
+      uint16x8_t hi = vaddq_u16(vmull_u8(vget_high_u8(d), vget_high_u8(ia)), round);
+      uint8x16_t r = vcombine_u8(vshrn_n_u16(vaddq_u16(lo, vshrq_n_u16(lo, 8)), 8), vshrn_n_u16(vaddq_u16(hi, vshrq_n_u16(hi, 8)), 8));
+      vst1q_u8(dst + x, vqaddq_u8(vld1q_u8(src + x), r));
+    }
+
+#endif
+
+    for (; x < nbytes; ++x) {
+      dst[x] = blend_premul_u8(src[x], dst[x], alpha[x]);
+    }
+  }
+
+  /* ----------------------------------------------------------- */
+
+  void kernel_bgra_to_luma_row(const uint8_t* src, uint8_t* dst, int width, const YuvCoefficients& c) {
+
+    int x = 0;
+
+#if defined(SC_HAVE_SSE2)
+
+    __m128i cy = _mm_setr_epi16(c.yb, c.yg, c.yr, 0, c.yb, c.yg, c.yr, 0);
+    __m128i offset = _mm_set1_epi16(c.y_offset);
+
+    for (; x + 16 <= width; x += 16) {
+      _mm_storeu_si128((__m128i*)(dst + x), sse2_bgra16_to_y(src + x * 4, cy, offset));
+    }
+
+#elif defined(SC_HAVE_NEON)
+
+    /* See kernel_bgra_to_i420_rows(). */
+    for (; x + 16 <= width; x += 16) {
+      uint8x16x4_t p = vld4q_u8(src + x * 4);
+      uint16x8_t lo = vdupq_n_u16(128);
+      uint16x8_t hi = vdupq_n_u16(128);
+      lo = vmlaq_n_u16(lo, vmovl_u8(vget_low_u8(p.val[0])), c.yb);
+      hi = vmlaq_n_u16(hi, vmovl_u8(vget_high_u8(p.val[0])), c.yb);
+      lo = vmlaq_n_u16(lo, vmovl_u8(vget_low_u8(p.val[1])), c.yg);
+      hi = vmlaq_n_u16(hi, vmovl_u8(vget_high_u8(p.val[1])), c.yg);
+      lo = vmlaq_n_u16(lo, vmovl_u8(vget_low_u8(p.val[2])), c.yr);
+      hi = vmlaq_n_u16(hi, vmovl_u8(vget_high_u8(p.val[2])), c.yr);
+      uint8x16_t y = vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8));
+      vst1q_u8(dst + x, vqaddq_u8(y, vdupq_n_u8((uint8_t)c.y_offset)));
+    }
+
+#endif
+
+    for (; x < width; ++x) {
+      const uint8_t* p = src + x * 4;
+      dst[x] = rgb_to_y(p[2], p[1], p[0], c);
+    }
+  }
+
+  /*
+    The sums vectorize: SSE2 sums 16 samples with one _mm_sad_epu8()
+    and squares them with _mm_madd_epi16(); NEON uses pairwise widening
+    adds. A histogram doesn't, neither instruction set can scatter, so
+    we count in plain C. Counting consecutive samples into 4 separate
+    histograms keeps equal neighbours (flat screen content) from
+    waiting on the increment of the previous sample.
+  */
+  void kernel_luma_stats_row(const uint8_t* src, int width, uint32_t* histogram, uint64_t* sums) {
+
+    int x = 0;
+    uint64_t sum = 0;
+    uint64_t sum_sq = 0;
+
+#if defined(SC_HAVE_SSE2)
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    __m128i acc_sq = zero;
+
+    for (; x + 16 <= width; x += 16) {
+      __m128i v = _mm_loadu_si128((const __m128i*)(src + x));
+      __m128i lo = _mm_unpacklo_epi8(v, zero);
+      __m128i hi = _mm_unpackhi_epi8(v, zero);
+      __m128i sq = _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi));
+      acc = _mm_add_epi64(acc, _mm_sad_epu8(v, zero));
+      acc_sq = _mm_add_epi64(acc_sq, _mm_add_epi64(_mm_unpacklo_epi32(sq, zero), _mm_unpackhi_epi32(sq, zero)));
+    }
+
+    uint64_t lanes[4];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    _mm_storeu_si128((__m128i*)(lanes + 2), acc_sq);
+    sum = lanes[0] + lanes[1];
+    sum_sq = lanes[2] + lanes[3];
+
+#elif defined(SC_HAVE_NEON)
+
+    uint64x2_t acc = vdupq_n_u64(0);
+    uint64x2_t acc_sq = vdupq_n_u64(0);
+
+    for (; x + 16 <= width; x += 16) {
+      uint8x16_t v = vld1q_u8(src + x);
+      uint32x4_t sq = vpaddlq_u16(vmull_u8(vget_low_u8(v), vget_low_u8(v)));
+      sq = vpadalq_u16(sq, vmull_u8(vget_high_u8(v), vget_high_u8(v)));
+      acc = vpadalq_u32(acc, vpaddlq_u16(vpaddlq_u8(v)));
+      acc_sq = vpadalq_u32(acc_sq, sq);
+    }
+
+    sum = vgetq_lane_u64(acc, 0) + vgetq_lane_u64(acc, 1);
+    sum_sq = vgetq_lane_u64(acc_sq, 0) + vgetq_lane_u64(acc_sq, 1);
+
+#endif
+
+    for (; x < width; ++x) {
+      sum += src[x];
+      sum_sq += src[x] * src[x];
+    }
+
+    sums[0] += sum;
+    sums[1] += sum_sq;
+
+    for (x = 0; x + 4 <= width; x += 4) {
+      histogram[src[x + 0] * 4 + 0]++;
+      histogram[src[x + 1] * 4 + 1]++;
+      histogram[src[x + 2] * 4 + 2]++;
+      histogram[src[x + 3] * 4 + 3]++;
+    }
+
+    for (; x < width; ++x) {
+      histogram[src[x] * 4]++;
+    }
+  }
+
+  /* ----------------------------------------------------------- */
+
+  /*
+    Block hash, used to find the tiles of a frame that changed. We use
+    the accumulate and scramble steps of XXH3: every 16 byte block of a
+    row is XORed with the key of its position, the two 64 bit lanes
+    are multiplied 32 x 32 > 64 and added, together with the swapped
+    input, to two accumulators. That's one multiply per 8 bytes which
+    SSE2 (_mm_mul_epu32) and NEON (vmull_u32) do in one instruction.
+    Scrambling the accumulators after every row makes the order of the
+    rows matter; the key per position makes the order of the blocks
+    in a row matter. The bytes at the end of a row that don't fill a
+    block are hashed as a block padded with zeros.
+  */
+  static inline uint64_t load_u64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+  }
+
+  static inline void hash_accumulate(uint64_t* acc, const uint8_t* p, const uint64_t* key) {
+    uint64_t d0 = load_u64(p);
+    uint64_t d1 = load_u64(p + 8);
+    uint64_t k0 = d0 ^ key[0];
+    uint64_t k1 = d1 ^ key[1];
+    acc[0] += d1 + (k0 & 0xFFFFFFFF) * (k0 >> 32);
+    acc[1] += d0 + (k1 & 0xFFFFFFFF) * (k1 >> 32);
+  }
+
+  static inline uint64_t hash_scramble(uint64_t a, uint64_t key) {
+    a ^= a >> 47;
+    a ^= key;
+    return a * 0x9E3779B1ull;
+  }
+
+  uint64_t kernel_hash_block(const uint8_t* src, size_t stride, int nbytes, int rows) {
+
+    uint64_t acc[2] = { 0x9E3779B185EBCA87ull, 0xC2B2AE3D27D4EB4Full };
+
+    for (int j = 0; j < rows; ++j) {
+
+      const uint8_t* p = src + j * stride;
+      int x = 0;
+
+#if defined(SC_HAVE_SSE2)
+
+      __m128i a = _mm_loadu_si128((const __m128i*)acc);
+
+#if defined(SC_HAVE_AVX2)
+
+      /* Two blocks at a time, each in its own lane; x is a multiple of 32 so the keys of both blocks are neighbours. */
+      __m256i a2 = _mm256_setzero_si256();
+
+      for (; x + 32 <= nbytes; x += 32) {
+        __m256i d = _mm256_loadu_si256((const __m256i*)(p + x));
+        __m256i k = _mm256_xor_si256(d, _mm256_loadu_si256((const __m256i*)hash_keys[(x >> 4) & 15]));
+        __m256i product = _mm256_mul_epu32(k, _mm256_srli_epi64(k, 32));
+        a2 = _mm256_add_epi64(a2, _mm256_add_epi64(product, _mm256_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2))));
+      }
+
+      a = _mm_add_epi64(a, _mm_add_epi64(_mm256_castsi256_si128(a2), _mm256_extracti128_si256(a2, 1)));
+
+#endif
+
+      for (; x + 16 <= nbytes; x += 16) {
+        __m128i d = _mm_loadu_si128((const __m128i*)(p + x));
+        __m128i k = _mm_xor_si128(d, _mm_loadu_si128((const __m128i*)hash_keys[(x >> 4) & 15]));
+        __m128i product = _mm_mul_epu32(k, _mm_srli_epi64(k, 32));
+        a = _mm_add_epi64(a, _mm_add_epi64(product, _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2))));
+      }
+
+      _mm_storeu_si128((__m128i*)acc, a);
+
+#elif defined(SC_HAVE_NEON)
+
+      uint64x2_t a = vld1q_u64(acc);
+
+      for (; x + 16 <= nbytes; x += 16) {
+        uint64x2_t d = vreinterpretq_u64_u8(vld1q_u8(p + x));
+        uint64x2_t k = veorq_u64(d, vld1q_u64(hash_keys[(x >> 4) & 15]));
+        uint64x2_t product = vmull_u32(vmovn_u64(k), vshrn_n_u64(k, 32));
+        a = vaddq_u64(a, vaddq_u64(product, vextq_u64(d, d, 1)));
+      }
+
+      vst1q_u64(acc, a);
+
+#endif
+
+      for (; x + 16 <= nbytes; x += 16) {
+        hash_accumulate(acc, p + x, hash_keys[(x >> 4) & 15]);
+      }
+
+      if (x < nbytes) {
+        uint8_t last[16] = { 0 };
+        memcpy(last, p + x, nbytes - x);
+        hash_accumulate(acc, last, hash_keys[(x >> 4) & 15]);
+      }
+
+      acc[0] = hash_scramble(acc[0], hash_keys[j & 15][0]);
+      acc[1] = hash_scramble(acc[1], hash_keys[j & 15][1]);
+    }
+
+    /* The finalizer of MurmurHash3 over both lanes and the size. */
+    uint64_t h = acc[0] ^ ((acc[1] << 31) | (acc[1] >> 33)) ^ ((uint64_t)nbytes << 32) ^ (uint64_t)rows;
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+
+    return h;
+  }
+
+  /* ----------------------------------------------------------- */
+
+  void get_functions(KernelFunctions& fn) {
+    fn.bgra_to_i420_rows = kernel_bgra_to_i420_rows;
+    fn.i420_to_bgra_row = kernel_i420_to_bgra_row;
+    fn.nv12_to_bgra_row = kernel_nv12_to_bgra_row;
+    fn.nv12_to_rgba_row = kernel_nv12_to_rgba_row;
+    fn.split_uv_row = kernel_split_uv_row;
+    fn.merge_uv_row = kernel_merge_uv_row;
+    fn.bgra_to_rgba_row = kernel_bgra_to_rgba_row;
+    fn.bgra_to_rgb24_row = kernel_bgra_to_rgb24_row;
+    fn.bgra_to_bgr24_row = kernel_bgra_to_bgr24_row;
+    fn.l10r_to_p010_rows = kernel_l10r_to_p010_rows;
+    fn.l10r_to_rgb48_row = kernel_l10r_to_rgb48_row;
+    fn.l10r_to_bgra_row = kernel_l10r_to_bgra_row;
+    fn.scale_rows_v = kernel_scale_rows_v;
+    fn.scale_row_h = kernel_scale_row_h;
+    fn.box_2x2_row = kernel_box_2x2_row;
+    fn.box_sum_rows = kernel_box_sum_rows;
+    fn.box_reduce_row = kernel_box_reduce_row;
+    fn.filter_rows_v = kernel_filter_rows_v;
+    fn.filter_row_h = kernel_filter_row_h;
+    fn.transpose_block = kernel_transpose_block;
+    fn.reverse_row = kernel_reverse_row;
+    fn.blend_bgra_row = kernel_blend_bgra_row;
+    fn.mask_bgra_row = kernel_mask_bgra_row;
+    fn.mono_to_bgra_row = kernel_mono_to_bgra_row;
+    fn.mono_to_masks_row = kernel_mono_to_masks_row;
+    fn.hash_block = kernel_hash_block;
+    fn.fill_row = kernel_fill_row;
+    fn.box_slide_row = kernel_box_slide_row;
+    fn.blend_premul_bgra_row = kernel_blend_premul_bgra_row;
+    fn.blend_premul_row = kernel_blend_premul_row;
+    fn.bgra_to_luma_row = kernel_bgra_to_luma_row;
+    fn.luma_stats_row = kernel_luma_stats_row;
+  }
+
+} /* namespace SC_KERNELS_NAMESPACE */
+} /* namespace sc */
+
+#endif
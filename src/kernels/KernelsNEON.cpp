@@ -0,0 +1,13 @@
+/* The NEON kernels; compile this file with -mfpu=neon on 32 bit ARM. */
+#include <screencapture/Kernels.h>
+
+#if defined(SC_ARCH_ARM)
+
+#  if defined(__GNUC__) && !defined(__ARM_NEON) && !defined(__ARM_NEON__)
+#    error "KernelsNEON.cpp must be compiled with NEON support (-mfpu=neon)."
+#  endif
+
+#  define SC_KERNELS_NAMESPACE kernels_neon
+#  define SC_KERNELS_USE_NEON
+#  include "KernelsImpl.h"
+#endif
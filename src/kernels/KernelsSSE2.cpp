@@ -0,0 +1,13 @@
+/* The SSE2 kernels; the baseline of every x86-64 CPU. Compile this file with -msse2 for 32 bit x86. */
+#include <screencapture/Kernels.h>
+
+#if defined(SC_ARCH_X86)
+
+#  if defined(__GNUC__) && !defined(__SSE2__)
+#    error "KernelsSSE2.cpp must be compiled with -msse2."
+#  endif
+
+#  define SC_KERNELS_NAMESPACE kernels_sse2
+#  define SC_KERNELS_USE_SSE2
+#  include "KernelsImpl.h"
+#endif
@@ -0,0 +1,14 @@
+/* The SSE2 and SSSE3 (pshufb) kernels; compile this file with -mssse3. */
+#include <screencapture/Kernels.h>
+
+#if defined(SC_ARCH_X86)
+
+#  if defined(__GNUC__) && !defined(__SSSE3__)
+#    error "KernelsSSSE3.cpp must be compiled with -mssse3."
+#  endif
+
+#  define SC_KERNELS_NAMESPACE kernels_ssse3
+#  define SC_KERNELS_USE_SSE2
+#  define SC_KERNELS_USE_SSSE3
+#  include "KernelsImpl.h"
+#endif
@@ -1,7 +1,10 @@
 /* -*-c++-*- */
+#include <math.h>
 #include <sstream>
 #include <Cocoa/Cocoa.h>
 #include <CoreFoundation/CoreFoundation.h>
+#include <mach/mach_time.h>
+#include <algorithm>
 #include <screencapture/mac/ScreenCaptureDisplayStream.h>
 
 namespace sc {
@@ -9,6 +12,8 @@ namespace sc {
   ScreenCaptureDisplayStream::ScreenCaptureDisplayStream()
     :Base()
     ,stream_ref(NULL)
+    ,display_width(0)
+    ,display_height(0)
   {
     dq = dispatch_queue_create("com.roxlu.screengrabber", DISPATCH_QUEUE_SERIAL);
   }
@@ -38,6 +43,7 @@ namespace sc {
       info->id = display_ids[i];
       display->info = (void*)info;
       display->name = ss.str();
+      /* The display stream delivers upright frames of rotated displays, so `display->rotation` stays SC_ROTATE_0. */
       displays.push_back(display);
     }
     
@@ -121,6 +127,10 @@ namespace sc {
       }
     }
 
+    CGRect bounds = CGDisplayBounds(info->id);
+    display_width = (int)bounds.size.width;
+    display_height = (int)bounds.size.height;
+
     __block PixelBuffer pixel_buffer;
     if (0 != pixel_buffer.init(settings.output_width, settings.output_height, settings.pixel_format)) {
       printf("Error: failed to setup the the pixel format.\n");
@@ -136,7 +146,9 @@ namespace sc {
     CFDictionaryRef opts;
     keys[0] = (void *) kCGDisplayStreamShowCursor;
     values[0] = (void *) kCFBooleanTrue;
-    opts = CFDictionaryCreate(kCFAllocatorDefault, (const void **) keys, (const void **) values, 1, NULL, NULL);
+    keys[1] = (void *) kCGDisplayStreamYCbCrMatrix;
+    values[1] = (void *) ((SC_COLOR_MATRIX_BT709 == settings.color_matrix) ? kCGDisplayStreamYCbCrMatrix_ITU_R_709_2 : kCGDisplayStreamYCbCrMatrix_ITU_R_601_4);
+    opts = CFDictionaryCreate(kCFAllocatorDefault, (const void **) keys, (const void **) values, 2, NULL, NULL);
 
     /* 
        UPDATE USING THIS CLEAN CODE: https://gist.github.com/roxlu/60f2f635347863d6384d 
@@ -183,6 +195,14 @@ namespace sc {
                                                                 exit(EXIT_FAILURE);
                                                               }
                                                               
+                                                              /* The dirty rects tell us whether anything changed since the previous frame. */
+                                                              updateMetadata(time, ref, pixel_buffer.width, pixel_buffer.height);
+                                                              pixel_buffer.info = &metadata;
+                                                              pixel_buffer.damage = SC_DAMAGE_UNKNOWN;
+                                                              if (0 != (metadata.flags & SC_FRAME_HAS_DIRTY_RECTS)) {
+                                                                pixel_buffer.damage = (0 == metadata.dirty_rects.size()) ? SC_DAMAGE_NONE : SC_DAMAGE_CHANGED;
+                                                              }
+
                                                               callback(pixel_buffer);
 
                                                               IOSurfaceUnlock(frame, kIOSurfaceLockReadOnly, NULL);
@@ -197,6 +217,46 @@ namespace sc {
     return 0;
   }
 
+  /*
+    The stream also reports the rects that moved, but not clearly
+    whether they are the source or the destination of the move, so we
+    only use the dirty rects; they include the moved areas.
+  */
+  void ScreenCaptureDisplayStream::updateMetadata(uint64_t time, CGDisplayStreamUpdateRef ref, int w, int h) {
+
+    static mach_timebase_info_data_t timebase = { 0, 0 };
+    if (0 == timebase.denom) {
+      mach_timebase_info(&timebase);
+    }
+
+    metadata.reset();
+    metadata.capture_time = screencapture_get_time_ns();
+    metadata.present_time = time * timebase.numer / timebase.denom;
+
+    if (NULL == ref || 0 >= display_width || 0 >= display_height) {
+      return;
+    }
+
+    size_t num_rects = 0;
+    const CGRect* rects = CGDisplayStreamUpdateGetRects(ref, kCGDisplayStreamUpdateDirtyRects, &num_rects);
+
+    for (size_t i = 0; i < num_rects; ++i) {
+      DirtyRect r;
+      r.x = std::max(0, (int)floor(rects[i].origin.x));
+      r.y = std::max(0, (int)floor(rects[i].origin.y));
+      r.width = std::min(display_width, (int)ceil(rects[i].origin.x + rects[i].size.width)) - r.x;
+      r.height = std::min(display_height, (int)ceil(rects[i].origin.y + rects[i].size.height)) - r.y;
+      if (0 < r.width && 0 < r.height) {
+        metadata.dirty_rects.push_back(r);
+      }
+    }
+
+    metadata.flags |= SC_FRAME_HAS_DIRTY_RECTS;
+
+    /* The stream scales the display into the frame size. */
+    metadata.scale(display_width, display_height, w, h, 1);
+  }
+
   int ScreenCaptureDisplayStream::start() {
 
     CGError err = CGDisplayStreamStart(stream_ref);
@@ -238,6 +298,16 @@ namespace sc {
     return 0;
   }
 
+  /* The display stream can produce 420v/420f with the BT.601 and BT.709 matrices; BT.2020 is converted from BGRA. */
+  int ScreenCaptureDisplayStream::canUseColorMatrix(int matrix) {
+    
+    if (SC_COLOR_MATRIX_BT601 == matrix || SC_COLOR_MATRIX_BT709 == matrix) {
+      return 0;
+    }
+
+    return -1;
+  }
+
 }; /* namespace sc */
 
 
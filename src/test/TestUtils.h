@@ -0,0 +1,38 @@
+/*
+
+  Test Utils
+  ----------
+
+  Helpers that the tests share: random pixels with a fixed seed, so
+  every run tests the same frames, and pixel buffers that own their
+  memory.
+
+ */
+#ifndef SCREEN_CAPTURE_TEST_UTILS_H
+#define SCREEN_CAPTURE_TEST_UTILS_H
+
+#include <stdlib.h>
+#include <vector>
+#include <screencapture/Types.h>
+
+/* ----------------------------------------------------------- */
+
+inline void fill_random(std::vector<uint8_t>& data, unsigned int seed = 1234) {
+  srand(seed);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = rand() & 0xFF;
+  }
+}
+
+inline int alloc_buffer(sc::PixelBuffer& buf, std::vector<uint8_t>& mem, int w, int h, int fmt) {
+
+  if (0 != buf.init(w, h, fmt)) {
+    return -1;
+  }
+
+  mem.resize(buf.getNumBytes());
+
+  return buf.setPlanes(&mem.front());
+}
+
+#endif
@@ -0,0 +1,386 @@
+/*
+
+  Analytics
+  ---------
+
+  Tests the frame statistics against a C reference for RGB and 4:2:0
+  frames with odd sizes, that the stats which a conversion computes
+  while it writes the frame are the same as analyzing the converted
+  frame (and as analyzing the BGRA source with the same flags), that
+  analyzing on multiple threads gives the same stats, the uniform and
+  blank detection and the errors. Prints the time to convert a 1080p
+  frame with and without the stats.
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <vector>
+#include <algorithm>
+#include <screencapture/Analytics.h>
+#include <screencapture/Convert.h>
+#include <screencapture/Scaler.h>
+#include <screencapture/Executor.h>
+#include "TestUtils.h"
+
+using namespace sc;
+
+static void get_luma(PixelBuffer& frame, const YuvCoefficients& c, std::vector<uint8_t>& luma);
+static int check_stats(FrameStats& stats, std::vector<uint8_t>& luma, int w, int h);
+static int is_same(FrameStats& a, FrameStats& b);
+static int test_format(int fmt, int w, int h, int flags, const YuvCoefficients& c, Executor& executor);
+static int test_convert(Executor& executor);
+static int test_blank();
+static int test_errors();
+static void benchmark();
+
+int main() {
+
+  printf("\n\ntest_analytics\n\n");
+
+  int r = 0;
+  Executor executor;
+
+  if (0 != executor.init(4)) {
+    exit(EXIT_FAILURE);
+  }
+
+  r |= test_format(SC_BGRA, 1283, 723, 0, yuv_bt601_video, executor);
+  r |= test_format(SC_BGRA, 5, 3, SC_CONVERT_BT709 | SC_CONVERT_FULL_RANGE, yuv_bt709_full, executor);
+  r |= test_format(SC_RGBA, 641, 479, SC_CONVERT_BT2020, yuv_bt2020_video, executor);
+  r |= test_format(SC_420V, 1283, 723, 0, yuv_bt601_video, executor);
+  r |= test_format(SC_420F, 1920, 1080, 0, yuv_bt601_full, executor);
+  r |= test_format(SC_I420, 17, 9, 0, yuv_bt601_video, executor);
+  r |= test_convert(executor);
+  r |= test_blank();
+  r |= test_errors();
+
+  if (0 != r) {
+    printf("\nFAILED\n\n");
+    exit(EXIT_FAILURE);
+  }
+
+  benchmark();
+
+  printf("\nOK\n\n");
+
+  return 0;
+}
+
+/* ----------------------------------------------------------- */
+
+static int test_format(int fmt, int w, int h, int flags, const YuvCoefficients& c, Executor& executor) {
+
+  FrameAnalyzer serial;
+  FrameAnalyzer parallel;
+  PixelBuffer frame;
+  std::vector<uint8_t> mem;
+  std::vector<uint8_t> luma;
+  std::string name = screencapture_pixelformat_to_string(fmt);
+
+  if (0 != alloc_buffer(frame, mem, w, h, fmt)) {
+    return 1;
+  }
+
+  fill_random(mem, (unsigned int)(w + fmt));
+  get_luma(frame, c, luma);
+
+  if (0 != serial.analyze(frame, flags) || 0 != parallel.analyze(frame, flags, &executor)) {
+    printf("- %s: FAILED, cannot analyze.\n", name.c_str());
+    return 1;
+  }
+
+  if (0 != check_stats(serial.stats, luma, w, h)) {
+    printf("- %s: FAILED, the stats differ from the reference.\n", name.c_str());
+    return 1;
+  }
+
+  if (0 != is_same(serial.stats, parallel.stats)) {
+    printf("- %s: FAILED, the stats differ when we analyze on multiple threads.\n", name.c_str());
+    return 1;
+  }
+
+  printf("- %s, %d x %d: OK, mean %.2f, variance %.2f\n", name.c_str(), w, h, serial.stats.mean, serial.stats.variance);
+
+  return 0;
+}
+
+/* The stats of a conversion are the stats of the converted frame, and of the source with the same flags. */
+static int test_convert(Executor& executor) {
+
+  FrameAnalyzer fused;
+  FrameAnalyzer parallel;
+  FrameAnalyzer separate;
+  FrameAnalyzer source;
+  PixelBuffer bgra;
+  PixelBuffer nv12;
+  PixelBuffer small;
+  std::vector<uint8_t> bgra_mem;
+  std::vector<uint8_t> nv12_mem;
+  std::vector<uint8_t> small_mem;
+  Scaler scaler;
+  int flags = SC_CONVERT_BT709;
+
+  if (0 != alloc_buffer(bgra, bgra_mem, 1921, 1081, SC_BGRA)
+      || 0 != alloc_buffer(nv12, nv12_mem, 1921, 1081, SC_420V)
+      || 0 != alloc_buffer(small, small_mem, 641, 359, SC_I420)
+      || 0 != scaler.init(1921, 1081, 641, 359, SC_BGRA))
+    {
+      return 1;
+    }
+
+  fill_random(bgra_mem, 5);
+
+  if (0 != screencapture_convert(bgra, nv12, flags, NULL, &fused)
+      || 0 != separate.analyze(nv12)
+      || 0 != source.analyze(bgra, flags)
+      || false == fused.has_stats)
+    {
+      printf("- convert: FAILED, cannot convert and analyze.\n");
+      return 1;
+    }
+
+  if (0 != is_same(fused.stats, separate.stats) || 0 != is_same(fused.stats, source.stats)) {
+    printf("- convert: FAILED, the stats of the conversion differ from the stats of the frames.\n");
+    return 1;
+  }
+
+  if (0 != screencapture_convert(bgra, nv12, flags, &executor, &parallel) || 0 != is_same(fused.stats, parallel.stats)) {
+    printf("- convert: FAILED, the stats differ when we convert on multiple threads.\n");
+    return 1;
+  }
+
+  if (0 != screencapture_scale_convert(scaler, bgra, small, 0, &executor, &fused)
+      || 0 != separate.analyze(small)
+      || 0 != is_same(fused.stats, separate.stats))
+    {
+      printf("- convert: FAILED, the stats of scaling and converting differ from the stats of the frame.\n");
+      return 1;
+    }
+
+  printf("- convert: OK\n");
+
+  return 0;
+}
+
+static int test_blank() {
+
+  FrameAnalyzer analyzer;
+  PixelBuffer nv12;
+  PixelBuffer bgra;
+  std::vector<uint8_t> nv12_mem;
+  std::vector<uint8_t> bgra_mem;
+
+  if (0 != alloc_buffer(nv12, nv12_mem, 640, 480, SC_420V) || 0 != alloc_buffer(bgra, bgra_mem, 320, 240, SC_BGRA)) {
+    return 1;
+  }
+
+  /* Black with a line of white text. */
+  memset(&nv12_mem.front(), 16, nv12_mem.size());
+  memset(nv12.plane[0] + 200 * nv12.stride[0] + 100, 235, 300);
+
+  if (0 != analyzer.analyze(nv12) || 1 != analyzer.stats.is_uniform || 1 != analyzer.stats.is_blank || 16 != analyzer.stats.peak_luma) {
+    printf("- blank: FAILED, a black frame with a line of text should be blank.\n");
+    return 1;
+  }
+
+  if (16.0f >= analyzer.stats.tile_mean[3][2] || 16.0f != analyzer.stats.tile_mean[0][0]) {
+    printf("- blank: FAILED, the tile with the text should be brighter.\n");
+    return 1;
+  }
+
+  /* A blue screen is uniform but not blank. */
+  memset(&nv12_mem.front(), 41, nv12.stride[0] * nv12.height);
+
+  if (0 != analyzer.analyze(nv12) || 1 != analyzer.stats.is_uniform || 0 != analyzer.stats.is_blank || 0.0f != analyzer.stats.variance) {
+    printf("- blank: FAILED, a blue screen should be uniform but not blank.\n");
+    return 1;
+  }
+
+  fill_random(nv12_mem, 11);
+
+  if (0 != analyzer.analyze(nv12) || 0 != analyzer.stats.is_uniform || 0 != analyzer.stats.is_blank) {
+    printf("- blank: FAILED, noise should not be uniform.\n");
+    return 1;
+  }
+
+  /* Black BGRA in full range has luma 0. */
+  for (size_t i = 0; i < bgra_mem.size(); i += 4) {
+    bgra_mem[i + 0] = 0;
+    bgra_mem[i + 1] = 0;
+    bgra_mem[i + 2] = 0;
+    bgra_mem[i + 3] = 255;
+  }
+
+  if (0 != analyzer.analyze(bgra, SC_CONVERT_FULL_RANGE) || 1 != analyzer.stats.is_blank || 0 != analyzer.stats.black_level || 320 * 240 != analyzer.stats.histogram[0]) {
+    printf("- blank: FAILED, a black full range BGRA frame should be blank.\n");
+    return 1;
+  }
+
+  printf("- blank: OK\n");
+
+  return 0;
+}
+
+static int test_errors() {
+
+  FrameAnalyzer analyzer;
+  PixelBuffer frame;
+  PixelBuffer rgb;
+  PixelBuffer bgra;
+  std::vector<uint8_t> rgb_mem;
+  std::vector<uint8_t> bgra_mem;
+
+  if (0 != frame.init(64, 64, SC_BGRA)
+      || 0 != alloc_buffer(rgb, rgb_mem, 64, 64, SC_RGB24)
+      || 0 != alloc_buffer(bgra, bgra_mem, 64, 64, SC_BGRA))
+    {
+      return 1;
+    }
+
+  if (0 == analyzer.canAnalyze(SC_RGB24)
+      || 0 == analyzer.canAnalyze(SC_P010)
+      || 0 == analyzer.begin(0, 64, SC_BGRA, 0, 1)
+      || 0 == analyzer.begin(64, 64, SC_BGRA, 0, 0)
+      || 0 == analyzer.analyze(frame)
+      || 0 == analyzer.analyze(rgb)
+      || 0 == screencapture_convert(bgra, rgb, 0, NULL, &analyzer)
+      || true == analyzer.has_stats)
+    {
+      printf("- errors: FAILED, invalid frames should fail.\n");
+      return 1;
+    }
+
+  printf("- errors: OK\n");
+
+  return 0;
+}
+
+static void benchmark() {
+
+  FrameAnalyzer analyzer;
+  PixelBuffer bgra;
+  PixelBuffer nv12;
+  std::vector<uint8_t> bgra_mem;
+  std::vector<uint8_t> nv12_mem;
+  int num_frames = 20;
+
+  if (0 != alloc_buffer(bgra, bgra_mem, 1920, 1080, SC_BGRA) || 0 != alloc_buffer(nv12, nv12_mem, 1920, 1080, SC_420V)) {
+    return;
+  }
+
+  fill_random(bgra_mem, 3);
+
+  clock_t start = clock();
+  for (int k = 0; k < num_frames; ++k) {
+    screencapture_convert(bgra, nv12);
+  }
+  double convert_ms = (1000.0 * (clock() - start)) / (CLOCKS_PER_SEC * num_frames);
+
+  start = clock();
+  for (int k = 0; k < num_frames; ++k) {
+    screencapture_convert(bgra, nv12, 0, NULL, &analyzer);
+  }
+  double fused_ms = (1000.0 * (clock() - start)) / (CLOCKS_PER_SEC * num_frames);
+
+  start = clock();
+  for (int k = 0; k < num_frames; ++k) {
+    analyzer.analyze(bgra);
+  }
+  double bgra_ms = (1000.0 * (clock() - start)) / (CLOCKS_PER_SEC * num_frames);
+
+  printf("- 1080p BGRA into 420V: %.3f ms, with stats %.3f ms; stats of the BGRA frame alone %.3f ms\n", convert_ms, fused_ms, bgra_ms);
+}
+
+/* ----------------------------------------------------------- */
+
+/* The reference: the Y of every pixel, with the formula of the conversions. */
+static void get_luma(PixelBuffer& frame, const YuvCoefficients& c, std::vector<uint8_t>& luma) {
+
+  int w = (int)frame.width;
+  int h = (int)frame.height;
+
+  luma.resize(w * h);
+
+  for (int y = 0; y < h; ++y) {
+    const uint8_t* row = frame.plane[0] + y * frame.stride[0];
+    for (int x = 0; x < w; ++x) {
+      if (SC_BGRA != frame.pixel_format && SC_RGBA != frame.pixel_format) {
+        luma[y * w + x] = row[x];
+        continue;
+      }
+      int r = (SC_BGRA == frame.pixel_format) ? row[x * 4 + 2] : row[x * 4 + 0];
+      int g = row[x * 4 + 1];
+      int b = (SC_BGRA == frame.pixel_format) ? row[x * 4 + 0] : row[x * 4 + 2];
+      int v = ((c.yr * r + c.yg * g + c.yb * b + 128) >> 8) + c.y_offset;
+      luma[y * w + x] = (uint8_t)std::min(255, std::max(0, v));
+    }
+  }
+}
+
+static int check_stats(FrameStats& stats, std::vector<uint8_t>& luma, int w, int h) {
+
+  uint32_t histogram[256] = { 0 };
+  double sums[2] = { 0.0 };
+  double tiles[SC_STATS_TILE_ROWS][SC_STATS_TILE_COLS][3];
+
+  memset(tiles, 0, sizeof(tiles));
+
+  for (int y = 0; y < h; ++y) {
+    for (int x = 0; x < w; ++x) {
+      double v = luma[y * w + x];
+      double* tile = tiles[(y * SC_STATS_TILE_ROWS) / h][(x * SC_STATS_TILE_COLS) / w];
+      histogram[luma[y * w + x]]++;
+      sums[0] += v;
+      sums[1] += v * v;
+      tile[0] += v;
+      tile[1] += v * v;
+      tile[2] += 1.0;
+    }
+  }
+
+  if (0 != memcmp(histogram, stats.histogram, sizeof(histogram))) {
+    printf("  the histograms differ.\n");
+    return -1;
+  }
+
+  double mean = sums[0] / (w * h);
+  double variance = sums[1] / (w * h) - mean * mean;
+
+  if (fabs(mean - stats.mean) > 0.01 || fabs(variance - stats.variance) > 0.05) {
+    printf("  mean %f, variance %f; expected %f, %f.\n", stats.mean, stats.variance, mean, variance);
+    return -2;
+  }
+
+  for (int ty = 0; ty < SC_STATS_TILE_ROWS; ++ty) {
+    for (int tx = 0; tx < SC_STATS_TILE_COLS; ++tx) {
+      double* tile = tiles[ty][tx];
+      double tile_mean = (0.0 == tile[2]) ? 0.0 : tile[0] / tile[2];
+      double tile_variance = (0.0 == tile[2]) ? 0.0 : tile[1] / tile[2] - tile_mean * tile_mean;
+      if (fabs(tile_mean - stats.tile_mean[ty][tx]) > 0.01 || fabs(tile_variance - stats.tile_variance[ty][tx]) > 0.05) {
+        printf("  tile %d, %d: mean %f, variance %f; expected %f, %f.\n", tx, ty, stats.tile_mean[ty][tx], stats.tile_variance[ty][tx], tile_mean, tile_variance);
+        return -3;
+      }
+    }
+  }
+
+  return 0;
+}
+
+static int is_same(FrameStats& a, FrameStats& b) {
+
+  if (0 != memcmp(a.histogram, b.histogram, sizeof(a.histogram))
+      || 0 != memcmp(a.tile_mean, b.tile_mean, sizeof(a.tile_mean))
+      || 0 != memcmp(a.tile_variance, b.tile_variance, sizeof(a.tile_variance))
+      || a.mean != b.mean
+      || a.variance != b.variance
+      || a.peak_luma != b.peak_luma
+      || a.is_blank != b.is_blank)
+    {
+      return -1;
+    }
+
+  return 0;
+}
@@ -0,0 +1,316 @@
+/*
+
+  Compositor
+  ----------
+
+  Tests the mosaic compositor: a frame with the size of its cell is
+  copied, other frames are scaled with their aspect ratio into the
+  middle of the cell (the same pixels as a `Scaler`) and the rest of
+  the cell stays black. Checks that `update()` only passes the canvas
+  when a cell received a frame, the dirty rects of the canvas, that
+  the cells of 4:2:0 canvases start at even positions, that scaling on
+  multiple threads gives the same canvas and the errors. Prints the
+  time to compose 16 1080p displays into a 1080p mosaic.
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include <screencapture/Compositor.h>
+#include "TestUtils.h"
+
+using namespace sc;
+
+static int num_canvases = 0;
+static std::vector<DirtyRect> last_dirty;
+static std::vector<uint8_t> last_canvas;
+
+static void on_canvas(PixelBuffer& canvas);
+static int test_bgra();
+static int test_yuv(int num_threads, std::vector<uint8_t>& result);
+static int test_errors();
+static void benchmark();
+
+int main() {
+
+  printf("\n\ntest_compositor\n\n");
+
+  int r = 0;
+  std::vector<uint8_t> single;
+  std::vector<uint8_t> multi;
+
+  r |= test_bgra();
+  r |= test_yuv(1, single);
+  r |= test_yuv(4, multi);
+  r |= test_errors();
+
+  if (0 == r && single != multi) {
+    printf("- threads: FAILED, scaling on 4 threads gives a different canvas.\n");
+    r = 1;
+  }
+
+  if (0 != r) {
+    printf("\nFAILED\n\n");
+    exit(EXIT_FAILURE);
+  }
+
+  printf("- threads: OK\n");
+
+  benchmark();
+
+  printf("\nOK\n\n");
+
+  return 0;
+}
+
+/* ----------------------------------------------------------- */
+
+static int test_bgra() {
+
+  Compositor comp(on_canvas, (void*)0x42);
+  CompositorSettings cfg;
+  PixelBuffer same;
+  PixelBuffer wide;
+  PixelBuffer expected;
+  std::vector<uint8_t> same_mem;
+  std::vector<uint8_t> wide_mem;
+  std::vector<uint8_t> expected_mem;
+  Scaler scaler;
+  FrameInfo info;
+  DirtyRect dirty = { 10, 12, 5, 6 };
+  uint8_t black[4] = { 0, 0, 0, 255 };
+
+  cfg.width = 200;
+  cfg.height = 120;
+  cfg.pixel_format = SC_BGRA;
+  cfg.cols = 2;
+  cfg.rows = 2;
+
+  if (0 != comp.init(cfg)
+      || 0 != alloc_buffer(same, same_mem, 100, 60, SC_BGRA)
+      || 0 != alloc_buffer(wide, wide_mem, 200, 60, SC_BGRA)
+      || 0 != alloc_buffer(expected, expected_mem, 100, 30, SC_BGRA))
+    {
+      return 1;
+    }
+
+  fill_random(same_mem, 1);
+  fill_random(wide_mem, 2);
+
+  if (1 != comp.update() || 0 != num_canvases) {
+    printf("- BGRA: FAILED, we shouldn't pass the canvas without frames.\n");
+    return 1;
+  }
+
+  /* Cell 0 gets a frame of its size, cell 1 a frame that's twice as wide; 100 x 30 at 15 rows from the top. */
+  if (0 != comp.setFrame(0, same)
+      || 0 != comp.setFrame(1, wide)
+      || 0 != comp.update()
+      || 1 != num_canvases
+      || 2 != last_dirty.size()
+      || 0 != scaler.init(200, 60, 100, 30, SC_BGRA)
+      || 0 != scaler.scale(wide, expected))
+    {
+      printf("- BGRA: FAILED, could not compose the frames.\n");
+      return 1;
+    }
+
+  PixelBuffer& canvas = comp.canvas;
+
+  for (int y = 0; y < 120; ++y) {
+    for (int x = 0; x < 200; ++x) {
+
+      const uint8_t* px = &last_canvas[y * canvas.stride[0] + x * 4];
+      const uint8_t* value = black;
+
+      if (x < 100 && y < 60) {
+        value = &same_mem[y * same.stride[0] + x * 4];
+      }
+      else if (x >= 100 && y >= 15 && y < 45) {
+        value = &expected_mem[(y - 15) * expected.stride[0] + (x - 100) * 4];
+      }
+
+      if (0 != memcmp(px, value, 4)) {
+        printf("- BGRA: FAILED, pixel %d, %d differs.\n", x, y);
+        return 1;
+      }
+    }
+  }
+
+  if (0 != last_dirty[0].x || 100 != last_dirty[1].x || 100 != last_dirty[1].width || 60 != last_dirty[1].height) {
+    printf("- BGRA: FAILED, the first frames should dirty their whole cell.\n");
+    return 1;
+  }
+
+  /* The dirty rects of a frame with the size of the previous one move into the cell. */
+  info.flags = SC_FRAME_HAS_DIRTY_RECTS;
+  info.dirty_rects.push_back(dirty);
+  same.info = &info;
+
+  if (1 != comp.update() || 0 != comp.setFrame(0, same) || 0 != comp.update() || 1 != last_dirty.size()
+      || 10 != last_dirty[0].x || 12 != last_dirty[0].y || 5 != last_dirty[0].width || 6 != last_dirty[0].height)
+    {
+      printf("- BGRA: FAILED, unexpected dirty rects: %lu.\n", last_dirty.size());
+      return 1;
+    }
+
+  /* A new size clears the cell. */
+  if (0 != comp.setFrame(1, same) || 0 != comp.update() || 1 != last_dirty.size() || 100 != last_dirty[0].width) {
+    printf("- BGRA: FAILED, a new size should dirty the whole cell.\n");
+    return 1;
+  }
+
+  printf("- BGRA: OK\n");
+
+  return 0;
+}
+
+/* 16 sources with odd sizes into an NV12 canvas with odd cells. */
+static int test_yuv(int num_threads, std::vector<uint8_t>& result) {
+
+  Compositor comp(on_canvas);
+  CompositorSettings cfg;
+
+  cfg.width = 642;
+  cfg.height = 362;
+  cfg.pixel_format = SC_420V;
+  cfg.cols = 4;
+  cfg.rows = 4;
+  cfg.num_threads = num_threads;
+  cfg.scale_quality = SC_SCALE_BICUBIC;
+
+  if (0 != comp.init(cfg)) {
+    return 1;
+  }
+
+  for (int i = 0; i < 16; ++i) {
+
+    PixelBuffer frame;
+    std::vector<uint8_t> mem;
+    CompositorCell* c = comp.cells[i];
+
+    if (0 != alloc_buffer(frame, mem, 101 + i * 37, 77 + i * 23, SC_420V)) {
+      return 1;
+    }
+
+    fill_random(mem, 10 + i);
+
+    if (0 != comp.setFrame(i, frame)) {
+      return 1;
+    }
+
+    if (0 != (c->x & 1) || 0 != (c->y & 1) || 0 != (c->frame_x & 1) || 0 != (c->frame_y & 1)
+        || c->frame_x < c->x || c->frame_y < c->y
+        || c->frame_x + c->frame_width > c->x + c->width
+        || c->frame_y + c->frame_height > c->y + c->height)
+      {
+        printf("- 420V: FAILED, cell %d is at %d, %d, %d x %d, its frame at %d, %d, %d x %d.\n", i, c->x, c->y, c->width, c->height, c->frame_x, c->frame_y, c->frame_width, c->frame_height);
+        return 1;
+      }
+  }
+
+  if (642 != comp.cells[15]->x + comp.cells[15]->width || 362 != comp.cells[15]->y + comp.cells[15]->height) {
+    printf("- 420V: FAILED, the cells don't cover the canvas.\n");
+    return 1;
+  }
+
+  if (0 != comp.update() || 16 != last_dirty.size()) {
+    return 1;
+  }
+
+  result = last_canvas;
+
+  printf("- 420V, %d thread(s): OK\n", num_threads);
+
+  return 0;
+}
+
+static int test_errors() {
+
+  Compositor comp(on_canvas);
+  CompositorSettings cfg;
+  PixelBuffer frame;
+  std::vector<uint8_t> mem;
+
+  cfg.width = 320;
+  cfg.height = 240;
+  cfg.pixel_format = SC_I420;
+  cfg.cols = 9;
+  cfg.rows = 9;
+
+  if (0 == comp.init(cfg)) {
+    return 1;
+  }
+
+  cfg.cols = 2;
+  cfg.rows = 2;
+  cfg.pixel_format = SC_P010;
+
+  if (0 == comp.init(cfg)) {
+    return 1;
+  }
+
+  cfg.pixel_format = SC_I420;
+
+  if (0 != comp.init(cfg) || 0 != alloc_buffer(frame, mem, 64, 64, SC_420V)) {
+    return 1;
+  }
+
+  if (0 == comp.setFrame(0, frame) || 0 == comp.setFrame(4, frame) || 0 == comp.setFrame(-1, frame)) {
+    printf("- errors: FAILED\n");
+    return 1;
+  }
+
+  comp.shutdown();
+
+  if (0 == comp.update()) {
+    return 1;
+  }
+
+  printf("- errors: OK\n");
+
+  return 0;
+}
+
+static void benchmark() {
+
+  Compositor comp(on_canvas);
+  CompositorSettings cfg;
+  PixelBuffer frame;
+  std::vector<uint8_t> mem;
+  int num_frames = 4;
+
+  cfg.width = 1920;
+  cfg.height = 1080;
+  cfg.pixel_format = SC_420V;
+  cfg.cols = 4;
+  cfg.rows = 4;
+  cfg.num_threads = 0;
+
+  if (0 != comp.init(cfg) || 0 != alloc_buffer(frame, mem, 1920, 1080, SC_420V)) {
+    return;
+  }
+
+  fill_random(mem, 3);
+
+  clock_t start = clock();
+  for (int k = 0; k < num_frames; ++k) {
+    for (int i = 0; i < 16; ++i) {
+      comp.setFrame(i, frame);
+    }
+    comp.update();
+  }
+  double ms = (1000.0 * (clock() - start)) / (CLOCKS_PER_SEC * num_frames);
+
+  printf("- 16 x 1080p into a 1080p 420V mosaic: %.3f ms CPU time per canvas\n", ms);
+}
+
+/* ----------------------------------------------------------- */
+
+static void on_canvas(PixelBuffer& canvas) {
+  num_canvases++;
+  last_dirty = canvas.info->dirty_rects;
+  last_canvas.assign(canvas.plane[0], canvas.plane[0] + canvas.getNumBytes());
+}
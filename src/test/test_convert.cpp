@@ -0,0 +1,500 @@
+/*
+
+  Convert
+  -------
+
+  Tests the pixel format conversions against a plain C reference
+  implementation. The SIMD kernels must produce exactly the same
+  output as the reference. We use a width that isn't a multiple of
+  the SIMD width and an odd height so the edge cases are tested too.
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include <screencapture/Convert.h>
+#include "TestUtils.h"
+
+using namespace sc;
+
+static uint8_t clamp(int v);
+static void reference_bgra_to_i420(PixelBuffer& src, PixelBuffer& dst);
+static void reference_i420_to_bgra(PixelBuffer& src, PixelBuffer& dst);
+static int compare_planes(const char* name, PixelBuffer& a, PixelBuffer& b, int plane, size_t nbytes, size_t nrows);
+static int test_packed(PixelBuffer& bgra, int fmt, const int* order, int bpp);
+static int test_l10r(int w, int h);
+static int test_nv12_to_rgb(int w, int h, int fmt, int flags, const int* coeffs);
+static int test_full_range(PixelBuffer& bgra, int flags);
+
+int main() {
+
+  printf("\n\ntest_convert\n\n");
+
+  int w = 173;
+  int h = 97;
+  int r = 0;
+
+  PixelBuffer bgra, i420, i420_ref, nv12, nv12_direct, i420_back, bgra_out, bgra_ref;
+  std::vector<uint8_t> bgra_mem, i420_mem, i420_ref_mem, nv12_mem, nv12_direct_mem, i420_back_mem, bgra_out_mem, bgra_ref_mem;
+
+  if (0 != bgra.init(w, h, SC_BGRA)
+      || 0 != i420.init(w, h, SC_I420)
+      || 0 != i420_ref.init(w, h, SC_I420)
+      || 0 != nv12.init(w, h, SC_420V)
+      || 0 != nv12_direct.init(w, h, SC_420V)
+      || 0 != i420_back.init(w, h, SC_I420)
+      || 0 != bgra_out.init(w, h, SC_BGRA)
+      || 0 != bgra_ref.init(w, h, SC_BGRA))
+    {
+      printf("Error: failed to initialize the pixel buffers.\n");
+      exit(EXIT_FAILURE);
+    }
+
+  bgra_mem.resize(bgra.getNumBytes());
+  i420_mem.resize(i420.getNumBytes());
+  i420_ref_mem.resize(i420_ref.getNumBytes());
+  nv12_mem.resize(nv12.getNumBytes());
+  nv12_direct_mem.resize(nv12_direct.getNumBytes());
+  i420_back_mem.resize(i420_back.getNumBytes());
+  bgra_out_mem.resize(bgra_out.getNumBytes());
+  bgra_ref_mem.resize(bgra_ref.getNumBytes());
+
+  bgra.setPlanes(&bgra_mem.front());
+  i420.setPlanes(&i420_mem.front());
+  i420_ref.setPlanes(&i420_ref_mem.front());
+  nv12.setPlanes(&nv12_mem.front());
+  nv12_direct.setPlanes(&nv12_direct_mem.front());
+  i420_back.setPlanes(&i420_back_mem.front());
+  bgra_out.setPlanes(&bgra_out_mem.front());
+  bgra_ref.setPlanes(&bgra_ref_mem.front());
+
+  fill_random(bgra_mem);
+
+  /* BGRA > I420 */
+  if (0 != screencapture_convert(bgra, i420)) {
+    exit(EXIT_FAILURE);
+  }
+
+  reference_bgra_to_i420(bgra, i420_ref);
+  r |= compare_planes("BGRA > I420 (Y)", i420, i420_ref, 0, w, h);
+  r |= compare_planes("BGRA > I420 (U)", i420, i420_ref, 1, (w + 1) / 2, (h + 1) / 2);
+  r |= compare_planes("BGRA > I420 (V)", i420, i420_ref, 2, (w + 1) / 2, (h + 1) / 2);
+
+  /* I420 > NV12 > I420, must be lossless. */
+  if (0 != screencapture_convert(i420, nv12)) {
+    exit(EXIT_FAILURE);
+  }
+
+  if (0 != screencapture_convert(nv12, i420_back)) {
+    exit(EXIT_FAILURE);
+  }
+
+  r |= compare_planes("I420 > NV12 > I420 (Y)", i420, i420_back, 0, w, h);
+  r |= compare_planes("I420 > NV12 > I420 (U)", i420, i420_back, 1, (w + 1) / 2, (h + 1) / 2);
+  r |= compare_planes("I420 > NV12 > I420 (V)", i420, i420_back, 2, (w + 1) / 2, (h + 1) / 2);
+
+  /* BGRA > NV12 must be the same as BGRA > I420 > NV12. */
+  if (0 != screencapture_convert(bgra, nv12_direct)) {
+    exit(EXIT_FAILURE);
+  }
+
+  r |= compare_planes("BGRA > NV12 (Y)", nv12_direct, nv12, 0, w, h);
+  r |= compare_planes("BGRA > NV12 (UV)", nv12_direct, nv12, 1, ((w + 1) / 2) * 2, (h + 1) / 2);
+
+  /* I420 > BGRA */
+  if (0 != screencapture_convert(i420, bgra_out)) {
+    exit(EXIT_FAILURE);
+  }
+
+  reference_i420_to_bgra(i420, bgra_ref);
+  r |= compare_planes("I420 > BGRA", bgra_out, bgra_ref, 0, w * 4, h);
+
+  /* BGRA > RGBA, RGB24, BGR24 */
+  const int order_rgba[] = { 2, 1, 0, 3 };
+  const int order_rgb[] = { 2, 1, 0 };
+  const int order_bgr[] = { 0, 1, 2 };
+  r |= test_packed(bgra, SC_RGBA, order_rgba, 4);
+  r |= test_packed(bgra, SC_RGB24, order_rgb, 3);
+  r |= test_packed(bgra, SC_BGR24, order_bgr, 3);
+
+  /* 420V, 420F > BGRA, RGBA; coefficients: y offset, y scale, v > r, u > g, v > g, u > b */
+  const int bt601_video[] = { 16, 75, 102, 25, 52, 129 };
+  const int bt709_full[] = { 0, 64, 101, 12, 30, 119 };
+  const int bt2020_video[] = { 16, 75, 107, 12, 42, 137 };
+  const int bt2020_full[] = { 0, 64, 94, 11, 37, 120 };
+  r |= test_nv12_to_rgb(w, h, SC_420V, 0, bt601_video);
+  r |= test_nv12_to_rgb(w, h, SC_420F, SC_CONVERT_BT709, bt709_full);
+  r |= test_nv12_to_rgb(w, h, SC_420V, SC_CONVERT_BT2020, bt2020_video);
+  r |= test_nv12_to_rgb(w, h, SC_420F, SC_CONVERT_BT2020, bt2020_full);
+
+  /* BGRA > I420 in full range must be the same as BGRA > 420F > I420. */
+  r |= test_full_range(bgra, SC_CONVERT_BT709);
+  r |= test_full_range(bgra, SC_CONVERT_BT2020);
+
+  /* We convert into NV12 in chunks of pixels; a wide frame spans a few of them. */
+  PixelBuffer wide;
+  std::vector<uint8_t> wide_mem;
+
+  if (0 != wide.init(1101, 5, SC_BGRA)) {
+    exit(EXIT_FAILURE);
+  }
+
+  wide_mem.resize(wide.getNumBytes());
+  wide.setPlanes(&wide_mem.front());
+  fill_random(wide_mem);
+  r |= test_full_range(wide, 0);
+
+  /* L10R > P010, RGB48, BGRA */
+  r |= test_l10r(w, h);
+
+  /* Unsupported conversions must fail. */
+  if (0 == screencapture_convert(bgra, bgra_out)) {
+    printf("Error: converting BGRA into BGRA should fail.\n");
+    r |= 1;
+  }
+
+  if (0 == screencapture_convert(bgra, i420, SC_CONVERT_BT709 | SC_CONVERT_BT2020)) {
+    printf("Error: converting with both the BT.709 and BT.2020 matrix should fail.\n");
+    r |= 1;
+  }
+
+  /* The flags of the settings; the range of SC_420V and SC_420F is part of the format. */
+  if (SC_CONVERT_BT709 != screencapture_get_convert_flags(SC_420V, SC_COLOR_MATRIX_BT709, SC_COLOR_RANGE_FULL)
+      || (SC_CONVERT_BT2020 | SC_CONVERT_FULL_RANGE) != screencapture_get_convert_flags(SC_420F, SC_COLOR_MATRIX_BT2020, SC_COLOR_RANGE_AUTO)
+      || SC_CONVERT_FULL_RANGE != screencapture_get_convert_flags(SC_I420, SC_COLOR_MATRIX_BT601, SC_COLOR_RANGE_FULL)
+      || 0 != screencapture_get_convert_flags(SC_I420, SC_COLOR_MATRIX_BT601, SC_COLOR_RANGE_AUTO))
+    {
+      printf("Error: unexpected flags for the color matrix and range.\n");
+      r |= 1;
+    }
+
+  if (0 != r) {
+    printf("\nFAILED\n\n");
+    exit(EXIT_FAILURE);
+  }
+
+  printf("\nOK\n\n");
+
+  return 0;
+}
+
+/* ----------------------------------------------------------- */
+
+static uint8_t clamp(int v) {
+  return (v < 0) ? 0 : ((v > 255) ? 255 : v);
+}
+
+/* BT.601 video range, see Kernels.cpp for the coefficients. */
+static void reference_bgra_to_i420(PixelBuffer& src, PixelBuffer& dst) {
+
+  for (size_t j = 0; j < src.height; ++j) {
+    for (size_t i = 0; i < src.width; ++i) {
+      uint8_t* p = src.plane[0] + j * src.stride[0] + i * 4;
+      dst.plane[0][j * dst.stride[0] + i] = clamp(((66 * p[2] + 129 * p[1] + 25 * p[0] + 128) >> 8) + 16);
+    }
+  }
+
+  for (size_t j = 0; j < (src.height + 1) / 2; ++j) {
+    for (size_t i = 0; i < (src.width + 1) / 2; ++i) {
+
+      int b = 0, g = 0, r = 0;
+
+      for (size_t dy = 0; dy < 2; ++dy) {
+        for (size_t dx = 0; dx < 2; ++dx) {
+          size_t x = std::min<size_t>(i * 2 + dx, src.width - 1);
+          size_t y = std::min<size_t>(j * 2 + dy, src.height - 1);
+          uint8_t* p = src.plane[0] + y * src.stride[0] + x * 4;
+          b += p[0];
+          g += p[1];
+          r += p[2];
+        }
+      }
+
+      dst.plane[1][j * dst.stride[1] + i] = clamp(((-38 * r - 74 * g + 112 * b + 512) >> 10) + 128);
+      dst.plane[2][j * dst.stride[2] + i] = clamp(((112 * r - 94 * g - 18 * b + 512) >> 10) + 128);
+    }
+  }
+}
+
+static void reference_i420_to_bgra(PixelBuffer& src, PixelBuffer& dst) {
+
+  for (size_t j = 0; j < src.height; ++j) {
+    for (size_t i = 0; i < src.width; ++i) {
+      int y = (src.plane[0][j * src.stride[0] + i] - 16) * 75;
+      int u = src.plane[1][(j / 2) * src.stride[1] + i / 2] - 128;
+      int v = src.plane[2][(j / 2) * src.stride[2] + i / 2] - 128;
+      uint8_t* p = dst.plane[0] + j * dst.stride[0] + i * 4;
+      p[0] = clamp((y + 129 * u + 32) >> 6);
+      p[1] = clamp((y - 25 * u - 52 * v + 32) >> 6);
+      p[2] = clamp((y + 102 * v + 32) >> 6);
+      p[3] = 0xFF;
+    }
+  }
+}
+
+/* Converts into the given packed format and checks each output byte; `order` holds the BGRA byte that we expect per output byte. */
+static int test_packed(PixelBuffer& bgra, int fmt, const int* order, int bpp) {
+
+  PixelBuffer out;
+  std::vector<uint8_t> mem;
+
+  if (0 != out.init(bgra.width, bgra.height, fmt)) {
+    return 1;
+  }
+
+  mem.resize(out.getNumBytes());
+  out.setPlanes(&mem.front());
+
+  if (0 != screencapture_convert(bgra, out)) {
+    return 1;
+  }
+
+  for (size_t j = 0; j < bgra.height; ++j) {
+    for (size_t i = 0; i < bgra.width; ++i) {
+      for (int k = 0; k < bpp; ++k) {
+        if (out.plane[0][j * out.stride[0] + i * bpp + k] != bgra.plane[0][j * bgra.stride[0] + i * 4 + order[k]]) {
+          printf("- BGRA > %s: FAILED, pixel %lu x %lu is different.\n", screencapture_pixelformat_to_string(fmt).c_str(), i, j);
+          return 1;
+        }
+      }
+    }
+  }
+
+  printf("- BGRA > %s: OK\n", screencapture_pixelformat_to_string(fmt).c_str());
+
+  return 0;
+}
+
+/* Converts random NV12 pixels into BGRA and RGBA and compares the results with a reference that uses `coeffs`. */
+static int test_nv12_to_rgb(int w, int h, int fmt, int flags, const int* coeffs) {
+
+  PixelBuffer nv12, out;
+  std::vector<uint8_t> nv12_mem, out_mem;
+  const int out_formats[] = { SC_BGRA, SC_RGBA };
+
+  if (0 != nv12.init(w, h, fmt)) {
+    return 1;
+  }
+
+  nv12_mem.resize(nv12.getNumBytes());
+  nv12.setPlanes(&nv12_mem.front());
+  fill_random(nv12_mem);
+
+  for (int k = 0; k < 2; ++k) {
+
+    if (0 != out.init(w, h, out_formats[k])) {
+      return 1;
+    }
+
+    out_mem.resize(out.getNumBytes());
+    out.setPlanes(&out_mem.front());
+
+    if (0 != screencapture_convert(nv12, out, flags)) {
+      return 1;
+    }
+
+    for (int j = 0; j < h; ++j) {
+      for (int i = 0; i < w; ++i) {
+        uint8_t* uv = nv12.plane[1] + (j / 2) * nv12.stride[1] + (i / 2) * 2;
+        uint8_t* p = out.plane[0] + j * out.stride[0] + i * 4;
+        int y = (nv12.plane[0][j * nv12.stride[0] + i] - coeffs[0]) * coeffs[1];
+        int u = uv[0] - 128;
+        int v = uv[1] - 128;
+        int expected[4] = {
+          clamp((y + coeffs[5] * u + 32) >> 6),
+          clamp((y - coeffs[3] * u - coeffs[4] * v + 32) >> 6),
+          clamp((y + coeffs[2] * v + 32) >> 6),
+          0xFF
+        };
+        if (SC_RGBA == out_formats[k]) {
+          std::swap(expected[0], expected[2]);
+        }
+        if (p[0] != expected[0] || p[1] != expected[1] || p[2] != expected[2] || p[3] != expected[3]) {
+          printf("- %s > %s: FAILED, pixel %d x %d is different.\n",
+                 screencapture_pixelformat_to_string(fmt).c_str(),
+                 screencapture_pixelformat_to_string(out_formats[k]).c_str(),
+                 i, j);
+          return 1;
+        }
+      }
+    }
+
+    printf("- %s > %s: OK\n", screencapture_pixelformat_to_string(fmt).c_str(), screencapture_pixelformat_to_string(out_formats[k]).c_str());
+  }
+
+  return 0;
+}
+
+/* Converts BGRA into full range I420 and into 420F with the same matrix and compares the planes. */
+static int test_full_range(PixelBuffer& bgra, int flags) {
+
+  PixelBuffer i420, nv12, i420_ref;
+  std::vector<uint8_t> i420_mem, nv12_mem, i420_ref_mem;
+  int w = bgra.width;
+  int h = bgra.height;
+  int r = 0;
+
+  if (0 != i420.init(w, h, SC_I420)
+      || 0 != nv12.init(w, h, SC_420F)
+      || 0 != i420_ref.init(w, h, SC_I420))
+    {
+      return 1;
+    }
+
+  i420_mem.resize(i420.getNumBytes());
+  nv12_mem.resize(nv12.getNumBytes());
+  i420_ref_mem.resize(i420_ref.getNumBytes());
+  i420.setPlanes(&i420_mem.front());
+  nv12.setPlanes(&nv12_mem.front());
+  i420_ref.setPlanes(&i420_ref_mem.front());
+
+  if (0 != screencapture_convert(bgra, i420, flags | SC_CONVERT_FULL_RANGE)
+      || 0 != screencapture_convert(bgra, nv12, flags)
+      || 0 != screencapture_convert(nv12, i420_ref))
+    {
+      return 1;
+    }
+
+  r |= compare_planes("BGRA > I420 full range (Y)", i420, i420_ref, 0, w, h);
+  r |= compare_planes("BGRA > I420 full range (U)", i420, i420_ref, 1, (w + 1) / 2, (h + 1) / 2);
+  r |= compare_planes("BGRA > I420 full range (V)", i420, i420_ref, 2, (w + 1) / 2, (h + 1) / 2);
+
+  return r;
+}
+
+/* Converts random L10R pixels into P010, RGB48 and (dithered) BGRA and compares the results with a reference. */
+static int test_l10r(int w, int h) {
+
+  PixelBuffer l10r, p010, p010_ref, rgb48, bgra, bgra_ref;
+  std::vector<uint8_t> l10r_mem, p010_mem, p010_ref_mem, rgb48_mem, bgra_mem, bgra_ref_mem;
+  int r = 0;
+
+  if (0 != l10r.init(w, h, SC_L10R)
+      || 0 != p010.init(w, h, SC_P010)
+      || 0 != p010_ref.init(w, h, SC_P010)
+      || 0 != rgb48.init(w, h, SC_RGB48)
+      || 0 != bgra.init(w, h, SC_BGRA)
+      || 0 != bgra_ref.init(w, h, SC_BGRA))
+    {
+      printf("Error: failed to initialize the 10 bit pixel buffers.\n");
+      return 1;
+    }
+
+  l10r_mem.resize(l10r.getNumBytes());
+  p010_mem.resize(p010.getNumBytes());
+  p010_ref_mem.resize(p010_ref.getNumBytes());
+  rgb48_mem.resize(rgb48.getNumBytes());
+  bgra_mem.resize(bgra.getNumBytes());
+  bgra_ref_mem.resize(bgra_ref.getNumBytes());
+
+  l10r.setPlanes(&l10r_mem.front());
+  p010.setPlanes(&p010_mem.front());
+  p010_ref.setPlanes(&p010_ref_mem.front());
+  rgb48.setPlanes(&rgb48_mem.front());
+  bgra.setPlanes(&bgra_mem.front());
+  bgra_ref.setPlanes(&bgra_ref_mem.front());
+
+  fill_random(l10r_mem);
+
+  /* L10R > P010 */
+  if (0 != screencapture_convert(l10r, p010)) {
+    return 1;
+  }
+
+  for (int j = 0; j < h; ++j) {
+    uint32_t* src = (uint32_t*)(l10r.plane[0] + j * l10r.stride[0]);
+    uint16_t* dst = (uint16_t*)(p010_ref.plane[0] + j * p010_ref.stride[0]);
+    for (int i = 0; i < w; ++i) {
+      int red = (src[i] >> 20) & 0x3FF;
+      int green = (src[i] >> 10) & 0x3FF;
+      int blue = src[i] & 0x3FF;
+      dst[i] = std::min(1023, ((66 * red + 129 * green + 25 * blue + 128) >> 8) + 64) << 6;
+    }
+  }
+
+  for (int j = 0; j < (h + 1) / 2; ++j) {
+    uint16_t* dst = (uint16_t*)(p010_ref.plane[1] + j * p010_ref.stride[1]);
+    for (int i = 0; i < (w + 1) / 2; ++i) {
+      int red = 0, green = 0, blue = 0;
+      for (int dy = 0; dy < 2; ++dy) {
+        for (int dx = 0; dx < 2; ++dx) {
+          int x = std::min(i * 2 + dx, w - 1);
+          int y = std::min(j * 2 + dy, h - 1);
+          uint32_t p = ((uint32_t*)(l10r.plane[0] + y * l10r.stride[0]))[x];
+          red += (p >> 20) & 0x3FF;
+          green += (p >> 10) & 0x3FF;
+          blue += p & 0x3FF;
+        }
+      }
+      dst[i * 2 + 0] = std::max(0, std::min(1023, ((-38 * red - 74 * green + 112 * blue + 512) >> 10) + 512)) << 6;
+      dst[i * 2 + 1] = std::max(0, std::min(1023, ((112 * red - 94 * green - 18 * blue + 512) >> 10) + 512)) << 6;
+    }
+  }
+
+  r |= compare_planes("L10R > P010 (Y)", p010, p010_ref, 0, w * 2, h);
+  r |= compare_planes("L10R > P010 (UV)", p010, p010_ref, 1, ((w + 1) / 2) * 4, (h + 1) / 2);
+
+  /* L10R > RGB48 */
+  if (0 != screencapture_convert(l10r, rgb48)) {
+    return 1;
+  }
+
+  for (int j = 0; j < h; ++j) {
+    uint32_t* src = (uint32_t*)(l10r.plane[0] + j * l10r.stride[0]);
+    uint16_t* dst = (uint16_t*)(rgb48.plane[0] + j * rgb48.stride[0]);
+    for (int i = 0; i < w; ++i) {
+      for (int k = 0; k < 3; ++k) {
+        uint32_t v = (src[i] >> (20 - k * 10)) & 0x3FF;
+        if (dst[i * 3 + k] != ((v << 6) | (v >> 4))) {
+          printf("- L10R > RGB48: FAILED, pixel %d x %d is different.\n", i, j);
+          return 1;
+        }
+      }
+    }
+  }
+
+  printf("- L10R > RGB48: OK\n");
+
+  /* L10R > BGRA, truncated and dithered. */
+  const int dither[2][2] = { { 0, 2 }, { 3, 1 } };
+
+  for (int pass = 0; pass < 2; ++pass) {
+
+    int flags = (0 == pass) ? 0 : SC_CONVERT_DITHER;
+    if (0 != screencapture_convert(l10r, bgra, flags)) {
+      return 1;
+    }
+
+    for (int j = 0; j < h; ++j) {
+      uint32_t* src = (uint32_t*)(l10r.plane[0] + j * l10r.stride[0]);
+      uint8_t* dst = bgra_ref.plane[0] + j * bgra_ref.stride[0];
+      for (int i = 0; i < w; ++i) {
+        int d = (0 == flags) ? 0 : dither[j & 1][i & 1];
+        dst[i * 4 + 0] = std::min(255, (int)((src[i] & 0x3FF) + d) >> 2);
+        dst[i * 4 + 1] = std::min(255, (int)(((src[i] >> 10) & 0x3FF) + d) >> 2);
+        dst[i * 4 + 2] = std::min(255, (int)(((src[i] >> 20) & 0x3FF) + d) >> 2);
+        dst[i * 4 + 3] = (src[i] >> 30) * 85;
+      }
+    }
+
+    r |= compare_planes((0 == flags) ? "L10R > BGRA" : "L10R > BGRA (dither)", bgra, bgra_ref, 0, w * 4, h);
+  }
+
+  return r;
+}
+
+static int compare_planes(const char* name, PixelBuffer& a, PixelBuffer& b, int plane, size_t nbytes, size_t nrows) {
+
+  for (size_t j = 0; j < nrows; ++j) {
+    if (0 != memcmp(a.plane[plane] + j * a.stride[plane], b.plane[plane] + j * b.stride[plane], nbytes)) {
+      printf("- %s: FAILED, row %lu is different.\n", name, j);
+      return 1;
+    }
+  }
+
+  printf("- %s: OK\n", name);
+
+  return 0;
+}
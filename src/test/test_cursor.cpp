@@ -0,0 +1,576 @@
+/*
+
+  Cursor
+  ------
+
+  Tests drawing the pointer: every pointer type is drawn at positions
+  inside, partially outside and completely outside of odd sized
+  frames and compared with a per pixel reference of the blend, AND/XOR
+  and masked color rules. For the YCbCr frames only the samples of the
+  pixels that the pointer changes may differ from the original frame;
+  they must match converting the reference BGRA result. The
+  monochrome decoder is fuzzed against the per bit conversion that the
+  D3D11 driver used before. The pointer cache must return the same
+  entry for a shape that reappears (also with different padding),
+  decode changed shapes, evict the least recently used shape and
+  survive hash collisions. Prints the time it takes to draw a 32 x 32
+  pointer, to decode a monochrome one and to look up a cached shape.
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include <screencapture/Cursor.h>
+#include <screencapture/Convert.h>
+#include "TestUtils.h"
+
+using namespace sc;
+
+struct Shape {
+  int type;
+  int width;
+  int height;
+  int pitch;
+  std::vector<uint8_t> pixels;
+};
+
+static void create_shape(Shape& shape, int type, int w, int h);
+static int reference_pixel(Shape& shape, int i, int j, uint8_t* dst);
+static void reference_draw(Shape& shape, PixelBuffer& frame, int left, int top, std::vector<uint8_t>& covered);
+static int test_draw(Shape& shape, int fmt, int flags, int x, int y);
+static void reference_decode(const uint8_t* pixels, int width, int height, int pitch, uint8_t* out_pixels, int stride);
+static int test_decode_fuzz();
+static int test_cache();
+static void benchmark();
+
+int main() {
+
+  printf("\n\ntest_cursor\n\n");
+
+  int r = 0;
+  int types[] = { SC_CURSOR_COLOR, SC_CURSOR_MASKED_COLOR, SC_CURSOR_MONOCHROME };
+  const char* names[] = { "color", "masked color", "monochrome" };
+  int formats[][2] = {
+    { SC_BGRA, 0 },
+    { SC_420V, 0 },
+    { SC_420F, SC_CONVERT_BT709 },
+    { SC_I420, SC_CONVERT_BT709 },
+  };
+  int sizes[][2] = { { 32, 32 }, { 13, 11 }, { 1, 1 } };
+  int positions[][2] = {
+    { 10, 7 },
+    { -5, -3 },                                                   /* Partially left and above the frame. */
+    { 60, 38 },                                                   /* Partially right and below the frame. */
+    { 66, 0 },
+    { 200, 10 },                                                  /* Outside. */
+    { -40, -40 },
+  };
+
+  for (int t = 0; t < 3; ++t) {
+    for (int f = 0; f < 4; ++f) {
+
+      int failed = 0;
+
+      for (int s = 0; s < 3; ++s) {
+
+        Shape shape;
+        create_shape(shape, types[t], sizes[s][0], sizes[s][1]);
+
+        for (size_t p = 0; p < sizeof(positions) / sizeof(positions[0]); ++p) {
+          failed |= test_draw(shape, formats[f][0], formats[f][1], positions[p][0], positions[p][1]);
+        }
+      }
+
+      printf("- %s > %s: %s\n", names[t], screencapture_pixelformat_to_string(formats[f][0]).c_str(), (0 == failed) ? "OK" : "FAILED");
+      r |= failed;
+    }
+  }
+
+  r |= test_decode_fuzz();
+  r |= test_cache();
+
+  /* Invalid arguments must fail. */
+  Cursor cursor;
+  PixelBuffer rgb;
+  std::vector<uint8_t> rgb_mem;
+  uint8_t pixels[64] = { 0 };
+
+  if (0 != alloc_buffer(rgb, rgb_mem, 16, 16, SC_RGB24)) {
+    exit(EXIT_FAILURE);
+  }
+
+  if (0 == cursor.draw(rgb, 0, 0)
+      || 0 == cursor.setShape(SC_CURSOR_NONE, 4, 4, 16, pixels)
+      || 0 == cursor.setShape(SC_CURSOR_COLOR, 0, 4, 16, pixels)
+      || 0 == cursor.setShape(SC_CURSOR_COLOR, 4, 4, 8, pixels)
+      || 0 == cursor.setShape(SC_CURSOR_MONOCHROME, 4, 4, 1, NULL)
+      || 0 != cursor.setShape(SC_CURSOR_MONOCHROME, 4, 4, 1, pixels)
+      || 0 == cursor.draw(rgb, 0, 0)
+      || 0 == cursor.canDraw(SC_P010)
+      || 0 == screencapture_decode_monochrome_cursor(pixels, 4, 4, 1, NULL, 16)
+      || 0 == screencapture_decode_monochrome_cursor(pixels, 9, 4, 1, pixels, 36))
+    {
+      printf("Error: drawing with invalid arguments should fail.\n");
+      r |= 1;
+    }
+
+  if (0 != r) {
+    printf("\nFAILED\n\n");
+    exit(EXIT_FAILURE);
+  }
+
+  benchmark();
+
+  printf("\nOK\n\n");
+
+  return 0;
+}
+
+/* ----------------------------------------------------------- */
+
+static int test_draw(Shape& shape, int fmt, int flags, int x, int y) {
+
+  int w = 67;
+  int h = 41;
+  int hotx = shape.width / 3;
+  int hoty = shape.height / 4;
+  int left = x - hotx;
+  int top = y - hoty;
+  Cursor cursor;
+  PixelBuffer frame, expected, ref_bgra, ref_yuv;
+  std::vector<uint8_t> frame_mem, expected_mem, ref_bgra_mem, ref_yuv_mem;
+  std::vector<uint8_t> covered;
+
+  if (0 != alloc_buffer(frame, frame_mem, w, h, fmt)
+      || 0 != alloc_buffer(expected, expected_mem, w, h, fmt)
+      || 0 != alloc_buffer(ref_bgra, ref_bgra_mem, w, h, SC_BGRA)
+      || 0 != alloc_buffer(ref_yuv, ref_yuv_mem, w, h, fmt))
+    {
+      return 1;
+    }
+
+  fill_random(frame_mem);
+  expected_mem = frame_mem;
+
+  if (0 != cursor.setShape(shape.type, shape.width, shape.height, shape.pitch, &shape.pixels.front(), hotx, hoty)
+      || 0 != cursor.draw(frame, x, y, flags))
+    {
+      printf("- %s %d x %d at %d, %d: FAILED, could not draw.\n", screencapture_pixelformat_to_string(fmt).c_str(), shape.width, shape.height, x, y);
+      return 1;
+    }
+
+  if (SC_BGRA == fmt) {
+    reference_draw(shape, expected, left, top, covered);
+  }
+  else {
+
+    /* The changed pixels get the samples of the converted reference, all others keep theirs. */
+    if (0 != screencapture_convert(expected, ref_bgra, flags)) {
+      return 1;
+    }
+
+    reference_draw(shape, ref_bgra, left, top, covered);
+
+    if (0 != screencapture_convert(ref_bgra, ref_yuv, flags)) {
+      return 1;
+    }
+
+    int chroma_bpp = (SC_I420 == fmt) ? 1 : 2;
+    int num_planes = (SC_I420 == fmt) ? 3 : 2;
+
+    for (int j = 0; j < h; ++j) {
+      for (int i = 0; i < w; ++i) {
+
+        if (0 == covered[j * w + i]) {
+          continue;
+        }
+
+        expected.plane[0][j * expected.stride[0] + i] = ref_yuv.plane[0][j * ref_yuv.stride[0] + i];
+
+        for (int p = 1; p < num_planes; ++p) {
+          memcpy(expected.plane[p] + (j / 2) * expected.stride[p] + (i / 2) * chroma_bpp,
+                 ref_yuv.plane[p] + (j / 2) * ref_yuv.stride[p] + (i / 2) * chroma_bpp,
+                 chroma_bpp);
+        }
+      }
+    }
+  }
+
+  if (frame_mem != expected_mem) {
+    printf("- %s %d x %d at %d, %d: FAILED, differs from the reference.\n", screencapture_pixelformat_to_string(fmt).c_str(), shape.width, shape.height, x, y);
+    return 1;
+  }
+
+  return 0;
+}
+
+/* Decodes random monochrome pointers with random sizes and pitches and compares them with the per bit reference. */
+static int test_decode_fuzz() {
+
+  srand(4321);
+
+  for (int k = 0; k < 2000; ++k) {
+
+    int w = 1 + rand() % 130;
+    int h = 1 + rand() % 64;
+    int pitch = (w + 7) / 8 + ((0 == (k & 1)) ? 0 : rand() % 5);
+    int stride = w * 4 + (rand() % 3) * 4;
+    std::vector<uint8_t> pixels(pitch * h * 2);
+    std::vector<uint8_t> result(stride * h, 0xAB);
+    std::vector<uint8_t> expected(stride * h, 0xAB);
+
+    for (size_t i = 0; i < pixels.size(); ++i) {
+      pixels[i] = rand() & 0xFF;
+    }
+
+    if (0 != screencapture_decode_monochrome_cursor(&pixels.front(), w, h, pitch, &result.front(), stride)) {
+      printf("- monochrome decoder: FAILED, could not decode %d x %d.\n", w, h);
+      return 1;
+    }
+
+    reference_decode(&pixels.front(), w, h, pitch, &expected.front(), stride);
+
+    if (result != expected) {
+      printf("- monochrome decoder: FAILED, %d x %d with pitch %d differs from the reference.\n", w, h, pitch);
+      return 1;
+    }
+  }
+
+  printf("- monochrome decoder: OK\n");
+
+  return 0;
+}
+
+/* Looks up shapes that change, reappear, get evicted and collide. */
+static int test_cache() {
+
+  CursorCache cache;
+  CursorCacheEntry* entries[3] = { NULL };
+  CursorCacheEntry* entry = NULL;
+  Shape shapes[3];
+
+  create_shape(shapes[0], SC_CURSOR_COLOR, 32, 32);               /* Arrow. */
+  create_shape(shapes[1], SC_CURSOR_MONOCHROME, 32, 32);          /* I-beam. */
+  create_shape(shapes[2], SC_CURSOR_MASKED_COLOR, 24, 24);        /* Hand. */
+
+  for (int i = 0; i < 3; ++i) {
+    Shape& s = shapes[i];
+    if (1 != cache.get(s.type, s.width, s.height, s.pitch, &s.pixels.front(), i, i, &entries[i])) {
+      printf("- cache: FAILED, a new shape should be decoded.\n");
+      return 1;
+    }
+  }
+
+  if (entries[0]->id == entries[1]->id || entries[1]->id == entries[2]->id) {
+    printf("- cache: FAILED, every shape should have its own id.\n");
+    return 1;
+  }
+
+  /* The decoded shapes must be the same as decoding them directly. */
+  Cursor cursor;
+  std::vector<uint8_t> bgra(32 * 32 * 4);
+
+  cursor.setShape(shapes[1].type, 32, 32, shapes[1].pitch, &shapes[1].pixels.front(), 1, 1);
+  screencapture_decode_monochrome_cursor(&shapes[1].pixels.front(), 32, 32, shapes[1].pitch, &bgra.front(), 32 * 4);
+
+  if (entries[1]->cursor.and_mask != cursor.and_mask
+      || entries[1]->cursor.xor_mask != cursor.xor_mask
+      || entries[1]->cursor.hotspot_x != 1
+      || entries[1]->bgra != bgra
+      || 0 != memcmp(&entries[0]->bgra[32 * 4], &shapes[0].pixels[shapes[0].pitch], 32 * 4))
+    {
+      printf("- cache: FAILED, the cached shape differs from decoding it.\n");
+      return 1;
+    }
+
+  /* The padding of the rows is not part of the shape. */
+  for (int i = 0; i < 3; ++i) {
+
+    Shape& s = shapes[i];
+    s.pixels[s.pitch - 1] ^= 0x5A;
+
+    if (0 != cache.get(s.type, s.width, s.height, s.pitch, &s.pixels.front(), i, i, &entry) || entry != entries[i]) {
+      printf("- cache: FAILED, a shape that reappears should be found.\n");
+      return 1;
+    }
+  }
+
+  /* A different pixel or hotspot is a different shape. */
+  shapes[0].pixels[shapes[0].pitch * 5 + 17] ^= 0x01;
+
+  if (1 != cache.get(shapes[0].type, 32, 32, shapes[0].pitch, &shapes[0].pixels.front(), 0, 0, &entry)
+      || 1 != cache.get(shapes[1].type, 32, 32, shapes[1].pitch, &shapes[1].pixels.front(), 2, 1, &entry))
+    {
+      printf("- cache: FAILED, a changed shape should be decoded.\n");
+      return 1;
+    }
+
+  /* Keep 2 shapes: looking up 0, 1, 0, 2 evicts 1. */
+  cache.clear();
+
+  if (0 != cache.setCapacity(2) || 0 == cache.setCapacity(0)) {
+    printf("- cache: FAILED, could not set the capacity.\n");
+    return 1;
+  }
+
+  int order[] = { 0, 1, 0, 2, 0, 1 };
+  int expected[] = { 1, 1, 0, 1, 0, 1 };
+
+  for (int k = 0; k < 6; ++k) {
+    Shape& s = shapes[order[k]];
+    if (expected[k] != cache.get(s.type, s.width, s.height, s.pitch, &s.pixels.front(), 0, 0, &entry)) {
+      printf("- cache: FAILED, lookup %d of the eviction order.\n", k);
+      return 1;
+    }
+  }
+
+  if (2 != cache.entries.size() || 2 != cache.num_hits || 4 != cache.num_misses) {
+    printf("- cache: FAILED, wrong number of entries, hits or misses.\n");
+    return 1;
+  }
+
+  /* A hash collision must not return the wrong shape. */
+  Shape& a = shapes[0];
+  Shape& b = shapes[2];
+
+  cache.clear();
+  cache.get(a.type, a.width, a.height, a.pitch, &a.pixels.front(), 0, 0, &entry);
+  entry->hash = CursorCache::hashShape(b.type, b.width, b.height, b.pitch, &b.pixels.front(), 0, 0);
+
+  if (1 != cache.get(b.type, b.width, b.height, b.pitch, &b.pixels.front(), 0, 0, &entry)
+      || b.width != entry->cursor.width
+      || SC_CURSOR_MASKED_COLOR != entry->cursor.type)
+    {
+      printf("- cache: FAILED, a hash collision returned the wrong shape.\n");
+      return 1;
+    }
+
+  if (0 == cache.get(a.type, a.width, a.height, a.pitch, &a.pixels.front(), 0, 0, NULL)
+      || 0 == cache.get(SC_CURSOR_NONE, 4, 4, 16, &a.pixels.front(), 0, 0, &entry)
+      || 0 == cache.get(SC_CURSOR_COLOR, 4, 4, 8, &a.pixels.front(), 0, 0, &entry)
+      || NULL != entry)
+    {
+      printf("- cache: FAILED, invalid arguments should fail.\n");
+      return 1;
+    }
+
+  printf("- cache: OK\n");
+
+  return 0;
+}
+
+/*
+  The per bit conversion that the D3D11 driver used before we had the
+  table driven decoder; it used (width + 7) / 8 instead of `pitch` and
+  wrote `width` * 4 bytes per row.
+*/
+static void reference_decode(const uint8_t* pixels, int width, int height, int pitch, uint8_t* out_pixels, int stride) {
+
+  const uint8_t* and_map = pixels;
+  const uint8_t* xor_map = pixels + pitch * height;
+
+  for (int j = 0; j < height; ++j) {
+
+    uint8_t bit = 0x80;
+
+    for (int i = 0; i < width; ++i) {
+
+      uint8_t and_bit = (and_map[j * pitch + i / 8] & bit) ? 1 : 0;
+      uint8_t xor_bit = (xor_map[j * pitch + i / 8] & bit) ? 1 : 0;
+      int out_dx = j * stride + i * 4;
+
+      if (0 == and_bit) {
+        /* 0 - 0 = black, 0 - 1 = white. */
+        uint8_t c = (0 == xor_bit) ? 0x00 : 0xFF;
+        out_pixels[out_dx + 0] = c;
+        out_pixels[out_dx + 1] = c;
+        out_pixels[out_dx + 2] = c;
+        out_pixels[out_dx + 3] = 0xFF;
+      }
+      else if (0 == xor_bit) {
+        /* 1 - 0 = transparent (screen). */
+        out_pixels[out_dx + 0] = 0x00;
+        out_pixels[out_dx + 1] = 0x00;
+        out_pixels[out_dx + 2] = 0x00;
+        out_pixels[out_dx + 3] = 0x00;
+      }
+      else {
+        /* 1 - 1 = reverse, black. */
+        out_pixels[out_dx + 0] = 0x00;
+        out_pixels[out_dx + 1] = 0x00;
+        out_pixels[out_dx + 2] = 0x00;
+        out_pixels[out_dx + 3] = 0xFF;
+      }
+
+      bit = (0x01 == bit) ? 0x80 : (bit >> 1);
+    }
+  }
+}
+
+/* Draws the shape per pixel into the BGRA frame and sets `covered` to 1 for every frame pixel that it changes. */
+static void reference_draw(Shape& shape, PixelBuffer& frame, int left, int top, std::vector<uint8_t>& covered) {
+
+  covered.assign(frame.width * frame.height, 0);
+
+  for (int j = 0; j < shape.height; ++j) {
+    for (int i = 0; i < shape.width; ++i) {
+
+      int fx = left + i;
+      int fy = top + j;
+
+      if (0 > fx || fx >= (int)frame.width || 0 > fy || fy >= (int)frame.height) {
+        continue;
+      }
+
+      covered[fy * frame.width + fx] = reference_pixel(shape, i, j, frame.plane[0] + fy * frame.stride[0] + fx * 4);
+    }
+  }
+}
+
+/* Applies pixel `i`, `j` of the shape to the BGRA pixel `dst`; returns 1 when the pixel may change, otherwise 0. */
+static int reference_pixel(Shape& shape, int i, int j, uint8_t* dst) {
+
+  switch (shape.type) {
+
+    case SC_CURSOR_COLOR: {
+      const uint8_t* s = &shape.pixels[j * shape.pitch + i * 4];
+      for (int c = 0; c < 3; ++c) {
+        dst[c] = (uint8_t)((s[c] * s[3] + dst[c] * (255 - s[3]) + 127) / 255);
+      }
+      return (0 != s[3]) ? 1 : 0;
+    }
+
+    case SC_CURSOR_MASKED_COLOR: {
+      const uint8_t* s = &shape.pixels[j * shape.pitch + i * 4];
+      for (int c = 0; c < 3; ++c) {
+        dst[c] = (0xFF == s[3]) ? (dst[c] ^ s[c]) : s[c];
+      }
+      return (0xFF != s[3] || 0 != (s[0] | s[1] | s[2])) ? 1 : 0;
+    }
+
+    case SC_CURSOR_MONOCHROME: {
+      uint8_t bit = 0x80 >> (i % 8);
+      int and_bit = (shape.pixels[j * shape.pitch + i / 8] & bit) ? 1 : 0;
+      int xor_bit = (shape.pixels[(shape.height + j) * shape.pitch + i / 8] & bit) ? 1 : 0;
+      for (int c = 0; c < 3; ++c) {
+        if (0 == and_bit) {
+          dst[c] = (0 == xor_bit) ? 0x00 : 0xFF;                  /* Black or white. */
+        }
+        else if (1 == xor_bit) {
+          dst[c] = 0xFF - dst[c];                                 /* Inverted. */
+        }
+      }
+      return (0 == and_bit || 1 == xor_bit) ? 1 : 0;
+    }
+  }
+
+  return 0;
+}
+
+/* Creates a random shape with all the alpha and mask combinations and a pitch with padding. */
+static void create_shape(Shape& shape, int type, int w, int h) {
+
+  shape.type = type;
+  shape.width = w;
+  shape.height = h;
+  shape.pitch = (SC_CURSOR_MONOCHROME == type) ? (w + 7) / 8 + 3 : w * 4 + 8;
+  shape.pixels.resize(shape.pitch * h * ((SC_CURSOR_MONOCHROME == type) ? 2 : 1));
+
+  fill_random(shape.pixels);
+
+  if (SC_CURSOR_MONOCHROME == type) {
+    return;
+  }
+
+  for (int j = 0; j < h; ++j) {
+    for (int i = 0; i < w; ++i) {
+      uint8_t* p = &shape.pixels[j * shape.pitch + i * 4];
+      int k = (i + j * 3) % 4;
+      if (SC_CURSOR_COLOR == type) {
+        p[3] = (0 == k) ? 0x00 : ((1 == k) ? 0xFF : p[3]);
+      }
+      else {
+        p[3] = (0 == (k & 1)) ? 0x00 : 0xFF;
+        if (3 == k && 0 == (j & 1)) {
+          p[0] = p[1] = p[2] = 0;                                 /* XOR with black doesn't change the screen. */
+        }
+      }
+    }
+  }
+}
+
+static void benchmark() {
+
+  PixelBuffer frame;
+  std::vector<uint8_t> mem;
+  Shape shape;
+  Cursor cursor;
+  int num_draws = 10000;
+  int formats[] = { SC_BGRA, SC_420V };
+
+  create_shape(shape, SC_CURSOR_COLOR, 32, 32);
+  cursor.setShape(shape.type, shape.width, shape.height, shape.pitch, &shape.pixels.front());
+
+  for (int f = 0; f < 2; ++f) {
+
+    if (0 != alloc_buffer(frame, mem, 1920, 1080, formats[f])) {
+      return;
+    }
+
+    clock_t start = clock();
+    for (int i = 0; i < num_draws; ++i) {
+      cursor.draw(frame, (i * 7) % 1900, (i * 3) % 1060);
+    }
+    double us = (1000000.0 * (clock() - start)) / (CLOCKS_PER_SEC * num_draws);
+
+    printf("- 32 x 32 color pointer > %s: %.3f us per draw\n", screencapture_pixelformat_to_string(formats[f]).c_str(), us);
+  }
+
+  /* Decoding a 64 x 64 monochrome pointer, per bit and with the table. */
+  std::vector<uint8_t> bits(8 * 64 * 2);
+  std::vector<uint8_t> bgra(64 * 64 * 4);
+  int num_decodes = 20000;
+
+  fill_random(bits);
+
+  clock_t start = clock();
+  for (int i = 0; i < num_decodes; ++i) {
+    reference_decode(&bits.front(), 64, 64, 8, &bgra.front(), 64 * 4);
+  }
+  double per_bit_us = (1000000.0 * (clock() - start)) / (CLOCKS_PER_SEC * num_decodes);
+
+  start = clock();
+  for (int i = 0; i < num_decodes; ++i) {
+    screencapture_decode_monochrome_cursor(&bits.front(), 64, 64, 8, &bgra.front(), 64 * 4);
+  }
+  double table_us = (1000000.0 * (clock() - start)) / (CLOCKS_PER_SEC * num_decodes);
+
+  printf("- 64 x 64 monochrome pointer: %.3f us per bit, %.3f us with the table\n", per_bit_us, table_us);
+
+  /* Flipping between two shapes: decoding every time vs looking them up. */
+  CursorCache cache;
+  CursorCacheEntry* entry = NULL;
+  CursorCacheEntry decoded;
+  Shape shapes[2];
+
+  create_shape(shapes[0], SC_CURSOR_COLOR, 32, 32);
+  create_shape(shapes[1], SC_CURSOR_MONOCHROME, 32, 32);
+
+  start = clock();
+  for (int i = 0; i < num_decodes; ++i) {
+    Shape& s = shapes[i & 1];
+    decoded.setShape(s.type, s.width, s.height, s.pitch, &s.pixels.front(), 0, 0);
+  }
+  double decode_us = (1000000.0 * (clock() - start)) / (CLOCKS_PER_SEC * num_decodes);
+
+  start = clock();
+  for (int i = 0; i < num_decodes; ++i) {
+    Shape& s = shapes[i & 1];
+    cache.get(s.type, s.width, s.height, s.pitch, &s.pixels.front(), 0, 0, &entry);
+  }
+  double lookup_us = (1000000.0 * (clock() - start)) / (CLOCKS_PER_SEC * num_decodes);
+
+  printf("- 32 x 32 pointer shape change: %.3f us per decode, %.3f us per cached lookup\n", decode_us, lookup_us);
+}
@@ -0,0 +1,382 @@
+/*
+
+  Dirty
+  -----
+
+  Tests the dirty detector: the first frame is dirty as a whole, an
+  unchanged frame has no dirty rectangles and changing one sample, of
+  any plane, marks exactly the tile that contains it. Random changes
+  are fuzzed: the rectangles must not overlap and must cover exactly
+  the changed tiles. The static frame filter drops only the frames
+  that are the same as the last frame it let through (ignoring the
+  padding of the rows), trusts the damage of the driver and lets a
+  static frame through when the keepalive expires. Prints the time it
+  takes to hash a 4K frame.
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <screencapture/Dirty.h>
+#include "TestUtils.h"
+
+using namespace sc;
+
+static int check_rect(std::vector<DirtyRect>& rects, int x, int y, int w, int h);
+static int test_changes(int fmt, int w, int h, int tile);
+static int test_fuzz();
+static int test_static_filter(int fmt);
+static void benchmark();
+
+int main() {
+
+  printf("\n\ntest_dirty\n\n");
+
+  int r = 0;
+  int formats[] = { SC_BGRA, SC_RGB24, SC_RGB48, SC_420V, SC_P010, SC_I420 };
+
+  for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i) {
+    r |= test_changes(formats[i], 301, 171, 64);
+    r |= test_changes(formats[i], 64, 64, 16);
+  }
+
+  r |= test_fuzz();
+  r |= test_static_filter(SC_BGRA);
+  r |= test_static_filter(SC_I420);
+  r |= test_static_filter(SC_P010);
+
+  /* Invalid arguments must fail. */
+  DirtyDetector detector;
+  PixelBuffer frame;
+  std::vector<uint8_t> mem;
+  std::vector<DirtyRect> rects;
+
+  if (0 != alloc_buffer(frame, mem, 32, 32, SC_BGRA)) {
+    exit(EXIT_FAILURE);
+  }
+
+  if (0 == detector.update(frame, rects)
+      || 0 == detector.init(32, 32, SC_BGRA, 15)
+      || 0 == detector.init(0, 32, SC_BGRA)
+      || 0 == detector.init(32, 32, SC_NONE)
+      || 0 != detector.init(32, 30, SC_BGRA)
+      || 0 == detector.update(frame, rects)
+      || 0 != detector.isInitFor(32, 30, SC_BGRA)
+      || 0 == detector.isInitFor(32, 30, SC_BGRA, 32))
+    {
+      printf("Error: detecting with invalid arguments should fail.\n");
+      r |= 1;
+    }
+
+  StaticFrameFilter filter;
+  if (0 == filter.init(-1)) {
+    printf("Error: a negative keepalive should fail.\n");
+    r |= 1;
+  }
+
+  if (0 != r) {
+    printf("\nFAILED\n\n");
+    exit(EXIT_FAILURE);
+  }
+
+  benchmark();
+
+  printf("\nOK\n\n");
+
+  return 0;
+}
+
+/* ----------------------------------------------------------- */
+
+/* Changes single samples of every plane and checks that only their tile is dirty. */
+static int test_changes(int fmt, int w, int h, int tile) {
+
+  PixelBuffer frame;
+  DirtyDetector detector;
+  std::vector<uint8_t> mem;
+  std::vector<DirtyRect> rects;
+  int bpp[3] = { 0 };
+  int num_planes = screencapture_get_plane_layout(fmt, bpp);
+  std::string fmt_name = screencapture_pixelformat_to_string(fmt);
+  const char* name = fmt_name.c_str();
+
+  if (0 != alloc_buffer(frame, mem, w, h, fmt) || 0 != detector.init(w, h, fmt, tile)) {
+    return 1;
+  }
+
+  fill_random(mem);
+
+  if (0 != detector.update(frame, rects) || 0 != check_rect(rects, 0, 0, w, h)) {
+    printf("- %s: FAILED, the first frame should be dirty as a whole.\n", name);
+    return 1;
+  }
+
+  if (0 != detector.update(frame, rects) || 0 != rects.size() || 0 != detector.num_dirty) {
+    printf("- %s: FAILED, an unchanged frame should have no dirty rectangles.\n", name);
+    return 1;
+  }
+
+  /* Pixels in the first tile, in the middle and in the clipped tile at the bottom right. */
+  int pixels[][2] = { { 0, 0 }, { w / 2, h / 2 }, { w - 1, h - 1 } };
+
+  for (int p = 0; p < num_planes; ++p) {
+    for (int k = 0; k < 3; ++k) {
+
+      int x = pixels[k][0];
+      int y = pixels[k][1];
+      int sx = (0 == p) ? x : x / 2;
+      int sy = (0 == p) ? y : y / 2;
+      int tx = (x / tile) * tile;
+      int ty = (y / tile) * tile;
+
+      frame.plane[p][sy * frame.stride[p] + sx * bpp[p] + bpp[p] - 1] ^= 0x01;
+
+      if (0 != detector.update(frame, rects) || 0 != check_rect(rects, tx, ty, std::min(tile, w - tx), std::min(tile, h - ty))) {
+        printf("- %s: FAILED, changing a sample of plane %d at %d, %d should only mark its tile.\n", name, p, x, y);
+        return 1;
+      }
+    }
+  }
+
+  /* The padding of the rows is not part of the frame. */
+  if (frame.stride[0] > (size_t)(w * bpp[0])) {
+
+    frame.plane[0][frame.stride[0] - 1] ^= 0xFF;
+
+    if (0 != detector.update(frame, rects) || 0 != rects.size()) {
+      printf("- %s: FAILED, changing the padding of a row should not mark a tile.\n", name);
+      return 1;
+    }
+  }
+
+  detector.reset();
+
+  if (0 != detector.update(frame, rects) || 0 != check_rect(rects, 0, 0, w, h)) {
+    printf("- %s: FAILED, the frame after reset() should be dirty as a whole.\n", name);
+    return 1;
+  }
+
+  printf("- %s, %d x %d, %d x %d tiles: OK\n", name, w, h, tile, tile);
+
+  return 0;
+}
+
+/* Changes random tiles and checks that the rectangles cover exactly those tiles, once. */
+static int test_fuzz() {
+
+  int w = 1000;
+  int h = 520;
+  int tile = 64;
+  int num_cols = (w + tile - 1) / tile;
+  int num_rows = (h + tile - 1) / tile;
+  PixelBuffer frame;
+  DirtyDetector detector;
+  std::vector<uint8_t> mem;
+  std::vector<DirtyRect> rects;
+
+  if (0 != alloc_buffer(frame, mem, w, h, SC_BGRA) || 0 != detector.init(w, h, SC_BGRA, tile)) {
+    return 1;
+  }
+
+  fill_random(mem);
+  detector.update(frame, rects);
+  srand(777);
+
+  for (int k = 0; k < 500; ++k) {
+
+    std::vector<int> changed(num_cols * num_rows, 0);
+    std::vector<int> covered(num_cols * num_rows, 0);
+
+    /* Sparse changes and changed rectangles, like windows. */
+    int n = 1 + rand() % 12;
+
+    for (int i = 0; i < n; ++i) {
+
+      int x0 = rand() % w;
+      int y0 = rand() % h;
+      int x1 = (0 == (i & 1)) ? x0 + 1 : std::min(w, x0 + 1 + rand() % 300);
+      int y1 = (0 == (i & 1)) ? y0 + 1 : std::min(h, y0 + 1 + rand() % 200);
+
+      for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; ++x) {
+          frame.plane[0][y * frame.stride[0] + x * 4] += 1;
+          changed[(y / tile) * num_cols + x / tile] = 1;
+        }
+      }
+    }
+
+    if (0 != detector.update(frame, rects)) {
+      return 1;
+    }
+
+    for (size_t i = 0; i < rects.size(); ++i) {
+
+      DirtyRect& r = rects[i];
+
+      if (0 != r.x % tile || 0 != r.y % tile || 0 >= r.width || 0 >= r.height || r.x + r.width > w || r.y + r.height > h) {
+        printf("- fuzz: FAILED, invalid rectangle %d, %d, %d x %d.\n", r.x, r.y, r.width, r.height);
+        return 1;
+      }
+
+      for (int y = r.y; y < r.y + r.height; y += tile) {
+        for (int x = r.x; x < r.x + r.width; x += tile) {
+          covered[(y / tile) * num_cols + x / tile]++;
+        }
+      }
+    }
+
+    if (changed != covered) {
+      printf("- fuzz: FAILED, iteration %d: the rectangles don't cover exactly the changed tiles.\n", k);
+      return 1;
+    }
+  }
+
+  printf("- fuzz: OK\n");
+
+  return 0;
+}
+
+static int test_static_filter(int fmt) {
+
+  int w = 301;
+  int h = 171;
+  PixelBuffer frame;
+  PixelBuffer other;
+  std::vector<uint8_t> mem;
+  std::vector<uint8_t> other_mem;
+  StaticFrameFilter filter;
+  std::string fmt_name = screencapture_pixelformat_to_string(fmt);
+
+  if (0 != alloc_buffer(frame, mem, w, h, fmt)
+      || 0 != alloc_buffer(other, other_mem, w / 2, h, fmt)
+      || 0 != filter.init(1000))
+    {
+      return 1;
+    }
+
+  fill_random(mem);
+
+  /* The first frame always passes, the same content is dropped until the keepalive expires. */
+  if (0 == filter.shouldDrop(frame, 0)
+      || 0 != filter.shouldDrop(frame, 10)
+      || 0 != filter.shouldDrop(frame, 999)
+      || 0 == filter.shouldDrop(frame, 1000)
+      || 0 != filter.shouldDrop(frame, 1500))
+    {
+      printf("Error: %s, the static frames or the keepalive are not handled correctly.\n", fmt_name.c_str());
+      return 1;
+    }
+
+  /* The padding of the rows is not part of the frame. */
+  if (frame.stride[0] > frame.width * (SC_BGRA == fmt ? 4 : 1)) {
+    frame.plane[0][frame.stride[0] - 1] ^= 0xFF;
+    if (0 != filter.shouldDrop(frame, 1600)) {
+      printf("Error: %s, a change of the padding should not pass the frame.\n", fmt_name.c_str());
+      return 1;
+    }
+  }
+
+  /* A change of the last sample of every plane passes the frame once. */
+  for (int i = 0; i < 3 && NULL != frame.plane[i]; ++i) {
+    int rows = (0 == i) ? h : (h + 1) / 2;
+    uint8_t* last = frame.plane[i] + (rows - 1) * frame.stride[i];
+    last[(0 == i) ? 0 : 1] ^= 0x01;
+    if (0 == filter.shouldDrop(frame, 1700) || 0 != filter.shouldDrop(frame, 1701)) {
+      printf("Error: %s, a change of plane %d is not detected.\n", fmt_name.c_str(), i);
+      return 1;
+    }
+  }
+
+  /* Another size is never static. */
+  if (0 == filter.shouldDrop(other, 1702) || 0 == filter.shouldDrop(frame, 1703)) {
+    printf("Error: %s, a frame of another size should pass.\n", fmt_name.c_str());
+    return 1;
+  }
+
+  /* We trust the damage of the driver, even when the content says otherwise. */
+  frame.damage = SC_DAMAGE_NONE;
+  frame.plane[0][0] ^= 0xFF;
+  if (0 != filter.shouldDrop(frame, 1704)) {
+    printf("Error: %s, a frame without damage should be dropped.\n", fmt_name.c_str());
+    return 1;
+  }
+
+  frame.damage = SC_DAMAGE_CHANGED;
+  if (0 == filter.shouldDrop(frame, 1705) || 0 == filter.shouldDrop(frame, 1706)) {
+    printf("Error: %s, a damaged frame should pass.\n", fmt_name.c_str());
+    return 1;
+  }
+
+  /* Back to hashing: the first hashed frame passes, then we compare again. */
+  frame.damage = SC_DAMAGE_UNKNOWN;
+  if (0 == filter.shouldDrop(frame, 1707) || 0 != filter.shouldDrop(frame, 1708)) {
+    printf("Error: %s, hashing after the damage of the driver failed.\n", fmt_name.c_str());
+    return 1;
+  }
+
+  /* Without keepalive we drop static frames forever; `reset()` passes the next one. */
+  if (0 != filter.init(0)
+      || 0 == filter.shouldDrop(frame, 0)
+      || 0 != filter.shouldDrop(frame, 1000000))
+    {
+      printf("Error: %s, static frames should be dropped without keepalive.\n", fmt_name.c_str());
+      return 1;
+    }
+
+  filter.reset();
+  if (0 == filter.shouldDrop(frame, 1000001) || 1 != filter.num_dropped || 2 != filter.num_passed) {
+    printf("Error: %s, the frame after reset() should pass.\n", fmt_name.c_str());
+    return 1;
+  }
+
+  printf("Info: %s, static frame filter ok.\n", fmt_name.c_str());
+
+  return 0;
+}
+
+static void benchmark() {
+
+  PixelBuffer frame;
+  DirtyDetector detector;
+  std::vector<uint8_t> mem;
+  std::vector<uint8_t> copy;
+  std::vector<DirtyRect> rects;
+  int num_frames = 20;
+
+  if (0 != alloc_buffer(frame, mem, 3840, 2160, SC_BGRA) || 0 != detector.init(3840, 2160, SC_BGRA)) {
+    return;
+  }
+
+  fill_random(mem);
+  copy.resize(mem.size());
+
+  clock_t start = clock();
+  for (int i = 0; i < num_frames; ++i) {
+    detector.update(frame, rects);
+  }
+  double hash_ms = (1000.0 * (clock() - start)) / (CLOCKS_PER_SEC * num_frames);
+
+  start = clock();
+  for (int i = 0; i < num_frames; ++i) {
+    memcpy(&copy.front(), &mem.front(), mem.size());
+  }
+  double copy_ms = (1000.0 * (clock() - start)) / (CLOCKS_PER_SEC * num_frames);
+
+  printf("- 4K BGRA: %.3f ms to find the dirty tiles, %.3f ms to copy the frame\n", hash_ms, copy_ms);
+}
+
+/* ----------------------------------------------------------- */
+
+/* Returns 0 when `rects` holds exactly the given rectangle. */
+static int check_rect(std::vector<DirtyRect>& rects, int x, int y, int w, int h) {
+
+  if (1 != rects.size()) {
+    return -1;
+  }
+
+  return (x == rects[0].x && y == rects[0].y && w == rects[0].width && h == rects[0].height) ? 0 : -1;
+}
@@ -0,0 +1,327 @@
+/*
+
+  Executor
+  --------
+
+  Tests the slice executor: every row must be handed out exactly once
+  and the `thread` values must be in range. Converting, scaling and
+  scaling + converting in parallel slices must give exactly the same
+  result as doing it on one thread, also for odd sizes. Prints the
+  time it takes to process an 8K frame on 1 and on all CPU cores.
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include <screencapture/Executor.h>
+#include <screencapture/Scaler.h>
+#include <screencapture/Convert.h>
+#include "TestUtils.h"
+
+#if defined(_WIN32)
+#  include <windows.h>
+#else
+#  include <sys/time.h>
+#endif
+
+using namespace sc;
+
+struct RowCounter {
+  std::vector<int> hits;                                          /* Per row, the number of times it was handed out. */
+  int num_threads;
+  int invalid_thread;
+};
+
+static double get_time_ms();
+static void count_rows(void* user, int thread, int first, int count);
+static int test_run(int nthreads, int nrows, int slice_rows);
+static int test_convert(Executor& executor, int w, int h, int from, int to, int flags);
+static int test_scale(Executor& executor, int srcw, int srch, int dstw, int dsth, int fmt, int quality);
+static int test_scale_convert(Executor& executor, int srcw, int srch, int dstw, int dsth, int fmt);
+static void benchmark(Executor& executor, int srcw, int srch, int dstw, int dsth);
+
+int main() {
+
+  printf("\n\ntest_executor\n\n");
+
+  int r = 0;
+
+  r |= test_run(1, 100, 7);
+  r |= test_run(4, 1, 16);
+  r |= test_run(4, 1001, 2);
+  r |= test_run(8, 4320, 32);
+  r |= test_run(3, 17, 16);
+
+  Executor executor;
+
+  if (0 != executor.init(4)) {
+    printf("Error: failed to initialize the executor.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  r |= test_convert(executor, 301, 173, SC_BGRA, SC_I420, 0);
+  r |= test_convert(executor, 301, 173, SC_BGRA, SC_420V, SC_CONVERT_BT709);
+  r |= test_convert(executor, 301, 173, SC_BGRA, SC_RGB24, 0);
+  r |= test_convert(executor, 301, 173, SC_I420, SC_BGRA, 0);
+  r |= test_convert(executor, 301, 173, SC_420F, SC_RGBA, 0);
+  r |= test_convert(executor, 301, 173, SC_420V, SC_I420, 0);
+  r |= test_convert(executor, 301, 173, SC_L10R, SC_P010, 0);
+  r |= test_convert(executor, 301, 173, SC_L10R, SC_BGRA, SC_CONVERT_DITHER);
+
+  int formats[] = { SC_BGRA, SC_420V, SC_I420 };
+
+  for (int i = 0; i < 3; ++i) {
+    r |= test_scale(executor, 1301, 773, 640, 361, formats[i], SC_SCALE_BILINEAR);
+    r |= test_scale(executor, 1280, 720, 640, 360, formats[i], SC_SCALE_BILINEAR);
+    r |= test_scale(executor, 640, 361, 1301, 773, formats[i], SC_SCALE_BILINEAR);
+    r |= test_scale(executor, 1301, 773, 640, 361, formats[i], SC_SCALE_LANCZOS3);
+  }
+
+  r |= test_scale_convert(executor, 1301, 773, 640, 361, SC_420V);
+  r |= test_scale_convert(executor, 1301, 773, 641, 363, SC_I420);
+
+  /* Invalid input must fail. */
+  Executor invalid;
+  if (0 == invalid.init(-1)
+      || 0 == executor.init(2)
+      || 0 == executor.run(NULL, NULL, 10, 2)
+      || 0 == executor.run(count_rows, NULL, 10, 0))
+    {
+      printf("Error: invalid executor input should fail.\n");
+      r |= 1;
+    }
+
+  if (0 != r) {
+    printf("\nFAILED\n\n");
+    exit(EXIT_FAILURE);
+  }
+
+  executor.shutdown();
+
+  Executor single;
+  Executor all;
+  single.init(1);
+  all.init(0);
+
+  benchmark(single, 7680, 4320, 3840, 2160);
+  benchmark(all, 7680, 4320, 3840, 2160);
+
+  printf("\nOK\n\n");
+
+  return 0;
+}
+
+/* ----------------------------------------------------------- */
+
+static void count_rows(void* user, int thread, int first, int count) {
+
+  RowCounter* counter = static_cast<RowCounter*>(user);
+
+  if (0 > thread || thread >= counter->num_threads) {
+    counter->invalid_thread = 1;
+    return;
+  }
+
+  /* Different slices never touch the same rows. */
+  for (int i = first; i < first + count; ++i) {
+    counter->hits[i]++;
+  }
+}
+
+static int test_run(int nthreads, int nrows, int slice_rows) {
+
+  Executor executor;
+  RowCounter counter;
+
+  if (0 != executor.init(nthreads)) {
+    return 1;
+  }
+
+  counter.num_threads = executor.getNumThreads();
+  counter.invalid_thread = 0;
+
+  /* Run a couple of jobs so the workers have to wake up more than once. */
+  for (int job = 0; job < 10; ++job) {
+
+    counter.hits.assign(nrows, 0);
+
+    if (0 != executor.run(count_rows, &counter, nrows, slice_rows)) {
+      printf("- run %d rows in slices of %d on %d threads: FAILED, run() returned an error.\n", nrows, slice_rows, nthreads);
+      return 1;
+    }
+
+    if (0 != counter.invalid_thread) {
+      printf("- run %d rows in slices of %d on %d threads: FAILED, invalid thread index.\n", nrows, slice_rows, nthreads);
+      return 1;
+    }
+
+    for (int i = 0; i < nrows; ++i) {
+      if (1 != counter.hits[i]) {
+        printf("- run %d rows in slices of %d on %d threads: FAILED, row %d was processed %d times.\n", nrows, slice_rows, nthreads, i, counter.hits[i]);
+        return 1;
+      }
+    }
+  }
+
+  printf("- run %d rows in slices of %d on %d threads: OK\n", nrows, slice_rows, nthreads);
+
+  return 0;
+}
+
+static int test_convert(Executor& executor, int w, int h, int from, int to, int flags) {
+
+  PixelBuffer src, serial, parallel;
+  std::vector<uint8_t> src_mem, serial_mem, parallel_mem;
+
+  if (0 != alloc_buffer(src, src_mem, w, h, from)
+      || 0 != alloc_buffer(serial, serial_mem, w, h, to)
+      || 0 != alloc_buffer(parallel, parallel_mem, w, h, to))
+    {
+      return 1;
+    }
+
+  fill_random(src_mem);
+
+  if (0 != screencapture_convert(src, serial, flags)
+      || 0 != screencapture_convert(src, parallel, flags, &executor))
+    {
+      printf("- convert %s > %s: FAILED, conversion returned an error.\n",
+             screencapture_pixelformat_to_string(from).c_str(), screencapture_pixelformat_to_string(to).c_str());
+      return 1;
+    }
+
+  if (serial_mem != parallel_mem) {
+    printf("- convert %s > %s %d x %d: FAILED, the parallel result differs.\n",
+           screencapture_pixelformat_to_string(from).c_str(), screencapture_pixelformat_to_string(to).c_str(), w, h);
+    return 1;
+  }
+
+  printf("- convert %s > %s %d x %d in slices: OK\n",
+         screencapture_pixelformat_to_string(from).c_str(), screencapture_pixelformat_to_string(to).c_str(), w, h);
+
+  return 0;
+}
+
+static int test_scale(Executor& executor, int srcw, int srch, int dstw, int dsth, int fmt, int quality) {
+
+  PixelBuffer src, serial, parallel;
+  std::vector<uint8_t> src_mem, serial_mem, parallel_mem;
+  Scaler scaler;
+
+  if (0 != alloc_buffer(src, src_mem, srcw, srch, fmt)
+      || 0 != alloc_buffer(serial, serial_mem, dstw, dsth, fmt)
+      || 0 != alloc_buffer(parallel, parallel_mem, dstw, dsth, fmt)
+      || 0 != scaler.init(srcw, srch, dstw, dsth, fmt, quality))
+    {
+      return 1;
+    }
+
+  fill_random(src_mem);
+
+  if (0 != scaler.scale(src, serial)
+      || 0 != scaler.scale(src, parallel, &executor))
+    {
+      printf("- scale %s: FAILED, scale() returned an error.\n", screencapture_pixelformat_to_string(fmt).c_str());
+      return 1;
+    }
+
+  if (serial_mem != parallel_mem) {
+    printf("- scale %s %d x %d > %d x %d (quality %d): FAILED, the parallel result differs.\n",
+           screencapture_pixelformat_to_string(fmt).c_str(), srcw, srch, dstw, dsth, quality);
+    return 1;
+  }
+
+  printf("- scale %s %d x %d > %d x %d (quality %d) in slices: OK\n",
+         screencapture_pixelformat_to_string(fmt).c_str(), srcw, srch, dstw, dsth, quality);
+
+  return 0;
+}
+
+static int test_scale_convert(Executor& executor, int srcw, int srch, int dstw, int dsth, int fmt) {
+
+  PixelBuffer src, serial, parallel;
+  std::vector<uint8_t> src_mem, serial_mem, parallel_mem;
+  Scaler scaler;
+
+  if (0 != alloc_buffer(src, src_mem, srcw, srch, SC_BGRA)
+      || 0 != alloc_buffer(serial, serial_mem, dstw, dsth, fmt)
+      || 0 != alloc_buffer(parallel, parallel_mem, dstw, dsth, fmt)
+      || 0 != scaler.init(srcw, srch, dstw, dsth, SC_BGRA))
+    {
+      return 1;
+    }
+
+  fill_random(src_mem);
+
+  if (0 != screencapture_scale_convert(scaler, src, serial)
+      || 0 != screencapture_scale_convert(scaler, src, parallel, 0, &executor))
+    {
+      printf("- scale and convert BGRA > %s: FAILED, returned an error.\n", screencapture_pixelformat_to_string(fmt).c_str());
+      return 1;
+    }
+
+  if (serial_mem != parallel_mem) {
+    printf("- scale and convert BGRA > %s %d x %d > %d x %d: FAILED, the parallel result differs.\n",
+           screencapture_pixelformat_to_string(fmt).c_str(), srcw, srch, dstw, dsth);
+    return 1;
+  }
+
+  printf("- scale and convert BGRA > %s %d x %d > %d x %d in slices: OK\n",
+         screencapture_pixelformat_to_string(fmt).c_str(), srcw, srch, dstw, dsth);
+
+  return 0;
+}
+
+/* ----------------------------------------------------------- */
+
+static void benchmark(Executor& executor, int srcw, int srch, int dstw, int dsth) {
+
+  PixelBuffer src, yuv, scaled;
+  std::vector<uint8_t> src_mem, yuv_mem, scaled_mem;
+  Scaler scaler;
+  int num_frames = 10;
+
+  if (0 != alloc_buffer(src, src_mem, srcw, srch, SC_BGRA)
+      || 0 != alloc_buffer(yuv, yuv_mem, srcw, srch, SC_420V)
+      || 0 != alloc_buffer(scaled, scaled_mem, dstw, dsth, SC_420V)
+      || 0 != scaler.init(srcw, srch, dstw, dsth, SC_BGRA))
+    {
+      return;
+    }
+
+  fill_random(src_mem);
+
+  /* Wall clock time; clock() adds up the time of all threads. */
+  double start = get_time_ms();
+  for (int i = 0; i < num_frames; ++i) {
+    screencapture_convert(src, yuv, 0, &executor);
+  }
+  double convert_ms = (get_time_ms() - start) / num_frames;
+
+  start = get_time_ms();
+  for (int i = 0; i < num_frames; ++i) {
+    screencapture_scale_convert(scaler, src, scaled, 0, &executor);
+  }
+  double scale_convert_ms = (get_time_ms() - start) / num_frames;
+
+  printf("- %d thread(s), BGRA %d x %d: %.3f ms to convert into 420V, %.3f ms to scale and convert into %d x %d 420V\n",
+         executor.getNumThreads(), srcw, srch, convert_ms, scale_convert_ms, dstw, dsth);
+}
+
+/* ----------------------------------------------------------- */
+
+static double get_time_ms() {
+
+#if defined(_WIN32)
+  LARGE_INTEGER freq, now;
+  QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&now);
+  return (1000.0 * now.QuadPart) / freq.QuadPart;
+#else
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+#endif
+}
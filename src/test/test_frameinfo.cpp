@@ -0,0 +1,398 @@
+/*
+
+  FrameInfo
+  ---------
+
+  Tests the transformations of the frame metadata: we mark a rectangle
+  in a frame, rotate the frame with `screencapture_rotate()` and check
+  that the rotated rectangle of the info covers exactly the marked
+  pixels, for every rotation and flip. Checks that scaling grows and
+  clips the rectangles and turns moves into dirty rectangles, that
+  `fit()` maps them into a letterboxed frame, that `breakMoves()` turns
+  the moves under the pointer into dirty rectangles, that `alignEven()` aligns the rectangles for 4:2:0 and that the clock is
+  monotonic.
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <screencapture/FrameInfo.h>
+#include <screencapture/Rotate.h>
+
+using namespace sc;
+
+static int test_rotate(int rotation);
+static int test_scale();
+static int test_fit();
+static int test_break_moves();
+static int test_align();
+static int test_time();
+static int get_rotated_rect(int rotation, int w, int h, int x, int y, int rw, int rh, DirtyRect& result);
+static int rect_equals(const char* what, int x, int y, int w, int h, int ex, int ey, int ew, int eh);
+
+int main() {
+
+  printf("\n\ntest_frameinfo\n\n");
+
+  int r = 0;
+  int rotations[] = { SC_ROTATE_0, SC_ROTATE_90, SC_ROTATE_180, SC_ROTATE_270 };
+
+  for (size_t i = 0; i < sizeof(rotations) / sizeof(rotations[0]); ++i) {
+    r |= test_rotate(rotations[i]);
+    r |= test_rotate(rotations[i] | SC_FLIP_HORIZONTAL);
+    r |= test_rotate(rotations[i] | SC_FLIP_VERTICAL);
+    r |= test_rotate(rotations[i] | SC_FLIP_HORIZONTAL | SC_FLIP_VERTICAL);
+  }
+
+  r |= test_scale();
+  r |= test_fit();
+  r |= test_break_moves();
+  r |= test_align();
+  r |= test_time();
+
+  if (0 != r) {
+    printf("\nFAILED\n\n");
+    exit(EXIT_FAILURE);
+  }
+
+  printf("\nOK\n\n");
+
+  return 0;
+}
+
+/* ----------------------------------------------------------- */
+
+static int test_rotate(int rotation) {
+
+  int w = 40;
+  int h = 24;
+  FrameInfo info;
+  DirtyRect dirty;
+  DirtyRect src = { 0, 0, 0, 0 };
+  DirtyRect dst = { 0, 0, 0, 0 };
+  DirtyRect cursor = { 0, 0, 0, 0 };
+  MoveRect move;
+
+  dirty.x = 3;
+  dirty.y = 5;
+  dirty.width = 10;
+  dirty.height = 7;
+
+  move.src_x = 20;
+  move.src_y = 2;
+  move.x = 22;
+  move.y = 9;
+  move.width = 12;
+  move.height = 6;
+
+  info.flags = SC_FRAME_HAS_DIRTY_RECTS | SC_FRAME_HAS_MOVE_RECTS | SC_FRAME_HAS_CURSOR;
+  info.dirty_rects.push_back(dirty);
+  info.move_rects.push_back(move);
+  info.cursor_x = 31;
+  info.cursor_y = 17;
+  info.cursor_visible = 1;
+  info.rotate(rotation, w, h);
+
+  if (0 != get_rotated_rect(rotation, w, h, dirty.x, dirty.y, dirty.width, dirty.height, dirty)
+      || 0 != get_rotated_rect(rotation, w, h, move.src_x, move.src_y, move.width, move.height, src)
+      || 0 != get_rotated_rect(rotation, w, h, move.x, move.y, move.width, move.height, dst)
+      || 0 != get_rotated_rect(rotation, w, h, 31, 17, 1, 1, cursor))
+    {
+      return 1;
+    }
+
+  MoveRect& m = info.move_rects[0];
+  DirtyRect& d = info.dirty_rects[0];
+
+  if (0 != rect_equals("dirty", d.x, d.y, d.width, d.height, dirty.x, dirty.y, dirty.width, dirty.height)
+      || 0 != rect_equals("move source", m.src_x, m.src_y, m.width, m.height, src.x, src.y, src.width, src.height)
+      || 0 != rect_equals("move", m.x, m.y, m.width, m.height, dst.x, dst.y, dst.width, dst.height)
+      || 0 != rect_equals("cursor", info.cursor_x, info.cursor_y, 1, 1, cursor.x, cursor.y, 1, 1))
+    {
+      printf("- rotation %d: FAILED\n", rotation);
+      return 1;
+    }
+
+  printf("- rotation %d: OK\n", rotation);
+
+  return 0;
+}
+
+static int test_scale() {
+
+  FrameInfo info;
+  DirtyRect dirty;
+  DirtyRect corner;
+  MoveRect move;
+
+  dirty.x = 10;
+  dirty.y = 10;
+  dirty.width = 20;
+  dirty.height = 20;
+
+  corner.x = 95;
+  corner.y = 90;
+  corner.width = 5;
+  corner.height = 10;
+
+  move.src_x = 40;
+  move.src_y = 40;
+  move.x = 40;
+  move.y = 60;
+  move.width = 20;
+  move.height = 10;
+
+  info.flags = SC_FRAME_HAS_DIRTY_RECTS | SC_FRAME_HAS_MOVE_RECTS | SC_FRAME_HAS_CURSOR;
+  info.dirty_rects.push_back(dirty);
+  info.dirty_rects.push_back(corner);
+  info.move_rects.push_back(move);
+  info.cursor_x = 51;
+  info.cursor_y = 99;
+  info.scale(100, 100, 50, 50, 3);
+
+  /* The dirty rects grow by 3 pixels, get clipped and the move becomes a dirty rect of its destination. */
+  if (3 != info.dirty_rects.size() || 0 != info.move_rects.size() || 0 != (info.flags & SC_FRAME_HAS_MOVE_RECTS)
+      || 0 != rect_equals("scaled dirty", info.dirty_rects[0].x, info.dirty_rects[0].y, info.dirty_rects[0].width, info.dirty_rects[0].height, 3, 3, 14, 14)
+      || 0 != rect_equals("scaled corner", info.dirty_rects[1].x, info.dirty_rects[1].y, info.dirty_rects[1].width, info.dirty_rects[1].height, 46, 43, 4, 7)
+      || 0 != rect_equals("scaled move", info.dirty_rects[2].x, info.dirty_rects[2].y, info.dirty_rects[2].width, info.dirty_rects[2].height, 18, 28, 14, 9)
+      || 0 != rect_equals("scaled cursor", info.cursor_x, info.cursor_y, 1, 1, 25, 49, 1, 1))
+    {
+      printf("- scale: FAILED\n");
+      return 1;
+    }
+
+  /* Without dirty rects we can't tell what changed; the moves are dropped. */
+  info.reset();
+  info.flags = SC_FRAME_HAS_MOVE_RECTS;
+  info.move_rects.push_back(move);
+  info.scale(100, 100, 200, 200, 1);
+
+  if (0 != info.flags || 0 != info.move_rects.size() || 0 != info.dirty_rects.size()) {
+    printf("- scale: FAILED, moves without dirty rects should be dropped.\n");
+    return 1;
+  }
+
+  /* The same size changes nothing. */
+  info.flags = SC_FRAME_HAS_DIRTY_RECTS | SC_FRAME_HAS_MOVE_RECTS;
+  info.move_rects.push_back(move);
+  info.scale(100, 100, 100, 100, 3);
+
+  if (1 != info.move_rects.size() || 0 != info.dirty_rects.size()) {
+    printf("- scale: FAILED, scaling into the same size should keep the moves.\n");
+    return 1;
+  }
+
+  printf("- scale: OK\n");
+
+  return 0;
+}
+
+static int test_fit() {
+
+  FrameInfo info;
+  DirtyRect dirty = { 100, 200, 50, 40 };
+  DirtyRect edge = { 1900, 0, 20, 10 };
+  MoveRect move = { 0, 0, 0, 100, 100, 50 };
+
+  /* 1920 x 1200 is wider than 1280 x 720 tall: scaled by 0.6 into 1152 x 720 with bars of 64 pixels left and right. */
+  info.flags = SC_FRAME_HAS_DIRTY_RECTS | SC_FRAME_HAS_MOVE_RECTS | SC_FRAME_HAS_CURSOR;
+  info.dirty_rects.push_back(dirty);
+  info.dirty_rects.push_back(edge);
+  info.move_rects.push_back(move);
+  info.cursor_x = 960;
+  info.cursor_y = 600;
+  info.fit(1920, 1200, 1280, 720, 1, 0);
+
+  if (3 != info.dirty_rects.size() || 0 != info.move_rects.size()
+      || 0 != rect_equals("fit dirty", info.dirty_rects[0].x, info.dirty_rects[0].y, info.dirty_rects[0].width, info.dirty_rects[0].height, 124, 120, 30, 24)
+      || 0 != rect_equals("fit edge", info.dirty_rects[1].x, info.dirty_rects[1].y, info.dirty_rects[1].width, info.dirty_rects[1].height, 1204, 0, 12, 6)
+      || 0 != rect_equals("fit move", info.dirty_rects[2].x, info.dirty_rects[2].y, info.dirty_rects[2].width, info.dirty_rects[2].height, 64, 60, 60, 30)
+      || 0 != rect_equals("fit cursor", info.cursor_x, info.cursor_y, 1, 1, 640, 360, 1, 1))
+    {
+      printf("- fit: FAILED\n");
+      return 1;
+    }
+
+  /* The same width: not scaled, only moved down past the bar, so the moves stay moves. */
+  MoveRect shift = { 10, 10, 20, 10, 5, 5 };
+
+  info.reset();
+  info.flags = SC_FRAME_HAS_DIRTY_RECTS | SC_FRAME_HAS_MOVE_RECTS;
+  info.move_rects.push_back(shift);
+  info.fit(100, 50, 100, 80, 1, 1);
+
+  if (1 != info.move_rects.size() || 0 != info.dirty_rects.size()
+      || 0 != rect_equals("fit move source", info.move_rects[0].src_x, info.move_rects[0].src_y, 5, 5, 10, 24, 5, 5)
+      || 0 != rect_equals("fit move destination", info.move_rects[0].x, info.move_rects[0].y, 5, 5, 20, 24, 5, 5))
+    {
+      printf("- fit: FAILED, a frame that is only offset should keep its moves.\n");
+      return 1;
+    }
+
+  printf("- fit: OK\n");
+
+  return 0;
+}
+
+static int test_break_moves() {
+
+  FrameInfo info;
+  DirtyRect pointer = { 50, 50, 32, 32 };
+  MoveRect into = { 0, 0, 40, 40, 20, 20 };
+  MoveRect from = { 60, 60, 0, 0, 10, 10 };
+  MoveRect away = { 200, 200, 200, 100, 50, 50 };
+
+  /* Content scrolls into and out of the area of the pointer, which didn't move. */
+  info.flags = SC_FRAME_HAS_DIRTY_RECTS | SC_FRAME_HAS_MOVE_RECTS;
+  info.move_rects.push_back(into);
+  info.move_rects.push_back(from);
+  info.move_rects.push_back(away);
+
+  if (2 != info.breakMoves(pointer)
+      || 1 != info.move_rects.size() || 2 != info.dirty_rects.size()
+      || 200 != info.move_rects[0].src_x
+      || 0 != rect_equals("move into the pointer", info.dirty_rects[0].x, info.dirty_rects[0].y, info.dirty_rects[0].width, info.dirty_rects[0].height, 40, 40, 20, 20)
+      || 0 != rect_equals("move from the pointer", info.dirty_rects[1].x, info.dirty_rects[1].y, info.dirty_rects[1].width, info.dirty_rects[1].height, 0, 0, 10, 10))
+    {
+      printf("- break moves: FAILED\n");
+      return 1;
+    }
+
+  printf("- break moves: OK\n");
+
+  return 0;
+}
+
+static int test_align() {
+
+  FrameInfo info;
+  DirtyRect dirty;
+  MoveRect even;
+  MoveRect odd;
+
+  dirty.x = 3;
+  dirty.y = 5;
+  dirty.width = 4;
+  dirty.height = 4;
+
+  even.src_x = 0;
+  even.src_y = 2;
+  even.x = 0;
+  even.y = 4;
+  even.width = 9;
+  even.height = 4;
+
+  odd = even;
+  odd.y = 3;
+
+  info.flags = SC_FRAME_HAS_DIRTY_RECTS | SC_FRAME_HAS_MOVE_RECTS;
+  info.dirty_rects.push_back(dirty);
+  info.move_rects.push_back(even);
+  info.move_rects.push_back(odd);
+  info.alignEven(9, 9);
+
+  /* The width of 9 is odd but the move ends at the right edge. */
+  if (1 != info.move_rects.size() || 2 != info.dirty_rects.size()
+      || 0 != rect_equals("aligned dirty", info.dirty_rects[0].x, info.dirty_rects[0].y, info.dirty_rects[0].width, info.dirty_rects[0].height, 2, 4, 6, 5)
+      || 0 != rect_equals("aligned move", info.dirty_rects[1].x, info.dirty_rects[1].y, info.dirty_rects[1].width, info.dirty_rects[1].height, 0, 2, 9, 6)
+      || 4 != info.move_rects[0].y)
+    {
+      printf("- align: FAILED\n");
+      return 1;
+    }
+
+  printf("- align: OK\n");
+
+  return 0;
+}
+
+static int test_time() {
+
+  uint64_t prev = screencapture_get_time_ns();
+
+  for (int i = 0; i < 1000; ++i) {
+    uint64_t now = screencapture_get_time_ns();
+    if (now < prev) {
+      printf("- time: FAILED, the clock went back from %llu to %llu.\n", (unsigned long long)prev, (unsigned long long)now);
+      return 1;
+    }
+    prev = now;
+  }
+
+  if (0 == prev) {
+    printf("- time: FAILED, the clock returns 0.\n");
+    return 1;
+  }
+
+  printf("- time: OK\n");
+
+  return 0;
+}
+
+/* ----------------------------------------------------------- */
+
+/* Marks the rectangle in a `w` x `h` BGRA frame, rotates the frame and returns the bounds of the marked pixels in `result`. */
+static int get_rotated_rect(int rotation, int w, int h, int x, int y, int rw, int rh, DirtyRect& result) {
+
+  PixelBuffer src;
+  PixelBuffer dst;
+  std::vector<uint8_t> src_mem;
+  std::vector<uint8_t> dst_mem;
+  int dst_w = 0;
+  int dst_h = 0;
+
+  screencapture_get_rotated_size(rotation, w, h, dst_w, dst_h);
+
+  if (0 != src.init(w, h, SC_BGRA) || 0 != dst.init(dst_w, dst_h, SC_BGRA)) {
+    return -1;
+  }
+
+  src_mem.assign(src.getNumBytes(), 0);
+  dst_mem.assign(dst.getNumBytes(), 0);
+
+  if (0 != src.setPlanes(&src_mem.front()) || 0 != dst.setPlanes(&dst_mem.front())) {
+    return -2;
+  }
+
+  for (int j = y; j < y + rh; ++j) {
+    memset(src.plane[0] + j * src.stride[0] + x * 4, 0xFF, rw * 4);
+  }
+
+  if (0 != screencapture_rotate(src, dst, rotation)) {
+    return -3;
+  }
+
+  int x0 = dst_w;
+  int y0 = dst_h;
+  int x1 = 0;
+  int y1 = 0;
+
+  for (int j = 0; j < dst_h; ++j) {
+    for (int i = 0; i < dst_w; ++i) {
+      if (0 != dst.plane[0][j * dst.stride[0] + i * 4]) {
+        x0 = (i < x0) ? i : x0;
+        y0 = (j < y0) ? j : y0;
+        x1 = (i + 1 > x1) ? i + 1 : x1;
+        y1 = (j + 1 > y1) ? j + 1 : y1;
+      }
+    }
+  }
+
+  result.x = x0;
+  result.y = y0;
+  result.width = x1 - x0;
+  result.height = y1 - y0;
+
+  return 0;
+}
+
+static int rect_equals(const char* what, int x, int y, int w, int h, int ex, int ey, int ew, int eh) {
+
+  if (x != ex || y != ey || w != ew || h != eh) {
+    printf("Error: the %s rect is %d, %d, %d x %d, expected %d, %d, %d x %d.\n", what, x, y, w, h, ex, ey, ew, eh);
+    return -1;
+  }
+
+  return 0;
+}
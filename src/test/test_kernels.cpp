@@ -0,0 +1,411 @@
+/*
+
+  Kernels
+  -------
+
+  Tests the runtime selection of the kernels. Every conversion,
+  rotation, pointer drawing, block hash, privacy mask, overlay and
+  every scaling path must give exactly the same result with each
+  variant that this CPU supports as with the plain C kernels. Prints
+  the CPU features, the selected variant (see the SC_KERNELS
+  environment variable) and the time the variants need for a 4K frame.
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include <algorithm>
+#include <screencapture/Kernels.h>
+#include <screencapture/Convert.h>
+#include <screencapture/Scaler.h>
+#include <screencapture/Rotate.h>
+#include <screencapture/Cursor.h>
+#include <screencapture/Mask.h>
+#include <screencapture/Overlay.h>
+#include "TestUtils.h"
+
+using namespace sc;
+
+static int run_conversions(std::vector<uint8_t>& result);
+static int run_scalers(std::vector<uint8_t>& result);
+static void benchmark(int variant);
+
+int main() {
+
+  printf("\n\ntest_kernels\n\n");
+
+  int r = 0;
+  int features = screencapture_get_cpu_features();
+
+  screencapture_init_kernels();
+
+  printf("- CPU features:%s%s%s%s\n",
+         (features & SC_CPU_SSE2) ? " sse2" : "",
+         (features & SC_CPU_SSSE3) ? " ssse3" : "",
+         (features & SC_CPU_AVX2) ? " avx2" : "",
+         (features & SC_CPU_NEON) ? " neon" : "");
+  printf("- Selected kernels: %s\n", screencapture_kernels_to_string(screencapture_get_kernels()).c_str());
+
+  if (0 != screencapture_is_kernels_supported(screencapture_get_kernels())) {
+    printf("Error: selected kernels that are not supported.\n");
+    r |= 1;
+  }
+
+  /* The C kernels are the reference. */
+  std::vector<uint8_t> expected_convert;
+  std::vector<uint8_t> expected_scale;
+
+  if (0 != screencapture_select_kernels(SC_KERNELS_C)
+      || 0 != run_conversions(expected_convert)
+      || 0 != run_scalers(expected_scale))
+    {
+      printf("Error: failed to run the C kernels.\n");
+      exit(EXIT_FAILURE);
+    }
+
+  for (int variant = SC_KERNELS_SSE2; variant <= SC_KERNELS_NEON; ++variant) {
+
+    std::string name = screencapture_kernels_to_string(variant);
+
+    if (0 != screencapture_is_kernels_supported(variant)) {
+      printf("- %s: not supported, skipped\n", name.c_str());
+      continue;
+    }
+
+    std::vector<uint8_t> convert_result;
+    std::vector<uint8_t> scale_result;
+
+    if (0 != screencapture_select_kernels(variant)
+        || 0 != run_conversions(convert_result)
+        || 0 != run_scalers(scale_result))
+      {
+        printf("- %s: FAILED, could not run the kernels.\n", name.c_str());
+        r |= 1;
+        continue;
+      }
+
+    if (convert_result != expected_convert) {
+      printf("- %s conversions: FAILED, differ from the C kernels.\n", name.c_str());
+      r |= 1;
+    }
+    else {
+      printf("- %s conversions: OK\n", name.c_str());
+    }
+
+    if (scale_result != expected_scale) {
+      printf("- %s scaling: FAILED, differs from the C kernels.\n", name.c_str());
+      r |= 1;
+    }
+    else {
+      printf("- %s scaling: OK\n", name.c_str());
+    }
+  }
+
+  /* Invalid variants must fail. */
+  if (0 == screencapture_select_kernels(SC_KERNELS_NONE)
+      || 0 == screencapture_select_kernels(100)
+      || "unknown" != screencapture_kernels_to_string(100))
+    {
+      printf("Error: selecting an invalid variant should fail.\n");
+      r |= 1;
+    }
+
+  if (0 != r) {
+    printf("\nFAILED\n\n");
+    exit(EXIT_FAILURE);
+  }
+
+  for (int variant = SC_KERNELS_C; variant <= SC_KERNELS_NEON; ++variant) {
+    benchmark(variant);
+  }
+
+  printf("\nOK\n\n");
+
+  return 0;
+}
+
+/* ----------------------------------------------------------- */
+
+/* Runs all conversions and rotations on random pixels with an odd size and appends the results. */
+static int run_conversions(std::vector<uint8_t>& result) {
+
+  int conversions[][3] = {
+    { SC_BGRA, SC_I420, 0 },
+    { SC_BGRA, SC_420V, SC_CONVERT_BT709 },
+    { SC_BGRA, SC_420F, 0 },
+    { SC_BGRA, SC_RGBA, 0 },
+    { SC_BGRA, SC_RGB24, 0 },
+    { SC_BGRA, SC_BGR24, 0 },
+    { SC_I420, SC_BGRA, 0 },
+    { SC_I420, SC_420V, 0 },
+    { SC_420V, SC_I420, 0 },
+    { SC_420V, SC_BGRA, 0 },
+    { SC_420F, SC_RGBA, SC_CONVERT_BT709 },
+    { SC_BGRA, SC_I420, SC_CONVERT_BT2020 | SC_CONVERT_FULL_RANGE },
+    { SC_420V, SC_BGRA, SC_CONVERT_BT2020 },
+    { SC_L10R, SC_P010, 0 },
+    { SC_L10R, SC_RGB48, 0 },
+    { SC_L10R, SC_BGRA, 0 },
+    { SC_L10R, SC_BGRA, SC_CONVERT_DITHER },
+  };
+
+  int w = 157;
+  int h = 35;
+
+  result.clear();
+
+  for (size_t i = 0; i < sizeof(conversions) / sizeof(conversions[0]); ++i) {
+
+    PixelBuffer src, dst;
+    std::vector<uint8_t> src_mem, dst_mem;
+
+    if (0 != alloc_buffer(src, src_mem, w, h, conversions[i][0])
+        || 0 != alloc_buffer(dst, dst_mem, w, h, conversions[i][1]))
+      {
+        return -1;
+      }
+
+    fill_random(src_mem);
+
+    if (0 != screencapture_convert(src, dst, conversions[i][2])) {
+      return -2;
+    }
+
+    result.insert(result.end(), dst_mem.begin(), dst_mem.end());
+  }
+
+  /* The transpose and reverse kernels, through all rotations. */
+  int rotate_formats[] = { SC_BGRA, SC_420V, SC_P010 };
+
+  for (int f = 0; f < 3; ++f) {
+    for (int rotation = SC_ROTATE_90; rotation <= (SC_ROTATE_270 | SC_FLIP_HORIZONTAL); ++rotation) {
+
+      PixelBuffer src, dst;
+      std::vector<uint8_t> src_mem, dst_mem;
+      int rw = 0;
+      int rh = 0;
+
+      if (0 != screencapture_get_rotated_size(rotation, w, h, rw, rh)
+          || 0 != alloc_buffer(src, src_mem, w, h, rotate_formats[f])
+          || 0 != alloc_buffer(dst, dst_mem, rw, rh, rotate_formats[f]))
+        {
+          return -1;
+        }
+
+      fill_random(src_mem);
+
+      if (0 != screencapture_rotate(src, dst, rotation)) {
+        return -2;
+      }
+
+      result.insert(result.end(), dst_mem.begin(), dst_mem.end());
+    }
+  }
+
+  /* The blend and mask kernels, through drawing pointers. */
+  int cursor_types[] = { SC_CURSOR_COLOR, SC_CURSOR_MASKED_COLOR, SC_CURSOR_MONOCHROME };
+
+  for (int t = 0; t < 3; ++t) {
+
+    PixelBuffer frame;
+    std::vector<uint8_t> frame_mem;
+    std::vector<uint8_t> shape(37 * 37 * 4 * 2);
+    Cursor cursor;
+
+    if (0 != alloc_buffer(frame, frame_mem, w, h, SC_BGRA)) {
+      return -1;
+    }
+
+    fill_random(frame_mem);
+    fill_random(shape);
+
+    if (0 != cursor.setShape(cursor_types[t], 37, 17, 37 * 4, &shape.front())
+        || 0 != cursor.draw(frame, 3, 9)
+        || 0 != cursor.draw(frame, w - 20, -5))
+      {
+        return -2;
+      }
+
+    result.insert(result.end(), frame_mem.begin(), frame_mem.end());
+  }
+
+  /* The monochrome pointer decoder; an odd width so the C code handles the end of the rows. */
+  std::vector<uint8_t> bits(7 * 21 * 2);
+  std::vector<uint8_t> bgra(53 * 21 * 4);
+
+  fill_random(bits);
+
+  if (0 != screencapture_decode_monochrome_cursor(&bits.front(), 53, 21, 7, &bgra.front(), 53 * 4)) {
+    return -2;
+  }
+
+  result.insert(result.end(), bgra.begin(), bgra.end());
+
+  /* Block hashes (see Dirty.h) of every row length up to 300 bytes, so the C code handles the end of the rows. */
+  std::vector<uint8_t> block(300 * 7);
+
+  fill_random(block);
+
+  for (int n = 1; n <= 300; ++n) {
+    uint64_t hash = kernel_hash_block(&block.front(), 300, n, 1 + n % 7);
+    result.insert(result.end(), (uint8_t*)&hash, (uint8_t*)&hash + sizeof(hash));
+  }
+
+  /* The fill and box blur kernels, through masking regions with an odd position and size. */
+  int mask_formats[] = { SC_BGRA, SC_420V, SC_I420 };
+
+  for (int f = 0; f < 3; ++f) {
+    for (int mode = SC_MASK_FILL; mode <= SC_MASK_BLUR; ++mode) {
+
+      PixelBuffer frame;
+      std::vector<uint8_t> frame_mem;
+      std::vector<MaskRegion> regions(1);
+      PrivacyMask mask;
+
+      regions[0].x = 5;
+      regions[0].y = 3;
+      regions[0].width = w - 12;
+      regions[0].height = h - 7;
+      regions[0].mode = mode;
+      regions[0].size = 5;
+      regions[0].red = 31;
+      regions[0].green = 147;
+      regions[0].blue = 220;
+
+      if (0 != alloc_buffer(frame, frame_mem, w, h, mask_formats[f])) {
+        return -1;
+      }
+
+      fill_random(frame_mem);
+
+      if (0 != mask.setRegions(regions) || 0 != mask.update() || 0 != mask.apply(frame)) {
+        return -2;
+      }
+
+      result.insert(result.end(), frame_mem.begin(), frame_mem.end());
+    }
+  }
+
+  /* The premultiplied blend kernels, through overlays at an odd position. */
+  int overlay_formats[] = { SC_BGRA, SC_RGBA, SC_420V, SC_I420 };
+
+  for (int f = 0; f < 4; ++f) {
+
+    PixelBuffer frame;
+    std::vector<uint8_t> frame_mem;
+    std::vector<uint8_t> pixels(61 * 19 * 4);
+    Overlays overlays;
+
+    if (0 != alloc_buffer(frame, frame_mem, w, h, overlay_formats[f])) {
+      return -1;
+    }
+
+    fill_random(frame_mem);
+    fill_random(pixels);
+
+    /* Premultiplied: the colors can't be larger than the alpha. */
+    for (size_t i = 0; i < pixels.size(); i += 4) {
+      pixels[i + 0] = std::min(pixels[i + 0], pixels[i + 3]);
+      pixels[i + 1] = std::min(pixels[i + 1], pixels[i + 3]);
+      pixels[i + 2] = std::min(pixels[i + 2], pixels[i + 3]);
+    }
+
+    if (0 != overlays.setOverlay(1, 7, 3, 61, 19, 61 * 4, &pixels.front())
+        || 0 != overlays.setOverlay(2, w - 40, h - 9, 61, 19, 61 * 4, &pixels.front())
+        || 0 != overlays.update()
+        || 0 != overlays.apply(frame))
+      {
+        return -2;
+      }
+
+    result.insert(result.end(), frame_mem.begin(), frame_mem.end());
+  }
+
+  return 0;
+}
+
+/* Runs the bilinear, box and filter paths for all formats and appends the results. */
+static int run_scalers(std::vector<uint8_t>& result) {
+
+  int sizes[][4] = {
+    { 301, 173, 128, 77 },                                        /* Bilinear down. */
+    { 97, 61, 200, 131 },                                         /* Bilinear up. */
+    { 132, 68, 66, 34 },                                          /* Box 2x. */
+    { 198, 102, 66, 34 },                                         /* Box 3x. */
+    { 264, 136, 66, 34 },                                         /* Box 4x. */
+  };
+
+  int formats[] = { SC_BGRA, SC_420V, SC_I420 };
+  int qualities[] = { SC_SCALE_BILINEAR, SC_SCALE_BICUBIC, SC_SCALE_LANCZOS3 };
+
+  result.clear();
+
+  for (int q = 0; q < 3; ++q) {
+    for (int f = 0; f < 3; ++f) {
+      for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+
+        PixelBuffer src, dst;
+        std::vector<uint8_t> src_mem, dst_mem;
+        Scaler scaler;
+
+        if (0 != alloc_buffer(src, src_mem, sizes[i][0], sizes[i][1], formats[f])
+            || 0 != alloc_buffer(dst, dst_mem, sizes[i][2], sizes[i][3], formats[f])
+            || 0 != scaler.init(sizes[i][0], sizes[i][1], sizes[i][2], sizes[i][3], formats[f], qualities[q]))
+          {
+            return -1;
+          }
+
+        fill_random(src_mem);
+
+        if (0 != scaler.scale(src, dst)) {
+          return -2;
+        }
+
+        result.insert(result.end(), dst_mem.begin(), dst_mem.end());
+      }
+    }
+  }
+
+  return 0;
+}
+
+static void benchmark(int variant) {
+
+  if (0 != screencapture_is_kernels_supported(variant)
+      || 0 != screencapture_select_kernels(variant))
+    {
+      return;
+    }
+
+  PixelBuffer bgra, nv12, scaled;
+  std::vector<uint8_t> bgra_mem, nv12_mem, scaled_mem;
+  Scaler scaler;
+  int num_frames = 10;
+
+  if (0 != alloc_buffer(bgra, bgra_mem, 3840, 2160, SC_BGRA)
+      || 0 != alloc_buffer(nv12, nv12_mem, 3840, 2160, SC_420V)
+      || 0 != alloc_buffer(scaled, scaled_mem, 1920, 1080, SC_BGRA)
+      || 0 != scaler.init(3840, 2160, 1920, 1080, SC_BGRA, SC_SCALE_BICUBIC))
+    {
+      return;
+    }
+
+  fill_random(bgra_mem);
+
+  clock_t start = clock();
+  for (int i = 0; i < num_frames; ++i) {
+    screencapture_convert(bgra, nv12);
+  }
+  double convert_ms = (1000.0 * (clock() - start)) / (CLOCKS_PER_SEC * num_frames);
+
+  start = clock();
+  for (int i = 0; i < num_frames; ++i) {
+    scaler.scale(bgra, scaled);
+  }
+  double scale_ms = (1000.0 * (clock() - start)) / (CLOCKS_PER_SEC * num_frames);
+
+  printf("- %s: %.3f ms to convert 4K BGRA into 420V, %.3f ms to scale it to 1080p (bicubic)\n",
+         screencapture_kernels_to_string(variant).c_str(), convert_ms, scale_ms);
+}
@@ -0,0 +1,401 @@
+/*
+
+  Mask
+  ----
+
+  Tests the privacy masks: we mask regions of random frames in every
+  supported format and check that the pixels outside the regions keep
+  their values, that a fill sets the color, that every block of a
+  pixelated region is the mean of its pixels and that the blur matches
+  a plain box filter. Checks the validation of the regions and how
+  the mask updates the dirty and move rects of the frame info. Prints
+  the time it takes to mask a region of a 4K frame.
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <screencapture/Mask.h>
+#include <screencapture/FrameInfo.h>
+#include <screencapture/Convert.h>
+#include "TestUtils.h"
+
+using namespace sc;
+
+static int test_format(int fmt);
+static int test_info();
+static int check_plane(const uint8_t* orig, const uint8_t* masked, size_t stride, int w, int h, int bpp, int x0, int y0, int x1, int y1, int mode, int size, const uint8_t* color);
+static void box_blur_reference(const uint8_t* src, size_t stride, int w, int h, int bpp, int radius, std::vector<uint8_t>& result);
+static void benchmark();
+
+int main() {
+
+  printf("\n\ntest_mask\n\n");
+
+  int r = 0;
+  int formats[] = { SC_BGRA, SC_RGBA, SC_420V, SC_420F, SC_I420 };
+
+  for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i) {
+    r |= test_format(formats[i]);
+  }
+
+  r |= test_info();
+
+  /* Invalid regions must fail and keep the current regions. */
+  PrivacyMask mask;
+  std::vector<MaskRegion> regions(1);
+
+  regions[0].width = 10;
+  regions[0].height = 10;
+
+  if (0 != mask.setRegions(regions) || 0 != mask.update()) {
+    printf("Error: setting a valid region failed.\n");
+    r |= 1;
+  }
+
+  regions[0].mode = 7;
+  r |= (0 == mask.setRegions(regions)) ? 1 : 0;
+  regions[0].mode = SC_MASK_PIXELATE;
+  regions[0].size = SC_MASK_MAX_BLOCK + 1;
+  r |= (0 == mask.setRegions(regions)) ? 1 : 0;
+  regions[0].mode = SC_MASK_BLUR;
+  regions[0].size = 0;
+  r |= (0 == mask.setRegions(regions)) ? 1 : 0;
+  regions[0].mode = SC_MASK_FILL;
+  regions[0].red = 256;
+  r |= (0 == mask.setRegions(regions)) ? 1 : 0;
+  regions[0].red = 0;
+  regions[0].width = -1;
+  r |= (0 == mask.setRegions(regions)) ? 1 : 0;
+
+  if (0 != mask.update() || true == mask.regions_changed || 0 != mask.canApply(SC_I420) || 0 == mask.canApply(SC_P010)) {
+    printf("Error: invalid regions should fail and keep the current regions.\n");
+    r |= 1;
+  }
+
+  mask.clear();
+
+  if (0 == mask.update() || false == mask.regions_changed) {
+    printf("Error: clearing the regions failed.\n");
+    r |= 1;
+  }
+
+  if (0 != r) {
+    printf("\nFAILED\n\n");
+    exit(EXIT_FAILURE);
+  }
+
+  benchmark();
+
+  printf("\nOK\n\n");
+
+  return 0;
+}
+
+/* ----------------------------------------------------------- */
+
+static int test_format(int fmt) {
+
+  int w = 97;
+  int h = 61;
+  int layout[3] = { 0 };
+  int num_planes = screencapture_get_plane_layout(fmt, layout);
+  bool is_yuv = (1 < num_planes);
+  std::string name = screencapture_pixelformat_to_string(fmt);
+  int modes[] = { SC_MASK_FILL, SC_MASK_PIXELATE, SC_MASK_BLUR };
+  const char* mode_names[] = { "fill", "pixelate", "blur" };
+
+  /* An odd position and size; partially outside the frame; the whole frame. */
+  int rects[][4] = {
+    { 13, 7, 41, 29 },
+    { 80, 50, 40, 40 },
+    { 0, 0, 97, 61 },
+  };
+
+  for (int m = 0; m < 3; ++m) {
+    for (size_t i = 0; i < sizeof(rects) / sizeof(rects[0]); ++i) {
+
+      PixelBuffer orig;
+      PixelBuffer frame;
+      std::vector<uint8_t> orig_mem;
+      std::vector<uint8_t> frame_mem;
+      std::vector<MaskRegion> regions(1);
+      PrivacyMask mask;
+      uint8_t color[4] = { 0 };
+
+      if (0 != alloc_buffer(orig, orig_mem, w, h, fmt) || 0 != alloc_buffer(frame, frame_mem, w, h, fmt)) {
+        return 1;
+      }
+
+      fill_random(orig_mem, 5 + i);
+      frame_mem = orig_mem;
+
+      regions[0].x = rects[i][0];
+      regions[0].y = rects[i][1];
+      regions[0].width = rects[i][2];
+      regions[0].height = rects[i][3];
+      regions[0].mode = modes[m];
+      regions[0].size = (SC_MASK_BLUR == modes[m]) ? 3 : 6;
+      regions[0].red = 200;
+      regions[0].green = 100;
+      regions[0].blue = 50;
+
+      if (0 != mask.setRegions(regions) || 0 != mask.update() || 0 != mask.apply(frame, SC_CONVERT_BT709)) {
+        printf("- %s %s: FAILED, could not mask the frame.\n", name.c_str(), mode_names[m]);
+        return 1;
+      }
+
+      /* The expected fill color per plane, converted like a frame. */
+      if (SC_MASK_FILL == modes[m]) {
+
+        PixelBuffer bgra;
+        PixelBuffer yuv;
+        std::vector<uint8_t> bgra_mem;
+        std::vector<uint8_t> yuv_mem;
+        uint8_t px[4] = { 50, 100, 200, 255 };
+
+        if (SC_RGBA == fmt) {
+          std::swap(px[0], px[2]);
+        }
+
+        memcpy(color, px, 4);
+
+        if (true == is_yuv) {
+          if (0 != alloc_buffer(bgra, bgra_mem, 2, 2, SC_BGRA) || 0 != alloc_buffer(yuv, yuv_mem, 2, 2, fmt)) {
+            return 1;
+          }
+          for (int k = 0; k < 4; ++k) {
+            memcpy(bgra.plane[0] + (k / 2) * bgra.stride[0] + (k % 2) * 4, px, 4);
+          }
+          if (0 != screencapture_convert(bgra, yuv, SC_CONVERT_BT709)) {
+            return 1;
+          }
+          color[0] = yuv.plane[0][0];
+          color[1] = yuv.plane[1][0];
+          color[2] = (SC_I420 == fmt) ? yuv.plane[2][0] : yuv.plane[1][1];
+        }
+      }
+
+      /* The region that we expect to change; even for 4:2:0. */
+      int x0 = std::max(0, rects[i][0]);
+      int y0 = std::max(0, rects[i][1]);
+      int x1 = std::min(w, rects[i][0] + rects[i][2]);
+      int y1 = std::min(h, rects[i][1] + rects[i][3]);
+
+      if (true == is_yuv) {
+        x0 &= ~1;
+        y0 &= ~1;
+        x1 = std::min(w, (x1 + 1) & ~1);
+        y1 = std::min(h, (y1 + 1) & ~1);
+      }
+
+      for (int p = 0; p < num_planes; ++p) {
+
+        int sub = (0 == p) ? 1 : 2;
+        size_t offset = orig.plane[p] - orig.plane[0];
+        const uint8_t* value = (1 == num_planes) ? color : color + p;
+
+        if (0 != check_plane(&orig_mem[offset], &frame_mem[offset], orig.stride[p],
+                             (w + sub - 1) / sub, (h + sub - 1) / sub, layout[p],
+                             x0 / sub, y0 / sub, (x1 + sub - 1) / sub, (y1 + sub - 1) / sub,
+                             modes[m], std::max(1, regions[0].size / sub), value))
+          {
+            printf("- %s %s, region %lu: FAILED, plane %d differs.\n", name.c_str(), mode_names[m], i, p);
+            return 1;
+          }
+      }
+    }
+
+    printf("- %s %s: OK\n", name.c_str(), mode_names[m]);
+  }
+
+  return 0;
+}
+
+static int test_info() {
+
+  PrivacyMask mask;
+  FrameInfo info;
+  std::vector<MaskRegion> regions(2);
+  DirtyRect dirty = { 0, 0, 8, 8 };
+  DirtyRect inside = { 110, 110, 4, 4 };
+  MoveRect away = { 0, 300, 0, 310, 50, 50 };
+  MoveRect into = { 200, 200, 100, 100, 20, 20 };
+
+  regions[0].x = 100;
+  regions[0].y = 100;
+  regions[0].width = 30;
+  regions[0].height = 30;
+  regions[0].mode = SC_MASK_PIXELATE;
+  regions[1].x = 400;
+  regions[1].y = 0;
+  regions[1].width = 30;
+  regions[1].height = 30;
+
+  /* New regions are dirty as a whole. */
+  info.flags = SC_FRAME_HAS_DIRTY_RECTS | SC_FRAME_HAS_MOVE_RECTS;
+  info.dirty_rects.push_back(dirty);
+
+  if (0 != mask.setRegions(regions) || 0 != mask.update() || false == mask.regions_changed) {
+    return 1;
+  }
+
+  mask.updateInfo(info, 640, 480);
+
+  if (3 != info.dirty_rects.size() || 100 != info.dirty_rects[1].x || 400 != info.dirty_rects[2].x) {
+    printf("- info: FAILED, new regions should be dirty.\n");
+    return 1;
+  }
+
+  /* A change inside a pixelated region dirties the region; a move into a region becomes a dirty rect. */
+  info.reset();
+  info.flags = SC_FRAME_HAS_DIRTY_RECTS | SC_FRAME_HAS_MOVE_RECTS;
+  info.dirty_rects.push_back(inside);
+  info.move_rects.push_back(away);
+  info.move_rects.push_back(into);
+
+  if (0 != mask.update() || true == mask.regions_changed) {
+    return 1;
+  }
+
+  mask.updateInfo(info, 640, 480);
+
+  if (1 != info.move_rects.size() || 310 != info.move_rects[0].y
+      || 3 != info.dirty_rects.size()
+      || 100 != info.dirty_rects[1].x || 20 != info.dirty_rects[1].width
+      || 100 != info.dirty_rects[2].x || 30 != info.dirty_rects[2].width)
+    {
+      printf("- info: FAILED, unexpected rects after a change inside a region.\n");
+      return 1;
+    }
+
+  printf("- info: OK\n");
+
+  return 0;
+}
+
+static void benchmark() {
+
+  PixelBuffer frame;
+  std::vector<uint8_t> mem;
+  std::vector<MaskRegion> regions(1);
+  PrivacyMask mask;
+  int modes[] = { SC_MASK_FILL, SC_MASK_PIXELATE, SC_MASK_BLUR };
+  const char* mode_names[] = { "fill", "pixelate", "blur" };
+  int num_frames = 20;
+
+  if (0 != alloc_buffer(frame, mem, 3840, 2160, SC_BGRA)) {
+    return;
+  }
+
+  fill_random(mem, 9);
+
+  regions[0].x = 1000;
+  regions[0].y = 500;
+  regions[0].width = 1200;
+  regions[0].height = 800;
+
+  for (int m = 0; m < 3; ++m) {
+
+    regions[0].mode = modes[m];
+    regions[0].size = 16;
+    mask.setRegions(regions);
+    mask.update();
+
+    clock_t start = clock();
+    for (int i = 0; i < num_frames; ++i) {
+      mask.apply(frame);
+    }
+    double ms = (1000.0 * (clock() - start)) / (CLOCKS_PER_SEC * num_frames);
+
+    printf("- 4K BGRA, 1200 x 800 region: %.3f ms to %s\n", ms, mode_names[m]);
+  }
+}
+
+/* ----------------------------------------------------------- */
+
+/* Checks one plane: outside [x0, x1) x [y0, y1) nothing changed, inside it's the result of the mode. */
+static int check_plane(const uint8_t* orig, const uint8_t* masked, size_t stride, int w, int h, int bpp, int x0, int y0, int x1, int y1, int mode, int size, const uint8_t* color) {
+
+  std::vector<uint8_t> blurred;
+
+  if (SC_MASK_BLUR == mode) {
+    box_blur_reference(orig + y0 * stride + x0 * bpp, stride, x1 - x0, y1 - y0, bpp, size, blurred);
+  }
+
+  for (int y = 0; y < h; ++y) {
+    for (int x = 0; x < w; ++x) {
+      for (int c = 0; c < bpp; ++c) {
+
+        size_t i = y * stride + x * bpp + c;
+        int expected = orig[i];
+
+        if (x >= x0 && x < x1 && y >= y0 && y < y1) {
+
+          if (SC_MASK_FILL == mode) {
+            expected = color[c];
+          }
+          else if (SC_MASK_PIXELATE == mode) {
+            int bx = x0 + ((x - x0) / size) * size;
+            int by = y0 + ((y - y0) / size) * size;
+            int bw = std::min(size, x1 - bx);
+            int bh = std::min(size, y1 - by);
+            int total = 0;
+            for (int j = by; j < by + bh; ++j) {
+              for (int k = bx; k < bx + bw; ++k) {
+                total += orig[j * stride + k * bpp + c];
+              }
+            }
+            expected = (total + (bw * bh) / 2) / (bw * bh);
+          }
+          else {
+            expected = blurred[((y - y0) * (x1 - x0) + (x - x0)) * bpp + c];
+          }
+        }
+
+        if (masked[i] != expected) {
+          printf("Error: the sample at %d, %d (channel %d) is %d, expected %d.\n", x, y, c, masked[i], expected);
+          return -1;
+        }
+      }
+    }
+  }
+
+  return 0;
+}
+
+/* A box filter over 2 * radius + 1 rows and then columns; the rows and columns outside the region repeat the edge. */
+static void box_blur_reference(const uint8_t* src, size_t stride, int w, int h, int bpp, int radius, std::vector<uint8_t>& result) {
+
+  int window = 2 * radius + 1;
+  uint32_t scale = (65536 + window - 1) / window;
+  std::vector<uint8_t> vertical(w * h * bpp);
+
+  result.resize(w * h * bpp);
+
+  for (int y = 0; y < h; ++y) {
+    for (int i = 0; i < w * bpp; ++i) {
+      uint32_t total = 0;
+      for (int k = -radius; k <= radius; ++k) {
+        total += src[std::min(h - 1, std::max(0, y + k)) * stride + i];
+      }
+      vertical[y * w * bpp + i] = (uint8_t)((total * scale) >> 16);
+    }
+  }
+
+  for (int y = 0; y < h; ++y) {
+    for (int x = 0; x < w; ++x) {
+      for (int c = 0; c < bpp; ++c) {
+        uint32_t total = 0;
+        for (int k = -radius; k <= radius; ++k) {
+          total += vertical[(y * w + std::min(w - 1, std::max(0, x + k))) * bpp + c];
+        }
+        result[(y * w + x) * bpp + c] = (uint8_t)((total * scale) >> 16);
+      }
+    }
+  }
+}
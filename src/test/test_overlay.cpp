@@ -0,0 +1,409 @@
+/*
+
+  Overlay
+  -------
+
+  Tests the overlays: we blend random premultiplied images, partially
+  outside the frame, into random BGRA and RGBA frames and compare with
+  a plain blend. For the YCbCr formats we check that an opaque overlay
+  gets the color of the converted image, that a transparent one and
+  the pixels around the overlays don't change, and that a half
+  transparent overlay blends the converted color. Checks that we only
+  copy and convert the pixels of an overlay when they change, the
+  dirty rects and the errors. Prints the time it takes to draw a
+  watermark into a 4K frame.
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <screencapture/Overlay.h>
+#include <screencapture/Convert.h>
+#include "TestUtils.h"
+
+using namespace sc;
+
+static void fill_premultiplied(std::vector<uint8_t>& pixels, unsigned int seed);
+static int test_packed(int fmt);
+static int test_yuv(int fmt);
+static int test_updates();
+static int get_converted_color(int fmt, int flags, const uint8_t* bgra, uint8_t* yuv);
+static int blend(int s, int d, int a);
+static void benchmark(int fmt);
+
+int main() {
+
+  printf("\n\ntest_overlay\n\n");
+
+  int r = 0;
+
+  r |= test_packed(SC_BGRA);
+  r |= test_packed(SC_RGBA);
+  r |= test_yuv(SC_420V);
+  r |= test_yuv(SC_420F);
+  r |= test_yuv(SC_I420);
+  r |= test_updates();
+
+  if (0 != r) {
+    printf("\nFAILED\n\n");
+    exit(EXIT_FAILURE);
+  }
+
+  benchmark(SC_BGRA);
+  benchmark(SC_420V);
+
+  printf("\nOK\n\n");
+
+  return 0;
+}
+
+/* ----------------------------------------------------------- */
+
+static int test_packed(int fmt) {
+
+  int w = 97;
+  int h = 61;
+  int positions[][2] = { { 13, 7 }, { -9, -5 }, { 80, 50 } };
+  std::string name = screencapture_pixelformat_to_string(fmt);
+
+  for (size_t i = 0; i < sizeof(positions) / sizeof(positions[0]); ++i) {
+
+    PixelBuffer frame;
+    std::vector<uint8_t> orig;
+    std::vector<uint8_t> frame_mem;
+    std::vector<uint8_t> pixels(41 * 23 * 4);
+    Overlays overlays;
+    int ox = positions[i][0];
+    int oy = positions[i][1];
+
+    if (0 != alloc_buffer(frame, frame_mem, w, h, fmt)) {
+      return 1;
+    }
+
+    fill_random(frame_mem, 3 + i);
+    fill_premultiplied(pixels, 7 + i);
+    orig = frame_mem;
+
+    if (0 != overlays.setOverlay(5, ox, oy, 41, 23, 41 * 4, &pixels.front())
+        || 0 != overlays.update()
+        || 0 != overlays.apply(frame))
+      {
+        printf("- %s: FAILED, could not draw the overlay.\n", name.c_str());
+        return 1;
+      }
+
+    for (int y = 0; y < h; ++y) {
+      for (int x = 0; x < w; ++x) {
+
+        const uint8_t* d = &orig[y * frame.stride[0] + x * 4];
+        const uint8_t* result = &frame_mem[y * frame.stride[0] + x * 4];
+        bool inside = (x >= ox && x < ox + 41 && y >= oy && y < oy + 23);
+
+        for (int c = 0; c < 4; ++c) {
+
+          int expected = d[c];
+
+          if (true == inside) {
+            const uint8_t* s = &pixels[((y - oy) * 41 + (x - ox)) * 4];
+            int sc = (SC_RGBA == fmt && 3 != c) ? s[2 - c] : s[c];
+            expected = blend(sc, d[c], s[3]);
+          }
+
+          if (result[c] != expected) {
+            printf("- %s: FAILED, channel %d of pixel %d, %d is %d, expected %d.\n", name.c_str(), c, x, y, result[c], expected);
+            return 1;
+          }
+        }
+      }
+    }
+  }
+
+  printf("- %s: OK\n", name.c_str());
+
+  return 0;
+}
+
+static int test_yuv(int fmt) {
+
+  int w = 97;
+  int h = 61;
+  int flags = SC_CONVERT_BT709;
+  int ox = 13;
+  int oy = 7;
+  int ow = 30;
+  int oh = 21;
+  std::string name = screencapture_pixelformat_to_string(fmt);
+  uint8_t colors[][4] = {
+    { 40, 180, 220, 255 },                                       /* Opaque. */
+    { 0, 0, 0, 0 },                                              /* Transparent. */
+    { 20, 90, 110, 128 },                                        /* Half transparent, premultiplied. */
+  };
+
+  for (int k = 0; k < 3; ++k) {
+
+    PixelBuffer frame;
+    std::vector<uint8_t> orig;
+    std::vector<uint8_t> frame_mem;
+    std::vector<uint8_t> pixels(ow * oh * 4);
+    Overlays overlays;
+    uint8_t straight[4] = { 0 };
+    uint8_t converted[3] = { 0 };
+    int a = colors[k][3];
+    int layout[3] = { 0 };
+    int num_planes = screencapture_get_plane_layout(fmt, layout);
+
+    for (int c = 0; c < 3; ++c) {
+      straight[c] = (0 == a) ? 0 : (uint8_t)std::min(255, (colors[k][c] * 255 + a / 2) / a);
+    }
+    straight[3] = 255;
+
+    if (0 != alloc_buffer(frame, frame_mem, w, h, fmt) || 0 != get_converted_color(fmt, flags, straight, converted)) {
+      return 1;
+    }
+
+    for (size_t i = 0; i < pixels.size(); i += 4) {
+      memcpy(&pixels[i], colors[k], 4);
+    }
+
+    fill_random(frame_mem, 11 + k);
+    orig = frame_mem;
+
+    if (0 != overlays.setOverlay(1, ox, oy, ow, oh, ow * 4, &pixels.front())
+        || 0 != overlays.update()
+        || 0 != overlays.apply(frame, flags))
+      {
+        printf("- %s: FAILED, could not draw the overlay.\n", name.c_str());
+        return 1;
+      }
+
+    for (int p = 0; p < num_planes; ++p) {
+
+      int sub = (0 == p) ? 1 : 2;
+      int pw = (w + sub - 1) / sub;
+      int ph = (h + sub - 1) / sub;
+      size_t offset = frame.plane[p] - frame.plane[0];
+
+      for (int y = 0; y < ph; ++y) {
+        for (int x = 0; x < pw * layout[p]; ++x) {
+
+          /* The samples that the overlay covers completely and the ones it doesn't touch. */
+          int px = x / layout[p];
+          bool inside = (px * sub >= ox && px * sub + sub <= ox + ow && y * sub >= oy && y * sub + sub <= oy + oh);
+          bool outside = (px * sub + sub <= ox || px * sub >= ox + ow || y * sub + sub <= oy || y * sub >= oy + oh);
+          size_t i = offset + y * frame.stride[p] + x;
+          int value = (0 == p) ? converted[0] : (SC_I420 == fmt) ? converted[p] : converted[1 + x % 2];
+          int expected = orig[i];
+
+          if (false == inside && false == outside) {
+            continue;
+          }
+
+          if (true == inside) {
+            int t = value * a + 128;
+            expected = blend((t + (t >> 8)) >> 8, orig[i], a);
+          }
+
+          if (frame_mem[i] != expected) {
+            printf("- %s: FAILED, overlay %d, plane %d, sample %d, %d is %d, expected %d.\n", name.c_str(), k, p, x, y, frame_mem[i], expected);
+            return 1;
+          }
+        }
+      }
+    }
+  }
+
+  printf("- %s: OK\n", name.c_str());
+
+  return 0;
+}
+
+static int test_updates() {
+
+  Overlays overlays;
+  PixelBuffer frame;
+  std::vector<uint8_t> frame_mem;
+  std::vector<uint8_t> pixels(16 * 8 * 4);
+  FrameInfo info;
+  MoveRect into = { 200, 200, 20, 12, 10, 10 };
+  MoveRect away = { 200, 200, 200, 300, 10, 10 };
+
+  if (0 != alloc_buffer(frame, frame_mem, 320, 240, SC_420V)) {
+    return 1;
+  }
+
+  fill_premultiplied(pixels, 1);
+
+  if (0 != overlays.setOverlay(1, 10, 10, 16, 8, 16 * 4, &pixels.front())
+      || 0 != overlays.update()
+      || 1 != overlays.changed_rects.size()
+      || 0 != overlays.apply(frame))
+    {
+      printf("- updates: FAILED, could not draw the overlay.\n");
+      return 1;
+    }
+
+  OverlayImage* img = overlays.overlays[0];
+
+  /* The same pixels at the same position: nothing changes. */
+  overlays.setOverlay(1, 10, 10, 16, 8, 16 * 4, &pixels.front());
+
+  if (true == overlays.has_pending || 0 != overlays.update() || 0 != overlays.changed_rects.size() || img != overlays.overlays[0] || SC_420V != img->prepared_fmt) {
+    printf("- updates: FAILED, setting the same pixels should not change the overlay.\n");
+    return 1;
+  }
+
+  /* An even move keeps the converted planes, an odd move converts again. */
+  overlays.moveOverlay(1, 12, 10);
+
+  if (0 != overlays.update() || 2 != overlays.changed_rects.size() || img != overlays.overlays[0] || SC_420V != img->prepared_fmt) {
+    printf("- updates: FAILED, moving the overlay should keep the converted planes.\n");
+    return 1;
+  }
+
+  overlays.moveOverlay(1, 13, 10);
+  overlays.update();
+  overlays.apply(frame);
+
+  if (1 != img->offset_x) {
+    printf("- updates: FAILED, moving to an odd position should convert the overlay again.\n");
+    return 1;
+  }
+
+  /* New pixels. */
+  pixels[5] ^= 1;
+  overlays.setOverlay(1, 13, 10, 16, 8, 16 * 4, &pixels.front());
+
+  if (0 != overlays.update() || SC_NONE != img->prepared_fmt || pixels != img->pixels) {
+    printf("- updates: FAILED, the new pixels weren't picked up.\n");
+    return 1;
+  }
+
+  /* The moves that touch the overlay become dirty rects; the overlay itself is dirty after a change. */
+  info.flags = SC_FRAME_HAS_DIRTY_RECTS | SC_FRAME_HAS_MOVE_RECTS;
+  info.move_rects.push_back(into);
+  info.move_rects.push_back(away);
+  overlays.setOverlay(2, 300, 230, 16, 8, 16 * 4, &pixels.front());
+  overlays.update();
+  overlays.updateInfo(info, 320, 240);
+
+  if (1 != info.move_rects.size() || 300 != info.move_rects[0].y
+      || 2 != info.dirty_rects.size()
+      || 20 != info.dirty_rects[0].x || 10 != info.dirty_rects[0].width
+      || 300 != info.dirty_rects[1].x || 230 != info.dirty_rects[1].y || 16 != info.dirty_rects[1].width)
+    {
+      printf("- updates: FAILED, unexpected rects after the changes.\n");
+      return 1;
+    }
+
+  /* Errors. */
+  if (0 == overlays.setOverlay(3, 0, 0, 0, 8, 16 * 4, &pixels.front())
+      || 0 == overlays.setOverlay(3, 0, 0, 16, 8, 8, &pixels.front())
+      || 0 == overlays.setOverlay(3, 0, 0, 16, 8, 16 * 4, NULL)
+      || 0 == overlays.moveOverlay(3, 0, 0)
+      || 0 == overlays.removeOverlay(3)
+      || 0 != overlays.canApply(SC_420F)
+      || 0 == overlays.canApply(SC_P010))
+    {
+      printf("- updates: FAILED, invalid overlays should fail.\n");
+      return 1;
+    }
+
+  if (0 != overlays.removeOverlay(1) || 0 != overlays.update() || 1 != overlays.overlays.size() || 2 != overlays.overlays[0]->id) {
+    printf("- updates: FAILED, could not remove an overlay.\n");
+    return 1;
+  }
+
+  overlays.clear();
+
+  if (0 == overlays.update() || 1 != overlays.changed_rects.size()) {
+    printf("- updates: FAILED, could not clear the overlays.\n");
+    return 1;
+  }
+
+  printf("- updates: OK\n");
+
+  return 0;
+}
+
+static void benchmark(int fmt) {
+
+  PixelBuffer frame;
+  std::vector<uint8_t> mem;
+  std::vector<uint8_t> pixels(480 * 64 * 4);
+  Overlays overlays;
+  int num_frames = 50;
+
+  if (0 != alloc_buffer(frame, mem, 3840, 2160, fmt)) {
+    return;
+  }
+
+  fill_random(mem, 9);
+  fill_premultiplied(pixels, 10);
+
+  overlays.setOverlay(1, 3333, 2061, 480, 64, 480 * 4, &pixels.front());
+  overlays.update();
+
+  clock_t start = clock();
+  for (int i = 0; i < num_frames; ++i) {
+    overlays.setOverlay(1, 3333, 2061, 480, 64, 480 * 4, &pixels.front());
+    overlays.update();
+    overlays.apply(frame);
+  }
+  double ms = (1000.0 * (clock() - start)) / (CLOCKS_PER_SEC * num_frames);
+
+  printf("- 4K %s, 480 x 64 watermark: %.3f ms per frame\n", screencapture_pixelformat_to_string(fmt).c_str(), ms);
+}
+
+/* ----------------------------------------------------------- */
+
+/* The reference blend of a premultiplied sample, see kernel_blend_premul_row(). */
+static int blend(int s, int d, int a) {
+  int v = d * (255 - a) + 128;
+  return std::min(255, s + ((v + (v >> 8)) >> 8));
+}
+
+/* Converts 2 x 2 pixels of one BGRA color into `fmt` and returns Y, U and V. */
+static int get_converted_color(int fmt, int flags, const uint8_t* bgra, uint8_t* yuv) {
+
+  PixelBuffer src;
+  PixelBuffer dst;
+  std::vector<uint8_t> src_mem;
+  std::vector<uint8_t> dst_mem;
+
+  if (0 != alloc_buffer(src, src_mem, 2, 2, SC_BGRA) || 0 != alloc_buffer(dst, dst_mem, 2, 2, fmt)) {
+    return -1;
+  }
+
+  for (int i = 0; i < 4; ++i) {
+    memcpy(src.plane[0] + (i / 2) * src.stride[0] + (i % 2) * 4, bgra, 4);
+  }
+
+  if (0 != screencapture_convert(src, dst, flags)) {
+    return -2;
+  }
+
+  yuv[0] = dst.plane[0][0];
+  yuv[1] = dst.plane[1][0];
+  yuv[2] = (SC_I420 == fmt) ? dst.plane[2][0] : dst.plane[1][1];
+
+  return 0;
+}
+
+/* Random BGRA with premultiplied alpha: every color channel <= alpha; a quarter of the pixels is opaque or transparent. */
+static void fill_premultiplied(std::vector<uint8_t>& pixels, unsigned int seed) {
+
+  srand(seed);
+
+  for (size_t i = 0; i < pixels.size(); i += 4) {
+    int kind = rand() % 8;
+    int a = (0 == kind) ? 0 : (1 == kind) ? 255 : rand() & 0xFF;
+    for (int c = 0; c < 3; ++c) {
+      pixels[i + c] = (uint8_t)(rand() % (a + 1));
+    }
+    pixels[i + 3] = (uint8_t)a;
+  }
+}
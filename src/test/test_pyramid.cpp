@@ -0,0 +1,245 @@
+/*
+
+  Pyramid
+  -------
+
+  Tests that every level of a pyramid is the rounded 2 x 2 mean of the
+  level above it, for packed and 4:2:0 formats with odd sizes, that
+  building the bands on multiple threads gives the same levels, the
+  sizes of the levels and the errors. Prints the time to build 3
+  levels of a 4K frame next to scaling the frame into the same sizes
+  with three scalers.
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include <screencapture/Pyramid.h>
+#include <screencapture/Scaler.h>
+#include <screencapture/Executor.h>
+#include "TestUtils.h"
+
+using namespace sc;
+
+static int check_level(PixelBuffer& src, PixelBuffer& dst);
+static int test_format(int fmt, int w, int h, int nlevels, Executor& executor);
+static int test_sizes();
+static int test_errors();
+static void benchmark();
+
+int main() {
+
+  printf("\n\ntest_pyramid\n\n");
+
+  int r = 0;
+  Executor executor;
+
+  if (0 != executor.init(4)) {
+    exit(EXIT_FAILURE);
+  }
+
+  r |= test_format(SC_BGRA, 1283, 723, 4, executor);
+  r |= test_format(SC_RGBA, 64, 64, 6, executor);
+  r |= test_format(SC_RGB24, 517, 301, 3, executor);
+  r |= test_format(SC_BGR24, 40, 9, 3, executor);
+  r |= test_format(SC_420V, 1283, 723, 4, executor);
+  r |= test_format(SC_420F, 1920, 1080, 5, executor);
+  r |= test_format(SC_I420, 641, 479, 3, executor);
+  r |= test_sizes();
+  r |= test_errors();
+
+  if (0 != r) {
+    printf("\nFAILED\n\n");
+    exit(EXIT_FAILURE);
+  }
+
+  benchmark();
+
+  printf("\nOK\n\n");
+
+  return 0;
+}
+
+/* ----------------------------------------------------------- */
+
+static int test_format(int fmt, int w, int h, int nlevels, Executor& executor) {
+
+  Pyramid serial;
+  Pyramid parallel;
+  PixelBuffer base;
+  std::vector<uint8_t> mem;
+  std::string name = screencapture_pixelformat_to_string(fmt);
+
+  if (0 != alloc_buffer(base, mem, w, h, fmt)
+      || 0 != serial.init(w, h, fmt, nlevels)
+      || 0 != parallel.init(w, h, fmt, nlevels))
+    {
+      printf("- %s: FAILED, cannot initialize.\n", name.c_str());
+      return 1;
+    }
+
+  fill_random(mem, (unsigned int)(w + fmt));
+
+  if (0 != serial.build(base) || 0 != parallel.build(base, &executor)) {
+    printf("- %s: FAILED, cannot build.\n", name.c_str());
+    return 1;
+  }
+
+  for (int i = 0; i < nlevels; ++i) {
+
+    PixelBuffer& src = (0 == i) ? base : serial.levels[i - 1];
+
+    if (i + 1 != serial.levels[i].level || 0 != check_level(src, serial.levels[i])) {
+      printf("- %s: FAILED, level %d is not the 2 x 2 mean of the level above it.\n", name.c_str(), i + 1);
+      return 1;
+    }
+
+    if (serial.pixels[i] != parallel.pixels[i]) {
+      printf("- %s: FAILED, level %d differs when we build it on multiple threads.\n", name.c_str(), i + 1);
+      return 1;
+    }
+  }
+
+  printf("- %s, %d x %d, %d levels down to %lu x %lu: OK\n", name.c_str(), w, h, nlevels, serial.levels[nlevels - 1].width, serial.levels[nlevels - 1].height);
+
+  return 0;
+}
+
+static int test_sizes() {
+
+  int w = 0;
+  int h = 0;
+  int expected[][2] = { { 1280, 720 }, { 640, 360 }, { 320, 180 }, { 160, 90 } };
+
+  for (int i = 0; i < 4; ++i) {
+    if (0 != screencapture_get_pyramid_size(2560, 1440, SC_420V, i + 1, w, h) || expected[i][0] != w || expected[i][1] != h) {
+      printf("- sizes: FAILED, level %d of 2560 x 1440 is %d x %d.\n", i + 1, w, h);
+      return 1;
+    }
+  }
+
+  /* 4:2:0 levels are rounded down to even sizes, the packed ones are not. */
+  if (0 != screencapture_get_pyramid_size(1920, 1080, SC_I420, 3, w, h) || 240 != w || 134 != h
+      || 0 != screencapture_get_pyramid_size(1920, 1080, SC_BGRA, 3, w, h) || 240 != w || 135 != h)
+    {
+      printf("- sizes: FAILED, unexpected odd level size: %d x %d.\n", w, h);
+      return 1;
+    }
+
+  printf("- sizes: OK\n");
+
+  return 0;
+}
+
+static int test_errors() {
+
+  Pyramid pyramid;
+  PixelBuffer base;
+  std::vector<uint8_t> mem;
+  int w = 0;
+  int h = 0;
+
+  if (0 == pyramid.init(640, 480, SC_P010, 1)
+      || 0 == pyramid.init(640, 480, SC_BGRA, 0)
+      || 0 == pyramid.init(640, 480, SC_BGRA, SC_PYRAMID_MAX_LEVELS + 1)
+      || 0 == pyramid.init(6, 6, SC_420V, 2)
+      || 0 == screencapture_get_pyramid_size(3, 3, SC_BGRA, 2, w, h)
+      || 0 == screencapture_can_build_pyramid(SC_L10R)
+      || 0 == pyramid.isInit())
+    {
+      printf("- errors: FAILED, invalid settings should fail.\n");
+      return 1;
+    }
+
+  if (0 != pyramid.init(640, 480, SC_BGRA, 2)
+      || 0 != pyramid.isInitFor(640, 480, SC_BGRA, 2)
+      || 0 == pyramid.isInitFor(640, 480, SC_BGRA, 3)
+      || 0 != alloc_buffer(base, mem, 640, 482, SC_BGRA)
+      || 0 == pyramid.build(base))
+    {
+      printf("- errors: FAILED, a base frame of another size should fail.\n");
+      return 1;
+    }
+
+  printf("- errors: OK\n");
+
+  return 0;
+}
+
+static void benchmark() {
+
+  Pyramid pyramid;
+  Scaler scalers[3];
+  PixelBuffer base;
+  PixelBuffer scaled[3];
+  std::vector<uint8_t> mem;
+  std::vector<uint8_t> scaled_mem[3];
+  int num_frames = 20;
+
+  if (0 != alloc_buffer(base, mem, 3840, 2160, SC_BGRA) || 0 != pyramid.init(3840, 2160, SC_BGRA, 3)) {
+    return;
+  }
+
+  for (int i = 0; i < 3; ++i) {
+    PixelBuffer& level = pyramid.levels[i];
+    if (0 != alloc_buffer(scaled[i], scaled_mem[i], (int)level.width, (int)level.height, SC_BGRA)
+        || 0 != scalers[i].init(3840, 2160, (int)level.width, (int)level.height, SC_BGRA))
+      {
+        return;
+      }
+  }
+
+  fill_random(mem, 7);
+
+  clock_t start = clock();
+  for (int k = 0; k < num_frames; ++k) {
+    pyramid.build(base);
+  }
+  double pyramid_ms = (1000.0 * (clock() - start)) / (CLOCKS_PER_SEC * num_frames);
+
+  start = clock();
+  for (int k = 0; k < num_frames; ++k) {
+    for (int i = 0; i < 3; ++i) {
+      scalers[i].scale(base, scaled[i]);
+    }
+  }
+  double scaler_ms = (1000.0 * (clock() - start)) / (CLOCKS_PER_SEC * num_frames);
+
+  printf("- 4K BGRA into 1920 x 1080, 960 x 540 and 480 x 270: pyramid %.3f ms, 3 scalers %.3f ms\n", pyramid_ms, scaler_ms);
+}
+
+/* ----------------------------------------------------------- */
+
+/* Compares every sample of `dst` with the rounded mean of the 2 x 2 samples of `src` that it covers. */
+static int check_level(PixelBuffer& src, PixelBuffer& dst) {
+
+  int bpp[3] = { 0 };
+  int num_planes = screencapture_get_plane_layout(dst.pixel_format, bpp);
+
+  for (int i = 0; i < num_planes; ++i) {
+
+    int sub = (0 == i) ? 1 : 2;
+    int w = (int)dst.width / sub;
+    int h = (int)dst.height / sub;
+
+    for (int y = 0; y < h; ++y) {
+
+      const uint8_t* s0 = src.plane[i] + 2 * y * src.stride[i];
+      const uint8_t* s1 = s0 + src.stride[i];
+      const uint8_t* d = dst.plane[i] + y * dst.stride[i];
+
+      for (int x = 0; x < w * bpp[i]; ++x) {
+        int k = (x / bpp[i]) * 2 * bpp[i] + (x % bpp[i]);
+        int mean = (s0[k] + s0[k + bpp[i]] + s1[k] + s1[k + bpp[i]] + 2) >> 2;
+        if (d[x] != mean) {
+          printf("  plane %d, row %d, byte %d: %d, expected %d.\n", i, y, x, d[x], mean);
+          return -1;
+        }
+      }
+    }
+  }
+
+  return 0;
+}
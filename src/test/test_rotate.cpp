@@ -0,0 +1,263 @@
+/*
+
+  Rotate
+  ------
+
+  Tests the rotations: every combination of SC_ROTATE_* and SC_FLIP_*
+  is compared with a per pixel reference for all supported pixel
+  formats, with odd sizes and sizes that span multiple tiles. Rotating
+  in parallel slices must give the same result. Prints the time it
+  takes to rotate a 4K BGRA frame by 90 degrees per pixel and with the
+  tiled kernels.
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include <screencapture/Rotate.h>
+#include <screencapture/Executor.h>
+#include "TestUtils.h"
+
+using namespace sc;
+
+static int get_planes(int fmt, int* bpp);
+static void reference_rotate(PixelBuffer& src, PixelBuffer& dst, int rotation);
+static int compare_buffers(PixelBuffer& a, PixelBuffer& b);
+static int test_rotate(int w, int h, int fmt, int rotation, Executor& executor);
+static void benchmark();
+
+int main() {
+
+  printf("\n\ntest_rotate\n\n");
+
+  int r = 0;
+  int formats[] = { SC_BGRA, SC_420V, SC_I420, SC_P010 };
+  int sizes[][2] = {
+    { 157, 35 },                                                  /* Odd, smaller than a tile in one direction. */
+    { 131, 70 },                                                  /* Multiple tiles, partial tiles at the end. */
+    { 8, 8 },                                                     /* Exactly one SIMD block. */
+    { 1, 5 },
+  };
+
+  Executor executor;
+  if (0 != executor.init(3)) {
+    printf("Error: failed to create the executor.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  for (int f = 0; f < 4; ++f) {
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+      for (int rotation = 0; rotation < 16; ++rotation) {
+        r |= test_rotate(sizes[s][0], sizes[s][1], formats[f], rotation, executor);
+      }
+    }
+    printf("- %s: %s\n", screencapture_pixelformat_to_string(formats[f]).c_str(), (0 == r) ? "OK" : "FAILED");
+  }
+
+  /* Invalid arguments must fail. */
+  PixelBuffer src, dst, rgb;
+  std::vector<uint8_t> src_mem, dst_mem, rgb_mem;
+
+  if (0 != alloc_buffer(src, src_mem, 16, 8, SC_BGRA)
+      || 0 != alloc_buffer(dst, dst_mem, 16, 8, SC_BGRA)
+      || 0 != alloc_buffer(rgb, rgb_mem, 16, 8, SC_RGB24))
+    {
+      exit(EXIT_FAILURE);
+    }
+
+  if (0 == screencapture_rotate(src, dst, SC_ROTATE_90)
+      || 0 == screencapture_rotate(src, dst, 16)
+      || 0 == screencapture_rotate(src, src, SC_ROTATE_180)
+      || 0 == screencapture_rotate(rgb, rgb, SC_ROTATE_180)
+      || 0 == screencapture_can_rotate(SC_RGB24))
+    {
+      printf("Error: rotating with invalid arguments should fail.\n");
+      r |= 1;
+    }
+
+  if (0 != r) {
+    printf("\nFAILED\n\n");
+    exit(EXIT_FAILURE);
+  }
+
+  benchmark();
+
+  printf("\nOK\n\n");
+
+  return 0;
+}
+
+/* ----------------------------------------------------------- */
+
+static int test_rotate(int w, int h, int fmt, int rotation, Executor& executor) {
+
+  PixelBuffer src, dst, dst_parallel, ref;
+  std::vector<uint8_t> src_mem, dst_mem, dst_parallel_mem, ref_mem;
+  int rw = 0;
+  int rh = 0;
+
+  if (0 != screencapture_get_rotated_size(rotation, w, h, rw, rh)
+      || 0 != alloc_buffer(src, src_mem, w, h, fmt)
+      || 0 != alloc_buffer(dst, dst_mem, rw, rh, fmt)
+      || 0 != alloc_buffer(dst_parallel, dst_parallel_mem, rw, rh, fmt)
+      || 0 != alloc_buffer(ref, ref_mem, rw, rh, fmt))
+    {
+      printf("Error: failed to allocate the buffers.\n");
+      return 1;
+    }
+
+  fill_random(src_mem);
+
+  if (0 != screencapture_rotate(src, dst, rotation)
+      || 0 != screencapture_rotate(src, dst_parallel, rotation, &executor))
+    {
+      printf("- %s %d x %d, rotation %d: FAILED, could not rotate.\n", screencapture_pixelformat_to_string(fmt).c_str(), w, h, rotation);
+      return 1;
+    }
+
+  reference_rotate(src, ref, rotation);
+
+  if (0 != compare_buffers(dst, ref)) {
+    printf("- %s %d x %d, rotation %d: FAILED, differs from the reference.\n", screencapture_pixelformat_to_string(fmt).c_str(), w, h, rotation);
+    return 1;
+  }
+
+  if (0 != compare_buffers(dst_parallel, ref)) {
+    printf("- %s %d x %d, rotation %d: FAILED, the parallel result differs.\n", screencapture_pixelformat_to_string(fmt).c_str(), w, h, rotation);
+    return 1;
+  }
+
+  return 0;
+}
+
+/*
+  Maps every destination sample back to its source sample by undoing
+  the flips and then the clockwise rotation.
+*/
+static void reference_rotate(PixelBuffer& src, PixelBuffer& dst, int rotation) {
+
+  int bpp[3] = { 0 };
+  int num_planes = get_planes(src.pixel_format, bpp);
+
+  for (int p = 0; p < num_planes; ++p) {
+
+    int sw = (0 == p) ? (int)src.width : ((int)src.width + 1) / 2;
+    int sh = (0 == p) ? (int)src.height : ((int)src.height + 1) / 2;
+    int dw = (0 == p) ? (int)dst.width : ((int)dst.width + 1) / 2;
+    int dh = (0 == p) ? (int)dst.height : ((int)dst.height + 1) / 2;
+
+    for (int j = 0; j < dh; ++j) {
+      for (int i = 0; i < dw; ++i) {
+
+        int x = (rotation & SC_FLIP_HORIZONTAL) ? (dw - 1 - i) : i;
+        int y = (rotation & SC_FLIP_VERTICAL) ? (dh - 1 - j) : j;
+        int sx = x;
+        int sy = y;
+
+        switch (rotation & 3) {
+          case SC_ROTATE_90: {
+            sx = y;
+            sy = sh - 1 - x;
+            break;
+          }
+          case SC_ROTATE_180: {
+            sx = sw - 1 - x;
+            sy = sh - 1 - y;
+            break;
+          }
+          case SC_ROTATE_270: {
+            sx = sw - 1 - y;
+            sy = x;
+            break;
+          }
+        }
+
+        memcpy(dst.plane[p] + j * dst.stride[p] + i * bpp[p], src.plane[p] + sy * src.stride[p] + sx * bpp[p], bpp[p]);
+      }
+    }
+  }
+}
+
+static int compare_buffers(PixelBuffer& a, PixelBuffer& b) {
+
+  int bpp[3] = { 0 };
+  int num_planes = get_planes(a.pixel_format, bpp);
+
+  for (int p = 0; p < num_planes; ++p) {
+
+    size_t w = (0 == p) ? a.width : (a.width + 1) / 2;
+    size_t h = (0 == p) ? a.height : (a.height + 1) / 2;
+
+    for (size_t j = 0; j < h; ++j) {
+      if (0 != memcmp(a.plane[p] + j * a.stride[p], b.plane[p] + j * b.stride[p], w * bpp[p])) {
+        return -1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+static void benchmark() {
+
+  PixelBuffer src, dst;
+  std::vector<uint8_t> src_mem, dst_mem;
+  int num_frames = 10;
+
+  if (0 != alloc_buffer(src, src_mem, 3840, 2160, SC_BGRA)
+      || 0 != alloc_buffer(dst, dst_mem, 2160, 3840, SC_BGRA))
+    {
+      return;
+    }
+
+  fill_random(src_mem);
+
+  clock_t start = clock();
+  for (int i = 0; i < num_frames; ++i) {
+    for (int y = 0; y < 3840; ++y) {
+      uint32_t* d = (uint32_t*)(dst.plane[0] + y * dst.stride[0]);
+      for (int x = 0; x < 2160; ++x) {
+        d[x] = *(uint32_t*)(src.plane[0] + (2159 - x) * src.stride[0] + y * 4);
+      }
+    }
+  }
+  double naive_ms = (1000.0 * (clock() - start)) / (CLOCKS_PER_SEC * num_frames);
+
+  start = clock();
+  for (int i = 0; i < num_frames; ++i) {
+    screencapture_rotate(src, dst, SC_ROTATE_90);
+  }
+  double tiled_ms = (1000.0 * (clock() - start)) / (CLOCKS_PER_SEC * num_frames);
+
+  printf("- 4K BGRA, 90 degrees: %.3f ms per pixel, %.3f ms tiled\n", naive_ms, tiled_ms);
+}
+
+/* ----------------------------------------------------------- */
+
+static int get_planes(int fmt, int* bpp) {
+
+  switch (fmt) {
+    case SC_BGRA: {
+      bpp[0] = 4;
+      return 1;
+    }
+    case SC_420V: {
+      bpp[0] = 1;
+      bpp[1] = 2;
+      return 2;
+    }
+    case SC_P010: {
+      bpp[0] = 2;
+      bpp[1] = 4;
+      return 2;
+    }
+    case SC_I420: {
+      bpp[0] = bpp[1] = bpp[2] = 1;
+      return 3;
+    }
+  }
+
+  return 0;
+}
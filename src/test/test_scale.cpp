@@ -0,0 +1,455 @@
+/*
+
+  Scale
+  -----
+
+  Tests the bilinear scaler against a plain C reference implementation;
+  the SIMD kernels must produce exactly the same output. We test down
+  and upscaling with odd sizes for all supported pixel formats and
+  print the time it takes to scale a 4K BGRA frame to 720p. Integer
+  downscales (2x, 3x, 4x) must match a plain area average. The bicubic
+  and Lanczos filters are checked against a plain C convolution with
+  the weights of the scaler; their weights must add up to one. Scaling
+  and converting BGRA into YCbCr in one pass must give the same result
+  as scaling and converting in two steps.
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include <algorithm>
+#include <screencapture/Scaler.h>
+#include <screencapture/Convert.h>
+#include "TestUtils.h"
+
+using namespace sc;
+
+static void reference_coefficients(int src_size, int dst_size, std::vector<int>& index, std::vector<int>& frac);
+static void reference_scale_plane(const uint8_t* src, size_t src_stride, int srcw, int srch, uint8_t* dst, size_t dst_stride, int dstw, int dsth, int bpp);
+static void reference_box_plane(const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride, int dstw, int dsth, int bpp, int factor);
+static void reference_filter_plane(const uint8_t* src, size_t src_stride, int srch, uint8_t* dst, size_t dst_stride, int dstw, int dsth, int bpp, ScalerFilter* fx, ScalerFilter* fy);
+static int test_scale(int srcw, int srch, int dstw, int dsth, int fmt);
+static int test_filter(int srcw, int srch, int dstw, int dsth, int fmt, int quality);
+static int test_filter_cache();
+static int test_scale_convert(int srcw, int srch, int dstw, int dsth, int fmt, int quality);
+static void benchmark_scale_convert(int srcw, int srch, int dstw, int dsth, int fmt);
+static int test_scale_convert(int srcw, int srch, int dstw, int dsth, int fmt, int quality) {
+
+  PixelBuffer src, scaled, fused, converted;
+  std::vector<uint8_t> src_mem, scaled_mem, fused_mem, converted_mem;
+  Scaler scaler;
+  int num_planes = (SC_I420 == fmt) ? 3 : 2;
+
+  if (0 != alloc_buffer(src, src_mem, srcw, srch, SC_BGRA)
+      || 0 != alloc_buffer(scaled, scaled_mem, dstw, dsth, SC_BGRA)
+      || 0 != alloc_buffer(fused, fused_mem, dstw, dsth, fmt)
+      || 0 != alloc_buffer(converted, converted_mem, dstw, dsth, fmt)
+      || 0 != scaler.init(srcw, srch, dstw, dsth, SC_BGRA, quality))
+    {
+      return 1;
+    }
+
+  fill_random(src_mem);
+
+  if (0 != scaler.scale(src, scaled)
+      || 0 != screencapture_convert(scaled, converted, SC_CONVERT_BT709)
+      || 0 != screencapture_scale_convert(scaler, src, fused, SC_CONVERT_BT709))
+    {
+      return 1;
+    }
+
+  for (int i = 0; i < num_planes; ++i) {
+    size_t nbytes = (0 == i) ? dstw : ((SC_I420 == fmt) ? (dstw + 1) / 2 : ((dstw + 1) / 2) * 2);
+    size_t nrows = (0 == i) ? dsth : (dsth + 1) / 2;
+    for (size_t j = 0; j < nrows; ++j) {
+      if (0 != memcmp(fused.plane[i] + j * fused.stride[i], converted.plane[i] + j * converted.stride[i], nbytes)) {
+        printf("- BGRA > %s %d x %d > %d x %d: FAILED, row %d of plane %d differs from scaling and converting in two steps.\n",
+               screencapture_pixelformat_to_string(fmt).c_str(), srcw, srch, dstw, dsth, (int)j, i);
+        return 1;
+      }
+    }
+  }
+
+  printf("- BGRA > %s %d x %d > %d x %d, scaled and converted in one pass: OK\n", screencapture_pixelformat_to_string(fmt).c_str(), srcw, srch, dstw, dsth);
+
+  return 0;
+}
+
+static void benchmark_scale_convert(int srcw, int srch, int dstw, int dsth, int fmt) {
+
+  PixelBuffer src, scaled, dst;
+  std::vector<uint8_t> src_mem, scaled_mem, dst_mem;
+  Scaler scaler;
+  int num_frames = 20;
+
+  if (0 != alloc_buffer(src, src_mem, srcw, srch, SC_BGRA)
+      || 0 != alloc_buffer(scaled, scaled_mem, dstw, dsth, SC_BGRA)
+      || 0 != alloc_buffer(dst, dst_mem, dstw, dsth, fmt)
+      || 0 != scaler.init(srcw, srch, dstw, dsth, SC_BGRA))
+    {
+      return;
+    }
+
+  fill_random(src_mem);
+
+  clock_t start = clock();
+  for (int i = 0; i < num_frames; ++i) {
+    scaler.scale(src, scaled);
+    screencapture_convert(scaled, dst);
+  }
+  double two_steps = (1000.0 * (clock() - start)) / (CLOCKS_PER_SEC * num_frames);
+
+  start = clock();
+  for (int i = 0; i < num_frames; ++i) {
+    screencapture_scale_convert(scaler, src, dst);
+  }
+  double one_pass = (1000.0 * (clock() - start)) / (CLOCKS_PER_SEC * num_frames);
+
+  printf("- BGRA > %s %d x %d > %d x %d: %.3f ms per frame in two steps, %.3f ms in one pass\n",
+         screencapture_pixelformat_to_string(fmt).c_str(), srcw, srch, dstw, dsth, two_steps, one_pass);
+}
+
+static void benchmark(int srcw, int srch, int dstw, int dsth, int fmt, int quality = SC_SCALE_BILINEAR);
+
+int main() {
+
+  printf("\n\ntest_scale\n\n");
+
+  int r = 0;
+  int formats[] = { SC_BGRA, SC_420V, SC_I420 };
+
+  for (int i = 0; i < 3; ++i) {
+    r |= test_scale(301, 173, 128, 77, formats[i]);
+    r |= test_scale(97, 61, 200, 131, formats[i]);
+    r |= test_scale(64, 48, 64, 48, formats[i]);
+    r |= test_scale(1, 1, 17, 9, formats[i]);
+    r |= test_scale(132, 68, 66, 34, formats[i]);
+    r |= test_scale(396, 204, 132, 68, formats[i]);
+    r |= test_scale(264, 136, 66, 34, formats[i]);
+    r |= test_scale(198, 102, 66, 34, formats[i]); /* Only the Y plane is an integer (3x) downscale. */
+  }
+
+  int qualities[] = { SC_SCALE_BICUBIC, SC_SCALE_LANCZOS3 };
+
+  for (int q = 0; q < 2; ++q) {
+    for (int i = 0; i < 3; ++i) {
+      r |= test_filter(301, 173, 128, 77, formats[i], qualities[q]);
+      r |= test_filter(97, 61, 200, 131, formats[i], qualities[q]);
+      r |= test_filter(132, 68, 66, 34, formats[i], qualities[q]);
+      r |= test_filter(3, 2, 17, 9, formats[i], qualities[q]);
+    }
+  }
+
+  r |= test_filter_cache();
+
+  int yuv_formats[] = { SC_I420, SC_420V, SC_420F };
+
+  for (int i = 0; i < 3; ++i) {
+    r |= test_scale_convert(301, 173, 128, 77, yuv_formats[i], SC_SCALE_BILINEAR);
+    r |= test_scale_convert(97, 61, 200, 131, yuv_formats[i], SC_SCALE_BILINEAR);
+    r |= test_scale_convert(264, 136, 66, 34, yuv_formats[i], SC_SCALE_BILINEAR);
+    r |= test_scale_convert(301, 173, 128, 77, yuv_formats[i], SC_SCALE_LANCZOS3);
+  }
+
+  /* Invalid input must fail. */
+  Scaler scaler;
+  if (0 == scaler.init(0, 10, 10, 10, SC_BGRA)
+      || 0 == scaler.init(10, 10, 10, 10, SC_L10R)
+      || 0 == scaler.init(10, 10, 5, 5, SC_BGRA, 100))
+    {
+    printf("Error: initializing the scaler with an invalid size or format should fail.\n");
+    r |= 1;
+  }
+
+  if (0 != r) {
+    printf("\nFAILED\n\n");
+    exit(EXIT_FAILURE);
+  }
+
+  benchmark(3840, 2160, 1280, 720, SC_BGRA);
+  benchmark(3840, 2160, 1280, 720, SC_420V);
+  benchmark(3840, 2160, 1920, 1080, SC_BGRA);
+  benchmark(3840, 2160, 1920, 1080, SC_420V);
+  benchmark(3840, 2160, 1281, 721, SC_BGRA);
+  benchmark(3840, 2160, 1920, 1080, SC_BGRA, SC_SCALE_BICUBIC);
+  benchmark(3840, 2160, 1920, 1080, SC_BGRA, SC_SCALE_LANCZOS3);
+  benchmark(3840, 2160, 1920, 1080, SC_420V, SC_SCALE_LANCZOS3);
+  benchmark_scale_convert(3840, 2160, 1920, 1080, SC_420V);
+  benchmark_scale_convert(3840, 2160, 1280, 720, SC_420V);
+  benchmark_scale_convert(3840, 2160, 1281, 721, SC_420V);
+
+  printf("\nOK\n\n");
+
+  return 0;
+}
+
+/* ----------------------------------------------------------- */
+
+static int test_scale(int srcw, int srch, int dstw, int dsth, int fmt) {
+
+  PixelBuffer src, dst;
+  std::vector<uint8_t> src_mem, dst_mem, ref;
+  Scaler scaler;
+
+  if (0 != alloc_buffer(src, src_mem, srcw, srch, fmt)
+      || 0 != alloc_buffer(dst, dst_mem, dstw, dsth, fmt))
+    {
+      return 1;
+    }
+
+  fill_random(src_mem);
+
+  if (0 != scaler.init(srcw, srch, dstw, dsth, fmt)) {
+    return 1;
+  }
+
+  if (0 != scaler.scale(src, dst)) {
+    return 1;
+  }
+
+  /* Planes: bytes per sample and whether it's a chroma plane. */
+  int num_planes = (SC_BGRA == fmt) ? 1 : ((SC_420V == fmt) ? 2 : 3);
+  int bpp[3] = { (SC_BGRA == fmt) ? 4 : 1, (SC_420V == fmt) ? 2 : 1, 1 };
+
+  for (int i = 0; i < num_planes; ++i) {
+
+    int sw = (0 == i) ? srcw : (srcw + 1) / 2;
+    int sh = (0 == i) ? srch : (srch + 1) / 2;
+    int dw = (0 == i) ? dstw : (dstw + 1) / 2;
+    int dh = (0 == i) ? dsth : (dsth + 1) / 2;
+
+    ref.assign(dw * dh * bpp[i], 0);
+
+    int factor = 0;
+    for (int f = 2; f <= 4; ++f) {
+      if (sw == dw * f && sh == dh * f) {
+        factor = f;
+      }
+    }
+
+    if (0 != factor) {
+      reference_box_plane(src.plane[i], src.stride[i], &ref.front(), dw * bpp[i], dw, dh, bpp[i], factor);
+    }
+    else {
+      reference_scale_plane(src.plane[i], src.stride[i], sw, sh, &ref.front(), dw * bpp[i], dw, dh, bpp[i]);
+    }
+
+    for (int j = 0; j < dh; ++j) {
+      if (0 != memcmp(dst.plane[i] + j * dst.stride[i], &ref[j * dw * bpp[i]], dw * bpp[i])) {
+        printf("- %s %d x %d > %d x %d: FAILED, row %d of plane %d is different.\n",
+               screencapture_pixelformat_to_string(fmt).c_str(), srcw, srch, dstw, dsth, j, i);
+        return 1;
+      }
+    }
+  }
+
+  printf("- %s %d x %d > %d x %d: OK\n", screencapture_pixelformat_to_string(fmt).c_str(), srcw, srch, dstw, dsth);
+
+  return 0;
+}
+
+static int test_filter(int srcw, int srch, int dstw, int dsth, int fmt, int quality) {
+
+  PixelBuffer src, dst;
+  std::vector<uint8_t> src_mem, dst_mem, ref;
+  Scaler scaler;
+  const char* name = (SC_SCALE_BICUBIC == quality) ? "bicubic" : "lanczos3";
+
+  if (0 != alloc_buffer(src, src_mem, srcw, srch, fmt)
+      || 0 != alloc_buffer(dst, dst_mem, dstw, dsth, fmt)
+      || 0 != scaler.init(srcw, srch, dstw, dsth, fmt, quality))
+    {
+      return 1;
+    }
+
+  fill_random(src_mem);
+
+  if (0 != scaler.scale(src, dst)) {
+    return 1;
+  }
+
+  for (int i = 0; i < scaler.num_planes; ++i) {
+
+    ScalerPlane& p = scaler.planes[i];
+    ScalerFilter* filters[2] = { p.x_filter, p.y_filter };
+
+    if (NULL == p.x_filter || NULL == p.y_filter || 0 != (p.x_filter->num_taps % 4)) {
+      printf("- %s %s %d x %d > %d x %d: FAILED, invalid filters for plane %d.\n", screencapture_pixelformat_to_string(fmt).c_str(), name, srcw, srch, dstw, dsth, i);
+      return 1;
+    }
+
+    for (int f = 0; f < 2; ++f) {
+      for (int j = 0; j < filters[f]->dst_size; ++j) {
+        int sum = 0;
+        for (int k = 0; k < filters[f]->num_taps; ++k) {
+          sum += filters[f]->weights[j * filters[f]->num_taps + k];
+        }
+        if (16384 != sum || filters[f]->offset[j] < 0 || filters[f]->offset[j] >= filters[f]->src_size) {
+          printf("- %s %s %d x %d > %d x %d: FAILED, weights of sample %d don't add up to one (%d).\n", screencapture_pixelformat_to_string(fmt).c_str(), name, srcw, srch, dstw, dsth, j, sum);
+          return 1;
+        }
+      }
+    }
+
+    ref.assign(p.dst_width * p.dst_height * p.bpp, 0);
+    reference_filter_plane(src.plane[i], src.stride[i], p.src_height, &ref.front(), p.dst_width * p.bpp, p.dst_width, p.dst_height, p.bpp, p.x_filter, p.y_filter);
+
+    for (int j = 0; j < p.dst_height; ++j) {
+      if (0 != memcmp(dst.plane[i] + j * dst.stride[i], &ref[j * p.dst_width * p.bpp], p.dst_width * p.bpp)) {
+        printf("- %s %s %d x %d > %d x %d: FAILED, row %d of plane %d is different.\n", screencapture_pixelformat_to_string(fmt).c_str(), name, srcw, srch, dstw, dsth, j, i);
+        return 1;
+      }
+    }
+  }
+
+  printf("- %s %s %d x %d > %d x %d: OK\n", screencapture_pixelformat_to_string(fmt).c_str(), name, srcw, srch, dstw, dsth);
+
+  return 0;
+}
+
+/* Re-initializing for sizes that we used before must reuse the filters. */
+static int test_filter_cache() {
+
+  Scaler scaler;
+
+  if (0 != scaler.init(640, 480, 320, 240, SC_BGRA, SC_SCALE_LANCZOS3)) {
+    return 1;
+  }
+
+  ScalerFilter* fx = scaler.planes[0].x_filter;
+
+  if (0 != scaler.init(800, 600, 320, 240, SC_BGRA, SC_SCALE_LANCZOS3)
+      || 0 != scaler.init(640, 480, 320, 240, SC_BGRA, SC_SCALE_LANCZOS3))
+    {
+      return 1;
+    }
+
+  if (fx != scaler.planes[0].x_filter || 4 != scaler.filters.size()) {
+    printf("- filter cache: FAILED, the filters were not reused.\n");
+    return 1;
+  }
+
+  printf("- filter cache: OK\n");
+
+  return 0;
+}
+
+static void benchmark(int srcw, int srch, int dstw, int dsth, int fmt, int quality) {
+
+  PixelBuffer src, dst;
+  std::vector<uint8_t> src_mem, dst_mem;
+  Scaler scaler;
+  int num_frames = 20;
+
+  if (0 != alloc_buffer(src, src_mem, srcw, srch, fmt)
+      || 0 != alloc_buffer(dst, dst_mem, dstw, dsth, fmt)
+      || 0 != scaler.init(srcw, srch, dstw, dsth, fmt, quality))
+    {
+      return;
+    }
+
+  fill_random(src_mem);
+
+  clock_t start = clock();
+  for (int i = 0; i < num_frames; ++i) {
+    scaler.scale(src, dst);
+  }
+  double ms = (1000.0 * (clock() - start)) / (CLOCKS_PER_SEC * num_frames);
+
+  const char* names[] = { "bilinear", "bicubic", "lanczos3" };
+  printf("- %s %s %d x %d > %d x %d: %.3f ms per frame\n", screencapture_pixelformat_to_string(fmt).c_str(), names[quality], srcw, srch, dstw, dsth, ms);
+}
+
+/* ----------------------------------------------------------- */
+
+/* Sample centers are aligned; 16.16 positions, 7 bit weights. */
+static void reference_coefficients(int src_size, int dst_size, std::vector<int>& index, std::vector<int>& frac) {
+
+  index.resize(dst_size);
+  frac.resize(dst_size);
+
+  for (int i = 0; i < dst_size; ++i) {
+    int fixed = std::max(0, (int)((((int64_t)(2 * i + 1) * src_size) << 16) / (2 * dst_size)) - 32768);
+    index[i] = fixed >> 16;
+    frac[i] = (fixed & 0xFFFF) >> 9;
+    if (index[i] >= src_size - 1) {
+      index[i] = src_size - 1;
+      frac[i] = 0;
+    }
+  }
+}
+
+static void reference_scale_plane(const uint8_t* src, size_t src_stride, int srcw, int srch, uint8_t* dst, size_t dst_stride, int dstw, int dsth, int bpp) {
+
+  std::vector<int> xi, xf, yi, yf;
+  reference_coefficients(srcw, dstw, xi, xf);
+  reference_coefficients(srch, dsth, yi, yf);
+
+  for (int j = 0; j < dsth; ++j) {
+
+    const uint8_t* row0 = src + yi[j] * src_stride;
+    const uint8_t* row1 = src + std::min(yi[j] + 1, srch - 1) * src_stride;
+
+    for (int i = 0; i < dstw; ++i) {
+
+      int x0 = xi[i];
+      int x1 = std::min(x0 + 1, srcw - 1);
+
+      for (int k = 0; k < bpp; ++k) {
+        int a = ((row0[x0 * bpp + k] << 7) + (row1[x0 * bpp + k] - row0[x0 * bpp + k]) * yf[j] + 64) >> 7;
+        int b = ((row0[x1 * bpp + k] << 7) + (row1[x1 * bpp + k] - row0[x1 * bpp + k]) * yf[j] + 64) >> 7;
+        dst[j * dst_stride + i * bpp + k] = ((a << 7) + (b - a) * xf[i] + 64) >> 7;
+      }
+    }
+  }
+}
+
+static void reference_box_plane(const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride, int dstw, int dsth, int bpp, int factor) {
+
+  int n = factor * factor;
+
+  for (int j = 0; j < dsth; ++j) {
+    for (int i = 0; i < dstw; ++i) {
+      for (int k = 0; k < bpp; ++k) {
+        int sum = 0;
+        for (int y = 0; y < factor; ++y) {
+          for (int x = 0; x < factor; ++x) {
+            sum += src[(j * factor + y) * src_stride + (i * factor + x) * bpp + k];
+          }
+        }
+        dst[j * dst_stride + i * bpp + k] = (sum + n / 2) / n;
+      }
+    }
+  }
+}
+
+/* Vertical pass into an 8 bit row, then the horizontal pass; like the scaler. */
+static void reference_filter_plane(const uint8_t* src, size_t src_stride, int srch, uint8_t* dst, size_t dst_stride, int dstw, int dsth, int bpp, ScalerFilter* fx, ScalerFilter* fy) {
+
+  int row_bytes = fx->src_size * bpp;
+  std::vector<uint8_t> row((fx->src_size + fx->num_taps) * bpp, 0);
+
+  for (int j = 0; j < dsth; ++j) {
+
+    for (int x = 0; x < row_bytes; ++x) {
+      int sum = 0;
+      for (int k = 0; k < fy->num_taps; ++k) {
+        int y = std::min(fy->offset[j] + k, srch - 1);
+        sum += src[y * src_stride + x] * fy->weights[j * fy->num_taps + k];
+      }
+      row[x] = std::max(0, std::min(255, (sum + 8192) >> 14));
+    }
+
+    for (int i = 0; i < dstw; ++i) {
+      for (int c = 0; c < bpp; ++c) {
+        int sum = 0;
+        for (int k = 0; k < fx->num_taps; ++k) {
+          sum += row[(fx->offset[i] + k) * bpp + c] * fx->weights[i * fx->num_taps + k];
+        }
+        dst[j * dst_stride + i * bpp + c] = std::max(0, std::min(255, (sum + 8192) >> 14));
+      }
+    }
+  }
+}
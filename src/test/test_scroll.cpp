@@ -0,0 +1,268 @@
+/*
+
+  Scroll
+  ------
+
+  Tests the scroll detector: we scroll a "window" in the middle of a
+  random frame vertically and horizontally and check that
+  every reported move copies exactly the right pixels (of all planes)
+  and that the moves cover most of the window. Static frames and
+  random changes have no moves. Prints the time it takes to detect a
+  scroll of a 4K frame.
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include <string>
+#include <screencapture/Scroll.h>
+#include "TestUtils.h"
+
+using namespace sc;
+
+static void scroll_window(PixelBuffer& prev, PixelBuffer& cur, int x0, int y0, int x1, int y1, int dx, int dy);
+static int check_moves(PixelBuffer& prev, PixelBuffer& cur, std::vector<MoveRect>& moves, int dx, int dy, int& area);
+static int test_scroll(int fmt, int dx, int dy);
+static void benchmark();
+
+int main() {
+
+  printf("\n\ntest_scroll\n\n");
+
+  int r = 0;
+  int formats[] = { SC_BGRA, SC_RGB24, SC_RGB48, SC_420V, SC_P010, SC_I420 };
+
+  for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i) {
+    r |= test_scroll(formats[i], 0, 38);
+    r |= test_scroll(formats[i], 0, -120);
+    r |= test_scroll(formats[i], 22, 0);
+    r |= test_scroll(formats[i], -64, 0);
+  }
+
+  /* Odd offsets only for the packed formats; the 4:2:0 formats can't move by half a chroma sample. */
+  r |= test_scroll(SC_BGRA, 0, 37);
+  r |= test_scroll(SC_RGB24, -21, 0);
+
+  /* Invalid arguments must fail. */
+  ScrollDetector detector;
+  PixelBuffer frame;
+  std::vector<uint8_t> mem;
+  std::vector<MoveRect> moves;
+
+  if (0 != alloc_buffer(frame, mem, 32, 32, SC_BGRA)) {
+    exit(EXIT_FAILURE);
+  }
+
+  if (0 == detector.update(frame, moves)
+      || 0 == detector.init(32, 32, SC_BGRA, 15)
+      || 0 == detector.init(0, 32, SC_BGRA)
+      || 0 == detector.init(32, 32, SC_NONE)
+      || 0 != detector.init(32, 30, SC_BGRA)
+      || 0 == detector.update(frame, moves)
+      || 0 != detector.isInitFor(32, 30, SC_BGRA)
+      || 0 == detector.isInitFor(32, 30, SC_BGRA, 32))
+    {
+      printf("Error: detecting with invalid arguments should fail.\n");
+      r |= 1;
+    }
+
+  if (0 != r) {
+    printf("\nFAILED\n\n");
+    exit(EXIT_FAILURE);
+  }
+
+  benchmark();
+
+  printf("\nOK\n\n");
+
+  return 0;
+}
+
+/* ----------------------------------------------------------- */
+
+static int test_scroll(int fmt, int dx, int dy) {
+
+  int w = 640;
+  int h = 480;
+  PixelBuffer prev;
+  PixelBuffer cur;
+  std::vector<uint8_t> prev_mem;
+  std::vector<uint8_t> cur_mem;
+  std::vector<MoveRect> moves;
+  ScrollDetector detector;
+  std::string fmt_name = screencapture_pixelformat_to_string(fmt);
+  int area = 0;
+  int num_moves = 0;
+
+  if (0 != alloc_buffer(prev, prev_mem, w, h, fmt)
+      || 0 != alloc_buffer(cur, cur_mem, w, h, fmt)
+      || 0 != detector.init(w, h, fmt))
+    {
+      return 1;
+    }
+
+  fill_random(prev_mem, 1);
+
+  /* Nothing moved in the first and in a static frame. */
+  if (0 != detector.update(prev, moves) || 0 != moves.size()
+      || 0 != detector.update(prev, moves) || 0 != moves.size())
+    {
+      printf("- %s: FAILED, a static frame should have no moves.\n", fmt_name.c_str());
+      return 1;
+    }
+
+  /* The window covers 6 strips (and bands) completely. */
+  scroll_window(prev, cur, 100, 60, 540, 460, dx, dy);
+
+  if (0 != detector.update(cur, moves) || 0 != check_moves(prev, cur, moves, dx, dy, area)) {
+    printf("- %s, %d, %d: FAILED, the moves don't copy the right pixels.\n", fmt_name.c_str(), dx, dy);
+    return 1;
+  }
+
+  int expected = (0 != dy) ? 6 * 64 * (400 - abs(dy)) : 6 * 64 * (440 - abs(dx));
+
+  if (area < expected) {
+    printf("- %s, %d, %d: FAILED, the moves cover %d pixels, expected at least %d.\n", fmt_name.c_str(), dx, dy, area, expected);
+    return 1;
+  }
+
+  num_moves = (int)moves.size();
+
+  /* Random changes don't move. */
+  fill_random(prev_mem, 2);
+
+  if (0 != detector.update(prev, moves) || 0 != moves.size()) {
+    printf("- %s: FAILED, random changes should have no moves.\n", fmt_name.c_str());
+    return 1;
+  }
+
+  printf("- %s, %d, %d: OK, %d moves\n", fmt_name.c_str(), dx, dy, num_moves);
+
+  return 0;
+}
+
+static void benchmark() {
+
+  PixelBuffer prev;
+  PixelBuffer cur;
+  ScrollDetector detector;
+  std::vector<uint8_t> prev_mem;
+  std::vector<uint8_t> cur_mem;
+  std::vector<MoveRect> moves;
+  int num_frames = 10;
+
+  if (0 != alloc_buffer(prev, prev_mem, 3840, 2160, SC_BGRA)
+      || 0 != alloc_buffer(cur, cur_mem, 3840, 2160, SC_BGRA)
+      || 0 != detector.init(3840, 2160, SC_BGRA))
+    {
+      return;
+    }
+
+  fill_random(prev_mem, 3);
+  scroll_window(prev, cur, 400, 200, 3400, 2000, 0, 50);
+
+  clock_t start = clock();
+  for (int i = 0; i < num_frames; ++i) {
+    detector.update(prev, moves);
+  }
+  double static_ms = (1000.0 * (clock() - start)) / (CLOCKS_PER_SEC * num_frames);
+
+  start = clock();
+  for (int i = 0; i < num_frames; ++i) {
+    detector.update((0 == (i & 1)) ? cur : prev, moves);
+  }
+  double scroll_ms = (1000.0 * (clock() - start)) / (CLOCKS_PER_SEC * num_frames);
+
+  printf("- 4K BGRA: %.3f ms for a static frame, %.3f ms for a scrolled frame\n", static_ms, scroll_ms);
+}
+
+/* ----------------------------------------------------------- */
+
+/*
+  Copies `prev` into `cur` and scrolls the content of the window
+  [x0, x1) x [y0, y1) by `dx`, `dy`: the pixel at x, y of `cur` is the
+  pixel at x - dx, y - dy of `prev`. The part of the window that
+  scrolls in gets new random pixels.
+*/
+static void scroll_window(PixelBuffer& prev, PixelBuffer& cur, int x0, int y0, int x1, int y1, int dx, int dy) {
+
+  int layout[3] = { 0 };
+  int num_planes = screencapture_get_plane_layout(prev.pixel_format, layout);
+
+  srand(4321);
+
+  for (int i = 0; i < num_planes; ++i) {
+
+    int sub = (0 == i) ? 1 : 2;
+    int rows = ((int)prev.height + sub - 1) / sub;
+    int bpp = layout[i];
+
+    memcpy(cur.plane[i], prev.plane[i], prev.stride[i] * rows);
+
+    for (int y = y0 / sub; y < y1 / sub; ++y) {
+      for (int x = x0 / sub; x < x1 / sub; ++x) {
+
+        int sx = x - dx / sub;
+        int sy = y - dy / sub;
+        uint8_t* dst = cur.plane[i] + y * cur.stride[i] + x * bpp;
+
+        for (int k = 0; k < bpp; ++k) {
+          if (sx >= x0 / sub && sx < x1 / sub && sy >= y0 / sub && sy < y1 / sub) {
+            dst[k] = prev.plane[i][sy * prev.stride[i] + sx * bpp + k];
+          }
+          else {
+            dst[k] = rand() & 0xFF;
+          }
+        }
+      }
+    }
+  }
+}
+
+/* Returns 0 when every move has the offset `dx`, `dy` and copies the right pixels of all planes; `area` is the number of pixels that the moves cover. */
+static int check_moves(PixelBuffer& prev, PixelBuffer& cur, std::vector<MoveRect>& moves, int dx, int dy, int& area) {
+
+  int layout[3] = { 0 };
+  int num_planes = screencapture_get_plane_layout(prev.pixel_format, layout);
+
+  area = 0;
+
+  for (size_t j = 0; j < moves.size(); ++j) {
+
+    MoveRect& m = moves[j];
+
+    if (m.x - m.src_x != dx || m.y - m.src_y != dy) {
+      printf("Error: unexpected move from %d, %d to %d, %d.\n", m.src_x, m.src_y, m.x, m.y);
+      return -1;
+    }
+
+    if (0 > m.src_x || 0 > m.src_y || 0 > m.x || 0 > m.y
+        || m.src_x + m.width > (int)prev.width || m.x + m.width > (int)prev.width
+        || m.src_y + m.height > (int)prev.height || m.y + m.height > (int)prev.height)
+      {
+        printf("Error: the move %d, %d, %d x %d is outside the frame.\n", m.x, m.y, m.width, m.height);
+        return -2;
+      }
+
+    for (int i = 0; i < num_planes; ++i) {
+
+      int sub = (0 == i) ? 1 : 2;
+      int nbytes = ((m.width + sub - 1) / sub) * layout[i];
+
+      for (int y = 0; y < (m.height + sub - 1) / sub; ++y) {
+        uint8_t* src = prev.plane[i] + (m.src_y / sub + y) * prev.stride[i] + (m.src_x / sub) * layout[i];
+        uint8_t* dst = cur.plane[i] + (m.y / sub + y) * cur.stride[i] + (m.x / sub) * layout[i];
+        if (0 != memcmp(src, dst, nbytes)) {
+          printf("Error: the move %d, %d, %d x %d copies the wrong pixels of plane %d.\n", m.x, m.y, m.width, m.height, i);
+          return -3;
+        }
+      }
+    }
+
+    area += m.width * m.height;
+  }
+
+  return 0;
+}
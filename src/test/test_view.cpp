@@ -0,0 +1,247 @@
+/*
+
+  View
+  ----
+
+  Tests the zero copy views of pixel buffers: the planes of a view must
+  point into the parent for every pixel format, converting a view must
+  give the same result as converting the same rectangle of a copied
+  frame, invalid rectangles must fail and views don't own or touch
+  their parent, also across copies and views of views.
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <screencapture/Types.h>
+#include <screencapture/Convert.h>
+#include "TestUtils.h"
+
+using namespace sc;
+
+static int test_planes(int fmt, int num_planes, const int* bpp);
+static int test_convert_view(int from, int to);
+static int test_lifetime();
+
+int main() {
+
+  printf("\n\ntest_view\n\n");
+
+  int r = 0;
+
+  const int bpp_bgra[] = { 4 };
+  const int bpp_rgb24[] = { 3 };
+  const int bpp_rgb48[] = { 6 };
+  const int bpp_nv12[] = { 1, 2 };
+  const int bpp_p010[] = { 2, 4 };
+  const int bpp_i420[] = { 1, 1, 1 };
+
+  r |= test_planes(SC_BGRA, 1, bpp_bgra);
+  r |= test_planes(SC_RGBA, 1, bpp_bgra);
+  r |= test_planes(SC_L10R, 1, bpp_bgra);
+  r |= test_planes(SC_RGB24, 1, bpp_rgb24);
+  r |= test_planes(SC_BGR24, 1, bpp_rgb24);
+  r |= test_planes(SC_RGB48, 1, bpp_rgb48);
+  r |= test_planes(SC_420V, 2, bpp_nv12);
+  r |= test_planes(SC_420F, 2, bpp_nv12);
+  r |= test_planes(SC_P010, 2, bpp_p010);
+  r |= test_planes(SC_I420, 3, bpp_i420);
+
+  r |= test_convert_view(SC_BGRA, SC_I420);
+  r |= test_convert_view(SC_420V, SC_BGRA);
+  r |= test_convert_view(SC_I420, SC_420V);
+
+  r |= test_lifetime();
+
+  if (0 != r) {
+    printf("\nFAILED\n\n");
+    exit(EXIT_FAILURE);
+  }
+
+  printf("\nOK\n\n");
+
+  return 0;
+}
+
+/* ----------------------------------------------------------- */
+
+/* Checks the planes and size of views at a few positions and that invalid rectangles fail. */
+static int test_planes(int fmt, int num_planes, const int* bpp) {
+
+  PixelBuffer buf;
+  std::vector<uint8_t> mem;
+  int rects[][4] = {
+    { 0, 0, 173, 97 },
+    { 10, 4, 31, 17 },
+    { 172, 96, 1, 1 },
+  };
+
+  if (0 != alloc_buffer(buf, mem, 173, 97, fmt)) {
+    return 1;
+  }
+
+  for (size_t k = 0; k < sizeof(rects) / sizeof(rects[0]); ++k) {
+
+    PixelBuffer view;
+    int x = rects[k][0];
+    int y = rects[k][1];
+
+    if (1 < num_planes && 2 == k) {
+      x = 170;
+      y = 94;
+    }
+
+    if (0 != buf.getView(x, y, rects[k][2], rects[k][3], view)) {
+      printf("- %s: FAILED, could not create a view at %d, %d.\n", screencapture_pixelformat_to_string(fmt).c_str(), x, y);
+      return 1;
+    }
+
+    if (view.width != (size_t)rects[k][2] || view.height != (size_t)rects[k][3] || view.pixel_format != fmt || view.parent != &buf) {
+      printf("- %s: FAILED, the view has the wrong size, format or parent.\n", screencapture_pixelformat_to_string(fmt).c_str());
+      return 1;
+    }
+
+    for (int i = 0; i < num_planes; ++i) {
+      int col = (0 == i) ? x : x / 2;
+      int row = (0 == i) ? y : y / 2;
+      if (view.plane[i] != buf.plane[i] + row * buf.stride[i] + col * bpp[i] || view.stride[i] != buf.stride[i]) {
+        printf("- %s: FAILED, plane %d of the view doesn't point into the parent.\n", screencapture_pixelformat_to_string(fmt).c_str(), i);
+        return 1;
+      }
+    }
+  }
+
+  PixelBuffer invalid;
+
+  if (0 == buf.getView(-1, 0, 4, 4, invalid)
+      || 0 == buf.getView(0, 0, 174, 4, invalid)
+      || 0 == buf.getView(0, 90, 4, 8, invalid)
+      || 0 == buf.getView(0, 0, 0, 4, invalid)
+      || 0 == buf.getView(0, 0, 4, 4, buf)
+      || (1 < num_planes && 0 == buf.getView(1, 0, 4, 4, invalid))
+      || (1 < num_planes && 0 == buf.getView(0, 3, 4, 4, invalid)))
+    {
+      printf("- %s: FAILED, creating an invalid view should fail.\n", screencapture_pixelformat_to_string(fmt).c_str());
+      return 1;
+    }
+
+  printf("- %s views: OK\n", screencapture_pixelformat_to_string(fmt).c_str());
+
+  return 0;
+}
+
+/* Converting a view must give the same pixels as copying the rectangle into a buffer of its own and converting that. */
+static int test_convert_view(int from, int to) {
+
+  int x = 18;
+  int y = 6;
+  int w = 61;
+  int h = 33;
+
+  PixelBuffer frame, view, copy, dst_view, dst_copy;
+  std::vector<uint8_t> frame_mem, copy_mem, dst_view_mem, dst_copy_mem;
+
+  if (0 != alloc_buffer(frame, frame_mem, 160, 90, from)
+      || 0 != alloc_buffer(copy, copy_mem, w, h, from)
+      || 0 != alloc_buffer(dst_view, dst_view_mem, w, h, to)
+      || 0 != alloc_buffer(dst_copy, dst_copy_mem, w, h, to))
+    {
+      return 1;
+    }
+
+  fill_random(frame_mem);
+
+  if (0 != frame.getView(x, y, w, h, view)) {
+    return 1;
+  }
+
+  /* Copy the rectangle, plane by plane. */
+  int num_planes = (SC_BGRA == from) ? 1 : ((SC_I420 == from) ? 3 : 2);
+
+  for (int i = 0; i < num_planes; ++i) {
+    size_t rows = (0 == i) ? h : (h + 1) / 2;
+    size_t nbytes = (0 == i) ? ((SC_BGRA == from) ? w * 4 : w) : ((SC_I420 == from) ? (w + 1) / 2 : ((w + 1) / 2) * 2);
+    for (size_t j = 0; j < rows; ++j) {
+      memcpy(copy.plane[i] + j * copy.stride[i], view.plane[i] + j * view.stride[i], nbytes);
+    }
+  }
+
+  if (0 != screencapture_convert(view, dst_view) || 0 != screencapture_convert(copy, dst_copy)) {
+    printf("- %s > %s view: FAILED, could not convert.\n",
+           screencapture_pixelformat_to_string(from).c_str(),
+           screencapture_pixelformat_to_string(to).c_str());
+    return 1;
+  }
+
+  if (dst_view_mem != dst_copy_mem) {
+    printf("- %s > %s view: FAILED, differs from converting a copy.\n",
+           screencapture_pixelformat_to_string(from).c_str(),
+           screencapture_pixelformat_to_string(to).c_str());
+    return 1;
+  }
+
+  printf("- %s > %s view: OK\n", screencapture_pixelformat_to_string(from).c_str(), screencapture_pixelformat_to_string(to).c_str());
+
+  return 0;
+}
+
+/* Views are non owning: a view of a view points into the parent and a view may outlive its parent. */
+static int test_lifetime() {
+
+  PixelBuffer* frame = new PixelBuffer();
+  PixelBuffer view;
+  PixelBuffer nested;
+  std::vector<uint8_t> mem;
+
+  if (0 != alloc_buffer(*frame, mem, 64, 32, SC_420V)) {
+    delete frame;
+    return 1;
+  }
+
+  if (0 != frame->getView(8, 4, 32, 16, view)
+      || 0 != view.getView(2, 2, 8, 8, nested))
+    {
+      printf("- lifetime: FAILED, could not create the views.\n");
+      delete frame;
+      return 1;
+    }
+
+  if (frame != nested.parent || nested.plane[0] != frame->plane[0] + 6 * frame->stride[0] + 10) {
+    printf("- lifetime: FAILED, a view of a view should be a view of the parent.\n");
+    delete frame;
+    return 1;
+  }
+
+  {
+    PixelBuffer copy = view;
+    PixelBuffer assigned;
+    assigned = nested;
+    if (frame != copy.parent || frame != assigned.parent) {
+      printf("- lifetime: FAILED, copies of views should be views of the same parent.\n");
+      delete frame;
+      return 1;
+    }
+  }
+
+  /* The parent doesn't track its views, so it can change its planes; the views keep pointing into `mem`. */
+  if (0 != frame->init(32, 32, SC_420V) || 0 != frame->setPlanes(&mem.front())) {
+    printf("- lifetime: FAILED, a buffer with views should be able to change its planes.\n");
+    delete frame;
+    return 1;
+  }
+
+  /* Destroying the parent first must not touch it when the views are destroyed; see ASan. */
+  delete frame;
+  frame = NULL;
+
+  /* A view that we initialize is not a view anymore. */
+  if (0 != nested.init(8, 8, SC_BGRA) || NULL != nested.parent) {
+    printf("- lifetime: FAILED, initializing a view should detach it.\n");
+    return 1;
+  }
+
+  printf("- lifetime: OK\n");
+
+  return 0;
+}
@@ -1,12 +1,15 @@
 #include <sstream> 
+#include <algorithm>
 #include <screencapture/win/ScreenCaptureDuplicateOutputDirect3D11.h>
 #include <screencapture/win/ScreenCaptureUtilsDirect3D11.h>
+#include <screencapture/Cursor.h>
 
 namespace sc {
 
   /* ----------------------------------------------------------- */
   
   void on_scaled_pixels(uint8_t* pixels, int stride, int width, int height, void* user);
+  static uint64_t qpc_to_ns(LARGE_INTEGER t);
   
   /* ----------------------------------------------------------- */
   
@@ -18,6 +21,13 @@ namespace sc {
     ,output(NULL)
     ,duplication(NULL)
     ,frame(NULL)
+    ,pointer_x(0)
+    ,pointer_y(0)
+    ,pointer_width(0)
+    ,pointer_height(0)
+    ,pointer_hotspot_x(0)
+    ,pointer_hotspot_y(0)
+    ,pointer_visible(0)
   {
     ZeroMemory(&output_desc, sizeof(output_desc));
     ZeroMemory(&frame_info, sizeof(frame_info));
@@ -150,6 +160,21 @@ namespace sc {
         return -12;
       }
 
+      /*
+         The duplicated desktop image is in the orientation of the
+         monitor's scan out, not the orientation of the desktop. Like
+         the DXGI desktop duplication sample and libwebrtc we treat
+         DXGI_MODE_ROTATION_ROTATE90 as "rotate the image 90 degrees
+         clockwise to get the desktop", which is SC_ROTATE_90 (clockwise)
+         here; ROTATE270 is the 90 degrees counter clockwise rotation.
+      */
+      switch (desc.Rotation) {
+        case DXGI_MODE_ROTATION_ROTATE90:  { display->rotation = SC_ROTATE_90;  break; }
+        case DXGI_MODE_ROTATION_ROTATE180: { display->rotation = SC_ROTATE_180; break; }
+        case DXGI_MODE_ROTATION_ROTATE270: { display->rotation = SC_ROTATE_270; break; }
+        default:                           { display->rotation = SC_ROTATE_0;   break; }
+      }
+
       display->info = (void*)output;
       displays.push_back(display);
     }
@@ -271,13 +296,36 @@ namespace sc {
       duplication = NULL;
     }
 
-    if (0 != pixel_buffer.init(cfg.output_width, cfg.output_height, cfg.pixel_format)) {
+    /*
+      The renderer scales with a linear sampler. For the higher quality
+      filters we capture at the size of the desktop and let ScreenCapture
+      scale the frames with the (cached) CPU filters, see Scaler.h.
+    */
+    int capture_width = cfg.output_width;
+    int capture_height = cfg.output_height;
+
+    if (SC_SCALE_BILINEAR != cfg.scale_quality && NULL != displays[cfg.display]->info) {
+      DXGI_OUTPUT_DESC desktop_desc;
+      IDXGIOutput* desktop = static_cast<IDXGIOutput*>(displays[cfg.display]->info);
+      if (S_OK == desktop->GetDesc(&desktop_desc)) {
+        capture_width = desktop_desc.DesktopCoordinates.right - desktop_desc.DesktopCoordinates.left;
+        capture_height = desktop_desc.DesktopCoordinates.bottom - desktop_desc.DesktopCoordinates.top;
+      }
+    }
+
+    /* The output size is upright; the frames of a monitor rotated by 90 or 270 degrees are not, ScreenCapture rotates them. */
+    if (displays[cfg.display]->rotation & 1) {
+      std::swap(capture_width, capture_height);
+    }
+
+    if (0 != pixel_buffer.init(capture_width, capture_height, cfg.pixel_format)) {
       printf("Error: failed to initialize the pixel buffer.");
       return -4;
     }
     
     /* @todo > WE DON'T WANT TO MAKE THIS THE RESPONSIBILITY OF AN IMPLEMENTATION! */
     pixel_buffer.user = user;
+    pixel_buffer.info = &metadata;
     
     /*
       When the renderer is already initialized, we first deallocate/release
@@ -291,8 +339,8 @@ namespace sc {
     ScreenCaptureRendererSettingsDirect3D11 trans_cfg;
     trans_cfg.device = device;
     trans_cfg.context = context;
-    trans_cfg.output_width = cfg.output_width;
-    trans_cfg.output_height = cfg.output_height;
+    trans_cfg.output_width = capture_width;
+    trans_cfg.output_height = capture_height;
     trans_cfg.cb_scaled = on_scaled_pixels;
     trans_cfg.cb_user = this;
     
@@ -412,7 +460,17 @@ namespace sc {
       hr = frame->QueryInterface(__uuidof(ID3D11Texture2D), (void**)&frame_tex);
       
       if (S_OK == hr) {
+        /* Neither the desktop nor the pointer changed; otherwise the content may still be the same, e.g. when an application presents the same image again. */
+        pixel_buffer.damage = (0 == frame_info.LastPresentTime.QuadPart && 0 == frame_info.LastMouseUpdateTime.QuadPart) ? SC_DAMAGE_NONE : SC_DAMAGE_UNKNOWN;
+
+        DirtyRect prev_pointer;
+        prev_pointer.x = pointer_x;
+        prev_pointer.y = pointer_y;
+        prev_pointer.width = pointer_width;
+        prev_pointer.height = pointer_height;
+
         updateMouse(&frame_info);
+        updateMetadata(frame_tex, prev_pointer);
         renderer.scale(frame_tex);
       }
     }
@@ -448,10 +506,10 @@ namespace sc {
     This function will extract the necessary information that is needed to draw the
     mouse pointer into the captured frame. We extract:
     - position
-    - pixels (we convert monochrome pointers to BGRA).
+    - pixels (we convert monochrome pointers to BGRA and cache the
+      decoded shapes, see Cursor.h).
     
-    @todo: - Use pitch when iterating over pixels
-           - This code has a simplyfied version which may be interesting https://gist.github.com/roxlu/78e9d5e1f34480923d0a
+    @todo: - This code has a simplyfied version which may be interesting https://gist.github.com/roxlu/78e9d5e1f34480923d0a
 
   */
   int ScreenCaptureDuplicateOutputDirect3D11::updateMouse(DXGI_OUTDUPL_FRAME_INFO* info) {
@@ -459,8 +517,10 @@ namespace sc {
     HRESULT hr = S_OK;
     UINT required_size = 0;
     DXGI_OUTDUPL_POINTER_SHAPE_INFO pointer_info;
-    int img_width = 0;
+    CursorCacheEntry* shape = NULL;
+    int shape_type = SC_CURSOR_NONE;
     int img_height = 0;
+    int r = 0;
     
     if (NULL == info) {
       printf("Error: requested to update the mouse info but the given info pointer is NULL.\n");
@@ -473,6 +533,10 @@ namespace sc {
 
     renderer.updatePointerPosition(info->PointerPosition.Position.x, info->PointerPosition.Position.y);
 
+    pointer_x = info->PointerPosition.Position.x;
+    pointer_y = info->PointerPosition.Position.y;
+    pointer_visible = (TRUE == info->PointerPosition.Visible) ? 1 : 0;
+
     /* A non-zero value indicates a new pointer shape. */
     if (0ull != info->PointerShapeBufferSize) {
 
@@ -487,115 +551,48 @@ namespace sc {
         return -2;
       }
 
-      size_t needed_size = pointer_info.Width * pointer_info.Height * 4;
-      if (pointer_out_pixels.capacity() < needed_size) {
-        pointer_out_pixels.resize(needed_size);
-      }
-
       if (DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MONOCHROME == pointer_info.Type) {
-
-        int xor_offset = pointer_info.Pitch * (pointer_info.Height / 2);
-        uint8_t* and_map = &pointer_in_pixels.front();
-        uint8_t* xor_map = &pointer_in_pixels.front() + xor_offset;
-        uint8_t* out_pixels = &pointer_out_pixels.front();
-        int width_in_bytes = (pointer_info.Width + 7) / 8;
-
+        /* The AND mask is followed by the XOR mask; the height includes both. */
+        shape_type = SC_CURSOR_MONOCHROME;
         img_height = pointer_info.Height / 2;
-        img_width = pointer_info.Width;
-
-        for (int j = 0; j < img_height ; ++j) {
-          
-          uint8_t bit = 0x80;
-
-          for (int i = 0; i < pointer_info.Width; ++i) {
-            
-            uint8_t and_byte = and_map[ j * width_in_bytes + i / 8 ];
-            uint8_t xor_byte = xor_map[ j * width_in_bytes + i / 8 ];
-            uint8_t and_bit = (and_byte & bit) ? 1 : 0;
-            uint8_t xor_bit = (xor_byte & bit) ? 1 : 0;
-            int out_dx = j * pointer_info.Width * 4 + i * 4;
-            
-            if (0 == and_bit) {
-              if (0 == xor_bit) {
-                /* 0 - 0 = black */
-                out_pixels[out_dx + 0] = 0x00;
-                out_pixels[out_dx + 1] = 0x00;
-                out_pixels[out_dx + 2] = 0x00;
-                out_pixels[out_dx + 3] = 0xFF;
-              }
-              else {
-                /* 0 - 1 = white */
-                out_pixels[out_dx + 0] = 0xFF;
-                out_pixels[out_dx + 1] = 0xFF;
-                out_pixels[out_dx + 2] = 0xFF;
-                out_pixels[out_dx + 3] = 0xFF;
-              }
-            }
-            else {
-              if (0 == xor_bit) {
-                /* 1 - 0 = transparent (screen). */
-                out_pixels[out_dx + 0] = 0x00;
-                out_pixels[out_dx + 1] = 0x00;
-                out_pixels[out_dx + 2] = 0x00;
-                out_pixels[out_dx + 3] = 0x00;
-              }
-              else {
-                /* 1 - 1 = reverse, black. */
-                out_pixels[out_dx + 0] = 0x00;
-                out_pixels[out_dx + 1] = 0x00;
-                out_pixels[out_dx + 2] = 0x00;
-                out_pixels[out_dx + 3] = 0xFF;
-              }
-            }
-            
-            if (0x01 == bit) {
-              bit = 0x80;
-            }
-            else {
-              bit = bit >> 1;
-            }
-          } /* cols */
-        } /* rows */
       }
-      else if (DXGI_OUTDUPL_POINTER_SHAPE_TYPE_COLOR == pointer_info.Type
-               || DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MASKED_COLOR == pointer_info.Type)
-        {
-          img_width = pointer_info.Width;
-          img_height = pointer_info.Height;
-#if 0
-          uint32_t* pointer_in_pixels32 = (uint32_t*)(&pointer_in_pixels.front());
-          uint32_t* pointer_out_pixels32 = (uint32_t*)(&pointer_out_pixels.front());
-
-          for (int j = 0; j < pointer_info.Height; ++j) {
-            for (int i = 0; i < pointer_info.Width; ++i) {
-
-              uint32_t mask = 0xFF000000 & pointer_in_pixels32[i + j * (pointer_info.Pitch / sizeof(uint32_t))];
-            
-              if (0 != mask) {
-                /* This is where we should XOR with screen pixels. */
-                pointer_out_pixels32[j * pointer_info.Width + i] =  pointer_in_pixels32[i + j * (pointer_info.Pitch / sizeof(uint32_t))]; //| 0xFF000000;
-              }
-              else { 
-                /* Similar as '0 != mask' as we don't have screen pixels. */
-                pointer_out_pixels32[j * pointer_info.Width + i] =  pointer_in_pixels32[i + j * (pointer_info.Pitch / sizeof(uint32_t))]; // | 0xFF000000;
-              }
-            }
-          }
-#else
-          uint8_t* out = &pointer_out_pixels.front();
-          uint8_t* in = &pointer_in_pixels.front();
-
-          for (int j = 0; j < pointer_info.Height; ++j) {
-            memcpy((char*)out + j * pointer_info.Pitch, in + j * pointer_info.Pitch, pointer_info.Pitch);
-          }
-#endif          
+      else if (DXGI_OUTDUPL_POINTER_SHAPE_TYPE_COLOR == pointer_info.Type) {
+        shape_type = SC_CURSOR_COLOR;
+        img_height = pointer_info.Height;
+      }
+      else if (DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MASKED_COLOR == pointer_info.Type) {
+        shape_type = SC_CURSOR_MASKED_COLOR;
+        img_height = pointer_info.Height;
       }
       else {
         printf("Error: unsupported pointer type: %02X\n", pointer_info.Type);
         exit(EXIT_FAILURE);
       }
 
-      if (0 != renderer.updatePointerPixels(img_width, img_height, &pointer_out_pixels.front())) {
+      /* Applications flip between a few shapes; only decode and upload the ones we didn't see recently. */
+      r = pointer_cache.get(shape_type,
+                            pointer_info.Width,
+                            img_height,
+                            pointer_info.Pitch,
+                            &pointer_in_pixels.front(),
+                            pointer_info.HotSpot.x,
+                            pointer_info.HotSpot.y,
+                            &shape);
+      if (0 > r) {
+        printf("Error: failed to decode the pointer shape.\n");
+        return -3;
+      }
+
+      pointer_width = shape->cursor.width;
+      pointer_height = shape->cursor.height;
+      pointer_hotspot_x = shape->cursor.hotspot_x;
+      pointer_hotspot_y = shape->cursor.hotspot_y;
+
+      if (0 == r && 0 == renderer.selectPointer(shape->id)) {
+        return 0;
+      }
+
+      if (0 != renderer.updatePointerPixels(shape->cursor.width, shape->cursor.height, &shape->bgra.front(), shape->id)) {
         printf("Error: failed to update the pointer pixels.\n");
         return -2;
       }
@@ -605,6 +602,117 @@ namespace sc {
     return 0;
   }
 
+  /*
+    The rects are in the pixels of the desktop image; we map them into
+    the letterboxed rect that the renderer scales the image into. The
+    renderer draws the pointer into the frame, so when the pointer
+    moved or changed shape we add its old and new area to the dirty
+    rects. DXGI moves only describe the desktop: a move from or into
+    the pointer would copy or overwrite the drawn pointer, so we turn
+    those into dirty rects and add the pointer areas too. When the desktop image changed but there are no rects (this
+    happens when the metadata didn't fit), we don't know what changed.
+  */
+  void ScreenCaptureDuplicateOutputDirect3D11::updateMetadata(ID3D11Texture2D* tex, DirtyRect& prev_pointer) {
+
+    HRESULT hr = S_OK;
+    UINT move_bytes = 0;
+    UINT dirty_bytes = 0;
+    D3D11_TEXTURE2D_DESC desc;
+
+    metadata.reset();
+    metadata.capture_time = screencapture_get_time_ns();
+
+    if (0 != frame_info.LastPresentTime.QuadPart) {
+      metadata.present_time = qpc_to_ns(frame_info.LastPresentTime);
+    }
+
+    /* DXGI gives the top left of the shape, FrameInfo wants the hotspot; fit() below maps it like the rects. */
+    if (0 != pointer_width) {
+      metadata.flags |= SC_FRAME_HAS_CURSOR;
+      metadata.cursor_x = pointer_x + pointer_hotspot_x;
+      metadata.cursor_y = pointer_y + pointer_hotspot_y;
+      metadata.cursor_visible = pointer_visible;
+    }
+
+    if (0 != frame_info.TotalMetadataBufferSize) {
+
+      metadata_buffer.resize(frame_info.TotalMetadataBufferSize);
+
+      hr = duplication->GetFrameMoveRects(frame_info.TotalMetadataBufferSize, (DXGI_OUTDUPL_MOVE_RECT*)&metadata_buffer.front(), &move_bytes);
+      if (S_OK == hr) {
+        hr = duplication->GetFrameDirtyRects(frame_info.TotalMetadataBufferSize - move_bytes, (RECT*)(&metadata_buffer.front() + move_bytes), &dirty_bytes);
+      }
+
+      if (S_OK != hr) {
+        printf("Error: failed to retrieve the dirty and move rects of the frame.\n");
+        return;
+      }
+
+      DXGI_OUTDUPL_MOVE_RECT* moves = (DXGI_OUTDUPL_MOVE_RECT*)&metadata_buffer.front();
+      RECT* dirty = (RECT*)(&metadata_buffer.front() + move_bytes);
+
+      for (UINT i = 0; i < move_bytes / sizeof(DXGI_OUTDUPL_MOVE_RECT); ++i) {
+        MoveRect m;
+        m.src_x = moves[i].SourcePoint.x;
+        m.src_y = moves[i].SourcePoint.y;
+        m.x = moves[i].DestinationRect.left;
+        m.y = moves[i].DestinationRect.top;
+        m.width = moves[i].DestinationRect.right - moves[i].DestinationRect.left;
+        m.height = moves[i].DestinationRect.bottom - moves[i].DestinationRect.top;
+        metadata.move_rects.push_back(m);
+      }
+
+      for (UINT i = 0; i < dirty_bytes / sizeof(RECT); ++i) {
+        DirtyRect r;
+        r.x = dirty[i].left;
+        r.y = dirty[i].top;
+        r.width = dirty[i].right - dirty[i].left;
+        r.height = dirty[i].bottom - dirty[i].top;
+        metadata.dirty_rects.push_back(r);
+      }
+
+      metadata.flags |= SC_FRAME_HAS_DIRTY_RECTS | SC_FRAME_HAS_MOVE_RECTS;
+    }
+    else if (0 == frame_info.LastPresentTime.QuadPart) {
+      metadata.flags |= SC_FRAME_HAS_DIRTY_RECTS | SC_FRAME_HAS_MOVE_RECTS;
+    }
+
+    tex->GetDesc(&desc);
+
+    DirtyRect r;
+    r.x = pointer_x;
+    r.y = pointer_y;
+    r.width = pointer_width;
+    r.height = pointer_height;
+
+    /* Also when the pointer didn't move but the content under it did, e.g. when scrolling. */
+    int num_broken = metadata.breakMoves(prev_pointer) + metadata.breakMoves(r);
+
+    if (0 != (metadata.flags & SC_FRAME_HAS_DIRTY_RECTS)
+        && (0 != frame_info.LastMouseUpdateTime.QuadPart || 0 < num_broken))
+      {
+        /* Clipped to the desktop image; the pointer can be partially outside. */
+        DirtyRect areas[2] = { prev_pointer, r };
+
+        for (int i = 0; i < 2; ++i) {
+          int x0 = std::max(0, areas[i].x);
+          int y0 = std::max(0, areas[i].y);
+          int x1 = std::min((int)desc.Width, areas[i].x + areas[i].width);
+          int y1 = std::min((int)desc.Height, areas[i].y + areas[i].height);
+          if (x1 > x0 && y1 > y0) {
+            areas[i].x = x0;
+            areas[i].y = y0;
+            areas[i].width = x1 - x0;
+            areas[i].height = y1 - y0;
+            metadata.dirty_rects.push_back(areas[i]);
+          }
+        }
+      }
+
+    /* The renderer samples linearly, a changed pixel touches its neighbours. */
+    metadata.fit(desc.Width, desc.Height, pixel_buffer.width, pixel_buffer.height, 1, 1);
+  }
+
   int ScreenCaptureDuplicateOutputDirect3D11::stop() {
     return 0;
   }
@@ -647,4 +755,13 @@ namespace sc {
       printf("Error: we received a pixel buffer, but we're only supprt BGRA atm.\n");
     }
   }
+
+  /* LastPresentTime is a QueryPerformanceCounter() value, the clock of `screencapture_get_time_ns()`. */
+  static uint64_t qpc_to_ns(LARGE_INTEGER t) {
+
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+
+    return (uint64_t)(t.QuadPart / freq.QuadPart) * 1000000000ull + (uint64_t)((t.QuadPart % freq.QuadPart) * 1000000000ll / freq.QuadPart);
+  }
 } /* namespace sc */
@@ -1,4 +1,5 @@
 #include <string>
+#include <algorithm>
 #include <stdio.h>
 #include <screencapture/win/ScreenCapturePointerDirect3D11.h>
 #include <screencapture/win/ScreenCaptureUtilsDirect3D11.h>
@@ -44,6 +45,8 @@ namespace sc {
   ScreenCapturePointerTextureDirect3D11::ScreenCapturePointerTextureDirect3D11(ID3D11Device* device, ID3D11DeviceContext* context)
     :width(0)
     ,height(0)
+    ,shape_id(-1)
+    ,last_used(0)
     ,device(device)
     ,context(context)
     ,texture(NULL)
@@ -141,7 +144,11 @@ namespace sc {
         return -7;
       }
 
-      memcpy(map.pData, pixels, w * h * 4);
+      /* The rows of the mapped texture may be padded. */
+      for (int j = 0; j < h; ++j) {
+        memcpy((uint8_t*)map.pData + j * map.RowPitch, pixels + j * w * 4, w * 4);
+      }
+      
       context->Unmap(texture, 0);
     }
 
@@ -169,6 +176,7 @@ namespace sc {
     ,vp_width(0.0f)
     ,vp_height(0.0f)
     ,curr_pointer(NULL)
+    ,clock(0)
   {
   }
 
@@ -532,7 +540,7 @@ namespace sc {
     context->Draw(4, 0);
   }
 
-  int ScreenCapturePointerDirect3D11::updatePointerPixels(int w, int h, uint8_t* pixels) {
+  int ScreenCapturePointerDirect3D11::updatePointerPixels(int w, int h, uint8_t* pixels, int id) {
     
     if (0 >= w) {
       printf("Error: cannot update the pointer pixels because the width is invalid: %d\n", w);
@@ -549,32 +557,64 @@ namespace sc {
       return -3;
     }
 
-    /* Find the texture. */
+    /* Find the texture of this shape, otherwise the least recently used one. */
     ScreenCapturePointerTextureDirect3D11* tex = NULL;
     for (size_t i = 0; i < pointers.size(); ++i) {
-      tex = pointers[i];
-      if (tex->width == w && tex->height == h) {
+      if (0 <= id && pointers[i]->shape_id == id) {
+        tex = pointers[i];
         break;
       }
-      tex = NULL;
+      if (NULL == tex || pointers[i]->last_used < tex->last_used) {
+        tex = pointers[i];
+      }
     }
 
-    if (NULL == tex) {
+    if (NULL == tex || (tex->shape_id != id && pointers.size() < SC_CURSOR_CACHE_SIZE)) {
       printf("Info: creating a new pointer texture.\n");
       tex = new ScreenCapturePointerTextureDirect3D11(device, context);
       pointers.push_back(tex);
     }
+    else if (tex->width != w || tex->height != h) {
+      /* We reuse the least recently used texture but its size doesn't match. */
+      ScreenCapturePointerTextureDirect3D11* resized = new ScreenCapturePointerTextureDirect3D11(device, context);
+      std::replace(pointers.begin(), pointers.end(), tex, resized);
+      if (curr_pointer == tex) {
+        curr_pointer = NULL;
+      }
+      delete tex;
+      tex = resized;
+    }
 
     if (0 != tex->updatePixels(w, h, pixels)) {
       printf("Error: failed to update the pointer pixels.\n");
+      tex->shape_id = -1;
       return -4;
     }
 
+    tex->shape_id = id;
+    tex->last_used = ++clock;
     curr_pointer = tex;
     
     return 0;
   }
 
+  int ScreenCapturePointerDirect3D11::selectPointer(int id) {
+
+    if (0 > id) {
+      return -1;
+    }
+
+    for (size_t i = 0; i < pointers.size(); ++i) {
+      if (pointers[i]->shape_id == id) {
+        pointers[i]->last_used = ++clock;
+        curr_pointer = pointers[i];
+        return 0;
+      }
+    }
+
+    return -2;
+  }
+
   int ScreenCapturePointerDirect3D11::shutdown() {
 
     device = NULL;
@@ -1,5 +1,6 @@
 #include <screencapture/win/ScreenCaptureRendererDirect3D11.h>
 #include <screencapture/win/ScreenCaptureUtilsDirect3D11.h>
+#include <screencapture/Scaler.h>
 #include <algorithm>
 
 static const std::string D3D11_SCALE_SHADER = ""
@@ -486,18 +487,20 @@ namespace sc {
         ZeroMemory(&desc, sizeof(desc));
         
         tex->GetDesc(&desc);
-        float width_ratio = float(settings.output_width) / desc.Width;
-        float height_ratio = float(settings.output_height) / desc.Height;
-        float scale_ratio = std::min<float>(width_ratio, height_ratio);
-        float new_width = scale_ratio * desc.Width;
-        float new_height = scale_ratio * desc.Height;
-
-        scale_viewport.TopLeftX = (settings.output_width - new_width) * 0.5;
-        scale_viewport.TopLeftY = (settings.output_height - new_height) * 0.5;
+
+        /* Letterboxed; the same rect that FrameInfo::fit() maps the dirty rects and pointer into. */
+        int vx = 0;
+        int vy = 0;
+        int vw = settings.output_width;
+        int vh = settings.output_height;
+        screencapture_get_fit_rect(desc.Width, desc.Height, settings.output_width, settings.output_height, 1, vx, vy, vw, vh);
+
+        scale_viewport.TopLeftX = (float)vx;
+        scale_viewport.TopLeftY = (float)vy;
         scale_viewport.MinDepth = 0.0f;
         scale_viewport.MaxDepth = 1.0f;
-        scale_viewport.Width = scale_ratio * desc.Width;
-        scale_viewport.Height = scale_ratio * desc.Height;
+        scale_viewport.Width = (float)vw;
+        scale_viewport.Height = (float)vh;
 
         pointer.setViewport(scale_viewport);
         pointer.setScale(scale_viewport.Width / desc.Width,scale_viewport.Height / desc.Height);